@@ -299,6 +299,17 @@ Status ServiceManager::checkService(const std::string& name, sp<IBinder>* outBin
     return Status::ok();
 }
 
+Status ServiceManager::checkServiceWithMetadata(const std::string& name,
+                                                ServiceWithMetadata* outService) {
+    outService->service = tryGetService(name, false);
+    // LazyServiceRegistrar registers a client callback right after adding the
+    // service, and before it can be shut down. Like the service itself, this
+    // is only reported to callers which can find the service.
+    outService->isLazyService =
+            outService->service != nullptr && mNameToClientCallback.count(name) > 0;
+    return Status::ok();
+}
+
 sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfNotFound) {
     auto ctx = mAccess->getCallingContext();
 
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android/os/IServiceManager.h>
+#include <benchmark/benchmark.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
+
+#include <vector>
+
+using android::defaultServiceManager;
+using android::IBinder;
+using android::interface_cast;
+using android::ProcessState;
+using android::sp;
+using android::String16;
+using android::String8;
+
+// Lookups of servicemanager itself, so the service is always there and isn't lazy.
+static const String16 kServiceName = String16("manager");
+
+// Looked up names, of which some may be lazy or not visible to this process.
+static constexpr size_t kMaxNames = 32;
+
+static std::vector<String16> getServiceNames() {
+    android::Vector<String16> all = defaultServiceManager()->listServices();
+    std::vector<String16> names;
+    for (size_t i = 0; i < all.size() && names.size() < kMaxNames; i++) {
+        names.push_back(all[i]);
+    }
+    return names;
+}
+
+// Through libbinder's IServiceManager, which caches the result.
+static void BM_checkService(benchmark::State& state) {
+    sp<android::IServiceManager> sm = defaultServiceManager();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sm->checkService(kServiceName));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_checkService)->ThreadRange(1, 16)->UseRealTime();
+
+// Straight to servicemanager, a transaction per lookup.
+static void BM_checkServiceUncached(benchmark::State& state) {
+    sp<android::os::IServiceManager> sm = interface_cast<android::os::IServiceManager>(
+            ProcessState::self()->getContextObject(nullptr));
+    const std::string name = String8(kServiceName).c_str();
+    for (auto _ : state) {
+        sp<IBinder> binder;
+        benchmark::DoNotOptimize(sm->checkService(name, &binder));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_checkServiceUncached)->ThreadRange(1, 16)->UseRealTime();
+
+// Like an app starting up, going over many different services.
+static void BM_checkServiceManyNames(benchmark::State& state) {
+    sp<android::IServiceManager> sm = defaultServiceManager();
+    std::vector<String16> names = getServiceNames();
+    if (names.empty()) {
+        state.SkipWithError("No services listed");
+        return;
+    }
+    size_t i = state.thread_index();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sm->checkService(names[i++ % names.size()]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_checkServiceManyNames)->ThreadRange(1, 16)->UseRealTime();
+
+int main(int argc, char** argv) {
+    // needed to receive the notifications which invalidate cached services
+    ProcessState::self()->startThreadPool();
+
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -16,6 +16,7 @@
 
 #include <android-base/properties.h>
 #include <android-base/strings.h>
+#include <android/os/BnClientCallback.h>
 #include <android/os/BnServiceCallback.h>
 #include <binder/Binder.h>
 #include <binder/IServiceManager.h>
@@ -267,6 +268,66 @@ TEST(GetService, NotAllowedFromIsolated) {
     EXPECT_EQ(nullptr, out.get());
 }
 
+TEST(CheckServiceWithMetadata, HappyHappy) {
+    auto sm = getPermissiveServiceManager();
+    sp<IBinder> service = getBinder();
+
+    EXPECT_TRUE(sm->addService("foo", service, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+
+    android::os::ServiceWithMetadata out;
+    EXPECT_TRUE(sm->checkServiceWithMetadata("foo", &out).isOk());
+    EXPECT_EQ(service, out.service);
+    EXPECT_FALSE(out.isLazyService);
+}
+
+TEST(CheckServiceWithMetadata, NonExistant) {
+    auto sm = getPermissiveServiceManager();
+
+    android::os::ServiceWithMetadata out;
+    EXPECT_TRUE(sm->checkServiceWithMetadata("foo", &out).isOk());
+    EXPECT_EQ(nullptr, out.service.get());
+    EXPECT_FALSE(out.isLazyService);
+}
+
+TEST(CheckServiceWithMetadata, LazyService) {
+    class LinkableClientCallback : public android::os::BnClientCallback {
+    public:
+        android::status_t linkToDeath(const sp<DeathRecipient>&, void*, uint32_t) override {
+            return android::OK;
+        }
+        android::binder::Status onClients(const sp<IBinder>&, bool) override {
+            return android::binder::Status::ok();
+        }
+    };
+
+    std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
+    MockAccess* accessPtr = access.get();
+    // registerClientCallback requires the caller to be the service
+    ON_CALL(*access, getCallingContext())
+            .WillByDefault(Return(Access::CallingContext{.debugPid = getpid()}));
+    ON_CALL(*access, canAdd(_, _)).WillByDefault(Return(true));
+    ON_CALL(*access, canFind(_, _)).WillByDefault(Return(true));
+    sp<ServiceManager> sm = sp<NiceMock<MockServiceManager>>::make(std::move(access));
+
+    sp<IBinder> service = getBinder();
+    EXPECT_TRUE(sm->addService("foo", service, false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    EXPECT_TRUE(
+            sm->registerClientCallback("foo", service, sp<LinkableClientCallback>::make()).isOk());
+
+    android::os::ServiceWithMetadata out;
+    EXPECT_TRUE(sm->checkServiceWithMetadata("foo", &out).isOk());
+    EXPECT_EQ(service, out.service);
+    EXPECT_TRUE(out.isLazyService);
+
+    // callers which can't find the service don't learn that it is lazy either
+    ON_CALL(*accessPtr, canFind(_, _)).WillByDefault(Return(false));
+    EXPECT_TRUE(sm->checkServiceWithMetadata("foo", &out).isOk());
+    EXPECT_EQ(nullptr, out.service.get());
+    EXPECT_FALSE(out.isLazyService);
+}
+
 TEST(ListServices, NoPermissions) {
     std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
 
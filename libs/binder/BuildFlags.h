@@ -28,4 +28,10 @@ constexpr bool kEnableKernelIpc = true;
 constexpr bool kEnableKernelIpc = false;
 #endif // BINDER_WITH_KERNEL_IPC
 
+#if defined(BINDER_WITH_RPC_REACTOR) && !defined(BINDER_RPC_SINGLE_THREADED)
+constexpr bool kEnableRpcReactor = true;
+#else  // BINDER_WITH_RPC_REACTOR
+constexpr bool kEnableRpcReactor = false;
+#endif // BINDER_WITH_RPC_REACTOR
+
 } // namespace android
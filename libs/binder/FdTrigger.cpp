@@ -58,6 +58,14 @@ bool FdTrigger::isTriggered() {
 #endif
 }
 
+binder::borrowed_fd FdTrigger::pollFd() const {
+#ifdef BINDER_RPC_SINGLE_THREADED
+    return binder::borrowed_fd(-1);
+#else
+    return mRead;
+#endif
+}
+
 status_t FdTrigger::triggerablePoll(const android::RpcTransportFd& transportFd, int16_t event) {
 #ifdef BINDER_RPC_SINGLE_THREADED
     if (mTriggered) {
@@ -57,6 +57,13 @@ public:
     [[nodiscard]] status_t triggerablePoll(const android::RpcTransportFd& transportFd,
                                            int16_t event);
 
+    /**
+     * For callers waiting on many FDs at once (e.g. with epoll), an FD which
+     * receives POLLHUP once this is triggered. Invalid in single-threaded
+     * builds.
+     */
+    [[nodiscard]] binder::borrowed_fd pollFd() const;
+
 private:
 #ifdef BINDER_RPC_SINGLE_THREADED
     bool mTriggered = false;
@@ -27,6 +27,7 @@
 #include <utils/Log.h>
 #include <utils/SystemClock.h>
 
+#include <algorithm>
 #include <atomic>
 #include <errno.h>
 #include <inttypes.h>
@@ -38,6 +39,7 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include "TransactionStatsTimer.h"
 #include "binder_module.h"
 
 #if LOG_NDEBUG
@@ -648,6 +650,13 @@ status_t IPCThreadState::getAndExecuteCommand()
                 mProcess->mStarvationStartTimeMs == 0) {
             mProcess->mStarvationStartTimeMs = uptimeMillis();
         }
+        mProcess->mPeakExecutingThreadsCount = std::max(mProcess->mPeakExecutingThreadsCount,
+                                                        mProcess->mExecutingThreadsCount);
+        if (mProcess->mAdaptiveIdleTimeoutMs != 0 &&
+            mProcess->mExecutingThreadsCount + mProcess->mAdaptiveMinIdleThreads >=
+                    mProcess->mCurrentThreads) {
+            mProcess->mLastPressureTimeMs = uptimeMillis();
+        }
         pthread_mutex_unlock(&mProcess->mThreadCountLock);
 
         result = executeCommand(cmd);
@@ -661,6 +670,8 @@ status_t IPCThreadState::getAndExecuteCommand()
                 ALOGE("binder thread pool (%zu threads) starved for %" PRId64 " ms",
                       mProcess->mMaxThreads, starvationTimeMs);
             }
+            mProcess->mStarvationCount++;
+            mProcess->mStarvationTimeMs += starvationTimeMs;
             mProcess->mStarvationStartTimeMs = 0;
         }
 
@@ -735,6 +746,7 @@ void IPCThreadState::joinThreadPool(bool isMain)
 
     mIsLooper = true;
     status_t result;
+    bool retired = false;
     do {
         processPendingDerefs();
         // now get the next command to be processed, waiting if necessary
@@ -750,6 +762,15 @@ void IPCThreadState::joinThreadPool(bool isMain)
         if(result == TIMED_OUT && !isMain) {
             break;
         }
+
+        // With setThreadPoolAdaptive, the pool also shrinks once it has been
+        // idle for long enough. Don't leave with commands still buffered.
+        if (result == NO_ERROR && !isMain && mIn.dataPosition() >= mIn.dataSize() &&
+            mProcess->shouldRetirePooledThread()) {
+            processPendingDerefs();
+            retired = true;
+            break;
+        }
     } while (result != -ECONNREFUSED && result != -EBADF);
 
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS LEAVING THE THREAD POOL err=%d\n",
@@ -764,6 +785,9 @@ void IPCThreadState::joinThreadPool(bool isMain)
                         "threadpool\n"
                         "Misconfiguration. Increase threadpool max threads configuration\n");
     mProcess->mCurrentThreads--;
+    if (retired) {
+        mProcess->onPooledThreadRetiredLocked();
+    }
     pthread_mutex_unlock(&mProcess->mThreadCountLock);
 }
 
@@ -815,6 +839,15 @@ status_t IPCThreadState::transact(int32_t handle,
 
     flags |= TF_ACCEPT_FDS;
 
+    binder::impl::TransactionStatsTimer statsTimer;
+    auto recordStats = [&](status_t status) {
+        if (!statsTimer.active()) return;
+        size_t descriptorLen;
+        const char16_t* descriptor = data.peekInterfaceToken(&descriptorLen);
+        statsTimer.finish(descriptor, descriptorLen, code, flags, data.dataSize(),
+                          reply ? reply->dataSize() : 0, status, 0 /*queueDelayNs*/);
+    };
+
     IF_LOG_TRANSACTIONS() {
         std::ostringstream logStream;
         logStream << "BC_TRANSACTION thr " << (void*)pthread_self() << " / hand " << handle
@@ -829,6 +862,7 @@ status_t IPCThreadState::transact(int32_t handle,
 
     if (err != NO_ERROR) {
         if (reply) reply->setError(err);
+        recordStats(err);
         return (mLastError = err);
     }
 
@@ -879,6 +913,7 @@ status_t IPCThreadState::transact(int32_t handle,
         err = waitForResponse(nullptr, nullptr);
     }
 
+    recordStats(err);
     return err;
 }
 
@@ -21,6 +21,8 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <atomic>
+
 #include <android-base/properties.h>
 #include <android/os/BnServiceCallback.h>
 #include <android/os/IServiceManager.h>
@@ -112,7 +114,47 @@ public:
     }
 
 protected:
+    // Services found by checkService, so that later lookups don't need a
+    // transaction to servicemanager. Entries are dropped when the service dies,
+    // or when servicemanager notifies that another binder was registered under
+    // the same name. Lazy services aren't cached, since holding them would keep
+    // them running.
+    class ServiceCache : public android::os::BnServiceCallback, public IBinder::DeathRecipient {
+    public:
+        // nullptr if not cached
+        sp<IBinder> get(const std::string& name);
+        void put(const sp<AidlServiceManager>& sm, const std::string& name,
+                 const sp<IBinder>& binder);
+        void invalidate(const std::string& name);
+
+        Status onRegistration(const std::string& name, const sp<IBinder>& binder) override;
+        void binderDied(const wp<IBinder>& who) override;
+
+    private:
+        struct Entry {
+            sp<IBinder> binder;
+            // binder this entry holds a death link on, kept while the entry
+            // is invalidated so that caching it again doesn't link again
+            wp<IBinder> linked;
+            // last binder servicemanager notified for this name
+            wp<IBinder> registered;
+            bool registeredForNotifications = false;
+        };
+        std::mutex mLock;
+        std::map<std::string, Entry> mEntries;
+    };
+
+    // Notifications are only received while the threadpool is running, so
+    // the cache can't be invalidated without it.
+    bool useServiceCache() const {
+        return mCheckServiceWithMetadataSupported.load(std::memory_order_relaxed) &&
+                ProcessState::self()->isThreadPoolStarted();
+    }
+
     sp<AidlServiceManager> mTheRealServiceManager;
+    sp<ServiceCache> mServiceCache = sp<ServiceCache>::make();
+    // false when talking to a servicemanager which predates the method
+    mutable std::atomic<bool> mCheckServiceWithMetadataSupported = true;
     // AidlRegistrationCallback -> services that its been registered for
     // notifications.
     using LocalRegistrationAndWaiter =
@@ -317,8 +359,24 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 
 sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
 {
+    const std::string name8 = String8(name).c_str();
+    if (sp<IBinder> cached = mServiceCache->get(name8); cached != nullptr) return cached;
+
+    if (useServiceCache()) {
+        os::ServiceWithMetadata out;
+        Status status = mTheRealServiceManager->checkServiceWithMetadata(name8, &out);
+        if (status.isOk()) {
+            if (out.service != nullptr && !out.isLazyService) {
+                mServiceCache->put(mTheRealServiceManager, name8, out.service);
+            }
+            return out.service;
+        }
+        if (status.transactionError() != UNKNOWN_TRANSACTION) return nullptr;
+        mCheckServiceWithMetadataSupported = false;
+    }
+
     sp<IBinder> ret;
-    if (!mTheRealServiceManager->checkService(String8(name).c_str(), &ret).isOk()) {
+    if (!mTheRealServiceManager->checkService(name8, &ret).isOk()) {
         return nullptr;
     }
     return ret;
@@ -327,11 +385,106 @@ sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
 status_t ServiceManagerShim::addService(const String16& name, const sp<IBinder>& service,
                                         bool allowIsolated, int dumpsysPriority)
 {
+    const std::string name8 = String8(name).c_str();
     Status status = mTheRealServiceManager->addService(
-        String8(name).c_str(), service, allowIsolated, dumpsysPriority);
+        name8, service, allowIsolated, dumpsysPriority);
+    // the notification would come later
+    mServiceCache->invalidate(name8);
     return status.exceptionCode();
 }
 
+sp<IBinder> ServiceManagerShim::ServiceCache::get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mEntries.find(name);
+    if (it == mEntries.end() || it->second.binder == nullptr) return nullptr;
+    // in case the death notification hasn't been processed yet
+    if (!it->second.binder->isBinderAlive()) {
+        it->second.binder = nullptr;
+        return nullptr;
+    }
+    return it->second.binder;
+}
+
+void ServiceManagerShim::ServiceCache::put(const sp<AidlServiceManager>& sm,
+                                           const std::string& name, const sp<IBinder>& binder) {
+    bool needsRegistration;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        Entry& entry = mEntries[name];
+        needsRegistration = !entry.registeredForNotifications;
+        entry.registeredForNotifications = true;
+    }
+
+    // Already registered names are notified of any new registration, so this
+    // only happens once per name.
+    if (needsRegistration) {
+        if (Status status = sm->registerForNotifications(name, sp<ServiceCache>::fromExisting(this));
+            !status.isOk()) {
+            ALOGW("Not caching %s, failed to registerForNotifications: %s", name.c_str(),
+                  status.toString8().c_str());
+            std::lock_guard<std::mutex> lock(mLock);
+            mEntries[name].registeredForNotifications = false;
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mLock);
+    Entry& entry = mEntries[name];
+    // Replaced since it was looked up. Whether the notification for the
+    // registration was already received or not, the binder can't be cached.
+    sp<IBinder> registered = entry.registered.promote();
+    if (registered != nullptr && registered != binder) return;
+
+    // Only link once per binder, a miss after invalidate() usually returns
+    // the same one.
+    if (sp<IBinder> linked = entry.linked.promote(); linked != binder) {
+        if (linked != nullptr) {
+            linked->unlinkToDeath(sp<ServiceCache>::fromExisting(this));
+        }
+        entry.linked.clear();
+        if (binder->remoteBinder() != nullptr) {
+            if (status_t status = binder->linkToDeath(sp<ServiceCache>::fromExisting(this));
+                status != OK) {
+                return;
+            }
+            entry.linked = binder;
+        }
+    }
+    entry.binder = binder;
+}
+
+void ServiceManagerShim::ServiceCache::invalidate(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mLock);
+    if (auto it = mEntries.find(name); it != mEntries.end()) {
+        it->second.binder = nullptr;
+    }
+}
+
+Status ServiceManagerShim::ServiceCache::onRegistration(const std::string& name,
+                                                        const sp<IBinder>& binder) {
+    std::lock_guard<std::mutex> lock(mLock);
+    Entry& entry = mEntries[name];
+    entry.registered = binder;
+    if (entry.binder != binder) entry.binder = nullptr;
+    // the old binder won't be cached under this name again
+    if (sp<IBinder> linked = entry.linked.promote(); linked != nullptr && linked != binder) {
+        linked->unlinkToDeath(sp<ServiceCache>::fromExisting(this));
+        entry.linked.clear();
+    }
+    return Status::ok();
+}
+
+void ServiceManagerShim::ServiceCache::binderDied(const wp<IBinder>& who) {
+    std::lock_guard<std::mutex> lock(mLock);
+    for (auto& [name, entry] : mEntries) {
+        if (entry.binder != nullptr && entry.binder.get() == who.unsafe_get()) {
+            entry.binder = nullptr;
+        }
+        // death notifications are only sent once
+        if (entry.linked == who) entry.linked.clear();
+    }
+}
+
 Vector<String16> ServiceManagerShim::listServices(int dumpsysPriority)
 {
     std::vector<std::string> ret;
@@ -377,6 +530,8 @@ sp<IBinder> ServiceManagerShim::waitForService(const String16& name16)
 
     const std::string name = String8(name16).c_str();
 
+    if (sp<IBinder> cached = mServiceCache->get(name); cached != nullptr) return cached;
+
     sp<IBinder> out;
     if (Status status = realGetService(name, &out); !status.isOk()) {
         ALOGW("Failed to getService in waitForService for %s: %s", name.c_str(),
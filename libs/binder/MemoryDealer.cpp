@@ -37,6 +37,11 @@
 #include <sys/mman.h>
 #include <sys/file.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -121,10 +126,11 @@ private:
 
 class SimpleBestFitAllocator
 {
+public:
     enum {
         PAGE_ALIGNED = 0x00000001
     };
-public:
+
     explicit SimpleBestFitAllocator(size_t size);
     ~SimpleBestFitAllocator();
 
@@ -162,6 +168,75 @@ private:
 
 // ----------------------------------------------------------------------------
 
+/*
+ * Size class allocator for small blocks. Slabs of kSlabSize bytes are taken
+ * from a SimpleBestFitAllocator, and each one is cut into blocks of a single
+ * size class. Free blocks are kept on lock-free stacks, a few per size class,
+ * and each thread starts with its own one. All bookkeeping is kept outside
+ * of the heap, since the heap may be read-only or shared with other processes.
+ */
+class SlabAllocator
+{
+public:
+    explicit SlabAllocator(SimpleBestFitAllocator* backing);
+    ~SlabAllocator();
+
+    static constexpr size_t kMaxBlockSize = 8 * 1024;
+
+    // 0 < size <= kMaxBlockSize
+    ssize_t     allocate(size_t size);
+    // returns NAME_NOT_FOUND if offset isn't in a slab
+    status_t    deallocate(size_t offset);
+    void        dump(String8& res) const;
+
+private:
+    static constexpr size_t kSlabSize = 64 * 1024;
+    static constexpr size_t kNumSizeClasses = 16;
+    static constexpr size_t kNumShards = 4;
+    static const size_t kBlockSizes[kNumSizeClasses];
+
+    // Block ids are (slab index << 16 | block index). Links hold the next
+    // block id + 1, 0 at the end of a stack, or kAllocated.
+    static constexpr uint32_t kAllocated = UINT32_MAX;
+
+    struct slab_t {
+        size_t start;
+        size_t sizeClass;
+        size_t blockSize;
+        size_t numBlocks;
+        std::unique_ptr<std::atomic<uint32_t>[]> links;
+    };
+
+    // (pop count << 32) | (block id + 1), so that a head which was popped
+    // and pushed again in between doesn't compare equal.
+    struct alignas(64) free_stack_t {
+        std::atomic<uint64_t> head{0};
+    };
+
+    static size_t sizeClassOf(size_t size);
+    static size_t shardOfThisThread();
+
+    std::atomic<uint32_t>& linkOf(uint32_t block) const;
+    size_t  offsetOf(uint32_t block) const;
+    bool    pop(free_stack_t& stack, uint32_t* block);
+    void    push(free_stack_t& stack, uint32_t first, uint32_t last);
+    bool    grow_l(size_t sizeClass, size_t shard, uint32_t* block);
+
+    SimpleBestFitAllocator* const mBacking;
+    const size_t mPageSize;
+    const size_t mNumPages;
+    const size_t mMaxSlabs;
+    // slab index + 1 for each page of a slab, 0 for other pages
+    std::unique_ptr<std::atomic<uint32_t>[]> mPageToSlab;
+    std::unique_ptr<std::atomic<slab_t*>[]> mSlabs;
+    std::atomic<size_t> mNumSlabs;
+    std::mutex mGrowLock;
+    free_stack_t mFree[kNumSizeClasses][kNumShards];
+    std::atomic<size_t> mAllocated[kNumSizeClasses];
+};
+
+// ----------------------------------------------------------------------------
+
 Allocation::Allocation(
         const sp<MemoryDealer>& dealer,
         const sp<IMemoryHeap>& heap, ssize_t offset, size_t size)
@@ -227,18 +302,32 @@ Allocation::~Allocation()
 // ----------------------------------------------------------------------------
 
 MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags)
+      : MemoryDealer(size, name, flags, AllocatorType::BEST_FIT) {}
+
+MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags, AllocatorType type)
       : mHeap(sp<MemoryHeapBase>::make(size, flags, name)),
-        mAllocator(new SimpleBestFitAllocator(size)) {}
+        mAllocator(new SimpleBestFitAllocator(size)),
+        mSlabAllocator(type == AllocatorType::SLAB ? new SlabAllocator(mAllocator) : nullptr) {}
 
 MemoryDealer::~MemoryDealer()
 {
+    delete mSlabAllocator;
     delete mAllocator;
 }
 
 sp<IMemory> MemoryDealer::allocate(size_t size)
 {
     sp<IMemory> memory;
-    const ssize_t offset = allocator()->allocate(size);
+    ssize_t offset;
+    if (mSlabAllocator != nullptr && size != 0 && size <= SlabAllocator::kMaxBlockSize) {
+        offset = mSlabAllocator->allocate(size);
+        if (offset < 0) {
+            // no room for another slab, the remaining space may still fit
+            offset = allocator()->allocate(size);
+        }
+    } else {
+        offset = allocator()->allocate(size);
+    }
     if (offset >= 0) {
         memory = sp<Allocation>::make(sp<MemoryDealer>::fromExisting(this), heap(), offset, size);
     }
@@ -247,12 +336,20 @@ sp<IMemory> MemoryDealer::allocate(size_t size)
 
 void MemoryDealer::deallocate(size_t offset)
 {
+    if (mSlabAllocator != nullptr && mSlabAllocator->deallocate(offset) != NAME_NOT_FOUND) {
+        return;
+    }
     allocator()->deallocate(offset);
 }
 
 void MemoryDealer::dump(const char* what) const
 {
     allocator()->dump(what);
+    if (mSlabAllocator != nullptr) {
+        String8 result;
+        mSlabAllocator->dump(result);
+        ALOGD("%s", result.c_str());
+    }
 }
 
 const sp<IMemoryHeap>& MemoryDealer::heap() const {
@@ -477,5 +574,200 @@ void SimpleBestFitAllocator::dump_l(String8& result,
     result.append(buffer);
 }
 
+// ----------------------------------------------------------------------------
+
+const size_t SlabAllocator::kBlockSizes[kNumSizeClasses] = {
+    32, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192,
+};
+
+SlabAllocator::SlabAllocator(SimpleBestFitAllocator* backing)
+    : mBacking(backing),
+      mPageSize(getpagesize()),
+      mNumPages(backing->size() / mPageSize),
+      // block ids have 16 bits for the slab index
+      mMaxSlabs(std::min<size_t>(backing->size() / kSlabSize, UINT16_MAX)),
+      mPageToSlab(new std::atomic<uint32_t>[mNumPages]),
+      mSlabs(new std::atomic<slab_t*>[mMaxSlabs]),
+      mNumSlabs(0)
+{
+    LOG_ALWAYS_FATAL_IF(kSlabSize % mPageSize != 0, "slab size %zu is not a multiple of %zu",
+            kSlabSize, mPageSize);
+    for (size_t i = 0; i < mNumPages; i++) {
+        mPageToSlab[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < mMaxSlabs; i++) {
+        mSlabs[i].store(nullptr, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < kNumSizeClasses; i++) {
+        mAllocated[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    // the slabs themselves go away with the backing allocator
+    for (size_t i = 0; i < mNumSlabs.load(std::memory_order_relaxed); i++) {
+        delete mSlabs[i].load(std::memory_order_relaxed);
+    }
+}
+
+size_t SlabAllocator::sizeClassOf(size_t size)
+{
+    size_t sizeClass = 0;
+    while (kBlockSizes[sizeClass] < size) sizeClass++;
+    return sizeClass;
+}
+
+size_t SlabAllocator::shardOfThisThread()
+{
+    static std::atomic<size_t> sNextShard(0);
+    thread_local size_t tShard = sNextShard.fetch_add(1, std::memory_order_relaxed) % kNumShards;
+    return tShard;
+}
+
+std::atomic<uint32_t>& SlabAllocator::linkOf(uint32_t block) const
+{
+    slab_t* slab = mSlabs[block >> 16].load(std::memory_order_acquire);
+    return slab->links[block & 0xffff];
+}
+
+size_t SlabAllocator::offsetOf(uint32_t block) const
+{
+    slab_t* slab = mSlabs[block >> 16].load(std::memory_order_acquire);
+    return slab->start + (block & 0xffff) * slab->blockSize;
+}
+
+bool SlabAllocator::pop(free_stack_t& stack, uint32_t* block)
+{
+    uint64_t head = stack.head.load(std::memory_order_acquire);
+    while (uint32_t(head) != 0) {
+        const uint32_t top = uint32_t(head) - 1;
+        // may be stale if another thread pops top first, but then the
+        // exchange below fails
+        const uint32_t next = linkOf(top).load(std::memory_order_relaxed);
+        const uint64_t newHead = (((head >> 32) + 1) << 32) | next;
+        if (stack.head.compare_exchange_weak(head, newHead, std::memory_order_acquire,
+                    std::memory_order_acquire)) {
+            *block = top;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SlabAllocator::push(free_stack_t& stack, uint32_t first, uint32_t last)
+{
+    uint64_t head = stack.head.load(std::memory_order_relaxed);
+    uint64_t newHead;
+    do {
+        linkOf(last).store(uint32_t(head), std::memory_order_relaxed);
+        newHead = (head & ~uint64_t(UINT32_MAX)) | (first + 1);
+    } while (!stack.head.compare_exchange_weak(head, newHead, std::memory_order_release,
+                std::memory_order_relaxed));
+}
+
+bool SlabAllocator::grow_l(size_t sizeClass, size_t shard, uint32_t* block)
+{
+    const size_t index = mNumSlabs.load(std::memory_order_relaxed);
+    if (index == mMaxSlabs) {
+        return false;
+    }
+    const ssize_t start = mBacking->allocate(kSlabSize, SimpleBestFitAllocator::PAGE_ALIGNED);
+    if (start < 0) {
+        return false;
+    }
+
+    slab_t* slab = new slab_t;
+    slab->start = start;
+    slab->sizeClass = sizeClass;
+    slab->blockSize = kBlockSizes[sizeClass];
+    slab->numBlocks = kSlabSize / slab->blockSize;
+    slab->links.reset(new std::atomic<uint32_t>[slab->numBlocks]);
+
+    // block 0 goes to the caller, the others are chained for the free stack
+    const uint32_t first = uint32_t(index << 16);
+    slab->links[0].store(kAllocated, std::memory_order_relaxed);
+    for (size_t i = 1; i + 1 < slab->numBlocks; i++) {
+        slab->links[i].store(first + i + 2, std::memory_order_relaxed);
+    }
+    mSlabs[index].store(slab, std::memory_order_release);
+    for (size_t page = start / mPageSize; page < (start + kSlabSize) / mPageSize; page++) {
+        mPageToSlab[page].store(index + 1, std::memory_order_release);
+    }
+    mNumSlabs.store(index + 1, std::memory_order_release);
+
+    if (slab->numBlocks > 1) {
+        push(mFree[sizeClass][shard], first + 1, first + slab->numBlocks - 1);
+    }
+    *block = first;
+    return true;
+}
+
+ssize_t SlabAllocator::allocate(size_t size)
+{
+    const size_t sizeClass = sizeClassOf(size);
+    const size_t shard = shardOfThisThread();
+
+    uint32_t block;
+    bool found = false;
+    for (size_t i = 0; i < kNumShards && !found; i++) {
+        found = pop(mFree[sizeClass][(shard + i) % kNumShards], &block);
+    }
+    if (!found) {
+        std::unique_lock<std::mutex> _l(mGrowLock);
+        // another thread may have added a slab in the meantime
+        found = pop(mFree[sizeClass][shard], &block) || grow_l(sizeClass, shard, &block);
+        if (!found) {
+            return NO_MEMORY;
+        }
+    }
+
+    linkOf(block).store(kAllocated, std::memory_order_relaxed);
+    mAllocated[sizeClass].fetch_add(1, std::memory_order_relaxed);
+    return offsetOf(block);
+}
+
+status_t SlabAllocator::deallocate(size_t offset)
+{
+    const size_t page = offset / mPageSize;
+    if (page >= mNumPages) {
+        return NAME_NOT_FOUND;
+    }
+    const uint32_t slabIndex = mPageToSlab[page].load(std::memory_order_acquire);
+    if (slabIndex == 0) {
+        return NAME_NOT_FOUND;
+    }
+    slab_t* slab = mSlabs[slabIndex - 1].load(std::memory_order_acquire);
+    const size_t index = (offset - slab->start) / slab->blockSize;
+    LOG_ALWAYS_FATAL_IF(slab->start + index * slab->blockSize != offset,
+            "offset 0x%08zX is not the start of a block of size 0x%08zX", offset,
+            slab->blockSize);
+
+    const uint32_t block = uint32_t((slabIndex - 1) << 16 | index);
+    const uint32_t link = slab->links[index].exchange(0, std::memory_order_relaxed);
+    LOG_ALWAYS_FATAL_IF(link != kAllocated, "block at offset 0x%08zX of size 0x%08zX already freed",
+            offset, slab->blockSize);
+    push(mFree[slab->sizeClass][shardOfThisThread()], block, block);
+    mAllocated[slab->sizeClass].fetch_sub(1, std::memory_order_relaxed);
+    return NO_ERROR;
+}
+
+void SlabAllocator::dump(String8& result) const
+{
+    size_t slabs[kNumSizeClasses] = {};
+    const size_t numSlabs = mNumSlabs.load(std::memory_order_acquire);
+    for (size_t i = 0; i < numSlabs; i++) {
+        slabs[mSlabs[i].load(std::memory_order_acquire)->sizeClass]++;
+    }
+
+    result.appendFormat("  slabs (%p, %zu of %zu used)\n", this, numSlabs, mMaxSlabs);
+    for (size_t i = 0; i < kNumSizeClasses; i++) {
+        if (slabs[i] == 0) continue;
+        result.appendFormat("  %5zu: %zu slabs, %zu of %zu blocks allocated\n", kBlockSizes[i],
+                slabs[i], mAllocated[i].load(std::memory_order_relaxed),
+                slabs[i] * (kSlabSize / kBlockSizes[i]));
+    }
+}
+
 
 } // namespace android
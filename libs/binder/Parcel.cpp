@@ -48,6 +48,7 @@
 #include <utils/String8.h>
 
 #include "OS.h"
+#include "ParcelBufferPool.h"
 #include "RpcState.h"
 #include "Static.h"
 #include "Utils.h"
@@ -485,6 +486,18 @@ status_t Parcel::setDataCapacity(size_t size)
     return NO_ERROR;
 }
 
+status_t Parcel::reserve(size_t len)
+{
+    if (len > INT32_MAX) {
+        // don't accept size_t values which may have come from an
+        // inadvertent conversion from a negative int.
+        return BAD_VALUE;
+    }
+    if (len > SIZE_MAX - mDataPos) return NO_MEMORY; // overflow
+
+    return setDataCapacity(mDataPos + len);
+}
+
 status_t Parcel::setData(const uint8_t* buffer, size_t len)
 {
     if (len > INT32_MAX) {
@@ -970,6 +983,40 @@ bool Parcel::checkInterface(IBinder* binder) const
     return enforceInterface(binder->getInterfaceDescriptor());
 }
 
+const char16_t* Parcel::peekInterfaceToken(size_t* outLen) const {
+    *outLen = 0;
+
+    size_t position;
+    if (auto* kernelFields = maybeKernelFields()) {
+        if (!kernelFields->mRequestHeaderPresent) return nullptr;
+        // after the work source and the vendor header
+        position = kernelFields->mWorkSourceRequestHeaderPosition + 2 * sizeof(int32_t);
+    } else {
+        // RPC parcels don't mark the token, so only a plausible descriptor at
+        // the start is accepted
+        position = 0;
+    }
+
+    int32_t size;
+    if (position > mDataSize || mDataSize - position < sizeof(size)) return nullptr;
+    memcpy(&size, mData + position, sizeof(size));
+    if (size <= 0 || size > 255) return nullptr;
+    position += sizeof(size);
+
+    size_t byteSize = (size + 1) * sizeof(char16_t);
+    if (mDataSize - position < byteSize) return nullptr;
+    const char16_t* str = reinterpret_cast<const char16_t*>(mData + position);
+    if (str[size] != u'\0') return nullptr;
+    if (maybeRpcFields() != nullptr) {
+        for (int32_t i = 0; i < size; i++) {
+            if (str[i] <= u' ' || str[i] > u'~') return nullptr;
+        }
+    }
+
+    *outLen = size;
+    return str;
+}
+
 bool Parcel::enforceInterface(const String16& interface,
                               IPCThreadState* threadState) const
 {
@@ -2879,7 +2926,7 @@ void Parcel::freeDataNoInit()
             if (mDeallocZero) {
                 zeroMemory(mData, mDataSize);
             }
-            free(mData);
+            parcelBufferFree(mData);
         }
         auto* kernelFields = maybeKernelFields();
         if (kernelFields && kernelFields->mObjects) free(kernelFields->mObjects);
@@ -2904,16 +2951,18 @@ status_t Parcel::growData(size_t len)
 
 static uint8_t* reallocZeroFree(uint8_t* data, size_t oldCapacity, size_t newCapacity, bool zero) {
     if (!zero) {
-        return (uint8_t*)realloc(data, newCapacity);
+        return parcelBufferRealloc(data, newCapacity);
     }
-    uint8_t* newData = (uint8_t*)malloc(newCapacity);
+    uint8_t* newData = parcelBufferAlloc(newCapacity);
     if (!newData) {
         return nullptr;
     }
 
-    memcpy(newData, data, std::min(oldCapacity, newCapacity));
-    zeroMemory(data, oldCapacity);
-    free(data);
+    if (data) {
+        memcpy(newData, data, std::min(oldCapacity, newCapacity));
+        zeroMemory(data, oldCapacity);
+    }
+    parcelBufferFree(data);
     return newData;
 }
 
@@ -3016,7 +3065,7 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        uint8_t* data = parcelBufferAlloc(desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -3026,7 +3075,7 @@ status_t Parcel::continueWrite(size_t desired)
         if (kernelFields && objectsSize) {
             objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                parcelBufferFree(data);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -3041,7 +3090,7 @@ status_t Parcel::continueWrite(size_t desired)
         }
         if (rpcFields) {
             if (status_t status = truncateRpcObjects(objectsSize); status != OK) {
-                free(data);
+                parcelBufferFree(data);
                 return status;
             }
         }
@@ -3118,7 +3167,8 @@ status_t Parcel::continueWrite(size_t desired)
             }
         }
 
-        // We own the data, so we can just do a realloc().
+        // We own the data, so we can just do a realloc(). This doesn't allocate
+        // while the size fits in the pooled buffer we already have.
         if (desired > mDataCapacity) {
             uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
             if (data) {
@@ -3145,7 +3195,7 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        uint8_t* data = parcelBufferAlloc(desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ParcelBufferPool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cstddef>
+
+namespace android::binder::impl {
+
+namespace {
+
+// Stored in front of each buffer, so that buffers can be freed without
+// knowing their size.
+struct alignas(std::max_align_t) BufferHeader {
+    size_t capacity;
+};
+
+// Parcel allocates at least this much
+constexpr size_t kMinPooledSize = 128;
+constexpr size_t kNumSizeClasses = 8;
+static_assert(kMinPooledSize << (kNumSizeClasses - 1) == kParcelBufferMaxPooledSize);
+
+bool isPooled(size_t capacity) {
+    return capacity >= kMinPooledSize && capacity <= kParcelBufferMaxPooledSize &&
+            (capacity & (capacity - 1)) == 0;
+}
+
+size_t capacityFor(size_t size) {
+    if (size > kParcelBufferMaxPooledSize) return size;
+    size_t capacity = kMinPooledSize;
+    while (capacity < size) capacity <<= 1;
+    return capacity;
+}
+
+BufferHeader* headerOf(uint8_t* data) {
+    return reinterpret_cast<BufferHeader*>(data) - 1;
+}
+
+uint8_t* dataOf(BufferHeader* header) {
+    return reinterpret_cast<uint8_t*>(header + 1);
+}
+
+BufferHeader* mallocBuffer(size_t capacity) {
+    if (capacity > SIZE_MAX - sizeof(BufferHeader)) return nullptr;
+    auto* header = static_cast<BufferHeader*>(malloc(sizeof(BufferHeader) + capacity));
+    if (header == nullptr) return nullptr;
+    header->capacity = capacity;
+    return header;
+}
+
+#ifndef __TRUSTY__
+
+// enough for the data and reply of a few nested transactions
+constexpr size_t kMaxCachedPerSizeClass = 4;
+
+size_t sizeClass(size_t capacity) {
+    size_t index = 0;
+    while ((kMinPooledSize << index) < capacity) index++;
+    return index;
+}
+
+// Trivially destructible, so that it can still be checked while other
+// thread_local objects are destroyed.
+thread_local bool tThreadCacheDestroyed = false;
+
+class ThreadCache {
+public:
+    ~ThreadCache() {
+        tThreadCacheDestroyed = true;
+        for (size_t i = 0; i < kNumSizeClasses; i++) {
+            for (size_t j = 0; j < mCounts[i]; j++) {
+                free(mBuffers[i][j]);
+            }
+        }
+    }
+
+    BufferHeader* take(size_t capacity) {
+        size_t index = sizeClass(capacity);
+        if (mCounts[index] == 0) return nullptr;
+        return mBuffers[index][--mCounts[index]];
+    }
+
+    bool put(BufferHeader* header) {
+        size_t index = sizeClass(header->capacity);
+        if (mCounts[index] == kMaxCachedPerSizeClass) return false;
+        mBuffers[index][mCounts[index]++] = header;
+        return true;
+    }
+
+private:
+    BufferHeader* mBuffers[kNumSizeClasses][kMaxCachedPerSizeClass];
+    size_t mCounts[kNumSizeClasses] = {};
+};
+
+thread_local ThreadCache tThreadCache;
+
+ThreadCache* threadCache() {
+    if (tThreadCacheDestroyed) return nullptr;
+    return &tThreadCache;
+}
+
+#else // __TRUSTY__
+
+// Not every Trusty environment has thread local storage, so nothing is cached.
+class ThreadCache {
+public:
+    BufferHeader* take(size_t) { return nullptr; }
+    bool put(BufferHeader*) { return false; }
+};
+
+ThreadCache* threadCache() {
+    return nullptr;
+}
+
+#endif // __TRUSTY__
+
+} // namespace
+
+uint8_t* parcelBufferAlloc(size_t size) {
+    size_t capacity = capacityFor(size);
+
+    BufferHeader* header = nullptr;
+    if (isPooled(capacity)) {
+        if (ThreadCache* cache = threadCache(); cache != nullptr) {
+            header = cache->take(capacity);
+        }
+    }
+    if (header == nullptr) header = mallocBuffer(capacity);
+    return header == nullptr ? nullptr : dataOf(header);
+}
+
+uint8_t* parcelBufferRealloc(uint8_t* data, size_t size) {
+    if (data == nullptr) return parcelBufferAlloc(size);
+    if (size == 0) {
+        parcelBufferFree(data);
+        return nullptr;
+    }
+
+    BufferHeader* header = headerOf(data);
+    size_t capacity = capacityFor(size);
+    if (isPooled(header->capacity) && capacity <= header->capacity) return data;
+
+    if (!isPooled(header->capacity) && !isPooled(capacity)) {
+        // too large to be cached, so let malloc resize it in place if it can
+        auto* resized =
+                static_cast<BufferHeader*>(realloc(header, sizeof(BufferHeader) + capacity));
+        if (resized == nullptr) return nullptr;
+        resized->capacity = capacity;
+        return dataOf(resized);
+    }
+
+    uint8_t* newData = parcelBufferAlloc(size);
+    if (newData == nullptr) return nullptr;
+    memcpy(newData, data, std::min(header->capacity, capacity));
+    parcelBufferFree(data);
+    return newData;
+}
+
+void parcelBufferFree(uint8_t* data) {
+    if (data == nullptr) return;
+
+    BufferHeader* header = headerOf(data);
+    if (isPooled(header->capacity)) {
+        if (ThreadCache* cache = threadCache(); cache != nullptr && cache->put(header)) return;
+    }
+    free(header);
+}
+
+} // namespace android::binder::impl
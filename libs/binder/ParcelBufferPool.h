@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <cstdint>
+
+namespace android::binder::impl {
+
+/**
+ * Allocator for data buffers of parcels and RPC transactions.
+ *
+ * Sizes up to kParcelBufferMaxPooledSize are rounded up to a power of two,
+ * and freed buffers of those sizes are kept in a small per-thread cache. A
+ * thread which keeps sending and receiving transactions of similar sizes
+ * reuses the same buffers, instead of going through malloc and free each
+ * time. Larger buffers aren't cached.
+ *
+ * Buffers from these functions can only be released with parcelBufferFree.
+ * They are aligned like malloc. nullptr is returned if memory can't be
+ * allocated.
+ */
+constexpr size_t kParcelBufferMaxPooledSize = 16 * 1024;
+
+uint8_t* parcelBufferAlloc(size_t size);
+
+// Like realloc, except that a zero size frees the buffer and returns nullptr.
+uint8_t* parcelBufferRealloc(uint8_t* data, size_t size);
+
+// OK to call with nullptr
+void parcelBufferFree(uint8_t* data);
+
+} // namespace android::binder::impl
@@ -28,6 +28,7 @@
 #include <utils/AndroidThreads.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
+#include <utils/SystemClock.h>
 #include <utils/Thread.h>
 
 #include "Static.h"
@@ -36,6 +37,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -44,6 +46,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <mutex>
 
 #define BINDER_VM_SIZE ((1 * 1024 * 1024) - sysconf(_SC_PAGE_SIZE) * 2)
@@ -422,7 +425,11 @@ status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     LOG_ALWAYS_FATAL_IF(mThreadPoolStarted && maxThreads < mMaxThreads,
            "Binder threadpool cannot be shrunk after starting");
     status_t result = NO_ERROR;
-    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &maxThreads) != -1) {
+    pthread_mutex_lock(&mThreadCountLock);
+    // threads which left the pool are still counted by the kernel
+    size_t kernelMaxThreads = maxThreads + mRetiredThreads;
+    pthread_mutex_unlock(&mThreadCountLock);
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &kernelMaxThreads) != -1) {
         mMaxThreads = maxThreads;
     } else {
         result = -errno;
@@ -474,6 +481,69 @@ bool ProcessState::isThreadPoolStarted() const {
     return mThreadPoolStarted;
 }
 
+status_t ProcessState::setThreadPoolAdaptive(size_t minIdleThreads, int64_t idleTimeoutMs) {
+    if (idleTimeoutMs < 0) {
+        ALOGE("Binder threadpool idle timeout must not be negative: %" PRId64, idleTimeoutMs);
+        return BAD_VALUE;
+    }
+    pthread_mutex_lock(&mThreadCountLock);
+    mAdaptiveMinIdleThreads = minIdleThreads;
+    mAdaptiveIdleTimeoutMs = idleTimeoutMs;
+    mLastPressureTimeMs = uptimeMillis();
+    pthread_mutex_unlock(&mThreadCountLock);
+    return NO_ERROR;
+}
+
+ProcessState::ThreadPoolStats ProcessState::getThreadPoolStats() const {
+    ThreadPoolStats stats;
+    pthread_mutex_lock(&mThreadCountLock);
+    stats.maxThreads = mMaxThreads;
+    stats.currentThreads = mCurrentThreads;
+    stats.executingThreads = mExecutingThreadsCount;
+    stats.peakExecutingThreads = mPeakExecutingThreadsCount;
+    stats.kernelStartedThreads = mKernelStartedThreads;
+    stats.retiredThreads = mRetiredThreads;
+    stats.starvationCount = mStarvationCount;
+    stats.starvationTimeMs = mStarvationTimeMs;
+    if (mStarvationStartTimeMs != 0) {
+        stats.starvationTimeMs += uptimeMillis() - mStarvationStartTimeMs;
+    }
+    pthread_mutex_unlock(&mThreadCountLock);
+    return stats;
+}
+
+bool ProcessState::shouldRetirePooledThread() {
+    pthread_mutex_lock(&mThreadCountLock);
+    auto detachGuard = make_scope_guard([&]() { pthread_mutex_unlock(&mThreadCountLock); });
+
+    if (mAdaptiveIdleTimeoutMs == 0) return false;
+    if (mWaitingForThreads > 0 || mStarvationStartTimeMs != 0) return false;
+
+    // The calling thread is idle too. Only leave if that doesn't take the
+    // pool back to the point where a command counts as pressure.
+    if (mExecutingThreadsCount + mAdaptiveMinIdleThreads + 2 > mCurrentThreads) return false;
+
+    int64_t now = uptimeMillis();
+    if (now - std::max(mLastPressureTimeMs, mLastRetireTimeMs) < mAdaptiveIdleTimeoutMs) {
+        return false;
+    }
+    mLastRetireTimeMs = now;
+    return true;
+}
+
+void ProcessState::onPooledThreadRetiredLocked() {
+    LOG_ALWAYS_FATAL_IF(mKernelStartedThreads == 0, "Retired a thread which the kernel didn't start");
+    mKernelStartedThreads--;
+    mRetiredThreads++;
+
+    // The thread has already sent BC_EXIT_LOOPER, so the kernel may start
+    // another one in its place, if it ever needs to.
+    size_t kernelMaxThreads = mMaxThreads + mRetiredThreads;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &kernelMaxThreads) == -1) {
+        ALOGE("Binder ioctl to set max threads failed: %s", strerror(errno));
+    }
+}
+
 #define DRIVER_FEATURES_PATH "/dev/binderfs/features/"
 bool ProcessState::isDriverFeatureEnabled(const DriverFeature feature) {
     static const char* const names[] = {
@@ -560,6 +630,14 @@ ProcessState::ProcessState(const char* driver)
         mCurrentThreads(0),
         mKernelStartedThreads(0),
         mStarvationStartTimeMs(0),
+        mStarvationCount(0),
+        mStarvationTimeMs(0),
+        mPeakExecutingThreadsCount(0),
+        mAdaptiveMinIdleThreads(0),
+        mAdaptiveIdleTimeoutMs(0),
+        mLastPressureTimeMs(0),
+        mLastRetireTimeMs(0),
+        mRetiredThreads(0),
         mForked(false),
         mThreadPoolStarted(false),
         mThreadPoolSeq(1),
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <log/log.h>
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace android {
+
+/**
+ * Map from RPC binder addresses to T, used for the node table of RpcState.
+ *
+ * Values are kept in one contiguous array, and an open addressing (linear
+ * probing) index maps addresses to positions in that array. Lookups only
+ * touch the flat index, and inserting doesn't allocate once the map has
+ * grown to its working size.
+ *
+ * The interface follows std::map where it is used by RpcState, with one
+ * difference in guarantees: iterators are indices, so they stay valid across
+ * insertions and erasure of other elements (handles are stable), but pointers
+ * and references to values are invalidated by insertions. Iteration order is
+ * unspecified.
+ */
+template <typename T>
+class RpcAddressMap {
+public:
+    using value_type = std::pair<const uint64_t, T>;
+
+    class iterator {
+    public:
+        value_type& operator*() const { return *(*mEntries)[mIndex]; }
+        value_type* operator->() const { return &*(*mEntries)[mIndex]; }
+        iterator& operator++() {
+            mIndex++;
+            skipEmpty();
+            return *this;
+        }
+        bool operator==(const iterator& o) const { return mIndex == o.mIndex; }
+        bool operator!=(const iterator& o) const { return mIndex != o.mIndex; }
+
+    private:
+        friend RpcAddressMap;
+        iterator(std::vector<std::optional<value_type>>* entries, size_t index)
+              : mEntries(entries), mIndex(index) {}
+        void skipEmpty() {
+            while (mIndex < mEntries->size() && !(*mEntries)[mIndex].has_value()) mIndex++;
+        }
+
+        std::vector<std::optional<value_type>>* mEntries;
+        size_t mIndex;
+    };
+
+    RpcAddressMap() = default;
+    RpcAddressMap(RpcAddressMap&& o) noexcept { *this = std::move(o); }
+    RpcAddressMap& operator=(RpcAddressMap&& o) noexcept {
+        mEntries = std::move(o.mEntries);
+        mFreeEntries = std::move(o.mFreeEntries);
+        mSlots = std::move(o.mSlots);
+        mSize = o.mSize;
+        mShift = o.mShift;
+        o.clear();
+        return *this;
+    }
+    RpcAddressMap(const RpcAddressMap&) = delete;
+    RpcAddressMap& operator=(const RpcAddressMap&) = delete;
+
+    iterator begin() {
+        iterator it(&mEntries, 0);
+        it.skipEmpty();
+        return it;
+    }
+    iterator end() { return iterator(&mEntries, mEntries.size()); }
+
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+
+    void clear() {
+        mEntries.clear();
+        mFreeEntries.clear();
+        mSlots.clear();
+        mSize = 0;
+        mShift = 64;
+    }
+
+    iterator find(uint64_t address) {
+        if (mSlots.empty()) return end();
+        for (size_t i = slotFor(address);; i = nextSlot(i)) {
+            const Slot& slot = mSlots[i];
+            if (slot.entry == kEmpty) return end();
+            if (slot.address == address) return iterator(&mEntries, slot.entry);
+        }
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value) {
+        uint64_t address = value.first;
+        if (iterator it = find(address); it != end()) return {it, false};
+
+        // keep load factor at or below 1/2, so probe sequences stay short
+        if ((mSize + 1) * 2 > mSlots.size()) {
+            rehash(mSlots.empty() ? kMinSlots : mSlots.size() * 2);
+        }
+
+        uint32_t entry;
+        if (!mFreeEntries.empty()) {
+            entry = mFreeEntries.back();
+            mFreeEntries.pop_back();
+            mEntries[entry].emplace(std::move(value));
+        } else {
+            LOG_ALWAYS_FATAL_IF(mEntries.size() >= kEmpty, "Too many addresses");
+            entry = static_cast<uint32_t>(mEntries.size());
+            mEntries.emplace_back(std::move(value));
+        }
+
+        size_t i = slotFor(address);
+        while (mSlots[i].entry != kEmpty) i = nextSlot(i);
+        mSlots[i] = Slot{.address = address, .entry = entry};
+        mSize++;
+
+        return {iterator(&mEntries, entry), true};
+    }
+
+    void erase(iterator it) {
+        LOG_ALWAYS_FATAL_IF(it.mIndex >= mEntries.size() || !mEntries[it.mIndex].has_value(),
+                            "Erasing invalid iterator");
+        uint64_t address = mEntries[it.mIndex]->first;
+
+        size_t hole = slotFor(address);
+        while (mSlots[hole].address != address || mSlots[hole].entry == kEmpty) {
+            hole = nextSlot(hole);
+        }
+
+        // Backward shift deletion: move later elements of the probe sequence
+        // into the hole, unless that would move them before their home slot.
+        for (size_t i = nextSlot(hole); mSlots[i].entry != kEmpty; i = nextSlot(i)) {
+            size_t home = slotFor(mSlots[i].address);
+            bool homeInRange = (hole <= i) ? (hole < home && home <= i) : (hole < home || home <= i);
+            if (!homeInRange) {
+                mSlots[hole] = mSlots[i];
+                hole = i;
+            }
+        }
+        mSlots[hole].entry = kEmpty;
+
+        mEntries[it.mIndex].reset();
+        mFreeEntries.push_back(static_cast<uint32_t>(it.mIndex));
+        mSize--;
+    }
+
+private:
+    static constexpr uint32_t kEmpty = UINT32_MAX;
+    static constexpr size_t kMinSlots = 16;
+
+    struct Slot {
+        uint64_t address = 0;
+        uint32_t entry = kEmpty;
+    };
+
+    // Fibonacci hashing, addresses differ mostly in their low bits
+    size_t slotFor(uint64_t address) const {
+        return static_cast<size_t>((address * 0x9E3779B97F4A7C15ull) >> mShift);
+    }
+    size_t nextSlot(size_t i) const { return (i + 1) & (mSlots.size() - 1); }
+
+    void rehash(size_t numSlots) {
+        mShift = 64 - __builtin_ctzll(numSlots);
+        mSlots.assign(numSlots, Slot{});
+        for (size_t entry = 0; entry < mEntries.size(); entry++) {
+            if (!mEntries[entry].has_value()) continue;
+            uint64_t address = mEntries[entry]->first;
+            size_t i = slotFor(address);
+            while (mSlots[i].entry != kEmpty) i = nextSlot(i);
+            mSlots[i] = Slot{.address = address, .entry = static_cast<uint32_t>(entry)};
+        }
+    }
+
+    std::vector<std::optional<value_type>> mEntries;
+    std::vector<uint32_t> mFreeEntries;
+    // size is zero or a power of two
+    std::vector<Slot> mSlots;
+    size_t mSize = 0;
+    // 64 - log2(mSlots.size())
+    int mShift = 64;
+};
+
+} // namespace android
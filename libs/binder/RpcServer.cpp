@@ -34,6 +34,9 @@
 #include "BuildFlags.h"
 #include "FdTrigger.h"
 #include "OS.h"
+#ifdef BINDER_WITH_RPC_REACTOR
+#include "RpcServerReactor.h"
+#endif
 #include "RpcSocketAddress.h"
 #include "RpcState.h"
 #include "RpcTransportUtils.h"
@@ -124,6 +127,19 @@ size_t RpcServer::getMaxThreads() {
     return mMaxThreads;
 }
 
+void RpcServer::setEventDrivenWorkerThreads(size_t threads) {
+    LOG_ALWAYS_FATAL_IF(threads > 0 && !kEnableRpcThreads,
+                        "Event driven mode is not supported on single-threaded libbinder");
+    LOG_ALWAYS_FATAL_IF(threads > 0 && !kEnableRpcReactor,
+                        "Event driven mode is not supported on this platform");
+    LOG_ALWAYS_FATAL_IF(mJoinThreadRunning, "Cannot set event driven threads while running");
+    mEventDrivenWorkerThreads = threads;
+}
+
+size_t RpcServer::getEventDrivenWorkerThreads() {
+    return mEventDrivenWorkerThreads;
+}
+
 bool RpcServer::setProtocolVersion(uint32_t version) {
     if (!RpcState::validateProtocolVersion(version)) {
         return false;
@@ -247,6 +263,13 @@ void RpcServer::join() {
         mJoinThreadRunning = true;
         mShutdownTrigger = FdTrigger::make();
         LOG_ALWAYS_FATAL_IF(mShutdownTrigger == nullptr, "Cannot create join signaler");
+#if defined(BINDER_WITH_RPC_REACTOR) && !defined(BINDER_RPC_SINGLE_THREADED)
+        mReactor = nullptr;
+        if (mEventDrivenWorkerThreads > 0) {
+            mReactor = RpcServerReactor::make(mEventDrivenWorkerThreads);
+            LOG_ALWAYS_FATAL_IF(mReactor == nullptr, "Cannot create event driven workers");
+        }
+#endif
     }
 
     status_t status;
@@ -290,6 +313,17 @@ void RpcServer::join() {
     }
     LOG_RPC_DETAIL("RpcServer::join exiting with %s", statusToString(status).c_str());
 
+#if defined(BINDER_WITH_RPC_REACTOR) && !defined(BINDER_RPC_SINGLE_THREADED)
+    // Kept until the next join(), so that connections which are still being
+    // established are closed by it.
+    std::shared_ptr<RpcServerReactor> reactor;
+    {
+        RpcMutexLockGuard _l(mLock);
+        reactor = mReactor;
+    }
+    if (reactor != nullptr) reactor->shutdown();
+#endif
+
     if constexpr (kEnableRpcThreads) {
         RpcMutexLockGuard _l(mLock);
         mJoinThreadRunning = false;
@@ -378,6 +412,8 @@ void RpcServer::establishConnection(
 
     status_t status = OK;
 
+    // also watched by the reactor, in event driven mode
+    [[maybe_unused]] borrowed_fd clientFdForPoll = clientFd.fd;
     int clientFdForLog = clientFd.fd.get();
     auto client = server->mCtx->newTransport(std::move(clientFd), server->mShutdownTrigger.get());
     if (client == nullptr) {
@@ -448,6 +484,7 @@ void RpcServer::establishConnection(
 
     RpcMaybeThread thisThread;
     sp<RpcSession> session;
+    std::shared_ptr<RpcServerReactor> reactor;
     {
         RpcMutexUniqueLock _l(server->mLock);
 
@@ -547,11 +584,36 @@ void RpcServer::establishConnection(
         }
 
         detachGuard.release();
-        session->preJoinThreadOwnership(std::move(thisThread));
+        // in event driven mode, this thread is done once the connection is set up
+        reactor = server->mReactor;
+        if (reactor == nullptr) {
+            session->preJoinThreadOwnership(std::move(thisThread));
+        } else {
+            // Still connecting until the reactor has taken over the connection,
+            // so that shutdown() waits for it.
+            server->mConnectingThreads[rpc_this_thread::get_id()] = std::move(thisThread);
+        }
     }
 
     auto setupResult = session->preJoinSetup(std::move(client));
 
+#if defined(BINDER_WITH_RPC_REACTOR) && !defined(BINDER_RPC_SINGLE_THREADED)
+    if (reactor != nullptr) {
+        // Closes the connection if the reactor was already shut down
+        reactor->addConnection(std::move(session), std::move(setupResult), clientFdForPoll);
+
+        RpcMutexUniqueLock _l(server->mLock);
+        auto threadId = server->mConnectingThreads.find(rpc_this_thread::get_id());
+        LOG_ALWAYS_FATAL_IF(threadId == server->mConnectingThreads.end(),
+                            "Connecting thread was removed while setting up");
+        threadId->second.detach();
+        server->mConnectingThreads.erase(threadId);
+        _l.unlock();
+        server->mShutdownCv.notify_all();
+        return;
+    }
+#endif
+
     // avoid strong cycle
     server = nullptr;
 
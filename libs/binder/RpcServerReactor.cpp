@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RpcServerReactor"
+#include <log/log.h>
+
+#include "RpcServerReactor.h"
+
+#include <sys/epoll.h>
+
+#include "FdTrigger.h"
+#include "RpcState.h"
+#include "Utils.h"
+
+namespace android {
+
+using android::binder::borrowed_fd;
+using android::binder::unique_fd;
+
+std::shared_ptr<RpcServerReactor> RpcServerReactor::make(size_t numThreads) {
+    LOG_ALWAYS_FATAL_IF(numThreads == 0, "Event driven mode needs at least one thread");
+
+    std::shared_ptr<RpcServerReactor> reactor(new RpcServerReactor());
+
+    reactor->mEpoll = unique_fd(epoll_create1(EPOLL_CLOEXEC));
+    if (!reactor->mEpoll.ok()) {
+        ALOGE("Could not create epoll instance: %s", strerror(errno));
+        return nullptr;
+    }
+
+    reactor->mShutdownTrigger = FdTrigger::make();
+    if (reactor->mShutdownTrigger == nullptr) return nullptr;
+
+    // not oneshot, so that every worker sees it
+    epoll_event event{
+            .events = 0,
+            .data = {.u64 = kShutdownId},
+    };
+    if (0 !=
+        epoll_ctl(reactor->mEpoll.get(), EPOLL_CTL_ADD,
+                  reactor->mShutdownTrigger->pollFd().get(), &event)) {
+        ALOGE("Could not watch shutdown trigger: %s", strerror(errno));
+        return nullptr;
+    }
+
+    RpcMutexLockGuard _l(reactor->mLock);
+    for (size_t i = 0; i < numThreads; i++) {
+        // workers don't own the reactor, it is shut down before it is destroyed
+        RpcServerReactor* thiz = reactor.get();
+        reactor->mThreads.emplace_back(
+                [thiz]() { RpcSession::runAttachedToJvm([thiz]() { thiz->workerLoop(); }); });
+    }
+    return reactor;
+}
+
+RpcServerReactor::~RpcServerReactor() {
+    shutdown();
+}
+
+void RpcServerReactor::addConnection(sp<RpcSession>&& session,
+                                     RpcSession::PreJoinSetupResult&& setupResult,
+                                     borrowed_fd socket) {
+    sp<RpcSession::RpcConnection>& connection = setupResult.connection;
+
+    if (setupResult.status != OK) {
+        ALOGE("Connection failed to init, closing with status %s",
+              statusToString(setupResult.status).c_str());
+        RpcSession::incomingConnectionEnded(std::move(session), connection);
+        return;
+    }
+    LOG_ALWAYS_FATAL_IF(!connection, "must have connection if setup succeeded");
+
+    // from now on, only owned by the worker which serves it
+    session->clearConnectionTid(connection);
+
+    {
+        RpcMutexLockGuard _l(mLock);
+
+        // If the session is triggered after this check, its watch reports it
+        // as soon as it is added.
+        if (!mShutdown && !session->mShutdownTrigger->isTriggered()) {
+            status_t status = OK;
+
+            auto [sessionIt, inserted] = mSessionWatches.try_emplace(session.get());
+            if (inserted) {
+                sessionIt->second.id = mNextId++;
+                Watch watch{
+                        .session = session,
+                        .fd = session->mShutdownTrigger->pollFd(),
+                };
+                status = watchLocked(EPOLL_CTL_ADD, sessionIt->second.id, watch);
+                if (status == OK) {
+                    mWatches.emplace(sessionIt->second.id, std::move(watch));
+                } else {
+                    mSessionWatches.erase(sessionIt);
+                }
+            }
+
+            if (status == OK) {
+                uint64_t id = mNextId++;
+                auto it = mWatches.emplace(id,
+                                           Watch{
+                                                   .session = session,
+                                                   .connection = connection,
+                                                   .fd = socket,
+                                           })
+                                  .first;
+                sessionIt->second.numConnections++;
+
+                if (watchLocked(EPOLL_CTL_ADD, id, it->second) == OK) return;
+
+                (void)removeLocked(it);
+            }
+        }
+    }
+
+    RpcSession::incomingConnectionEnded(std::move(session), connection);
+}
+
+void RpcServerReactor::shutdown() {
+    std::vector<RpcMaybeThread> threads;
+    {
+        RpcMutexLockGuard _l(mLock);
+        if (mShutdown) return;
+        mShutdown = true;
+
+        if (mShutdownTrigger != nullptr) mShutdownTrigger->trigger();
+        threads = std::move(mThreads);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // workers are gone, so no connection is busy anymore
+    std::vector<Watch> closed;
+    {
+        RpcMutexLockGuard _l(mLock);
+        std::vector<uint64_t> ids;
+        for (const auto& [id, watch] : mWatches) {
+            if (watch.connection != nullptr) ids.push_back(id);
+        }
+        for (uint64_t id : ids) {
+            closed.push_back(removeLocked(mWatches.find(id)));
+        }
+        LOG_ALWAYS_FATAL_IF(!mWatches.empty() || !mSessionWatches.empty(),
+                            "Sessions are still watched without connections");
+    }
+
+    for (Watch& watch : closed) {
+        endConnection(std::move(watch));
+    }
+}
+
+void RpcServerReactor::workerLoop() {
+    while (true) {
+        // One event at a time, so that connections which are ready together
+        // are spread over idle workers.
+        epoll_event event;
+        int ret = TEMP_FAILURE_RETRY(epoll_wait(mEpoll.get(), &event, 1, -1));
+        if (ret < 0) {
+            ALOGE("Worker exiting, could not epoll_wait: %s", strerror(errno));
+            return;
+        }
+        if (ret == 0) continue;
+
+        if (event.data.u64 == kShutdownId) return;
+        onEvent(event.data.u64);
+    }
+}
+
+void RpcServerReactor::onEvent(uint64_t id) {
+    sp<RpcSession> session;
+    sp<RpcSession::RpcConnection> connection;
+    std::vector<Watch> closed;
+    {
+        RpcMutexLockGuard _l(mLock);
+        auto it = mWatches.find(id);
+        // closed by another thread after the event was reported
+        if (it == mWatches.end()) return;
+
+        if (it->second.connection == nullptr) {
+            // Busy connections of the session are closed by their workers,
+            // which check the trigger before watching them again.
+            closeIdleConnectionsLocked(it->second.session.get(), &closed);
+        } else {
+            LOG_ALWAYS_FATAL_IF(it->second.busy, "Connection reported while it is being served");
+            it->second.busy = true;
+            session = it->second.session;
+            connection = it->second.connection;
+        }
+    }
+
+    for (Watch& watch : closed) {
+        endConnection(std::move(watch));
+    }
+    if (connection == nullptr) return;
+
+    status_t status = RpcSession::executeAvailableCommands(session, connection);
+
+    Watch ended;
+    {
+        RpcMutexLockGuard _l(mLock);
+        auto it = mWatches.find(id);
+        LOG_ALWAYS_FATAL_IF(it == mWatches.end(), "Connection was closed while being served");
+        it->second.busy = false;
+
+        if (status == OK && !mShutdown && !session->mShutdownTrigger->isTriggered() &&
+            watchLocked(EPOLL_CTL_MOD, id, it->second) == OK) {
+            return;
+        }
+        ended = removeLocked(it);
+    }
+
+    session.clear();
+    connection.clear();
+    endConnection(std::move(ended));
+}
+
+status_t RpcServerReactor::watchLocked(int op, uint64_t id, const Watch& watch) {
+    // Sessions only need to be reported once, when they are shut down
+    // (EPOLLHUP is always reported).
+    epoll_event event{
+            .events = static_cast<uint32_t>((watch.connection != nullptr ? EPOLLIN : 0) |
+                                            EPOLLONESHOT),
+            .data = {.u64 = id},
+    };
+    if (0 != epoll_ctl(mEpoll.get(), op, watch.fd.get(), &event)) {
+        int savedErrno = errno;
+        ALOGE("Could not watch fd %d: %s", watch.fd.get(), strerror(savedErrno));
+        return -savedErrno;
+    }
+    return OK;
+}
+
+RpcServerReactor::Watch RpcServerReactor::removeLocked(std::map<uint64_t, Watch>::iterator it) {
+    Watch watch = std::move(it->second);
+    mWatches.erase(it);
+
+    // fails if adding the fd failed, which is fine
+    (void)epoll_ctl(mEpoll.get(), EPOLL_CTL_DEL, watch.fd.get(), nullptr);
+
+    if (watch.connection != nullptr) {
+        auto sessionIt = mSessionWatches.find(watch.session.get());
+        LOG_ALWAYS_FATAL_IF(sessionIt == mSessionWatches.end(), "Connection of unknown session");
+
+        if (--sessionIt->second.numConnections == 0) {
+            auto sessionWatchIt = mWatches.find(sessionIt->second.id);
+            LOG_ALWAYS_FATAL_IF(sessionWatchIt == mWatches.end(), "Session watch is missing");
+            mSessionWatches.erase(sessionIt);
+            // still referenced by 'watch', so the session isn't destroyed here
+            (void)removeLocked(sessionWatchIt);
+        }
+    }
+    return watch;
+}
+
+void RpcServerReactor::closeIdleConnectionsLocked(const RpcSession* session,
+                                                  std::vector<Watch>* closed) {
+    std::vector<uint64_t> ids;
+    for (const auto& [id, watch] : mWatches) {
+        if (watch.session.get() == session && watch.connection != nullptr && !watch.busy) {
+            ids.push_back(id);
+        }
+    }
+    for (uint64_t id : ids) {
+        closed->push_back(removeLocked(mWatches.find(id)));
+    }
+}
+
+void RpcServerReactor::endConnection(Watch&& watch) {
+    RpcSession::incomingConnectionEnded(std::move(watch.session), watch.connection);
+}
+
+} // namespace android
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <binder/RpcSession.h>
+#include <binder/RpcThreads.h>
+#include <binder/unique_fd.h>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace android {
+
+class FdTrigger;
+
+/**
+ * Serves the incoming connections of all sessions of an RpcServer with a
+ * fixed number of threads, see RpcServer::setEventDrivenWorkerThreads.
+ *
+ * Idle connections are watched with epoll(7) in EPOLLONESHOT mode, so that a
+ * connection which becomes readable is handed to exactly one worker. That
+ * worker owns the connection like a thread in RpcSession::join would (nested
+ * calls go over it), until no more data is available, and then it is watched
+ * again. The shutdown trigger of each session is watched as well, so idle
+ * connections are closed when their session shuts down.
+ *
+ * Not supported in single-threaded builds.
+ */
+class RpcServerReactor {
+public:
+    /** Returns nullptr for error case */
+    static std::shared_ptr<RpcServerReactor> make(size_t numThreads);
+    ~RpcServerReactor();
+
+    /**
+     * Takes over an incoming connection which was set up with
+     * RpcSession::preJoinSetup on this thread, instead of RpcSession::join.
+     * 'socket' is the FD the connection's transport reads from.
+     */
+    void addConnection(sp<RpcSession>&& session, RpcSession::PreJoinSetupResult&& setupResult,
+                       binder::borrowed_fd socket);
+
+    /**
+     * Closes all connections which aren't being served, and waits for the
+     * workers to finish the ones which are. Connections added later are
+     * closed immediately.
+     */
+    void shutdown();
+
+private:
+    struct Watch {
+        sp<RpcSession> session;
+        // nullptr if this watches the shutdown trigger of 'session'
+        sp<RpcSession::RpcConnection> connection;
+        binder::borrowed_fd fd = -1;
+        // a worker is executing commands on 'connection'
+        bool busy = false;
+    };
+    struct SessionWatch {
+        uint64_t id;
+        size_t numConnections = 0;
+    };
+
+    // id of the reactor's own shutdown trigger
+    static constexpr uint64_t kShutdownId = 0;
+
+    RpcServerReactor() = default;
+
+    void workerLoop();
+    void onEvent(uint64_t id);
+
+    [[nodiscard]] status_t watchLocked(int op, uint64_t id, const Watch& watch);
+    // Stops watching, and returns the connection for incomingConnectionEnded
+    Watch removeLocked(std::map<uint64_t, Watch>::iterator it);
+    void closeIdleConnectionsLocked(const RpcSession* session, std::vector<Watch>* closed);
+    static void endConnection(Watch&& watch);
+
+    binder::unique_fd mEpoll;
+    std::unique_ptr<FdTrigger> mShutdownTrigger;
+
+    RpcMutex mLock; // for below
+    bool mShutdown = false;
+    std::vector<RpcMaybeThread> mThreads;
+    uint64_t mNextId = kShutdownId + 1;
+    std::map<uint64_t, Watch> mWatches;
+    std::map<const RpcSession*, SessionWatch> mSessionWatches;
+};
+
+} // namespace android
@@ -41,6 +41,7 @@
 #include "RpcState.h"
 #include "RpcTransportUtils.h"
 #include "RpcWireFormat.h"
+#include "TransactionStatsTimer.h"
 #include "Utils.h"
 
 #if defined(__ANDROID__) && !defined(__ANDROID_RECOVERY__)
@@ -266,6 +267,14 @@ bool RpcSession::shutdownAndWait(bool wait) {
 
 status_t RpcSession::transact(const sp<IBinder>& binder, uint32_t code, const Parcel& data,
                               Parcel* reply, uint32_t flags) {
+    if (OnewayBatch* batch = onewayBatchForThisThread(); batch != nullptr) {
+        if ((flags & IBinder::FLAG_ONEWAY) && !data.hasFileDescriptors()) {
+            return batch->queue(binder, code, data, flags);
+        }
+        if (status_t status = batch->flush(); status != OK) return status;
+    }
+
+    TransactionStatsTimer queueTimer;
     ExclusiveConnection connection;
     status_t status =
             ExclusiveConnection::find(sp<RpcSession>::fromExisting(this),
@@ -274,7 +283,8 @@ status_t RpcSession::transact(const sp<IBinder>& binder, uint32_t code, const Pa
                                       &connection);
     if (status != OK) return status;
     return state()->transact(connection.get(), binder, code, data,
-                             sp<RpcSession>::fromExisting(this), reply, flags);
+                             sp<RpcSession>::fromExisting(this), reply, flags,
+                             queueTimer.elapsedNs());
 }
 
 status_t RpcSession::sendDecStrong(const BpBinder* binder) {
@@ -283,6 +293,8 @@ status_t RpcSession::sendDecStrong(const BpBinder* binder) {
 }
 
 status_t RpcSession::sendDecStrongToTarget(uint64_t address, size_t target) {
+    if (status_t status = flushOnewayBatchForThisThread(); status != OK) return status;
+
     ExclusiveConnection connection;
     status_t status = ExclusiveConnection::find(sp<RpcSession>::fromExisting(this),
                                                 ConnectionUse::CLIENT_REFCOUNT, &connection);
@@ -291,6 +303,93 @@ status_t RpcSession::sendDecStrongToTarget(uint64_t address, size_t target) {
                                           address, target);
 }
 
+namespace {
+// Number of OnewayBatch objects alive on the calling thread, over all
+// sessions. Lets transactions skip looking up a batch without any locking in
+// the common case.
+#ifdef BINDER_RPC_SINGLE_THREADED
+size_t tOnewayBatchCount = 0;
+#else
+thread_local size_t tOnewayBatchCount = 0;
+#endif
+} // namespace
+
+RpcSession::OnewayBatch::OnewayBatch(const sp<RpcSession>& session, size_t maxBytes,
+                                     std::chrono::nanoseconds maxDelay)
+      : mSession(session),
+        mTid(binder::os::GetThreadId()),
+        mMaxBytes(maxBytes),
+        mMaxDelay(maxDelay) {
+    RpcMutexLockGuard _l(mSession->mMutex);
+    auto&& [_, inserted] = mSession->mOnewayBatches.insert({mTid, this});
+    LOG_ALWAYS_FATAL_IF(!inserted, "Only one OnewayBatch per thread and session is allowed");
+    tOnewayBatchCount++;
+}
+
+RpcSession::OnewayBatch::~OnewayBatch() {
+    LOG_ALWAYS_FATAL_IF(mTid != binder::os::GetThreadId(),
+                        "OnewayBatch must be destroyed on the thread which created it");
+
+    if (status_t status = flush(); status != OK) {
+        ALOGE("Failed to flush oneway batch: %s", statusToString(status).c_str());
+    }
+
+    RpcMutexLockGuard _l(mSession->mMutex);
+    mSession->mOnewayBatches.erase(mTid);
+    tOnewayBatchCount--;
+}
+
+status_t RpcSession::OnewayBatch::queue(const sp<IBinder>& binder, uint32_t code,
+                                        const Parcel& data, uint32_t flags) {
+    auto now = std::chrono::steady_clock::now();
+    if (mData.empty()) mFirstQueued = now;
+
+    if (status_t status = mSession->state()->appendOnewayTransaction(binder, code, data, mSession,
+                                                                     flags, &mData);
+        status != OK) {
+        return status;
+    }
+    mTargets.push_back(binder);
+
+    if (mData.size() >= mMaxBytes || now - mFirstQueued >= mMaxDelay) {
+        return flush();
+    }
+    return OK;
+}
+
+status_t RpcSession::OnewayBatch::flush() {
+    if (mData.empty()) return OK;
+
+    // Taken out first, since commands processed while waiting to write may
+    // call back into this batch. On failure, the session is shut down, so
+    // these are never retried.
+    std::vector<uint8_t> data = std::move(mData);
+    std::vector<sp<IBinder>> targets = std::move(mTargets);
+    mData.clear();
+    mTargets.clear();
+
+    ExclusiveConnection connection;
+    status_t status = ExclusiveConnection::find(mSession, ConnectionUse::CLIENT_ASYNC, &connection);
+    if (status != OK) return status;
+    return mSession->state()->sendOnewayBatch(connection.get(), mSession, &data);
+}
+
+RpcSession::OnewayBatch* RpcSession::onewayBatchForThisThread() {
+    // only this thread creates and destroys its batches, so no lock is needed
+    if (tOnewayBatchCount == 0) return nullptr;
+
+    RpcMutexLockGuard _l(mMutex);
+    auto it = mOnewayBatches.find(binder::os::GetThreadId());
+    return it == mOnewayBatches.end() ? nullptr : it->second;
+}
+
+status_t RpcSession::flushOnewayBatchForThisThread() {
+    if (OnewayBatch* batch = onewayBatchForThisThread(); batch != nullptr) {
+        return batch->flush();
+    }
+    return OK;
+}
+
 status_t RpcSession::readId() {
     {
         RpcMutexLockGuard _l(mMutex);
@@ -351,6 +450,11 @@ RpcSession::PreJoinSetupResult RpcSession::preJoinSetup(
     if (connection == nullptr) {
         status = DEAD_OBJECT;
     } else {
+        // Nothing is read ahead if FDs may be received, since they couldn't be
+        // matched with their command.
+        connection->readAheadEnabled =
+                getFileDescriptorTransportMode() == FileDescriptorTransportMode::NONE;
+
         status =
                 mRpcBinderState->readConnectionInit(connection, sp<RpcSession>::fromExisting(this));
     }
@@ -429,6 +533,7 @@ void RpcSession::join(sp<RpcSession>&& session, PreJoinSetupResult&& setupResult
     if (setupResult.status == OK) {
         LOG_ALWAYS_FATAL_IF(!connection, "must have connection if setup succeeded");
         [[maybe_unused]] JavaThreadAttacher javaThreadAttacher;
+
         while (true) {
             status_t status = session->state()->getAndExecuteCommand(connection, session,
                                                                      RpcState::CommandType::ANY);
@@ -443,14 +548,57 @@ void RpcSession::join(sp<RpcSession>&& session, PreJoinSetupResult&& setupResult
               statusToString(setupResult.status).c_str());
     }
 
-    sp<RpcSession::EventListener> listener;
     {
         RpcMutexLockGuard _l(session->mMutex);
         auto it = session->mConnections.mThreads.find(rpc_this_thread::get_id());
         LOG_ALWAYS_FATAL_IF(it == session->mConnections.mThreads.end());
         it->second.detach();
         session->mConnections.mThreads.erase(it);
+    }
+
+    incomingConnectionEnded(std::move(session), connection);
+}
+
+status_t RpcSession::executeAvailableCommands(const sp<RpcSession>& session,
+                                              const sp<RpcConnection>& connection) {
+    {
+        RpcMutexLockGuard _l(session->mMutex);
+        LOG_ALWAYS_FATAL_IF(connection->exclusiveTid != std::nullopt,
+                            "Incoming connection is already being served");
+        // so that nested calls from this thread use this connection
+        connection->exclusiveTid = binder::os::GetThreadId();
+    }
+
+    status_t status;
+    while (true) {
+        // bytes which were read ahead are no longer visible to the transport
+        if (connection->readAheadBegin == connection->readAheadEnd) {
+            status = connection->rpcTransport->pollRead();
+            if (status == WOULD_BLOCK) {
+                status = OK;
+                break;
+            }
+            if (status != OK) break;
+        }
+
+        status = session->state()->getAndExecuteCommand(connection, session,
+                                                        RpcState::CommandType::ANY);
+        if (status != OK) {
+            LOG_RPC_DETAIL("Binder connection closing w/ status %s",
+                           statusToString(status).c_str());
+            break;
+        }
+    }
 
+    session->clearConnectionTid(connection);
+    return status;
+}
+
+void RpcSession::incomingConnectionEnded(sp<RpcSession>&& session,
+                                         const sp<RpcConnection>& connection) {
+    sp<RpcSession::EventListener> listener;
+    {
+        RpcMutexLockGuard _l(session->mMutex);
         listener = session->mEventListener.promote();
     }
 
@@ -467,6 +615,11 @@ void RpcSession::join(sp<RpcSession>&& session, PreJoinSetupResult&& setupResult
     }
 }
 
+void RpcSession::runAttachedToJvm(const std::function<void()>& fn) {
+    [[maybe_unused]] JavaThreadAttacher javaThreadAttacher;
+    fn();
+}
+
 sp<RpcServer> RpcSession::server() {
     RpcServer* unsafeServer = mForServer.unsafe_get();
     sp<RpcServer> server = mForServer.promote();
@@ -25,6 +25,7 @@
 
 #include "Debug.h"
 #include "RpcWireFormat.h"
+#include "TransactionStatsTimer.h"
 #include "Utils.h"
 
 #include <random>
@@ -94,57 +95,80 @@ status_t RpcState::onBinderLeaving(const sp<RpcSession>& session, const sp<IBind
         return INVALID_OPERATION;
     }
 
-    RpcMutexLockGuard _l(mNodeMutex);
-    if (mTerminated) return DEAD_OBJECT;
+    if (isRpc) {
+        // RPC binder proxies know their own address
+        uint64_t addr = binder->remoteBinder()->getPrivateAccessor().rpcAddress();
+        NodeShard& shard = shardFor(addr);
+        RpcMutexLockGuard _l(shard.mutex);
+        if (mTerminated) return DEAD_OBJECT;
+
+        auto it = shard.nodes.find(addr);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodes.end() || binder != it->second.binder,
+                            "RPC binder must have known address at this point");
+        it->second.timesSent++;
+        it->second.sentRef = binder; // might already be set
+        *outAddress = addr;
+        return OK;
+    }
+
+    // Held until a new node is inserted, so that two threads sending the same
+    // new binder can't both create a node for it.
+    RpcMutexLockGuard _ll(mLocalNodeMutex);
+
+    // TODO(b/182939933): maybe keep binder->address map in RpcState
+    for (NodeShard& shard : mShards) {
+        RpcMutexLockGuard _l(shard.mutex);
+        if (mTerminated) return DEAD_OBJECT;
 
-    // TODO(b/182939933): maybe move address out of BpBinder, and keep binder->address map
-    // in RpcState
-    for (auto& [addr, node] : mNodeForAddress) {
-        if (binder == node.binder) {
-            if (isRpc) {
-                // check integrity of data structure
-                uint64_t actualAddr = binder->remoteBinder()->getPrivateAccessor().rpcAddress();
-                LOG_ALWAYS_FATAL_IF(addr != actualAddr, "Address mismatch %" PRIu64 " vs %" PRIu64,
-                                    addr, actualAddr);
+        for (auto& [addr, node] : shard.nodes) {
+            if (binder == node.binder) {
+                node.timesSent++;
+                node.sentRef = binder; // might already be set
+                *outAddress = addr;
+                return OK;
             }
-            node.timesSent++;
-            node.sentRef = binder; // might already be set
-            *outAddress = addr;
-            return OK;
         }
     }
-    LOG_ALWAYS_FATAL_IF(isRpc, "RPC binder must have known address at this point");
 
     bool forServer = session->server() != nullptr;
 
+    // Count the node before inserting it, so that erasing the last node of
+    // another shard can't see the count drop to zero and shut down while this
+    // binder is being registered. Only given back if nothing is inserted.
+    //
     // arbitrary limit for maximum number of nodes in a process (otherwise we
     // might run out of addresses)
-    if (mNodeForAddress.size() > 100000) {
+    if (mNodeCount.fetch_add(1) > 100000) {
+        mNodeCount--;
         return NO_MEMORY;
     }
 
     while (true) {
+        // wraps around to 0 after the max, without an ubsan abort
+        uint32_t id = mNextId.fetch_add(1);
+
         RpcWireAddress address{
                 .options = RPC_WIRE_ADDRESS_OPTION_CREATED,
-                .address = mNextId,
+                .address = id,
         };
         if (forServer) {
             address.options |= RPC_WIRE_ADDRESS_OPTION_FOR_SERVER;
         }
 
-        // avoid ubsan abort
-        if (mNextId >= std::numeric_limits<uint32_t>::max()) {
-            mNextId = 0;
-        } else {
-            mNextId++;
+        uint64_t rawAddress = RpcWireAddress::toRaw(address);
+        NodeShard& shard = shardFor(rawAddress);
+        RpcMutexLockGuard _l(shard.mutex);
+        if (mTerminated) {
+            mNodeCount--;
+            return DEAD_OBJECT;
         }
 
-        auto&& [it, inserted] = mNodeForAddress.insert({RpcWireAddress::toRaw(address),
-                                                        BinderNode{
-                                                                .binder = binder,
-                                                                .sentRef = binder,
-                                                                .timesSent = 1,
-                                                        }});
+        auto&& [it, inserted] = shard.nodes.insert({rawAddress,
+                                                    BinderNode{
+                                                            .binder = binder,
+                                                            .sentRef = binder,
+                                                            .timesSent = 1,
+                                                    }});
         if (inserted) {
             *outAddress = it->first;
             return OK;
@@ -170,10 +194,11 @@ status_t RpcState::onBinderEntering(const sp<RpcSession>& session, uint64_t addr
         return BAD_VALUE;
     }
 
-    RpcMutexLockGuard _l(mNodeMutex);
+    NodeShard& shard = shardFor(address);
+    RpcMutexLockGuard _l(shard.mutex);
     if (mTerminated) return DEAD_OBJECT;
 
-    if (auto it = mNodeForAddress.find(address); it != mNodeForAddress.end()) {
+    if (auto it = shard.nodes.find(address); it != shard.nodes.end()) {
         *out = it->second.binder.promote();
 
         // implicitly have strong RPC refcount, since we received this binder
@@ -189,7 +214,9 @@ status_t RpcState::onBinderEntering(const sp<RpcSession>& session, uint64_t addr
         return BAD_VALUE;
     }
 
-    auto&& [it, inserted] = mNodeForAddress.insert({address, BinderNode{}});
+    // counted before inserting, see onBinderLeaving
+    mNodeCount++;
+    auto&& [it, inserted] = shard.nodes.insert({address, BinderNode{}});
     LOG_ALWAYS_FATAL_IF(!inserted, "Failed to insert binder when creating proxy");
 
     // Currently, all binders are assumed to be part of the same session (no
@@ -205,12 +232,13 @@ status_t RpcState::flushExcessBinderRefs(const sp<RpcSession>& session, uint64_t
     // extra reference counting packets now.
     if (binder->remoteBinder()) return OK;
 
-    RpcMutexUniqueLock _l(mNodeMutex);
+    NodeShard& shard = shardFor(address);
+    RpcMutexUniqueLock _l(shard.mutex);
     if (mTerminated) return DEAD_OBJECT;
 
-    auto it = mNodeForAddress.find(address);
+    auto it = shard.nodes.find(address);
 
-    LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(), "Can't be deleted while we hold sp<>");
+    LOG_ALWAYS_FATAL_IF(it == shard.nodes.end(), "Can't be deleted while we hold sp<>");
     LOG_ALWAYS_FATAL_IF(it->second.binder != binder,
                         "Caller of flushExcessBinderRefs using inconsistent arguments");
 
@@ -233,19 +261,19 @@ status_t RpcState::flushExcessBinderRefs(const sp<RpcSession>& session, uint64_t
 }
 
 status_t RpcState::sendObituaries(const sp<RpcSession>& session) {
-    RpcMutexUniqueLock _l(mNodeMutex);
-
     // Gather strong pointers to all of the remote binders for this session so
     // we hold the strong references. remoteBinder() returns a raw pointer.
     // Send the obituaries and drop the strong pointers outside of the lock so
     // the destructors and the onBinderDied calls are not done while locked.
     std::vector<sp<IBinder>> remoteBinders;
-    for (const auto& [_, binderNode] : mNodeForAddress) {
-        if (auto binder = binderNode.binder.promote()) {
-            remoteBinders.push_back(std::move(binder));
+    for (NodeShard& shard : mShards) {
+        RpcMutexLockGuard _l(shard.mutex);
+        for (const auto& [_, binderNode] : shard.nodes) {
+            if (auto binder = binderNode.binder.promote()) {
+                remoteBinders.push_back(std::move(binder));
+            }
         }
     }
-    _l.unlock();
 
     for (const auto& binder : remoteBinders) {
         if (binder->remoteBinder() &&
@@ -257,23 +285,32 @@ status_t RpcState::sendObituaries(const sp<RpcSession>& session) {
 }
 
 size_t RpcState::countBinders() {
-    RpcMutexLockGuard _l(mNodeMutex);
-    return mNodeForAddress.size();
+    return mNodeCount;
 }
 
 void RpcState::dump() {
-    RpcMutexLockGuard _l(mNodeMutex);
+    lockAllShards();
     dumpLocked();
+    unlockAllShards();
 }
 
-void RpcState::clear() {
-    return clear(RpcMutexUniqueLock(mNodeMutex));
+void RpcState::lockAllShards() {
+    for (NodeShard& shard : mShards) shard.mutex.lock();
 }
 
-void RpcState::clear(RpcMutexUniqueLock nodeLock) {
+void RpcState::unlockAllShards() {
+    for (size_t i = kNumNodeShards; i > 0; i--) mShards[i - 1].mutex.unlock();
+}
+
+void RpcState::clear() {
+    lockAllShards();
+
     if (mTerminated) {
-        LOG_ALWAYS_FATAL_IF(!mNodeForAddress.empty(),
-                            "New state should be impossible after terminating!");
+        for (const NodeShard& shard : mShards) {
+            LOG_ALWAYS_FATAL_IF(!shard.nodes.empty(),
+                                "New state should be impossible after terminating!");
+        }
+        unlockAllShards();
         return;
     }
     mTerminated = true;
@@ -283,31 +320,42 @@ void RpcState::clear(RpcMutexUniqueLock nodeLock) {
         dumpLocked();
     }
 
-    // invariants
-    for (auto& [address, node] : mNodeForAddress) {
-        bool guaranteedHaveBinder = node.timesSent > 0;
-        if (guaranteedHaveBinder) {
-            LOG_ALWAYS_FATAL_IF(node.sentRef == nullptr,
-                                "Binder expected to be owned with address: %" PRIu64 " %s", address,
-                                node.toString().c_str());
-        }
-    }
-
     // if the destructor of a binder object makes another RPC call, then calling
     // decStrong could deadlock. So, we must hold onto these binders until
-    // mNodeMutex is no longer taken.
-    auto temp = std::move(mNodeForAddress);
-    mNodeForAddress.clear(); // RpcState isn't reusable, but for future/explicit
+    // the shard locks are no longer taken.
+    std::vector<RpcAddressMap<BinderNode>> temp;
+    temp.reserve(kNumNodeShards);
+    size_t clearedCount = 0;
+    for (NodeShard& shard : mShards) {
+        // invariants
+        for (auto& [address, node] : shard.nodes) {
+            bool guaranteedHaveBinder = node.timesSent > 0;
+            if (guaranteedHaveBinder) {
+                LOG_ALWAYS_FATAL_IF(node.sentRef == nullptr,
+                                    "Binder expected to be owned with address: %" PRIu64 " %s",
+                                    address, node.toString().c_str());
+            }
+        }
+
+        clearedCount += shard.nodes.size();
+        temp.push_back(std::move(shard.nodes));
+        shard.nodes.clear(); // RpcState isn't reusable, but for future/explicit
+    }
+    // Binders which are being registered are counted but not inserted yet.
+    // They see mTerminated and give their count back.
+    mNodeCount -= clearedCount;
 
-    nodeLock.unlock();
+    unlockAllShards();
     temp.clear(); // explicit
 }
 
 void RpcState::dumpLocked() {
     ALOGE("DUMP OF RpcState %p", this);
-    ALOGE("DUMP OF RpcState (%zu nodes)", mNodeForAddress.size());
-    for (const auto& [address, node] : mNodeForAddress) {
-        ALOGE("- address: %" PRIu64 " %s", address, node.toString().c_str());
+    ALOGE("DUMP OF RpcState (%zu nodes)", mNodeCount.load());
+    for (const NodeShard& shard : mShards) {
+        for (const auto& [address, node] : shard.nodes) {
+            ALOGE("- address: %" PRIu64 " %s", address, node.toString().c_str());
+        }
     }
     ALOGE("END DUMP OF RpcState");
 }
@@ -354,7 +402,7 @@ RpcState::CommandData::CommandData(size_t size) : mSize(size) {
         ALOGW("Transaction requested too much data allocation %zu", size);
         return;
     }
-    mData.reset(new (std::nothrow) uint8_t[size]);
+    mData.reset(parcelBufferAlloc(size));
 }
 
 status_t RpcState::rpcSend(const sp<RpcSession::RpcConnection>& connection,
@@ -381,14 +429,62 @@ status_t RpcState::rpcSend(const sp<RpcSession::RpcConnection>& connection,
     return OK;
 }
 
+status_t RpcState::readWithReadAhead(const sp<RpcSession::RpcConnection>& connection,
+                                     FdTrigger* fdTrigger, iovec* iovs, int niovs) {
+    // A burst of commands (e.g. from RpcSession::OnewayBatch) is usually
+    // received with one recvmsg, and the following commands are then served
+    // from here.
+    constexpr size_t kReadAheadSize = 16 * 1024;
+
+    while (niovs > 0) {
+        if (iovs[0].iov_len == 0) {
+            iovs++;
+            niovs--;
+            continue;
+        }
+        size_t available = connection->readAheadEnd - connection->readAheadBegin;
+        if (available == 0) break;
+
+        size_t size = std::min(available, iovs[0].iov_len);
+        memcpy(iovs[0].iov_base, connection->readAhead.data() + connection->readAheadBegin, size);
+        connection->readAheadBegin += size;
+        iovs[0].iov_base = reinterpret_cast<uint8_t*>(iovs[0].iov_base) + size;
+        iovs[0].iov_len -= size;
+    }
+    if (niovs == 0) return OK;
+
+    // everything buffered was consumed
+    connection->readAheadBegin = connection->readAheadEnd = 0;
+    if (connection->readAhead.empty()) connection->readAhead.resize(kReadAheadSize);
+
+    size_t readAheadSize = 0;
+    if (status_t status = connection->rpcTransport
+                                  ->interruptableReadFullyWithReadAhead(fdTrigger, iovs, niovs,
+                                                                        connection->readAhead
+                                                                                .data(),
+                                                                        connection->readAhead
+                                                                                .size(),
+                                                                        &readAheadSize);
+        status != OK) {
+        return status;
+    }
+    connection->readAheadEnd = readAheadSize;
+    return OK;
+}
+
 status_t RpcState::rpcRec(const sp<RpcSession::RpcConnection>& connection,
                           const sp<RpcSession>& session, const char* what, iovec* iovs, int niovs,
                           std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds) {
-    if (status_t status =
-                connection->rpcTransport->interruptableReadFully(session->mShutdownTrigger.get(),
-                                                                 iovs, niovs, std::nullopt,
-                                                                 ancillaryFds);
-        status != OK) {
+    status_t status;
+    if (connection->readAheadEnabled) {
+        LOG_ALWAYS_FATAL_IF(ancillaryFds != nullptr, "Can't read ahead when receiving FDs");
+        status = readWithReadAhead(connection, session->mShutdownTrigger.get(), iovs, niovs);
+    } else {
+        status = connection->rpcTransport->interruptableReadFully(session->mShutdownTrigger.get(),
+                                                                  iovs, niovs, std::nullopt,
+                                                                  ancillaryFds);
+    }
+    if (status != OK) {
         LOG_RPC_DETAIL("Failed to read %s (%d iovs) on RpcTransport %p, error: %s", what, niovs,
                        connection->rpcTransport.get(), statusToString(status).c_str());
         (void)session->shutdownAndWait(false);
@@ -524,7 +620,8 @@ status_t RpcState::getSessionId(const sp<RpcSession::RpcConnection>& connection,
 
 status_t RpcState::transact(const sp<RpcSession::RpcConnection>& connection,
                             const sp<IBinder>& binder, uint32_t code, const Parcel& data,
-                            const sp<RpcSession>& session, Parcel* reply, uint32_t flags) {
+                            const sp<RpcSession>& session, Parcel* reply, uint32_t flags,
+                            int64_t queueDelayNs) {
     std::string errorMsg;
     if (status_t status = validateParcel(session, data, &errorMsg); status != OK) {
         ALOGE("Refusing to send RPC on binder %p code %" PRIu32 ": Parcel %p failed validation: %s",
@@ -534,32 +631,34 @@ status_t RpcState::transact(const sp<RpcSession::RpcConnection>& connection,
     uint64_t address;
     if (status_t status = onBinderLeaving(session, binder, &address); status != OK) return status;
 
-    return transactAddress(connection, address, code, data, session, reply, flags);
+    return transactAddress(connection, address, code, data, session, reply, flags, queueDelayNs);
 }
 
 status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connection,
                                    uint64_t address, uint32_t code, const Parcel& data,
-                                   const sp<RpcSession>& session, Parcel* reply, uint32_t flags) {
+                                   const sp<RpcSession>& session, Parcel* reply, uint32_t flags,
+                                   int64_t queueDelayNs) {
+    TransactionStatsTimer statsTimer;
+    status_t status = sendTransactionAndWait(connection, address, code, data, session, reply, flags);
+    if (statsTimer.active()) {
+        size_t descriptorLen;
+        const char16_t* descriptor = data.peekInterfaceToken(&descriptorLen);
+        statsTimer.finish(descriptor, descriptorLen, code, flags, data.dataSize(),
+                          reply ? reply->dataSize() : 0, status, queueDelayNs);
+    }
+    return status;
+}
+
+status_t RpcState::sendTransactionAndWait(const sp<RpcSession::RpcConnection>& connection,
+                                          uint64_t address, uint32_t code, const Parcel& data,
+                                          const sp<RpcSession>& session, Parcel* reply,
+                                          uint32_t flags) {
     LOG_ALWAYS_FATAL_IF(!data.isForRpc());
     LOG_ALWAYS_FATAL_IF(data.objectsCount() != 0);
 
     uint64_t asyncNumber = 0;
-
-    if (address != 0) {
-        RpcMutexUniqueLock _l(mNodeMutex);
-        if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(address);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(),
-                            "Sending transact on unknown address %" PRIu64, address);
-
-        if (flags & IBinder::FLAG_ONEWAY) {
-            asyncNumber = it->second.asyncNumber;
-            if (!nodeProgressAsyncNumber(&it->second)) {
-                _l.unlock();
-                (void)session->shutdownAndWait(false);
-                return DEAD_OBJECT;
-            }
-        }
+    if (status_t status = takeAsyncNumber(session, address, flags, &asyncNumber); status != OK) {
+        return status;
     }
 
     auto* rpcFields = data.maybeRpcFields();
@@ -639,9 +738,137 @@ status_t RpcState::transactAddress(const sp<RpcSession::RpcConnection>& connecti
     return waitForReply(connection, session, reply);
 }
 
+status_t RpcState::takeAsyncNumber(const sp<RpcSession>& session, uint64_t address,
+                                   uint32_t flags, uint64_t* asyncNumber) {
+    *asyncNumber = 0;
+    if (address == 0) return OK;
+
+    NodeShard& shard = shardFor(address);
+    RpcMutexUniqueLock _l(shard.mutex);
+    if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
+    auto it = shard.nodes.find(address);
+    LOG_ALWAYS_FATAL_IF(it == shard.nodes.end(),
+                        "Sending transact on unknown address %" PRIu64, address);
+
+    if (flags & IBinder::FLAG_ONEWAY) {
+        *asyncNumber = it->second.asyncNumber;
+        if (!nodeProgressAsyncNumber(&it->second)) {
+            _l.unlock();
+            (void)session->shutdownAndWait(false);
+            return DEAD_OBJECT;
+        }
+    }
+    return OK;
+}
+
+status_t RpcState::appendOnewayTransaction(const sp<IBinder>& binder, uint32_t code,
+                                           const Parcel& data, const sp<RpcSession>& session,
+                                           uint32_t flags, std::vector<uint8_t>* out) {
+    LOG_ALWAYS_FATAL_IF(!(flags & IBinder::FLAG_ONEWAY), "Only oneway transactions are batched");
+    LOG_ALWAYS_FATAL_IF(data.hasFileDescriptors(), "Can't batch transactions with FDs");
+
+    std::string errorMsg;
+    if (status_t status = validateParcel(session, data, &errorMsg); status != OK) {
+        ALOGE("Refusing to send RPC on binder %p code %" PRIu32 ": Parcel %p failed validation: %s",
+              binder.get(), code, &data, errorMsg.c_str());
+        return status;
+    }
+    LOG_ALWAYS_FATAL_IF(data.objectsCount() != 0);
+
+    uint64_t address;
+    if (status_t status = onBinderLeaving(session, binder, &address); status != OK) return status;
+
+    auto* rpcFields = data.maybeRpcFields();
+    LOG_ALWAYS_FATAL_IF(rpcFields == nullptr);
+
+    Span<const uint32_t> objectTableSpan = Span<const uint32_t>{rpcFields->mObjectPositions.data(),
+                                                                rpcFields->mObjectPositions.size()};
+
+    uint32_t bodySize;
+    LOG_ALWAYS_FATAL_IF(__builtin_add_overflow(sizeof(RpcWireTransaction), data.dataSize(),
+                                               &bodySize) ||
+                                __builtin_add_overflow(objectTableSpan.byteSize(), bodySize,
+                                                       &bodySize),
+                        "Too much data %zu", data.dataSize());
+    RpcWireHeader command{
+            .command = RPC_COMMAND_TRANSACT,
+            .bodySize = bodySize,
+    };
+
+    RpcWireTransaction transaction{
+            .address = RpcWireAddress::fromRaw(address),
+            .code = code,
+            .flags = flags,
+            .asyncNumber = 0, // taken by sendOnewayBatch
+            // bodySize didn't overflow => this cast is safe
+            .parcelDataSize = static_cast<uint32_t>(data.dataSize()),
+    };
+
+    // same layout as the iovecs written by transactAddress
+    const iovec iovs[]{
+            {&command, sizeof(RpcWireHeader)},
+            {&transaction, sizeof(RpcWireTransaction)},
+            {const_cast<uint8_t*>(data.data()), data.dataSize()},
+            objectTableSpan.toIovec(),
+    };
+    out->reserve(out->size() + sizeof(RpcWireHeader) + bodySize);
+    for (const iovec& iov : iovs) {
+        const uint8_t* begin = reinterpret_cast<const uint8_t*>(iov.iov_base);
+        out->insert(out->end(), begin, begin + iov.iov_len);
+    }
+
+    LOG_RPC_DETAIL("Batched oneway transaction on %" PRIu64 " (%zu bytes pending)", address,
+                   out->size());
+    return OK;
+}
+
+status_t RpcState::sendOnewayBatch(const sp<RpcSession::RpcConnection>& connection,
+                                   const sp<RpcSession>& session, std::vector<uint8_t>* data) {
+    if (data->empty()) return OK;
+
+    // Async numbers are only taken when the batch is written. Otherwise, the
+    // oneway transactions which other threads make to the same binders while
+    // the batch is pending would be held up by the server until it is.
+    for (size_t offset = 0; offset < data->size();) {
+        RpcWireHeader command;
+        memcpy(&command, data->data() + offset, sizeof(RpcWireHeader));
+        uint8_t* transactionData = data->data() + offset + sizeof(RpcWireHeader);
+        RpcWireTransaction transaction;
+        memcpy(&transaction, transactionData, sizeof(RpcWireTransaction));
+
+        uint64_t asyncNumber;
+        if (status_t status = takeAsyncNumber(session, RpcWireAddress::toRaw(transaction.address),
+                                              transaction.flags, &asyncNumber);
+            status != OK) {
+            return status;
+        }
+        memcpy(transactionData + offsetof(RpcWireTransaction, asyncNumber), &asyncNumber,
+               sizeof(asyncNumber));
+
+        offset += sizeof(RpcWireHeader) + command.bodySize;
+    }
+
+    // see transactAddress, a batch is also just a series of oneway calls
+    constexpr size_t kWaitMaxUs = 1000000;
+    size_t waitUs = 0;
+    auto altPoll = [&] {
+        if (waitUs > 0) {
+            usleep(waitUs);
+            waitUs = std::min(kWaitMaxUs, waitUs * 2);
+        } else {
+            waitUs = 1;
+        }
+
+        return drainCommands(connection, session, CommandType::CONTROL_ONLY);
+    };
+
+    iovec iov{data->data(), data->size()};
+    return rpcSend(connection, session, "oneway batch", &iov, 1, std::ref(altPoll));
+}
+
 static void cleanup_reply_data(const uint8_t* data, size_t dataSize, const binder_size_t* objects,
                                size_t objectsCount) {
-    delete[] const_cast<uint8_t*>(data);
+    parcelBufferFree(const_cast<uint8_t*>(data));
     (void)dataSize;
     LOG_ALWAYS_FATAL_IF(objects != nullptr);
     (void)objectsCount;
@@ -734,10 +961,11 @@ status_t RpcState::sendDecStrongToTarget(const sp<RpcSession::RpcConnection>& co
     };
 
     {
-        RpcMutexUniqueLock _l(mNodeMutex);
+        NodeShard& shard = shardFor(addr);
+        RpcMutexUniqueLock _l(shard.mutex);
         if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(addr);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(),
+        auto it = shard.nodes.find(addr);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodes.end(),
                             "Sending dec strong on unknown address %" PRIu64, addr);
 
         LOG_ALWAYS_FATAL_IF(it->second.timesRecd < target, "Can't dec count of %zu to %zu.",
@@ -783,7 +1011,9 @@ status_t RpcState::getAndExecuteCommand(const sp<RpcSession::RpcConnection>& con
 status_t RpcState::drainCommands(const sp<RpcSession::RpcConnection>& connection,
                                  const sp<RpcSession>& session, CommandType type) {
     while (true) {
-        status_t status = connection->rpcTransport->pollRead();
+        status_t status = connection->readAheadBegin < connection->readAheadEnd
+                ? OK
+                : connection->rpcTransport->pollRead();
         if (status == WOULD_BLOCK) break;
         if (status != OK) return status;
 
@@ -907,8 +1137,9 @@ processTransactInternalTailCall:
             (void)session->shutdownAndWait(false);
             replyStatus = BAD_VALUE;
         } else if (oneway) {
-            RpcMutexUniqueLock _l(mNodeMutex);
-            auto it = mNodeForAddress.find(addr);
+            NodeShard& shard = shardFor(addr);
+            RpcMutexUniqueLock _l(shard.mutex);
+            auto it = shard.nodes.find(addr);
             if (it->second.binder.promote() != target) {
                 ALOGE("Binder became invalid during transaction. Bad client? %" PRIu64, addr);
                 replyStatus = BAD_VALUE;
@@ -1056,10 +1287,11 @@ processTransactInternalTailCall:
         // downside: asynchronous transactions may drown out synchronous
         // transactions.
         {
-            RpcMutexUniqueLock _l(mNodeMutex);
-            auto it = mNodeForAddress.find(addr);
+            NodeShard& shard = shardFor(addr);
+            RpcMutexUniqueLock _l(shard.mutex);
+            auto it = shard.nodes.find(addr);
             // last refcount dropped after this transaction happened
-            if (it == mNodeForAddress.end()) return OK;
+            if (it == shard.nodes.end()) return OK;
 
             if (!nodeProgressAsyncNumber(&it->second)) {
                 _l.unlock();
@@ -1165,9 +1397,10 @@ status_t RpcState::processDecStrong(const sp<RpcSession::RpcConnection>& connect
         return status;
 
     uint64_t addr = RpcWireAddress::toRaw(body.address);
-    RpcMutexUniqueLock _l(mNodeMutex);
-    auto it = mNodeForAddress.find(addr);
-    if (it == mNodeForAddress.end()) {
+    NodeShard& shard = shardFor(addr);
+    RpcMutexUniqueLock _l(shard.mutex);
+    auto it = shard.nodes.find(addr);
+    if (it == shard.nodes.end()) {
         ALOGE("Unknown binder address %" PRIu64 " for dec strong.", addr);
         return OK;
     }
@@ -1263,8 +1496,8 @@ status_t RpcState::validateParcel(const sp<RpcSession>& session, const Parcel& p
     return OK;
 }
 
-sp<IBinder> RpcState::tryEraseNode(const sp<RpcSession>& session, RpcMutexUniqueLock nodeLock,
-                                   std::map<uint64_t, BinderNode>::iterator& it) {
+sp<IBinder> RpcState::tryEraseNode(const sp<RpcSession>& session, RpcMutexUniqueLock shardLock,
+                                   RpcAddressMap<BinderNode>::iterator& it) {
     bool shouldShutdown = false;
 
     sp<IBinder> ref;
@@ -1275,24 +1508,22 @@ sp<IBinder> RpcState::tryEraseNode(const sp<RpcSession>& session, RpcMutexUnique
         if (it->second.timesRecd == 0) {
             LOG_ALWAYS_FATAL_IF(!it->second.asyncTodo.empty(),
                                 "Can't delete binder w/ pending async transactions");
-            mNodeForAddress.erase(it);
+            shardFor(it->first).nodes.erase(it);
 
-            if (mNodeForAddress.size() == 0) {
+            if (--mNodeCount == 0) {
                 shouldShutdown = true;
             }
         }
     }
 
+    shardLock.unlock(); // explicit
+    // LOCK IS RELEASED
+
     // If we shutdown, prevent RpcState from being re-used. This prevents another
     // thread from getting the root object again.
     if (shouldShutdown) {
-        clear(std::move(nodeLock));
-    } else {
-        nodeLock.unlock(); // explicit
-    }
-    // LOCK IS RELEASED
+        clear();
 
-    if (shouldShutdown) {
         ALOGI("RpcState has no binders left, so triggering shutdown...");
         (void)session->shutdownAndWait(false);
     }
@@ -22,14 +22,18 @@
 #include <binder/RpcThreads.h>
 #include <binder/unique_fd.h>
 
-#include <map>
+#include <atomic>
 #include <optional>
 #include <queue>
 
 #include <sys/uio.h>
 
+#include "ParcelBufferPool.h"
+#include "RpcAddressMap.h"
+
 namespace android {
 
+class FdTrigger;
 struct RpcWireHeader;
 
 /**
@@ -84,11 +88,32 @@ public:
 
     [[nodiscard]] status_t transact(const sp<RpcSession::RpcConnection>& connection,
                                     const sp<IBinder>& address, uint32_t code, const Parcel& data,
-                                    const sp<RpcSession>& session, Parcel* reply, uint32_t flags);
+                                    const sp<RpcSession>& session, Parcel* reply, uint32_t flags,
+                                    int64_t queueDelayNs = 0);
+    // queueDelayNs is the time spent waiting for 'connection', for
+    // binder::debug::TransactionStats.
     [[nodiscard]] status_t transactAddress(const sp<RpcSession::RpcConnection>& connection,
                                            uint64_t address, uint32_t code, const Parcel& data,
                                            const sp<RpcSession>& session, Parcel* reply,
-                                           uint32_t flags);
+                                           uint32_t flags, int64_t queueDelayNs = 0);
+
+    /**
+     * Encodes a oneway transaction like transact would write it, but appends
+     * it to 'out' instead of sending it. Used by RpcSession::OnewayBatch.
+     * 'data' must not contain file descriptors. The async number is filled in
+     * by sendOnewayBatch.
+     */
+    [[nodiscard]] status_t appendOnewayTransaction(const sp<IBinder>& address, uint32_t code,
+                                                   const Parcel& data,
+                                                   const sp<RpcSession>& session, uint32_t flags,
+                                                   std::vector<uint8_t>* out);
+    /**
+     * Numbers the transactions gathered by appendOnewayTransaction, and writes
+     * them with a single write.
+     */
+    [[nodiscard]] status_t sendOnewayBatch(const sp<RpcSession::RpcConnection>& connection,
+                                           const sp<RpcSession>& session,
+                                           std::vector<uint8_t>* data);
 
     /**
      * The ownership model here carries an implicit strong refcount whenever a
@@ -171,7 +196,6 @@ public:
     void clear();
 
 private:
-    void clear(RpcMutexUniqueLock nodeLock);
     void dumpLocked();
 
     // Alternative to std::vector<uint8_t> that doesn't abort on allocation failure and caps
@@ -181,10 +205,14 @@ private:
         bool valid() { return mSize == 0 || mData != nullptr; }
         size_t size() { return mSize; }
         uint8_t* data() { return mData.get(); }
+        // must be freed with binder::impl::parcelBufferFree
         uint8_t* release() { return mData.release(); }
 
     private:
-        std::unique_ptr<uint8_t[]> mData;
+        struct Deleter {
+            void operator()(uint8_t* data) { binder::impl::parcelBufferFree(data); }
+        };
+        std::unique_ptr<uint8_t, Deleter> mData;
         size_t mSize;
     };
 
@@ -200,6 +228,22 @@ private:
                                   std::vector<std::variant<binder::unique_fd, binder::borrowed_fd>>*
                                           ancillaryFds = nullptr);
 
+    // Reads from the read ahead buffer of 'connection' first, and refills it
+    // with whatever is available when it runs out.
+    [[nodiscard]] static status_t readWithReadAhead(
+            const sp<RpcSession::RpcConnection>& connection, FdTrigger* fdTrigger, iovec* iovs,
+            int niovs);
+
+    // transactAddress, without recording stats
+    [[nodiscard]] status_t sendTransactionAndWait(const sp<RpcSession::RpcConnection>& connection,
+                                                  uint64_t address, uint32_t code,
+                                                  const Parcel& data, const sp<RpcSession>& session,
+                                                  Parcel* reply, uint32_t flags);
+
+    // for oneway transactions, take the next async number of 'address'
+    [[nodiscard]] status_t takeAsyncNumber(const sp<RpcSession>& session, uint64_t address,
+                                           uint32_t flags, uint64_t* asyncNumber);
+
     [[nodiscard]] status_t waitForReply(const sp<RpcSession::RpcConnection>& connection,
                                         const sp<RpcSession>& session, Parcel* reply);
     [[nodiscard]] status_t processCommand(
@@ -273,29 +317,51 @@ private:
         std::string toString() const;
     };
 
+    // Nodes are partitioned by address into independently locked shards, so
+    // that transactions and refcounts for unrelated binders don't contend.
+    // A thread holds at most one shard lock at a time, except for operations
+    // on the whole table, which lock all shards in order (see lockAllShards).
+    struct NodeShard {
+        RpcMutex mutex;
+        // binders known by both sides of a session
+        RpcAddressMap<BinderNode> nodes;
+    };
+    static constexpr size_t kNumNodeShards = 16;
+
+    NodeShard& shardFor(uint64_t address) {
+        // addresses are mostly sequential, so the low bits spread well
+        return mShards[(address ^ (address >> 32)) % kNumNodeShards];
+    }
+    void lockAllShards();
+    void unlockAllShards();
+
     // Checks if there is any reference left to a node and erases it. If this
     // is the last node, shuts down the session.
     //
-    // Node lock is passed here for convenience, so that we can release it
+    // Shard lock is passed here for convenience, so that we can release it
     // and terminate the session, but we could leave it up to the caller
     // by returning a continuation if we needed to erase multiple specific
-    // nodes. It may be tempting to allow the client to keep on holding the
-    // lock and instead just return whether or not we should shutdown, but
-    // this introduces the posssibility that another thread calls
-    // getRootBinder and thinks it is valid, rather than immediately getting
-    // an error.
-    sp<IBinder> tryEraseNode(const sp<RpcSession>& session, RpcMutexUniqueLock nodeLock,
-                             std::map<uint64_t, BinderNode>::iterator& it);
+    // nodes. Terminating needs all shard locks, so it happens right after the
+    // shard lock is released. A binder which enters in between is cleared
+    // with the rest of the session, which is shut down either way.
+    sp<IBinder> tryEraseNode(const sp<RpcSession>& session, RpcMutexUniqueLock shardLock,
+                             RpcAddressMap<BinderNode>::iterator& it);
 
     // true - success
     // false - session shutdown, halt
     [[nodiscard]] bool nodeProgressAsyncNumber(BinderNode* node);
 
-    RpcMutex mNodeMutex;
-    bool mTerminated = false;
-    uint32_t mNextId = 0;
-    // binders known by both sides of a session
-    std::map<uint64_t, BinderNode> mNodeForAddress;
+    NodeShard mShards[kNumNodeShards];
+    // only set with all shard locks taken, so it may be read with any of them
+    std::atomic<bool> mTerminated = false;
+    // Nodes in all shards, plus nodes which are about to be inserted. It is
+    // incremented before a node is inserted and decremented after one is
+    // erased, so it only drops to zero once no binder is left or entering.
+    std::atomic<size_t> mNodeCount = 0;
+    std::atomic<uint32_t> mNextId = 0;
+    // serializes finding or creating the node of a local binder in
+    // onBinderLeaving, which needs to look at all shards
+    RpcMutex mLocalNodeMutex;
 };
 
 } // namespace android
@@ -0,0 +1,569 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RpcIoUringTransport"
+#include <log/log.h>
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+
+#include <binder/RpcTransportIoUring.h>
+#include <binder/RpcTransportRaw.h>
+
+#include "FdTrigger.h"
+#include "OS.h"
+#include "RpcState.h"
+#include "RpcTransportUtils.h"
+
+namespace android {
+
+using namespace android::binder::impl;
+using android::binder::borrowed_fd;
+using android::binder::unique_fd;
+
+namespace {
+
+// At most four entries are queued by one wait, plus a cancellation
+constexpr unsigned kRingEntries = 8;
+
+// Minimal io_uring, since liburing isn't available to libbinder. Not
+// threadsafe, each transport owns one.
+class IoUring {
+public:
+    static std::unique_ptr<IoUring> make(unsigned entries) {
+        io_uring_params params{};
+        unique_fd fd(static_cast<int>(syscall(__NR_io_uring_setup, entries, &params)));
+        if (!fd.ok()) {
+            LOG_RPC_DETAIL("io_uring_setup: %s", strerror(errno));
+            return nullptr;
+        }
+        // Used as a proxy for a kernel which has linked and cancellable
+        // socket operations.
+        if ((params.features & IORING_FEAT_FAST_POLL) == 0) {
+            LOG_RPC_DETAIL("io_uring doesn't support IORING_FEAT_FAST_POLL");
+            return nullptr;
+        }
+
+        auto ring = std::unique_ptr<IoUring>(new IoUring());
+        ring->mFd = std::move(fd);
+        ring->mSqEntries = params.sq_entries;
+
+        ring->mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) {
+            ring->mSqRingSize = ring->mCqRingSize =
+                    std::max(ring->mSqRingSize, ring->mCqRingSize);
+        }
+
+        ring->mSqRing = ring->map(ring->mSqRingSize, IORING_OFF_SQ_RING);
+        if (ring->mSqRing == MAP_FAILED) return nullptr;
+        if (singleMmap) {
+            ring->mCqRing = ring->mSqRing;
+        } else {
+            ring->mCqRing = ring->map(ring->mCqRingSize, IORING_OFF_CQ_RING);
+            if (ring->mCqRing == MAP_FAILED) return nullptr;
+        }
+        ring->mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ring->map(ring->mSqesSize, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return nullptr;
+        ring->mSqes = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq = static_cast<uint8_t*>(ring->mSqRing);
+        ring->mSqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        ring->mSqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        ring->mSqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        ring->mSqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        ring->mLocalTail = *ring->mSqTail;
+
+        auto* cq = static_cast<uint8_t*>(ring->mCqRing);
+        ring->mCqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        ring->mCqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        ring->mCqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        ring->mCqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return ring;
+    }
+
+    ~IoUring() {
+        if (mSqes != nullptr) munmap(mSqes, mSqesSize);
+        if (mCqRing != MAP_FAILED && mCqRing != mSqRing) munmap(mCqRing, mCqRingSize);
+        if (mSqRing != MAP_FAILED) munmap(mSqRing, mSqRingSize);
+    }
+
+    // Returns a zeroed entry, which is submitted by the next submitAndWait.
+    io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+        if (mLocalTail - head >= mSqEntries) return nullptr;
+        unsigned index = mLocalTail & mSqMask;
+        mSqArray[index] = index;
+        mLocalTail++;
+        io_uring_sqe* sqe = &mSqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Submits queued entries, and waits for at least waitNr completions.
+    // io_uring_enter only fails before consuming any entry, so on error they
+    // are all still queued, see discardQueued.
+    status_t submitAndWait(unsigned waitNr) {
+        __atomic_store_n(mSqTail, mLocalTail, __ATOMIC_RELEASE);
+        while (true) {
+            unsigned toSubmit = mLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+            if (syscall(__NR_io_uring_enter, mFd.get(), toSubmit, waitNr, IORING_ENTER_GETEVENTS,
+                        nullptr, 0) >= 0) {
+                return OK;
+            }
+            int savedErrno = errno;
+            if (savedErrno != EINTR) return -savedErrno;
+        }
+    }
+
+    // Waits for a completion without io_uring_enter, for when it fails while
+    // entries are in flight.
+    status_t waitWithPoll() {
+        pollfd pfd{.fd = mFd.get(), .events = POLLIN, .revents = 0};
+        if (TEMP_FAILURE_RETRY(poll(&pfd, 1, -1)) < 0) {
+            return -errno;
+        }
+        return OK;
+    }
+
+    // Number of entries which the kernel hasn't consumed yet.
+    unsigned queued() const { return mLocalTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE); }
+
+    // Drops all entries which the kernel hasn't consumed yet.
+    void discardQueued() {
+        mLocalTail = __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+        __atomic_store_n(mSqTail, mLocalTail, __ATOMIC_RELEASE);
+    }
+
+    template <typename Fn>
+    void forEachCqe(Fn fn) {
+        unsigned head = *mCqHead;
+        unsigned tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            fn(mCqes[head & mCqMask]);
+        }
+        __atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+    }
+
+private:
+    IoUring() = default;
+
+    void* map(size_t size, off_t offset) {
+        return mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd.get(),
+                    offset);
+    }
+
+    unique_fd mFd;
+    unsigned mSqEntries = 0;
+
+    void* mSqRing = MAP_FAILED;
+    size_t mSqRingSize = 0;
+    unsigned* mSqHead = nullptr;
+    unsigned* mSqTail = nullptr;
+    unsigned mSqMask = 0;
+    unsigned* mSqArray = nullptr;
+    unsigned mLocalTail = 0;
+    io_uring_sqe* mSqes = nullptr;
+    size_t mSqesSize = 0;
+
+    void* mCqRing = MAP_FAILED;
+    size_t mCqRingSize = 0;
+    unsigned* mCqHead = nullptr;
+    unsigned* mCqTail = nullptr;
+    unsigned mCqMask = 0;
+    io_uring_cqe* mCqes = nullptr;
+};
+
+} // namespace
+
+// RpcTransport with TLS disabled, waiting on the socket with io_uring.
+class RpcTransportIoUring : public RpcTransport {
+public:
+    RpcTransportIoUring(android::RpcTransportFd socket, std::unique_ptr<IoUring> ring)
+          : mSocket(std::move(socket)), mRing(std::move(ring)) {}
+
+    status_t pollRead(void) override {
+        uint8_t buf;
+        ssize_t ret = TEMP_FAILURE_RETRY(
+                ::recv(mSocket.fd.get(), &buf, sizeof(buf), MSG_PEEK | MSG_DONTWAIT));
+        if (ret < 0) {
+            int savedErrno = errno;
+            if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+                return WOULD_BLOCK;
+            }
+
+            LOG_RPC_DETAIL("RpcTransport poll(): %s", strerror(savedErrno));
+            return -savedErrno;
+        } else if (ret == 0) {
+            return DEAD_OBJECT;
+        }
+
+        return OK;
+    }
+
+    status_t interruptableWriteFully(
+            FdTrigger* fdTrigger, iovec* iovs, int niovs,
+            const std::optional<SmallFunction<status_t()>>& altPoll,
+            const std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds) override {
+        bool sentFds = false;
+        // Most writes fit in the socket buffer, so sendmsg is tried first.
+        auto send = [&](iovec* iovs, int niovs, ssize_t* sizeOut) -> status_t {
+            bool withFds = !sentFds && ancillaryFds != nullptr && !ancillaryFds->empty();
+            ssize_t ret = binder::os::sendMessageOnSocket(mSocket, iovs, niovs,
+                                                          sentFds ? nullptr : ancillaryFds);
+            if (ret >= 0) {
+                sentFds |= ret > 0;
+                *sizeOut = ret;
+                return OK;
+            }
+            int savedErrno = errno;
+            if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) return -savedErrno;
+
+            if (altPoll) return altPollAndRetry(fdTrigger, *altPoll);
+            if (withFds) {
+                // the ring doesn't pass fds, so only wait with it
+                if (status_t status = waitAndTransfer(fdTrigger, POLLOUT, nullptr, 0, nullptr);
+                    status != OK) {
+                    return status;
+                }
+                return WOULD_BLOCK;
+            }
+            msghdr msg{};
+            msg.msg_iov = iovs;
+            msg.msg_iovlen = niovs;
+            return waitAndTransfer(fdTrigger, POLLOUT, &msg, IORING_OP_SENDMSG, sizeOut);
+        };
+        return transferFully(fdTrigger, iovs, niovs, send, "sendmsg");
+    }
+
+    status_t interruptableReadFully(
+            FdTrigger* fdTrigger, iovec* iovs, int niovs,
+            const std::optional<SmallFunction<status_t()>>& altPoll,
+            std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds) override {
+        auto recv = [&](iovec* iovs, int niovs, ssize_t* sizeOut) -> status_t {
+            if (altPoll || ancillaryFds != nullptr) {
+                return receiveDirect(fdTrigger, iovs, niovs, altPoll, ancillaryFds, sizeOut);
+            }
+            msghdr msg{};
+            msg.msg_iov = iovs;
+            msg.msg_iovlen = niovs;
+            return waitAndTransfer(fdTrigger, POLLIN, &msg, IORING_OP_RECVMSG, sizeOut);
+        };
+        return transferFully(fdTrigger, iovs, niovs, recv, "recvmsg");
+    }
+
+    status_t interruptableReadFullyWithReadAhead(FdTrigger* fdTrigger, iovec* iovs, int niovs,
+                                                 void* readAhead, size_t readAheadSize,
+                                                 size_t* readAheadOut) override {
+        *readAheadOut = 0;
+
+        // Same as RpcTransportRaw, the read ahead buffer is an extra iovec
+        // which is hidden from transferFully.
+        constexpr int kMaxIovs = 8;
+        if (niovs <= 0 || niovs >= kMaxIovs || readAheadSize == 0) {
+            return interruptableReadFully(fdTrigger, iovs, niovs, std::nullopt, nullptr);
+        }
+
+        auto recv = [&](iovec* iovs, int niovs, ssize_t* sizeOut) -> status_t {
+            iovec allIovs[kMaxIovs];
+            size_t requested = 0;
+            for (int i = 0; i < niovs; i++) {
+                allIovs[i] = iovs[i];
+                requested += iovs[i].iov_len;
+            }
+            allIovs[niovs] = {readAhead, readAheadSize};
+
+            msghdr msg{};
+            msg.msg_iov = allIovs;
+            msg.msg_iovlen = niovs + 1;
+            if (status_t status =
+                        waitAndTransfer(fdTrigger, POLLIN, &msg, IORING_OP_RECVMSG, sizeOut);
+                status != OK) {
+                return status;
+            }
+            if (static_cast<size_t>(*sizeOut) > requested) {
+                *readAheadOut = *sizeOut - requested;
+                *sizeOut = requested;
+            }
+            return OK;
+        };
+        return transferFully(fdTrigger, iovs, niovs, recv, "recvmsg");
+    }
+
+    bool isWaiting() override { return mWaiting.load(std::memory_order_relaxed); }
+
+private:
+    // Kinds of entries submitted by waitAndTransfer, in the low bits of the
+    // user data. The rest is the generation of the wait.
+    enum : uint64_t {
+        kTransfer = 0,
+        kSocketPoll = 1,
+        kTriggerPoll = 2,
+        kCancel = 3,
+    };
+    static uint64_t tag(uint64_t generation, uint64_t kind) { return generation << 2 | kind; }
+
+    // Like interruptableReadOrWrite, except that 'transfer' waits itself,
+    // and returns WOULD_BLOCK when it should be called again.
+    template <typename Transfer>
+    status_t transferFully(FdTrigger* fdTrigger, iovec* iovs, int niovs, Transfer transfer,
+                           const char* funName) {
+        MAYBE_WAIT_IN_FLAKE_MODE;
+
+        if (niovs < 0) {
+            return BAD_VALUE;
+        }
+        if (fdTrigger->isTriggered()) {
+            return DEAD_OBJECT;
+        }
+
+        // See interruptableReadOrWrite
+        while (niovs > 0 && iovs[niovs - 1].iov_len == 0) {
+            niovs--;
+        }
+
+        while (niovs > 0) {
+            ssize_t processSize = 0;
+            status_t status = transfer(iovs, niovs, &processSize);
+            if (status == WOULD_BLOCK) continue;
+            if (status != OK) {
+                LOG_RPC_DETAIL("RpcTransport %s(): %s", funName, statusToString(status).c_str());
+                return status;
+            }
+            if (processSize == 0) {
+                return DEAD_OBJECT;
+            }
+
+            while (processSize > 0 && niovs > 0) {
+                auto& iov = iovs[0];
+                if (static_cast<size_t>(processSize) < iov.iov_len) {
+                    // Advance the base of the current iovec
+                    iov.iov_base = reinterpret_cast<char*>(iov.iov_base) + processSize;
+                    iov.iov_len -= processSize;
+                    break;
+                }
+
+                // The current iovec was fully transferred
+                processSize -= iov.iov_len;
+                iovs++;
+                niovs--;
+            }
+            LOG_ALWAYS_FATAL_IF(niovs == 0 && processSize > 0,
+                                "Reached the end of iovecs with %zd bytes remaining", processSize);
+        }
+        return OK;
+    }
+
+    status_t altPollAndRetry(FdTrigger* fdTrigger, const SmallFunction<status_t()>& altPoll) {
+        if (status_t status = altPoll(); status != OK) return status;
+        if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+        return WOULD_BLOCK;
+    }
+
+    // For reads which need the fd handling of receiveMessageFromSocket, or
+    // which wait with altPoll.
+    status_t receiveDirect(FdTrigger* fdTrigger, iovec* iovs, int niovs,
+                           const std::optional<SmallFunction<status_t()>>& altPoll,
+                           std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds,
+                           ssize_t* sizeOut) {
+        ssize_t ret = binder::os::receiveMessageFromSocket(mSocket, iovs, niovs, ancillaryFds);
+        if (ret >= 0) {
+            *sizeOut = ret;
+            return OK;
+        }
+        int savedErrno = errno;
+        if (savedErrno != EAGAIN && savedErrno != EWOULDBLOCK) return -savedErrno;
+
+        if (altPoll) return altPollAndRetry(fdTrigger, *altPoll);
+        if (status_t status = waitAndTransfer(fdTrigger, POLLIN, nullptr, 0, nullptr);
+            status != OK) {
+            return status;
+        }
+        return WOULD_BLOCK;
+    }
+
+    // Waits for 'event' on the socket, or for the trigger, with a single
+    // io_uring_enter. If 'msg' is set, the 'opcode' transfer is linked to the
+    // wait and its size is returned in 'sizeOut'.
+    status_t waitAndTransfer(FdTrigger* fdTrigger, int16_t event, msghdr* msg, uint8_t opcode,
+                             ssize_t* sizeOut) {
+        uint64_t generation = ++mGeneration;
+        uint64_t previousTriggerPoll = mPendingTriggerPoll;
+
+        // The trigger poll of the previous wait may still be armed
+        if (mPendingTriggerPoll) {
+            io_uring_sqe* sqe = getSqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = mPendingTriggerPoll;
+            sqe->user_data = tag(generation, kCancel);
+            mPendingTriggerPoll = 0;
+        }
+
+        borrowed_fd triggerFd = fdTrigger->pollFd();
+        bool triggerPollArmed = triggerFd.ok();
+        if (triggerPollArmed) {
+            io_uring_sqe* sqe = getSqe();
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = triggerFd.get();
+            sqe->poll32_events = 0; // POLLHUP is always reported
+            sqe->user_data = tag(generation, kTriggerPoll);
+        }
+
+        io_uring_sqe* pollSqe = getSqe();
+        pollSqe->opcode = IORING_OP_POLL_ADD;
+        pollSqe->fd = mSocket.fd.get();
+        pollSqe->poll32_events = event;
+        pollSqe->user_data = tag(generation, kSocketPoll);
+
+        uint64_t doneTag = tag(generation, kSocketPoll);
+        if (msg != nullptr) {
+            pollSqe->flags |= IOSQE_IO_LINK;
+
+            io_uring_sqe* sqe = getSqe();
+            sqe->opcode = opcode;
+            sqe->fd = mSocket.fd.get();
+            sqe->addr = reinterpret_cast<uintptr_t>(msg);
+            sqe->len = 1;
+            sqe->msg_flags = opcode == IORING_OP_SENDMSG ? MSG_NOSIGNAL : 0;
+            doneTag = tag(generation, kTransfer);
+            sqe->user_data = doneTag;
+        }
+
+        mWaiting.store(true, std::memory_order_relaxed);
+        bool done = false;
+        bool triggered = false;
+        bool cancelled = false;
+        int32_t result = 0;
+        while (!done) {
+            if (triggered && !cancelled) {
+                // also cancels the linked transfer
+                io_uring_sqe* sqe = getSqe();
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->addr = tag(generation, kSocketPoll);
+                sqe->user_data = tag(generation, kCancel);
+                cancelled = true;
+            }
+
+            unsigned queued = mRing->queued();
+            if (status_t status = mRing->submitAndWait(1); status != OK) {
+                LOG_RPC_DETAIL("io_uring_enter: %s", statusToString(status).c_str());
+                if (queued == 0 || cancelled) {
+                    // The kernel may still be using 'msg', so this can't bail
+                    // out until the wait completes. If poll fails too, the
+                    // loop retries.
+                    if (status = mRing->waitWithPoll(); status != OK) {
+                        LOG_RPC_DETAIL("poll on io_uring: %s", statusToString(status).c_str());
+                    }
+                } else {
+                    // Nothing of this wait reached the kernel
+                    mRing->discardQueued();
+                    mPendingTriggerPoll = previousTriggerPoll;
+                    mWaiting.store(false, std::memory_order_relaxed);
+                    return status;
+                }
+            }
+
+            mRing->forEachCqe([&](const io_uring_cqe& cqe) {
+                // anything else is from a previous wait
+                if (cqe.user_data == doneTag) {
+                    done = true;
+                    result = cqe.res;
+                } else if (cqe.user_data == tag(generation, kTriggerPoll)) {
+                    triggered = true;
+                    triggerPollArmed = false;
+                }
+            });
+        }
+        mWaiting.store(false, std::memory_order_relaxed);
+
+        // Cancelled lazily, with the next submission
+        if (triggerPollArmed) mPendingTriggerPoll = tag(generation, kTriggerPoll);
+
+        if (triggered || fdTrigger->isTriggered()) {
+            return DEAD_OBJECT;
+        }
+        if (result < 0) {
+            return result == -EAGAIN ? WOULD_BLOCK : result;
+        }
+        if (msg == nullptr) {
+            if (result & POLLNVAL) return BAD_VALUE;
+            if (result & (POLLERR | POLLHUP)) return DEAD_OBJECT;
+            return OK;
+        }
+        *sizeOut = result;
+        return OK;
+    }
+
+    io_uring_sqe* getSqe() {
+        io_uring_sqe* sqe = mRing->getSqe();
+        LOG_ALWAYS_FATAL_IF(sqe == nullptr, "io_uring submission queue is full");
+        return sqe;
+    }
+
+    android::RpcTransportFd mSocket;
+    std::unique_ptr<IoUring> mRing;
+    uint64_t mGeneration = 0;
+    // user data of a trigger poll which still needs to be cancelled, or 0
+    uint64_t mPendingTriggerPoll = 0;
+    std::atomic<bool> mWaiting = false;
+};
+
+// RpcTransportCtx with TLS disabled, using io_uring when it is available.
+class RpcTransportCtxIoUring : public RpcTransportCtx {
+public:
+    std::unique_ptr<RpcTransport> newTransport(android::RpcTransportFd socket,
+                                               FdTrigger* fdTrigger) const override {
+        if (auto ring = IoUring::make(kRingEntries); ring != nullptr) {
+            return std::make_unique<RpcTransportIoUring>(std::move(socket), std::move(ring));
+        }
+        LOG_RPC_DETAIL("io_uring unavailable, using the raw transport");
+        return mRawCtx->newTransport(std::move(socket), fdTrigger);
+    }
+    std::vector<uint8_t> getCertificate(RpcCertificateFormat) const override { return {}; }
+
+private:
+    std::unique_ptr<RpcTransportCtx> mRawCtx = RpcTransportCtxFactoryRaw::make()->newClientCtx();
+};
+
+std::unique_ptr<RpcTransportCtx> RpcTransportCtxFactoryIoUring::newServerCtx() const {
+    return std::make_unique<RpcTransportCtxIoUring>();
+}
+
+std::unique_ptr<RpcTransportCtx> RpcTransportCtxFactoryIoUring::newClientCtx() const {
+    return std::make_unique<RpcTransportCtxIoUring>();
+}
+
+const char* RpcTransportCtxFactoryIoUring::toCString() const {
+    return "io_uring";
+}
+
+std::unique_ptr<RpcTransportCtxFactory> RpcTransportCtxFactoryIoUring::make() {
+    return std::unique_ptr<RpcTransportCtxFactoryIoUring>(new RpcTransportCtxFactoryIoUring());
+}
+
+} // namespace android
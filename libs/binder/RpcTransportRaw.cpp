@@ -83,6 +83,40 @@ public:
                                         altPoll);
     }
 
+    status_t interruptableReadFullyWithReadAhead(FdTrigger* fdTrigger, iovec* iovs, int niovs,
+                                                 void* readAhead, size_t readAheadSize,
+                                                 size_t* readAheadOut) override {
+        *readAheadOut = 0;
+
+        // The read ahead buffer is passed as an extra iovec, so that it is
+        // filled by the same recvmsg call which completes the read. Any bytes
+        // past the requested ones are hidden from interruptableReadOrWrite.
+        constexpr int kMaxIovs = 8;
+        if (niovs <= 0 || niovs >= kMaxIovs || readAheadSize == 0) {
+            return interruptableReadFully(fdTrigger, iovs, niovs, std::nullopt, nullptr);
+        }
+
+        auto recv = [&](iovec* iovs, int niovs) -> ssize_t {
+            iovec allIovs[kMaxIovs];
+            size_t requested = 0;
+            for (int i = 0; i < niovs; i++) {
+                allIovs[i] = iovs[i];
+                requested += iovs[i].iov_len;
+            }
+            allIovs[niovs] = {readAhead, readAheadSize};
+
+            ssize_t ret = binder::os::receiveMessageFromSocket(mSocket, allIovs, niovs + 1,
+                                                               nullptr);
+            if (ret > 0 && static_cast<size_t>(ret) > requested) {
+                *readAheadOut = ret - requested;
+                ret = requested;
+            }
+            return ret;
+        };
+        return interruptableReadOrWrite(mSocket, fdTrigger, iovs, niovs, recv, "recvmsg", POLLIN,
+                                        std::nullopt);
+    }
+
     bool isWaiting() override { return mSocket.isInPollingState(); }
 
 private:
@@ -0,0 +1,496 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RpcShmemTransport"
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <deque>
+
+#include <binder/RpcTransportShmem.h>
+
+#include "FdTrigger.h"
+#include "OS.h"
+#include "RpcState.h"
+#include "RpcTransportUtils.h"
+#include "Utils.h"
+
+namespace android {
+
+using namespace android::binder::impl;
+using android::binder::borrowed_fd;
+using android::binder::unique_fd;
+
+namespace {
+
+// At the start of each ring mapping, shared by both processes. Positions count
+// all bytes written or read so far, and are taken modulo the ring size.
+struct RingHeader {
+    std::atomic<uint64_t> writePos;
+    std::atomic<uint64_t> readPos;
+    // Set by the reader before it waits for data, or by the writer before it
+    // waits for space, so that the other side sends a wakeup on the socket.
+    std::atomic<uint32_t> readerWaiting;
+    std::atomic<uint32_t> writerWaiting;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring is shared between processes");
+
+constexpr size_t kRingDataOffset = 64;
+static_assert(sizeof(RingHeader) <= kRingDataOffset);
+
+// don't map arbitrarily large rings for the peer
+constexpr size_t kMaxRingSize = 64 << 20;
+
+// Records sent on the socket
+constexpr uint8_t kRecordWakeup = 'W';
+// Followed by a uint64_t ring position. The FDs sent with this record belong
+// to the data which starts at that position.
+constexpr uint8_t kRecordFds = 'F';
+constexpr size_t kRecordFdsSize = 1 + sizeof(uint64_t);
+
+bool isValidRingSize(size_t size) {
+    return size >= static_cast<size_t>(getpagesize()) && size <= kMaxRingSize &&
+            (size & (size - 1)) == 0;
+}
+
+// Mapping of the shared memory for one direction of a connection.
+class Ring {
+public:
+    Ring() = default;
+    ~Ring() {
+        if (mBase != MAP_FAILED) munmap(mBase, kRingDataOffset + mSize);
+    }
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    // Creates the ring this process writes to.
+    status_t create(size_t size, unique_fd* outFd) {
+        unique_fd fd(memfd_create("binder_rpc_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+        if (!fd.ok()) {
+            int savedErrno = errno;
+            ALOGE("Could not create memfd: %s", strerror(savedErrno));
+            return -savedErrno;
+        }
+        if (0 != TEMP_FAILURE_RETRY(ftruncate(fd.get(), kRingDataOffset + size))) {
+            int savedErrno = errno;
+            ALOGE("Could not resize memfd to %zu: %s", size, strerror(savedErrno));
+            return -savedErrno;
+        }
+        // checked by the peer, so that its mapping can't fault
+        if (0 != fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+            int savedErrno = errno;
+            ALOGE("Could not seal memfd: %s", strerror(savedErrno));
+            return -savedErrno;
+        }
+        if (status_t status = mapFd(fd, size); status != OK) return status;
+
+        new (mBase) RingHeader();
+        *outFd = std::move(fd);
+        return OK;
+    }
+
+    // Maps the ring the peer writes to.
+    status_t map(borrowed_fd fd) {
+        int seals = fcntl(fd.get(), F_GET_SEALS);
+        if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+            ALOGE("Ring of the peer may be shrunk, not mapping it");
+            return BAD_VALUE;
+        }
+
+        struct stat st;
+        if (0 != fstat(fd.get(), &st)) {
+            int savedErrno = errno;
+            ALOGE("Could not stat ring of the peer: %s", strerror(savedErrno));
+            return -savedErrno;
+        }
+        if (st.st_size <= static_cast<off_t>(kRingDataOffset) ||
+            !isValidRingSize(st.st_size - kRingDataOffset)) {
+            ALOGE("Ring of the peer has invalid size %" PRId64, static_cast<int64_t>(st.st_size));
+            return BAD_VALUE;
+        }
+
+        return mapFd(fd, st.st_size - kRingDataOffset);
+    }
+
+    RingHeader* header() { return static_cast<RingHeader*>(mBase); }
+    uint8_t* data() { return static_cast<uint8_t*>(mBase) + kRingDataOffset; }
+    size_t size() const { return mSize; }
+
+private:
+    status_t mapFd(borrowed_fd fd, size_t size) {
+        void* base = mmap(nullptr, kRingDataOffset + size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                          fd.get(), 0);
+        if (base == MAP_FAILED) {
+            int savedErrno = errno;
+            ALOGE("Could not map ring: %s", strerror(savedErrno));
+            return -savedErrno;
+        }
+        mBase = base;
+        mSize = size;
+        return OK;
+    }
+
+    void* mBase = MAP_FAILED;
+    size_t mSize = 0;
+};
+
+} // namespace
+
+// RpcTransport which copies data through shared memory.
+class RpcTransportShmem : public RpcTransport {
+public:
+    explicit RpcTransportShmem(android::RpcTransportFd socket) : mSocket(std::move(socket)) {}
+
+    // Creates the ring for outgoing data, and exchanges it with the peer's.
+    status_t setup(FdTrigger* fdTrigger, size_t ringSize) {
+        unique_fd outFd;
+        if (status_t status = mOut.create(ringSize, &outFd); status != OK) return status;
+
+        // each ring is attached to a single byte message
+        uint8_t byte = 0;
+        iovec iov{&byte, sizeof(byte)};
+        std::vector<std::variant<unique_fd, borrowed_fd>> fds;
+        fds.emplace_back(borrowed_fd(outFd));
+        if (status_t status = sendOnSocket(fdTrigger, &iov, &fds); status != OK) return status;
+
+        fds.clear();
+        iov = {&byte, sizeof(byte)};
+        auto recv = [&](iovec* iovs, int niovs) -> ssize_t {
+            return binder::os::receiveMessageFromSocket(mSocket, iovs, niovs, &fds);
+        };
+        if (status_t status = interruptableReadOrWrite(mSocket, fdTrigger, &iov, 1, recv,
+                                                       "recvmsg", POLLIN, std::nullopt);
+            status != OK) {
+            return status;
+        }
+        if (fds.size() != 1) {
+            ALOGE("Expected the ring of the peer, but got %zu FDs", fds.size());
+            return BAD_VALUE;
+        }
+        return mIn.map(std::get<unique_fd>(fds[0]));
+    }
+
+    status_t pollRead(void) override {
+        status_t drained = drainSocket();
+
+        size_t available;
+        if (status_t status = readable(&available); status != OK) return status;
+        if (available > 0) return OK;
+        if (drained != OK) return drained;
+
+        // so that whoever polls the socket next is woken up by new data
+        mIn.header()->readerWaiting.store(1);
+        if (status_t status = readable(&available); status != OK) return status;
+        return available > 0 ? OK : WOULD_BLOCK;
+    }
+
+    status_t interruptableWriteFully(
+            FdTrigger* fdTrigger, iovec* iovs, int niovs,
+            const std::optional<SmallFunction<status_t()>>& altPoll,
+            const std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds) override {
+        MAYBE_WAIT_IN_FLAKE_MODE;
+
+        if (niovs < 0) return BAD_VALUE;
+        if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+
+        if (ancillaryFds != nullptr && !ancillaryFds->empty()) {
+            // sent before the data is published, so the peer has them when it reads it
+            uint8_t record[kRecordFdsSize] = {kRecordFds};
+            memcpy(record + 1, &mWritePos, sizeof(mWritePos));
+            iovec iov{record, sizeof(record)};
+            if (status_t status = sendOnSocket(fdTrigger, &iov, ancillaryFds); status != OK) {
+                return status;
+            }
+        }
+
+        for (int i = 0; i < niovs; i++) {
+            const uint8_t* buf = static_cast<const uint8_t*>(iovs[i].iov_base);
+            size_t remaining = iovs[i].iov_len;
+            while (remaining > 0) {
+                size_t space;
+                if (status_t status = writable(&space); status != OK) return status;
+                if (space == 0) {
+                    mOut.header()->writerWaiting.store(1);
+                    // the peer may have caught up before it saw the flag
+                    if (status_t status = writable(&space); status != OK) return status;
+                    if (space == 0) {
+                        if (status_t status = waitForPeer(fdTrigger, altPoll); status != OK) {
+                            return status;
+                        }
+                        continue;
+                    }
+                }
+
+                size_t offset = mWritePos & (mOut.size() - 1);
+                size_t len = std::min({remaining, space, mOut.size() - offset});
+                memcpy(mOut.data() + offset, buf, len);
+                buf += len;
+                remaining -= len;
+                mWritePos += len;
+
+                mOut.header()->writePos.store(mWritePos);
+                if (mOut.header()->readerWaiting.exchange(0) != 0) {
+                    if (status_t status = wakePeer(fdTrigger); status != OK) return status;
+                }
+            }
+        }
+        return OK;
+    }
+
+    status_t interruptableReadFully(
+            FdTrigger* fdTrigger, iovec* iovs, int niovs,
+            const std::optional<SmallFunction<status_t()>>& altPoll,
+            std::vector<std::variant<unique_fd, borrowed_fd>>* ancillaryFds) override {
+        MAYBE_WAIT_IN_FLAKE_MODE;
+
+        if (niovs < 0) return BAD_VALUE;
+        if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+
+        uint64_t startPos = mReadPos;
+        for (int i = 0; i < niovs; i++) {
+            uint8_t* buf = static_cast<uint8_t*>(iovs[i].iov_base);
+            size_t remaining = iovs[i].iov_len;
+            while (remaining > 0) {
+                size_t available;
+                if (status_t status = readable(&available); status != OK) return status;
+                if (available == 0) {
+                    mIn.header()->readerWaiting.store(1);
+                    // the peer may have written before it saw the flag
+                    if (status_t status = readable(&available); status != OK) return status;
+                    if (available == 0) {
+                        if (status_t status = waitForPeer(fdTrigger, altPoll); status != OK) {
+                            return status;
+                        }
+                        continue;
+                    }
+                }
+
+                size_t offset = mReadPos & (mIn.size() - 1);
+                size_t len = std::min({remaining, available, mIn.size() - offset});
+                memcpy(buf, mIn.data() + offset, len);
+                buf += len;
+                remaining -= len;
+                mReadPos += len;
+
+                mIn.header()->readPos.store(mReadPos);
+                if (mIn.header()->writerWaiting.exchange(0) != 0) {
+                    if (status_t status = wakePeer(fdTrigger); status != OK) return status;
+                }
+            }
+        }
+
+        if (ancillaryFds != nullptr) {
+            // The peer may have closed the socket after sending everything,
+            // which is noticed on the next read.
+            if (status_t status = drainSocket(); status != OK && status != DEAD_OBJECT) {
+                return status;
+            }
+        }
+        while (!mPendingFds.empty() && mPendingFds.front().pos < mReadPos) {
+            PendingFds& pending = mPendingFds.front();
+            if (pending.pos < startPos || ancillaryFds == nullptr) {
+                ALOGE("Received FDs for data at %" PRIu64 " which doesn't expect any",
+                      pending.pos);
+                return BAD_VALUE;
+            }
+            for (auto& fd : pending.fds) {
+                ancillaryFds->push_back(std::move(fd));
+            }
+            mPendingFds.pop_front();
+        }
+        return OK;
+    }
+
+    bool isWaiting() override { return mSocket.isInPollingState(); }
+
+private:
+    // Bytes of the incoming ring which can be read. The positions in shared
+    // memory are only trusted within the ring size.
+    status_t readable(size_t* out) {
+        uint64_t available = mIn.header()->writePos.load() - mReadPos;
+        if (available > mIn.size()) {
+            ALOGE("Peer corrupted its ring: %" PRIu64 " bytes available", available);
+            return DEAD_OBJECT;
+        }
+        *out = available;
+        return OK;
+    }
+
+    // Bytes of the outgoing ring which can be written.
+    status_t writable(size_t* out) {
+        uint64_t used = mWritePos - mOut.header()->readPos.load();
+        if (used > mOut.size()) {
+            ALOGE("Peer corrupted our ring: %" PRIu64 " bytes used", used);
+            return DEAD_OBJECT;
+        }
+        *out = mOut.size() - used;
+        return OK;
+    }
+
+    // Waits until the peer sends something on the socket, and processes it.
+    status_t waitForPeer(FdTrigger* fdTrigger,
+                         const std::optional<SmallFunction<status_t()>>& altPoll) {
+        if (altPoll) {
+            if (status_t status = (*altPoll)(); status != OK) return status;
+            if (fdTrigger->isTriggered()) return DEAD_OBJECT;
+        } else {
+            if (status_t status = fdTrigger->triggerablePoll(mSocket, POLLIN); status != OK) {
+                return status;
+            }
+        }
+        return drainSocket();
+    }
+
+    // Processes all records which were sent on the socket, without blocking.
+    status_t drainSocket() {
+        while (true) {
+            uint8_t buf[64];
+            iovec iov{buf, sizeof(buf)};
+            std::vector<std::variant<unique_fd, borrowed_fd>> fds;
+            ssize_t ret = binder::os::receiveMessageFromSocket(mSocket, &iov, 1, &fds);
+            if (ret < 0) {
+                int savedErrno = errno;
+                if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) return OK;
+                LOG_RPC_DETAIL("RpcTransport recvmsg(): %s", strerror(savedErrno));
+                return -savedErrno;
+            }
+            if (ret == 0) return DEAD_OBJECT;
+
+            for (ssize_t i = 0; i < ret; i++) {
+                if (mRecordSize == 0) {
+                    if (buf[i] == kRecordWakeup) continue;
+                    if (buf[i] != kRecordFds) {
+                        ALOGE("Unknown record %" PRIu8 " on socket", buf[i]);
+                        return BAD_VALUE;
+                    }
+                    // A read never continues past a message with FDs, so the
+                    // FDs of this read belong to this record.
+                    if (fds.empty()) {
+                        ALOGE("Received FD record without FDs");
+                        return BAD_VALUE;
+                    }
+                    mRecordFds = std::move(fds);
+                    fds.clear();
+                }
+
+                mRecord[mRecordSize++] = buf[i];
+                if (mRecordSize == kRecordFdsSize) {
+                    uint64_t pos;
+                    memcpy(&pos, mRecord + 1, sizeof(pos));
+                    mPendingFds.push_back(PendingFds{.pos = pos, .fds = std::move(mRecordFds)});
+                    mRecordFds.clear();
+                    mRecordSize = 0;
+                }
+            }
+            if (!fds.empty()) {
+                ALOGE("Received %zu FDs without a record", fds.size());
+                return BAD_VALUE;
+            }
+        }
+    }
+
+    status_t wakePeer(FdTrigger* fdTrigger) {
+        uint8_t record = kRecordWakeup;
+        iovec iov{&record, sizeof(record)};
+        return sendOnSocket(fdTrigger, &iov, nullptr);
+    }
+
+    status_t sendOnSocket(FdTrigger* fdTrigger, iovec* iov,
+                          const std::vector<std::variant<unique_fd, borrowed_fd>>* fds) {
+        bool sentFds = false;
+        auto send = [&](iovec* iovs, int niovs) -> ssize_t {
+            ssize_t ret =
+                    binder::os::sendMessageOnSocket(mSocket, iovs, niovs, sentFds ? nullptr : fds);
+            sentFds |= ret > 0;
+            return ret;
+        };
+        return interruptableReadOrWrite(mSocket, fdTrigger, iov, 1, send, "sendmsg", POLLOUT,
+                                        std::nullopt);
+    }
+
+    struct PendingFds {
+        uint64_t pos;
+        std::vector<std::variant<unique_fd, borrowed_fd>> fds;
+    };
+
+    android::RpcTransportFd mSocket;
+
+    Ring mIn;  // written by the peer
+    Ring mOut; // written by this process
+    // The positions in shared memory may be changed by the peer, so these
+    // are the ones used.
+    uint64_t mReadPos = 0;
+    uint64_t mWritePos = 0;
+
+    // record which was partially read from the socket
+    uint8_t mRecord[kRecordFdsSize];
+    size_t mRecordSize = 0;
+    std::vector<std::variant<unique_fd, borrowed_fd>> mRecordFds;
+    // FDs for data which wasn't read yet, in order
+    std::deque<PendingFds> mPendingFds;
+};
+
+// RpcTransportCtx which sets up shared memory rings for each connection.
+class RpcTransportCtxShmem : public RpcTransportCtx {
+public:
+    explicit RpcTransportCtxShmem(size_t ringSize) : mRingSize(ringSize) {}
+
+    std::unique_ptr<RpcTransport> newTransport(android::RpcTransportFd socket,
+                                               FdTrigger* fdTrigger) const override {
+        if (fdTrigger == nullptr) {
+            ALOGE("Cannot exchange rings without a trigger");
+            return nullptr;
+        }
+        auto transport = std::make_unique<RpcTransportShmem>(std::move(socket));
+        if (status_t status = transport->setup(fdTrigger, mRingSize); status != OK) {
+            ALOGE("Could not set up shared memory rings: %s", statusToString(status).c_str());
+            return nullptr;
+        }
+        return transport;
+    }
+    std::vector<uint8_t> getCertificate(RpcCertificateFormat) const override { return {}; }
+
+private:
+    size_t mRingSize;
+};
+
+std::unique_ptr<RpcTransportCtx> RpcTransportCtxFactoryShmem::newServerCtx() const {
+    return std::make_unique<RpcTransportCtxShmem>(mRingSize);
+}
+
+std::unique_ptr<RpcTransportCtx> RpcTransportCtxFactoryShmem::newClientCtx() const {
+    return std::make_unique<RpcTransportCtxShmem>(mRingSize);
+}
+
+const char* RpcTransportCtxFactoryShmem::toCString() const {
+    return "shmem";
+}
+
+std::unique_ptr<RpcTransportCtxFactory> RpcTransportCtxFactoryShmem::make(size_t ringSize) {
+    LOG_ALWAYS_FATAL_IF(!isValidRingSize(ringSize), "Invalid ring size %zu", ringSize);
+    return std::unique_ptr<RpcTransportCtxFactoryShmem>(new RpcTransportCtxFactoryShmem(ringSize));
+}
+
+} // namespace android
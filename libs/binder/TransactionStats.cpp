@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TransactionStatsTimer.h"
+
+#include <binder/IBinder.h>
+#include <binder/TransactionStats.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace android::binder {
+
+namespace {
+
+constexpr size_t kMaxEntries = 256;
+constexpr size_t kMaxDescriptorLength = 95;
+
+// Log-linear histogram, like HdrHistogram. Latencies under 2^kMinExponent ns
+// are split into kSubBuckets linear buckets. Each power of two above that is
+// split into kSubBuckets buckets, so the relative error is 1/kSubBuckets.
+constexpr int kSubBucketBits = 3;
+constexpr int64_t kSubBuckets = 1 << kSubBucketBits;
+constexpr int kMinExponent = 10;  // ~1us
+constexpr int kMaxExponent = 36;  // ~69s, larger values go in the last bucket
+constexpr size_t kNumBuckets = kSubBuckets + (kMaxExponent - kMinExponent) * kSubBuckets;
+
+size_t bucketFor(int64_t ns) {
+    if (ns < (int64_t{1} << kMinExponent)) {
+        return std::max<int64_t>(ns, 0) >> (kMinExponent - kSubBucketBits);
+    }
+    int exponent = 63 - __builtin_clzll(static_cast<uint64_t>(ns));
+    if (exponent >= kMaxExponent) return kNumBuckets - 1;
+    size_t subBucket = (ns >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return kSubBuckets + (exponent - kMinExponent) * kSubBuckets + subBucket;
+}
+
+// Middle of the range of values in the bucket
+int64_t bucketValue(size_t bucket) {
+    if (bucket < kSubBuckets) {
+        int64_t width = int64_t{1} << (kMinExponent - kSubBucketBits);
+        return bucket * width + width / 2;
+    }
+    int exponent = kMinExponent + (bucket - kSubBuckets) / kSubBuckets;
+    int64_t subBucket = (bucket - kSubBuckets) % kSubBuckets;
+    int64_t width = int64_t{1} << (exponent - kSubBucketBits);
+    return (kSubBuckets + subBucket) * width + width / 2;
+}
+
+void atomicMax(std::atomic<int64_t>& target, int64_t value) {
+    int64_t current = target.load(std::memory_order_relaxed);
+    while (current < value &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+struct Slot {
+    // 0 when unused. Set once, never cleared.
+    std::atomic<uint64_t> key{0};
+    // set after descriptor and code are written
+    std::atomic<bool> ready{false};
+    char descriptor[kMaxDescriptorLength + 1];
+    uint32_t code;
+
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> oneway{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<int64_t> totalLatencyNs{0};
+    std::atomic<int64_t> maxLatencyNs{0};
+    std::atomic<int64_t> totalQueueDelayNs{0};
+    std::atomic<int64_t> maxQueueDelayNs{0};
+    std::atomic<uint64_t> totalDataBytes{0};
+    std::atomic<uint64_t> totalReplyBytes{0};
+    std::atomic<uint32_t> histogram[kNumBuckets];
+};
+
+// Open addressing, with linear probing
+struct Table {
+    Slot slots[kMaxEntries];
+    std::atomic<uint64_t> dropped{0};
+};
+
+std::atomic<bool> gEnabled{false};
+// Allocated when first enabled, and never freed, since transactions may be
+// recorded concurrently.
+std::atomic<Table*> gTable{nullptr};
+
+uint64_t keyFor(const char16_t* descriptor, size_t descriptorLen, uint32_t code) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < descriptorLen; i++) {
+        hash = (hash ^ descriptor[i]) * 0x100000001b3;
+    }
+    hash = (hash ^ code) * 0x100000001b3;
+    return hash == 0 ? 1 : hash;
+}
+
+Slot* findOrClaimSlot(Table* table, const char16_t* descriptor, size_t descriptorLen,
+                      uint32_t code) {
+    uint64_t key = keyFor(descriptor, descriptorLen, code);
+    for (size_t i = 0; i < kMaxEntries; i++) {
+        Slot& slot = table->slots[(key + i) % kMaxEntries];
+        uint64_t slotKey = slot.key.load(std::memory_order_relaxed);
+        if (slotKey == 0) {
+            if (!slot.key.compare_exchange_strong(slotKey, key, std::memory_order_relaxed)) {
+                // claimed by another thread, maybe for the same key
+                if (slotKey == key) return &slot;
+                continue;
+            }
+            size_t len = std::min(descriptorLen, kMaxDescriptorLength);
+            for (size_t j = 0; j < len; j++) {
+                // descriptors are ASCII
+                slot.descriptor[j] = descriptor[j] < 0x80 ? static_cast<char>(descriptor[j]) : '?';
+            }
+            slot.descriptor[len] = '\0';
+            slot.code = code;
+            slot.ready.store(true, std::memory_order_release);
+            return &slot;
+        }
+        if (slotKey == key) return &slot;
+    }
+    return nullptr;
+}
+
+int64_t percentile(const uint32_t (&histogram)[kNumBuckets], uint64_t count, int percent) {
+    uint64_t target = (count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kNumBuckets; i++) {
+        seen += histogram[i];
+        if (seen >= target) return bucketValue(i);
+    }
+    return bucketValue(kNumBuckets - 1);
+}
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+} // namespace
+
+namespace impl {
+
+TransactionStatsTimer::TransactionStatsTimer()
+      : mStartNs(gEnabled.load(std::memory_order_relaxed) ? nowNs() : 0) {}
+
+int64_t TransactionStatsTimer::elapsedNs() const {
+    return active() ? nowNs() - mStartNs : 0;
+}
+
+void TransactionStatsTimer::finish(const char16_t* descriptor, size_t descriptorLen, uint32_t code,
+                                   uint32_t flags, size_t dataSize, size_t replySize,
+                                   status_t status, int64_t queueDelayNs) const {
+    if (!active()) return;
+    int64_t latencyNs = nowNs() - mStartNs;
+
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return;
+    if (descriptor == nullptr) descriptorLen = 0;
+
+    Slot* slot = findOrClaimSlot(table, descriptor, descriptorLen, code);
+    if (slot == nullptr) {
+        table->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    slot->calls.fetch_add(1, std::memory_order_relaxed);
+    if (flags & IBinder::FLAG_ONEWAY) slot->oneway.fetch_add(1, std::memory_order_relaxed);
+    if (status != OK) slot->errors.fetch_add(1, std::memory_order_relaxed);
+    slot->totalLatencyNs.fetch_add(latencyNs, std::memory_order_relaxed);
+    atomicMax(slot->maxLatencyNs, latencyNs);
+    slot->histogram[bucketFor(latencyNs)].fetch_add(1, std::memory_order_relaxed);
+    if (queueDelayNs > 0) {
+        slot->totalQueueDelayNs.fetch_add(queueDelayNs, std::memory_order_relaxed);
+        atomicMax(slot->maxQueueDelayNs, queueDelayNs);
+    }
+    slot->totalDataBytes.fetch_add(dataSize, std::memory_order_relaxed);
+    slot->totalReplyBytes.fetch_add(replySize, std::memory_order_relaxed);
+}
+
+} // namespace impl
+
+namespace debug {
+
+void TransactionStats::setEnabled(bool enabled) {
+    if (enabled && gTable.load(std::memory_order_acquire) == nullptr) {
+        Table* table = new Table();
+        Table* expected = nullptr;
+        if (!gTable.compare_exchange_strong(expected, table, std::memory_order_acq_rel)) {
+            delete table;
+        }
+    }
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TransactionStats::isEnabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+std::vector<TransactionStats::Entry> TransactionStats::snapshot() {
+    std::vector<Entry> entries;
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return entries;
+
+    for (Slot& slot : table->slots) {
+        if (!slot.ready.load(std::memory_order_acquire)) continue;
+
+        // Counters are read one at a time, so they may be off by the
+        // transactions recorded meanwhile.
+        Entry entry;
+        entry.calls = slot.calls.load(std::memory_order_relaxed);
+        if (entry.calls == 0) continue;
+        entry.descriptor = slot.descriptor;
+        entry.code = slot.code;
+        entry.oneway = slot.oneway.load(std::memory_order_relaxed);
+        entry.errors = slot.errors.load(std::memory_order_relaxed);
+        entry.totalLatencyNs = slot.totalLatencyNs.load(std::memory_order_relaxed);
+        entry.maxLatencyNs = slot.maxLatencyNs.load(std::memory_order_relaxed);
+        entry.totalQueueDelayNs = slot.totalQueueDelayNs.load(std::memory_order_relaxed);
+        entry.maxQueueDelayNs = slot.maxQueueDelayNs.load(std::memory_order_relaxed);
+        entry.totalDataBytes = slot.totalDataBytes.load(std::memory_order_relaxed);
+        entry.totalReplyBytes = slot.totalReplyBytes.load(std::memory_order_relaxed);
+
+        uint32_t histogram[kNumBuckets];
+        uint64_t histogramCount = 0;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            histogram[i] = slot.histogram[i].load(std::memory_order_relaxed);
+            histogramCount += histogram[i];
+        }
+        if (histogramCount > 0) {
+            entry.p50LatencyNs =
+                    std::min(percentile(histogram, histogramCount, 50), entry.maxLatencyNs);
+            entry.p90LatencyNs =
+                    std::min(percentile(histogram, histogramCount, 90), entry.maxLatencyNs);
+            entry.p99LatencyNs =
+                    std::min(percentile(histogram, histogramCount, 99), entry.maxLatencyNs);
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.totalLatencyNs > b.totalLatencyNs;
+    });
+    return entries;
+}
+
+std::string TransactionStats::dump() {
+    std::vector<Entry> entries = snapshot();
+
+    std::string result;
+    const size_t SIZE = 384;
+    char buffer[SIZE];
+    snprintf(buffer, SIZE, "Binder transaction stats (%s, %zu keys, %" PRIu64 " dropped):\n",
+             isEnabled() ? "enabled" : "disabled", entries.size(), droppedCount());
+    result.append(buffer);
+    snprintf(buffer, SIZE,
+             "  %-48s %6s %9s %9s %7s %9s %9s %9s %9s %9s %9s %9s %9s\n", "descriptor", "code",
+             "calls", "oneway", "errors", "mean_us", "p50_us", "p90_us", "p99_us", "max_us",
+             "queue_us", "data_B", "reply_B");
+    result.append(buffer);
+
+    for (const Entry& entry : entries) {
+        auto us = [](int64_t ns) { return static_cast<double>(ns) / 1000; };
+        snprintf(buffer, SIZE,
+                 "  %-48s %6" PRIu32 " %9" PRIu64 " %9" PRIu64 " %7" PRIu64
+                 " %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9" PRIu64 " %9" PRIu64 "\n",
+                 entry.descriptor.empty() ? "<no interface token>" : entry.descriptor.c_str(),
+                 entry.code, entry.calls, entry.oneway, entry.errors,
+                 us(entry.totalLatencyNs / static_cast<int64_t>(entry.calls)),
+                 us(entry.p50LatencyNs), us(entry.p90LatencyNs), us(entry.p99LatencyNs),
+                 us(entry.maxLatencyNs),
+                 us(entry.totalQueueDelayNs / static_cast<int64_t>(entry.calls)),
+                 entry.totalDataBytes / entry.calls, entry.totalReplyBytes / entry.calls);
+        result.append(buffer);
+    }
+    return result;
+}
+
+void TransactionStats::reset() {
+    Table* table = gTable.load(std::memory_order_acquire);
+    if (table == nullptr) return;
+
+    for (Slot& slot : table->slots) {
+        slot.calls.store(0, std::memory_order_relaxed);
+        slot.oneway.store(0, std::memory_order_relaxed);
+        slot.errors.store(0, std::memory_order_relaxed);
+        slot.totalLatencyNs.store(0, std::memory_order_relaxed);
+        slot.maxLatencyNs.store(0, std::memory_order_relaxed);
+        slot.totalQueueDelayNs.store(0, std::memory_order_relaxed);
+        slot.maxQueueDelayNs.store(0, std::memory_order_relaxed);
+        slot.totalDataBytes.store(0, std::memory_order_relaxed);
+        slot.totalReplyBytes.store(0, std::memory_order_relaxed);
+        for (auto& bucket : slot.histogram) bucket.store(0, std::memory_order_relaxed);
+    }
+    table->dropped.store(0, std::memory_order_relaxed);
+}
+
+uint64_t TransactionStats::droppedCount() {
+    Table* table = gTable.load(std::memory_order_acquire);
+    return table == nullptr ? 0 : table->dropped.load(std::memory_order_relaxed);
+}
+
+} // namespace debug
+
+} // namespace android::binder
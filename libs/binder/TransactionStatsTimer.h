@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/Errors.h>
+
+namespace android::binder::impl {
+
+// Times one outgoing transaction for binder::debug::TransactionStats. Does
+// nothing, not even reading the clock, when stats are disabled.
+class TransactionStatsTimer {
+public:
+    TransactionStatsTimer();
+
+    bool active() const { return mStartNs != 0; }
+
+    // 0 if not active
+    int64_t elapsedNs() const;
+
+    // Records the transaction, if active. 'descriptor' is from
+    // Parcel::peekInterfaceToken, and may be nullptr.
+    void finish(const char16_t* descriptor, size_t descriptorLen, uint32_t code, uint32_t flags,
+                size_t dataSize, size_t replySize, status_t status, int64_t queueDelayNs) const;
+
+private:
+    int64_t mStartNs;
+};
+
+} // namespace android::binder::impl
@@ -26,6 +26,7 @@ namespace android {
 // ----------------------------------------------------------------------------
 
 class SimpleBestFitAllocator;
+class SlabAllocator;
 
 // ----------------------------------------------------------------------------
 
@@ -35,6 +36,17 @@ public:
     explicit MemoryDealer(size_t size, const char* name = nullptr,
             uint32_t flags = 0 /* or bits such as MemoryHeapBase::READ_ONLY */ );
 
+    enum class AllocatorType {
+        // Best fit search through a list of blocks, under a lock.
+        BEST_FIT,
+        // Blocks of up to 8 KiB are taken from slabs of fixed size blocks,
+        // in O(1) and without locking. Slabs are never returned to the heap,
+        // so this suits many small allocations of similar sizes. Larger
+        // blocks are allocated like BEST_FIT.
+        SLAB,
+    };
+    MemoryDealer(size_t size, const char* name, uint32_t flags, AllocatorType type);
+
     virtual sp<IMemory> allocate(size_t size);
     virtual void        dump(const char* what) const;
 
@@ -54,6 +66,8 @@ private:
 
     sp<IMemoryHeap>             mHeap;
     SimpleBestFitAllocator*     mAllocator;
+    // Only for AllocatorType::SLAB
+    SlabAllocator*              mSlabAllocator;
 };
 
 
@@ -83,6 +83,12 @@ public:
     // Writing over objects, such as file descriptors and binders, is not supported.
     void                setDataPosition(size_t pos) const;
     status_t            setDataCapacity(size_t size);
+    // Makes room for writing at least 'len' more bytes at the current data
+    // position, so that they can be written without growing the Parcel in
+    // multiple steps. Vectors of parcelables which have a non-virtual
+    // 'size_t getParcelSizeHint() const', returning an upper bound of what
+    // writeToParcel writes, are reserved this way automatically.
+    status_t            reserve(size_t len);
 
     status_t            setData(const uint8_t* buffer, size_t len);
 
@@ -647,6 +653,10 @@ private:
     status_t            validateReadData(size_t len) const;
 
     void                updateWorkSourceRequestHeaderPosition() const;
+    // For transaction stats. Returns the descriptor written by
+    // writeInterfaceToken, without moving the data position, or nullptr if
+    // there isn't one.
+    const char16_t*     peekInterfaceToken(size_t* outLen) const;
 
     status_t            finishFlattenBinder(const sp<IBinder>& binder);
     status_t            finishUnflattenBinder(const sp<IBinder>& binder, sp<IBinder>* out) const;
@@ -888,6 +898,18 @@ private:
     template <typename T>
     static inline constexpr bool is_fixed_array_v = is_fixed_array<T>::value;
 
+    // Tells if T has a 'size_t getParcelSizeHint() const', see reserve().
+    template <typename T, typename = void>
+    struct has_parcel_size_hint : std::false_type {};
+
+    template <typename T>
+    struct has_parcel_size_hint<
+            T, std::void_t<decltype(std::declval<const T&>().getParcelSizeHint())>>
+          : std::true_type {};
+
+    template <typename T>
+    static inline constexpr bool has_parcel_size_hint_v = has_parcel_size_hint<T>::value;
+
     // special int32 value to indicate NonNull or Null parcelables
     // This is fixed to be only 0 or 1 by contract, do not change.
     static constexpr int32_t kNonNullParcelableFlag = 1;
@@ -1022,6 +1044,24 @@ private:
             for (const auto t: c) {
                 *data++ = static_cast<int32_t>(t);
             }
+        } else if constexpr (std::is_base_of_v<Parcelable, T> && has_parcel_size_hint_v<T>) {
+            // One allocation for all elements, if they all know their size.
+            size_t hint = 0;
+            for (const auto& t : c) {
+                size_t elementHint = t.getParcelSizeHint();
+                if (elementHint == 0 ||
+                    __builtin_add_overflow(hint, sizeof(int32_t) + elementHint, &hint)) {
+                    hint = 0;
+                    break;
+                }
+            }
+            // only an optimization, errors are noticed by the writes
+            if (hint > 0) (void)reserve(hint);
+
+            for (const auto& t : c) {
+                const status_t status = writeData(t);
+                if (status != OK) return status;
+            }
         } else /* constexpr */ {
             for (const auto &t : c) {
                 const status_t status = writeData(t);
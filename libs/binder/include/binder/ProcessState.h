@@ -126,6 +126,45 @@ public:
      */
     bool isThreadPoolStarted() const;
 
+    /**
+     * Lets threads started by the kernel for the thread pool leave it again
+     * once they are no longer needed. The kernel still starts threads on
+     * demand, up to the count given to setThreadPoolMaxThreadCount.
+     *
+     * Every command received by the pool which leaves 'minIdleThreads' or
+     * fewer threads idle counts as pressure. When a pooled thread finishes a
+     * command, at least 'idleTimeoutMs' after the last pressure, and more
+     * than 'minIdleThreads' threads would still be idle without it, that
+     * thread leaves the pool. At most one thread leaves per 'idleTimeoutMs'.
+     *
+     * Threads blocked in the driver can't be woken up, so threads only leave
+     * the pool when it receives work.
+     *
+     * 'idleTimeoutMs' of 0 turns this off again, which is the default.
+     */
+    status_t setThreadPoolAdaptive(size_t minIdleThreads, int64_t idleTimeoutMs);
+
+    struct ThreadPoolStats {
+        // Configured with setThreadPoolMaxThreadCount
+        size_t maxThreads = 0;
+        // Threads inside the thread pool, including joined and polling threads
+        size_t currentThreads = 0;
+        size_t executingThreads = 0;
+        // Highest executingThreads seen
+        size_t peakExecutingThreads = 0;
+        // Threads started by the kernel which are still running
+        size_t kernelStartedThreads = 0;
+        // Threads which left the pool because of setThreadPoolAdaptive
+        size_t retiredThreads = 0;
+        // Number of times, and total time, every thread in the pool was busy
+        size_t starvationCount = 0;
+        int64_t starvationTimeMs = 0;
+    };
+    /**
+     * Utilization of the thread pool since the process started.
+     */
+    ThreadPoolStats getThreadPoolStats() const;
+
     enum class DriverFeature {
         ONEWAY_SPAM_DETECTION,
         EXTENDED_ERROR,
@@ -157,6 +196,11 @@ private:
 
     handle_entry* lookupHandleLocked(int32_t handle);
 
+    // Called from IPCThreadState::joinThreadPool after a pooled thread
+    // executed a command. Returns true if it should leave the pool.
+    bool shouldRetirePooledThread();
+    void onPooledThreadRetiredLocked();
+
     String8 mDriverName;
     int mDriverFD;
     void* mVMStart;
@@ -177,6 +221,19 @@ private:
     size_t mKernelStartedThreads;
     // Time when thread pool was emptied
     int64_t mStarvationStartTimeMs;
+    // Number of times the thread pool was emptied, and total time it was empty
+    size_t mStarvationCount;
+    int64_t mStarvationTimeMs;
+    size_t mPeakExecutingThreadsCount;
+    // Configured by setThreadPoolAdaptive, idle timeout is 0 if disabled.
+    size_t mAdaptiveMinIdleThreads;
+    int64_t mAdaptiveIdleTimeoutMs;
+    // Last time a command left mAdaptiveMinIdleThreads or fewer threads idle
+    int64_t mLastPressureTimeMs;
+    int64_t mLastRetireTimeMs;
+    // Number of kernel started threads which left the thread pool. The kernel
+    // keeps counting them as started, so its limit is raised by this much.
+    size_t mRetiredThreads;
 
     mutable std::mutex mLock; // protects everything below.
 
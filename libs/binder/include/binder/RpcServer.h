@@ -30,6 +30,7 @@
 namespace android {
 
 class FdTrigger;
+class RpcServerReactor;
 class RpcServerTrusty;
 class RpcSocketAddress;
 
@@ -133,6 +134,21 @@ public:
     void setMaxThreads(size_t threads);
     size_t getMaxThreads();
 
+    /**
+     * By default, each incoming connection is served by its own thread, which
+     * waits for commands on it. For servers with many mostly idle clients,
+     * this must be called with a non-zero value before join(). Then, idle
+     * connections are watched with epoll(7) instead, and join() starts this
+     * many threads, which serve whichever connections have data (including
+     * nested transactions on them). setMaxThreads still limits the number of
+     * connections each session may have.
+     *
+     * Only supported by multi-threaded libbinder on Linux, not by Trusty or
+     * the SDK library.
+     */
+    void setEventDrivenWorkerThreads(size_t threads);
+    size_t getEventDrivenWorkerThreads();
+
     /**
      * By default, the latest protocol version which is supported by a client is
      * used. However, this can be used in order to prevent newer protocol
@@ -264,6 +280,7 @@ private:
 
     const std::unique_ptr<RpcTransportCtx> mCtx;
     size_t mMaxThreads = 1;
+    size_t mEventDrivenWorkerThreads = 0;
     std::optional<uint32_t> mProtocolVersion;
     // A mode is supported if the N'th bit is on, where N is the mode enum's value.
     std::bitset<8> mSupportedFileDescriptorTransportModes = std::bitset<8>().set(
@@ -274,6 +291,8 @@ private:
     std::unique_ptr<RpcMaybeThread> mJoinThread;
     bool mJoinThreadRunning = false;
     std::map<RpcMaybeThread::id, RpcMaybeThread> mConnectingThreads;
+    // set by join() when event driven, see setEventDrivenWorkerThreads
+    std::shared_ptr<RpcServerReactor> mReactor;
 
     sp<IBinder> mRootObject;
     wp<IBinder> mRootObjectWeak;
@@ -22,6 +22,7 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <chrono>
 #include <map>
 #include <optional>
 #include <vector>
@@ -30,6 +31,7 @@ namespace android {
 
 class Parcel;
 class RpcServer;
+class RpcServerReactor;
 class RpcServerTrusty;
 class RpcSocketAddress;
 class RpcState;
@@ -193,6 +195,57 @@ public:
     [[nodiscard]] status_t transact(const sp<IBinder>& binder, uint32_t code, const Parcel& data,
                                     Parcel* reply, uint32_t flags);
 
+    /**
+     * While an object of this type is alive, oneway transactions which the
+     * thread that created it makes over |session| are not written right away.
+     * Instead, they are gathered and written to a single connection with one
+     * write once |maxBytes| are pending, once |maxDelay| has passed since the
+     * first pending transaction was queued (checked when queueing), before
+     * this thread sends anything else over the session, and when the object
+     * is destroyed. The bytes on the wire are the same as if the transactions
+     * were sent one at a time, so this works with any server. Transactions
+     * are only numbered when they are written, so pending ones don't hold up
+     * oneway transactions which other threads make to the same binders.
+     *
+     * Oneway transactions carrying file descriptors are never gathered. Only
+     * one OnewayBatch may exist per thread and session, and it must be
+     * destroyed on the thread which created it.
+     */
+    class OnewayBatch {
+    public:
+        static constexpr size_t kDefaultMaxBytes = 64 * 1024;
+        static constexpr std::chrono::microseconds kDefaultMaxDelay{500};
+
+        explicit OnewayBatch(const sp<RpcSession>& session, size_t maxBytes = kDefaultMaxBytes,
+                             std::chrono::nanoseconds maxDelay = kDefaultMaxDelay);
+        ~OnewayBatch();
+
+        /**
+         * Write all pending transactions now.
+         */
+        [[nodiscard]] status_t flush();
+
+    private:
+        friend RpcSession;
+
+        OnewayBatch(const OnewayBatch&) = delete;
+        void operator=(const OnewayBatch&) = delete;
+
+        [[nodiscard]] status_t queue(const sp<IBinder>& binder, uint32_t code, const Parcel& data,
+                                     uint32_t flags);
+
+        sp<RpcSession> mSession;
+        uint64_t mTid;
+        size_t mMaxBytes;
+        std::chrono::nanoseconds mMaxDelay;
+        std::chrono::steady_clock::time_point mFirstQueued;
+        // wire encoding of all pending transactions
+        std::vector<uint8_t> mData;
+        // keeps targets alive, so that their refcounts can't be dropped on the
+        // wire before the pending transactions are written
+        std::vector<sp<IBinder>> mTargets;
+    };
+
     /**
      * Generally, you should not call this, unless you are testing error
      * conditions, as this is called automatically by BpBinders when they are
@@ -219,6 +272,7 @@ public:
 private:
     friend sp<RpcSession>;
     friend RpcServer;
+    friend RpcServerReactor;
     friend RpcServerTrusty;
     friend RpcState;
     explicit RpcSession(std::unique_ptr<RpcTransportCtx> ctx);
@@ -258,6 +312,14 @@ private:
         std::optional<uint64_t> exclusiveTid;
 
         bool allowNested = false;
+
+        // Bytes which were received after the end of the last read. Only used
+        // for incoming connections which don't transfer file descriptors, see
+        // RpcState::rpcRec.
+        bool readAheadEnabled = false;
+        std::vector<uint8_t> readAhead;
+        size_t readAheadBegin = 0;
+        size_t readAheadEnd = 0;
     };
 
     [[nodiscard]] status_t readId();
@@ -281,6 +343,17 @@ private:
     // join on thread passed to preJoinThreadOwnership
     static void join(sp<RpcSession>&& session, PreJoinSetupResult&& result);
 
+    // Instead of join, RpcServerReactor serves connections after preJoinSetup
+    // with these. Executes commands until no more data is available without
+    // blocking, and returns an error if the connection should be closed.
+    [[nodiscard]] static status_t executeAvailableCommands(const sp<RpcSession>& session,
+                                                           const sp<RpcConnection>& connection);
+    // cleanup once an incoming connection is no longer served (end of join)
+    static void incomingConnectionEnded(sp<RpcSession>&& session,
+                                        const sp<RpcConnection>& connection);
+    // runs 'fn' on this thread, attached to the JVM like join
+    static void runAttachedToJvm(const std::function<void()>& fn);
+
     [[nodiscard]] status_t setupClient(
             const std::function<status_t(const std::vector<uint8_t>& sessionId, bool incoming)>&
                     connectAndInit);
@@ -305,6 +378,12 @@ private:
 
     [[nodiscard]] status_t initShutdownTrigger();
 
+    // OnewayBatch created by the calling thread for this session, if any
+    OnewayBatch* onewayBatchForThisThread();
+    // flush the OnewayBatch of the calling thread (if any) before it sends
+    // anything else over this session
+    [[nodiscard]] status_t flushOnewayBatchForThisThread();
+
     /**
      * Checks whether any connection is active (Not polling on fd)
      */
@@ -380,6 +459,9 @@ private:
 
     RpcConditionVariable mAvailableConnectionCv; // for mWaitingThreads
 
+    // by thread ID, see OnewayBatch
+    std::map<uint64_t, OnewayBatch*> mOnewayBatches;
+
     std::unique_ptr<RpcTransport> mBootstrapTransport;
 
     struct ThreadState {
@@ -94,6 +94,28 @@ public:
             const std::optional<binder::impl::SmallFunction<status_t()>>& altPoll,
             std::vector<std::variant<binder::unique_fd, binder::borrowed_fd>>* ancillaryFds) = 0;
 
+    /**
+     * Same as interruptableReadFully without altPoll or ancillaryFds, except
+     * that bytes which are already available after the end of 'iovs' are also
+     * read, up to 'readAheadSize' bytes into 'readAhead'. The number of these
+     * extra bytes is returned in 'readAheadOut'. This never waits for extra
+     * bytes to arrive.
+     *
+     * This must not be used when file descriptors may be received, since they
+     * couldn't be attributed to the right part of the data. Transports which
+     * don't support reading ahead always return zero extra bytes.
+     */
+    [[nodiscard]] virtual status_t interruptableReadFullyWithReadAhead(FdTrigger* fdTrigger,
+                                                                       iovec* iovs, int niovs,
+                                                                       void* readAhead,
+                                                                       size_t readAheadSize,
+                                                                       size_t* readAheadOut) {
+        (void)readAhead;
+        (void)readAheadSize;
+        *readAheadOut = 0;
+        return interruptableReadFully(fdTrigger, iovs, niovs, std::nullopt, nullptr);
+    }
+
     /**
      *  Check whether any threads are blocked while polling the transport
      *  for read operations
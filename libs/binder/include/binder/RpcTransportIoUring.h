@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Wraps the transport layer of RPC. Implementation uses plain sockets, and
+// waits for them with io_uring.
+
+#pragma once
+
+#include <memory>
+
+#include <binder/RpcTransport.h>
+
+namespace android {
+
+// RpcTransportCtxFactory with TLS disabled, which is compatible with
+// RpcTransportCtxFactoryRaw on the other side of a connection.
+//
+// When a transfer has to wait for the socket, the wait, the shutdown trigger
+// and the sendmsg or recvmsg are submitted to an io_uring together, so that
+// they take a single system call instead of a poll followed by the transfer.
+// Each connection owns a small ring. If io_uring isn't available (e.g. it is
+// blocked by seccomp), connections fall back to the raw transport.
+class RpcTransportCtxFactoryIoUring : public RpcTransportCtxFactory {
+public:
+    static std::unique_ptr<RpcTransportCtxFactory> make();
+
+    std::unique_ptr<RpcTransportCtx> newServerCtx() const override;
+    std::unique_ptr<RpcTransportCtx> newClientCtx() const override;
+    const char* toCString() const override;
+
+private:
+    RpcTransportCtxFactoryIoUring() = default;
+};
+
+} // namespace android
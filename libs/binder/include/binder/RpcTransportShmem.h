@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Wraps the transport layer of RPC. Implementation uses shared memory rings
+// between processes on the same machine.
+
+#pragma once
+
+#include <memory>
+
+#include <binder/RpcTransport.h>
+
+namespace android {
+
+// RpcTransportCtxFactory for Unix domain sockets, where data is copied through
+// a shared memory ring per direction instead of through the socket. When a
+// connection is set up, each side creates a memfd for the data it sends, and
+// passes it to the other side. After that, the socket only carries wakeups
+// and file descriptors sent in parcels.
+//
+// Both sides of a session must use this. Not supported on other socket types.
+// Only available in libbinder on Linux, since it needs memfd_create.
+class RpcTransportCtxFactoryShmem : public RpcTransportCtxFactory {
+public:
+    static constexpr size_t kDefaultRingSize = 1 << 20;
+
+    // ringSize must be a power of two and at least a page.
+    static std::unique_ptr<RpcTransportCtxFactory> make(size_t ringSize = kDefaultRingSize);
+
+    std::unique_ptr<RpcTransportCtx> newServerCtx() const override;
+    std::unique_ptr<RpcTransportCtx> newClientCtx() const override;
+    const char* toCString() const override;
+
+private:
+    explicit RpcTransportCtxFactoryShmem(size_t ringSize) : mRingSize(ringSize) {}
+
+    size_t mRingSize;
+};
+
+} // namespace android
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace android::binder::debug {
+
+// Statistics of the transactions sent by this process, over kernel binder
+// (IPCThreadState::transact) and RPC binder (RpcState::transactAddress).
+// They are keyed by the interface descriptor written by writeInterfaceToken
+// and the transaction code.
+//
+// Disabled by default. When disabled, a transaction only pays for an atomic
+// load. When enabled, recording is lock-free, and takes a few atomic
+// increments. A bounded number of keys is tracked, and transactions for keys
+// past that are counted as dropped.
+class TransactionStats {
+public:
+    struct Entry {
+        // empty if the transaction has no interface token
+        std::string descriptor;
+        uint32_t code = 0;
+
+        uint64_t calls = 0;
+        uint64_t oneway = 0;
+        uint64_t errors = 0;
+
+        // Time spent in transact, until the reply is received, or until a
+        // oneway transaction is sent.
+        int64_t totalLatencyNs = 0;
+        int64_t maxLatencyNs = 0;
+        // From a log-linear histogram, so within 12.5%
+        int64_t p50LatencyNs = 0;
+        int64_t p90LatencyNs = 0;
+        int64_t p99LatencyNs = 0;
+
+        // Time spent waiting for a connection of an RPC session, before the
+        // transaction is sent. Always zero for kernel binder.
+        int64_t totalQueueDelayNs = 0;
+        int64_t maxQueueDelayNs = 0;
+
+        uint64_t totalDataBytes = 0;
+        uint64_t totalReplyBytes = 0;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // Entries with at least one call, sorted by total latency, largest first.
+    static std::vector<Entry> snapshot();
+    // snapshot() as a human readable table, e.g. for dumpsys
+    static std::string dump();
+    // Zeroes all counts. Keys stay allocated.
+    static void reset();
+
+    // Number of transactions which weren't recorded because too many keys
+    // are in use.
+    static uint64_t droppedCount();
+};
+
+} // namespace android::binder::debug
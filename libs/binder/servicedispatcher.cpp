@@ -128,6 +128,11 @@ public:
         // We can't send BpBinder for regular binder over RPC.
         return android::binder::Status::fromStatusT(android::INVALID_OPERATION);
     }
+    android::binder::Status checkServiceWithMetadata(
+            const std::string&, android::os::ServiceWithMetadata*) override {
+        // We can't send BpBinder for regular binder over RPC.
+        return android::binder::Status::fromStatusT(android::INVALID_OPERATION);
+    }
     android::binder::Status addService(const std::string&, const android::sp<android::IBinder>&,
                                        bool, int32_t) override {
         // We can't send BpBinder for RPC over regular binder.
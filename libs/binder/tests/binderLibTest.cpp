@@ -125,7 +125,9 @@ enum BinderLibTestTranscationCode {
     BINDER_LIB_TEST_LOCK_UNLOCK,
     BINDER_LIB_TEST_PROCESS_LOCK,
     BINDER_LIB_TEST_UNLOCK_AFTER_MS,
-    BINDER_LIB_TEST_PROCESS_TEMPORARY_LOCK
+    BINDER_LIB_TEST_PROCESS_TEMPORARY_LOCK,
+    BINDER_LIB_TEST_SET_THREADPOOL_ADAPTIVE,
+    BINDER_LIB_TEST_GET_RETIRED_THREAD_COUNT,
 };
 
 pid_t start_server_process(int arg2, bool usePoll = false)
@@ -1411,6 +1413,67 @@ TEST_F(BinderLibTest, ThreadPoolStarted) {
     EXPECT_TRUE(reply.readBool());
 }
 
+TEST_F(BinderLibTest, ThreadPoolStats) {
+    sp<ProcessState> proc = ProcessState::self();
+    ProcessState::ThreadPoolStats stats = proc->getThreadPoolStats();
+    EXPECT_GE(stats.peakExecutingThreads, stats.executingThreads);
+    EXPECT_LE(stats.kernelStartedThreads, stats.maxThreads + 1);
+    EXPECT_EQ(stats.retiredThreads, 0u);
+
+    EXPECT_THAT(proc->setThreadPoolAdaptive(0, -1), StatusEq(BAD_VALUE));
+}
+
+TEST_F(BinderLibTest, ThreadPoolAdaptiveRetiresAndReplacesThreads) {
+    constexpr int64_t kIdleTimeoutMs = 100;
+    Parcel data, reply;
+    sp<IBinder> server = addServer();
+    ASSERT_TRUE(server != nullptr);
+
+    data.writeInt32(0);
+    data.writeInt64(kIdleTimeoutMs);
+    ASSERT_THAT(server->transact(BINDER_LIB_TEST_SET_THREADPOOL_ADAPTIVE, data, &reply),
+                StatusEq(NO_ERROR));
+
+    // Like ThreadPoolAvailableThreads, this deadlocks unless the server can
+    // run kKernelThreads + 2 calls at once.
+    auto saturateThreadPool = [&]() {
+        Parcel data, reply;
+        EXPECT_THAT(server->transact(BINDER_LIB_TEST_PROCESS_LOCK, data, &reply), NO_ERROR);
+        std::vector<std::thread> ts;
+        for (size_t i = 0; i < kKernelThreads + 1; i++) {
+            ts.push_back(std::thread([&] {
+                Parcel local_reply;
+                EXPECT_THAT(server->transact(BINDER_LIB_TEST_LOCK_UNLOCK, data, &local_reply),
+                            NO_ERROR);
+            }));
+        }
+        // see ThreadPoolAvailableThreads
+        sleep(1);
+        data.writeInt32(100);
+        EXPECT_THAT(server->transact(BINDER_LIB_TEST_UNLOCK_AFTER_MS, data, &reply), NO_ERROR);
+        for (auto &t : ts) {
+            t.join();
+        }
+    };
+    saturateThreadPool();
+
+    // Threads only retire after finishing a command, once the pool has been
+    // idle for kIdleTimeoutMs.
+    uint64_t retired = 0;
+    for (size_t i = 0; i < 50 && retired == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2 * kIdleTimeoutMs));
+        EXPECT_THAT(server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                    StatusEq(NO_ERROR));
+        EXPECT_THAT(server->transact(BINDER_LIB_TEST_GET_RETIRED_THREAD_COUNT, data, &reply),
+                    StatusEq(NO_ERROR));
+        retired = reply.readUint64();
+    }
+    EXPECT_GT(retired, 0u);
+
+    // The kernel starts replacements for the retired threads
+    saturateThreadPool();
+}
+
 size_t epochMillis() {
     using std::chrono::duration_cast;
     using std::chrono::milliseconds;
@@ -1933,6 +1996,15 @@ public:
                 t.detach();
                 return NO_ERROR;
             }
+            case BINDER_LIB_TEST_SET_THREADPOOL_ADAPTIVE: {
+                int32_t minIdleThreads = data.readInt32();
+                int64_t idleTimeoutMs = data.readInt64();
+                return ProcessState::self()->setThreadPoolAdaptive(minIdleThreads, idleTimeoutMs);
+            }
+            case BINDER_LIB_TEST_GET_RETIRED_THREAD_COUNT: {
+                reply->writeUint64(ProcessState::self()->getThreadPoolStats().retiredThreads);
+                return NO_ERROR;
+            }
             default:
                 return UNKNOWN_TRANSACTION;
         };
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <binder/MemoryDealer.h>
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+// Usage: atest binderMemoryDealerBenchmark
+
+using android::IMemory;
+using android::MemoryDealer;
+using android::sp;
+
+using AllocatorType = MemoryDealer::AllocatorType;
+
+static constexpr size_t kHeapSize = 16 * 1024 * 1024;
+
+static sp<MemoryDealer> gDealer;
+
+// Sizes of typical small media buffers
+static size_t randomSize(std::minstd_rand& rand) {
+    return 64 + rand() % 4032;
+}
+
+// Fills the heap with small blocks and frees every other one, so that the
+// free list of the best fit allocator is long and fragmented.
+static void fragment(const sp<MemoryDealer>& dealer, std::vector<sp<IMemory>>* kept) {
+    std::minstd_rand rand(0);
+    std::vector<sp<IMemory>> all;
+    while (sp<IMemory> memory = dealer->allocate(randomSize(rand))) {
+        all.push_back(memory);
+        if (all.size() * 4096 > kHeapSize / 2) break;
+    }
+    for (size_t i = 0; i < all.size(); i += 2) {
+        kept->push_back(all[i]);
+    }
+}
+
+static void BM_allocateFree(benchmark::State& state, AllocatorType type) {
+    static std::vector<sp<IMemory>> kept;
+    if (state.thread_index() == 0) {
+        gDealer = sp<MemoryDealer>::make(kHeapSize, "binderMemoryDealerBenchmark", 0, type);
+        fragment(gDealer, &kept);
+    }
+
+    std::minstd_rand rand(state.thread_index());
+    std::vector<sp<IMemory>> live(16);
+    size_t i = 0;
+    for (auto _ : state) {
+        // replace one of a few live blocks per iteration
+        live[i++ % live.size()] = gDealer->allocate(randomSize(rand));
+    }
+    live.clear();
+
+    if (state.thread_index() == 0) {
+        kept.clear();
+        gDealer.clear();
+    }
+}
+BENCHMARK_CAPTURE(BM_allocateFree, BestFit, AllocatorType::BEST_FIT)->ThreadRange(1, 8);
+BENCHMARK_CAPTURE(BM_allocateFree, Slab, AllocatorType::SLAB)->ThreadRange(1, 8);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <binder/MemoryDealer.h>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace android;
+
+using AllocatorType = MemoryDealer::AllocatorType;
+
+class MemoryDealerTest : public ::testing::TestWithParam<AllocatorType> {
+protected:
+    sp<MemoryDealer> makeDealer(size_t size) {
+        return sp<MemoryDealer>::make(size, "MemoryDealerTest", 0, GetParam());
+    }
+};
+
+static void expectNoOverlap(std::vector<sp<IMemory>> memories) {
+    std::sort(memories.begin(), memories.end(),
+              [](const sp<IMemory>& a, const sp<IMemory>& b) {
+                  return a->unsecurePointer() < b->unsecurePointer();
+              });
+    for (size_t i = 1; i < memories.size(); i++) {
+        auto* prevEnd =
+                static_cast<uint8_t*>(memories[i - 1]->unsecurePointer()) + memories[i - 1]->size();
+        EXPECT_LE(prevEnd, memories[i]->unsecurePointer());
+    }
+}
+
+TEST_P(MemoryDealerTest, AllocationsAreAlignedAndDistinct) {
+    sp<MemoryDealer> dealer = makeDealer(1024 * 1024);
+    std::vector<sp<IMemory>> memories;
+    for (size_t size : {1, 31, 32, 33, 100, 1000, 4096, 8191, 8192, 8193, 20000}) {
+        sp<IMemory> memory = dealer->allocate(size);
+        ASSERT_NE(memory, nullptr) << size;
+        EXPECT_EQ(memory->size(), size);
+        EXPECT_EQ(memory->offset() % MemoryDealer::getAllocationAlignment(), 0u);
+        memories.push_back(memory);
+    }
+    expectNoOverlap(memories);
+}
+
+TEST_P(MemoryDealerTest, FreedMemoryIsReused) {
+    sp<MemoryDealer> dealer = makeDealer(256 * 1024);
+    // more than fits at once
+    for (size_t i = 0; i < 1000; i++) {
+        sp<IMemory> memory = dealer->allocate(i % 2 ? 1000 : 100 * 1024);
+        ASSERT_NE(memory, nullptr) << i;
+    }
+}
+
+TEST_P(MemoryDealerTest, FullHeap) {
+    sp<MemoryDealer> dealer = makeDealer(256 * 1024);
+    std::vector<sp<IMemory>> memories;
+    while (sp<IMemory> memory = dealer->allocate(512)) {
+        memories.push_back(memory);
+    }
+    // slabs don't use the whole heap, but most of it
+    EXPECT_GE(memories.size(), 256u);
+    expectNoOverlap(memories);
+
+    memories.pop_back();
+    EXPECT_NE(dealer->allocate(512), nullptr);
+}
+
+TEST_P(MemoryDealerTest, ConcurrentAllocations) {
+    sp<MemoryDealer> dealer = makeDealer(4 * 1024 * 1024);
+    std::vector<std::vector<sp<IMemory>>> kept(4);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < kept.size(); t++) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < 2000; i++) {
+                sp<IMemory> memory = dealer->allocate(32 + (i * 97 + t) % 4000);
+                ASSERT_NE(memory, nullptr);
+                if (i % 8 == 0) kept[t].push_back(memory);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+
+    std::vector<sp<IMemory>> all;
+    for (const auto& memories : kept) all.insert(all.end(), memories.begin(), memories.end());
+    expectNoOverlap(all);
+}
+
+INSTANTIATE_TEST_SUITE_P(MemoryDealer, MemoryDealerTest,
+                         ::testing::Values(AllocatorType::BEST_FIT, AllocatorType::SLAB),
+                         [](const ::testing::TestParamInfo<AllocatorType>& info) {
+                             return info.param == AllocatorType::SLAB ? "Slab" : "BestFit";
+                         });
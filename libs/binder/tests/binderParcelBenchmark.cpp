@@ -169,4 +169,66 @@ BENCHMARK(BM_CharVector)->Apply(VectorArgs);
 BENCHMARK(BM_Int32Vector)->Apply(VectorArgs);
 BENCHMARK(BM_Int64Vector)->Apply(VectorArgs);
 
+// Parcelable of a few hundred bytes, similar to a WindowInfo.
+class SizedParcelable : public android::Parcelable {
+public:
+    explicit SizedParcelable(bool sizeHint) : mSizeHint(sizeHint) {}
+
+    android::status_t writeToParcel(android::Parcel* parcel) const override {
+        for (int64_t value : mValues) {
+            if (android::status_t status = parcel->writeInt64(value); status != android::OK) {
+                return status;
+            }
+        }
+        return android::OK;
+    }
+
+    android::status_t readFromParcel(const android::Parcel* parcel) override {
+        for (int64_t& value : mValues) {
+            if (android::status_t status = parcel->readInt64(&value); status != android::OK) {
+                return status;
+            }
+        }
+        return android::OK;
+    }
+
+    size_t getParcelSizeHint() const { return mSizeHint ? sizeof(mValues) : 0; }
+
+private:
+    bool mSizeHint;
+    int64_t mValues[40] = {};
+};
+
+template <bool kSizeHint>
+static void BM_ParcelableVectorWrite(benchmark::State& state) {
+    const size_t elements = state.range(0);
+
+    std::vector<SizedParcelable> v(elements, SizedParcelable(kSizeHint));
+    while (state.KeepRunning()) {
+        // new Parcel each time, so that it grows from its initial size
+        android::Parcel p;
+        p.writeParcelableVector(v);
+
+        benchmark::DoNotOptimize(p.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(elements);
+}
+
+/*
+  Parcelable vector write into a new Parcel, which either grows while each
+  element is written, or is sized once from the getParcelSizeHint of the elements.
+*/
+
+static void BM_ParcelableVectorGrow(benchmark::State& state) {
+    BM_ParcelableVectorWrite<false>(state);
+}
+
+static void BM_ParcelableVectorSizeHint(benchmark::State& state) {
+    BM_ParcelableVectorWrite<true>(state);
+}
+
+BENCHMARK(BM_ParcelableVectorGrow)->Apply(VectorArgs);
+BENCHMARK(BM_ParcelableVectorSizeHint)->Apply(VectorArgs);
+
 BENCHMARK_MAIN();
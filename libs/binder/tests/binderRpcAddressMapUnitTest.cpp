@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <random>
+
+#include "../RpcAddressMap.h"
+
+using android::RpcAddressMap;
+
+TEST(RpcAddressMap, InsertFindErase) {
+    RpcAddressMap<int> map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.end(), map.find(1));
+
+    auto [it, inserted] = map.insert({1, 10});
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(1u, it->first);
+    EXPECT_EQ(10, it->second);
+
+    auto [it2, inserted2] = map.insert({1, 20});
+    EXPECT_FALSE(inserted2);
+    EXPECT_EQ(10, it2->second);
+    EXPECT_EQ(1u, map.size());
+
+    map.erase(map.find(1));
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.end(), map.find(1));
+}
+
+TEST(RpcAddressMap, IteratorsStableAcrossInsert) {
+    RpcAddressMap<std::unique_ptr<int>> map;
+    auto [it, inserted] = map.insert({42, std::make_unique<int>(42)});
+    ASSERT_TRUE(inserted);
+    for (uint64_t i = 0; i < 1000; i++) {
+        if (i != 42) map.insert({i, std::make_unique<int>(i)});
+    }
+    EXPECT_EQ(42u, it->first);
+    EXPECT_EQ(42, *it->second);
+}
+
+TEST(RpcAddressMap, MoveLeavesEmpty) {
+    RpcAddressMap<int> map;
+    map.insert({1, 1});
+    RpcAddressMap<int> moved = std::move(map);
+    EXPECT_TRUE(map.empty()); // NOLINT(bugprone-use-after-move)
+    EXPECT_EQ(map.begin(), map.end());
+    EXPECT_EQ(1u, moved.size());
+    map.insert({2, 2});
+    EXPECT_EQ(1u, map.size());
+}
+
+TEST(RpcAddressMap, MatchesStdMap) {
+    RpcAddressMap<uint64_t> map;
+    std::map<uint64_t, uint64_t> expected;
+
+    std::mt19937_64 rng(0);
+    for (size_t i = 0; i < 100000; i++) {
+        // small key space, so that erasing and probe sequence collisions happen
+        uint64_t address = rng() % 2048;
+        if (rng() % 3 == 0) {
+            auto it = map.find(address);
+            ASSERT_EQ(expected.count(address) != 0, it != map.end()) << address;
+            if (it != map.end()) map.erase(it);
+            expected.erase(address);
+        } else {
+            bool inserted = map.insert({address, i}).second;
+            ASSERT_EQ(inserted, expected.insert({address, i}).second) << address;
+        }
+        ASSERT_EQ(expected.size(), map.size());
+    }
+
+    for (const auto& [address, value] : expected) {
+        auto it = map.find(address);
+        ASSERT_NE(map.end(), it) << address;
+        EXPECT_EQ(value, it->second);
+    }
+
+    size_t count = 0;
+    for (const auto& [address, value] : map) {
+        EXPECT_EQ(expected.at(address), value);
+        count++;
+    }
+    EXPECT_EQ(expected.size(), count);
+}
@@ -27,6 +27,7 @@
 #include <binder/RpcSession.h>
 #include <binder/RpcTlsTestUtils.h>
 #include <binder/RpcTlsUtils.h>
+#include <binder/RpcTransportIoUring.h>
 #include <binder/RpcTransportRaw.h>
 #include <binder/RpcTransportTls.h>
 #include <openssl/ssl.h>
@@ -53,6 +54,7 @@ using android::RpcCertificateVerifierNoOp;
 using android::RpcServer;
 using android::RpcSession;
 using android::RpcTransportCtxFactory;
+using android::RpcTransportCtxFactoryIoUring;
 using android::RpcTransportCtxFactoryRaw;
 using android::RpcTransportCtxFactoryTls;
 using android::sp;
@@ -114,10 +116,14 @@ class MyBinderRpcBenchmark : public BnBinderRpcBenchmark {
     size_t mBinderCount;
 };
 
+// for benchmarks with concurrent transactions
+constexpr size_t kMaxThreads = 8;
+
 enum Transport {
     KERNEL,
     RPC,
     RPC_TLS,
+    RPC_IO_URING,
 };
 
 static const std::initializer_list<int64_t> kTransportList = {
@@ -126,6 +132,7 @@ static const std::initializer_list<int64_t> kTransportList = {
 #endif
         Transport::RPC,
         Transport::RPC_TLS,
+        Transport::RPC_IO_URING,
 };
 
 std::unique_ptr<RpcTransportCtxFactory> makeFactoryTls() {
@@ -145,6 +152,8 @@ static sp<IBinder> gRpcBinder;
 // Skip certificate validation to simplify the setup process.
 static sp<RpcSession> gSessionTls = RpcSession::make(makeFactoryTls());
 static sp<IBinder> gRpcTlsBinder;
+static sp<RpcSession> gSessionIoUring = RpcSession::make(RpcTransportCtxFactoryIoUring::make());
+static sp<IBinder> gRpcIoUringBinder;
 #ifdef __BIONIC__
 static const String16 kKernelBinderInstance = String16(u"binderRpcBenchmark-control");
 static sp<IBinder> gKernelBinder;
@@ -161,6 +170,8 @@ static sp<IBinder> getBinderForOptions(benchmark::State& state) {
             return gRpcBinder;
         case RPC_TLS:
             return gRpcTlsBinder;
+        case RPC_IO_URING:
+            return gRpcIoUringBinder;
         default:
             LOG(FATAL) << "Unknown transport value: " << transport;
             return nullptr;
@@ -181,6 +192,9 @@ static void SetLabel(benchmark::State& state) {
         case RPC_TLS:
             state.SetLabel("rpc_tls");
             break;
+        case RPC_IO_URING:
+            state.SetLabel("rpc_io_uring");
+            break;
         default:
             LOG(FATAL) << "Unknown transport value: " << transport;
     }
@@ -282,6 +296,38 @@ void BM_collectProxies(benchmark::State& state) {
 }
 BENCHMARK(BM_collectProxies)->ArgsProduct({kTransportList, {10, 100, 1000, 5000, 10000, 20000}});
 
+// Cost of a transaction depending on how many other binders are live in the
+// session (for RPC binder, these are all entries in the RpcState node table).
+void BM_repeatBinderWithLiveProxies(benchmark::State& state) {
+    sp<IBinder> binder = getBinderForOptions(state);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    std::vector<sp<IBinder>> live(state.range(1));
+    for (auto& proxy : live) {
+        Status ret = iface->gimmeBinder(&proxy);
+        CHECK(ret.isOk()) << ret;
+    }
+
+    // send one of the live binders along, so that both directions need to
+    // look up a node which isn't the root object
+    sp<IBinder> sent = live.empty() ? sp<BBinder>::make() : live.back();
+    while (state.KeepRunning()) {
+        sp<IBinder> out;
+        Status ret = iface->repeatBinder(sent, &out);
+        CHECK(ret.isOk()) << ret;
+    }
+
+    live.clear();
+    sent = nullptr;
+    android::IInterface::asBinder(iface)->pingBinder();
+    iface->waitGimmesDestroyed();
+
+    SetLabel(state);
+}
+BENCHMARK(BM_repeatBinderWithLiveProxies)
+        ->ArgsProduct({kTransportList, {0, 100, 1000, 10000, 50000}});
+
 void BM_repeatBinder(benchmark::State& state) {
     sp<IBinder> binder = getBinderForOptions(state);
     CHECK(binder != nullptr);
@@ -301,9 +347,34 @@ void BM_repeatBinder(benchmark::State& state) {
 }
 BENCHMARK(BM_repeatBinder)->ArgsProduct({kTransportList});
 
+// Each thread transacts on its own binder, so RPC binder threads only share
+// the session and transport, and otherwise unrelated node state.
+void BM_repeatBinderContended(benchmark::State& state) {
+    sp<IBinder> binder = getBinderForOptions(state);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    sp<IBinder> mine;
+    Status ret = iface->gimmeBinder(&mine);
+    CHECK(ret.isOk()) << ret;
+
+    while (state.KeepRunning()) {
+        sp<IBinder> out;
+        Status ret = iface->repeatBinder(mine, &out);
+        CHECK(ret.isOk()) << ret;
+    }
+
+    SetLabel(state);
+}
+BENCHMARK(BM_repeatBinderContended)
+        ->ArgsProduct({kTransportList})
+        ->ThreadRange(1, kMaxThreads)
+        ->UseRealTime();
+
 void forkRpcServer(const char* addr, const sp<RpcServer>& server) {
     if (0 == fork()) {
         prctl(PR_SET_PDEATHSIG, SIGHUP); // racey, okay
+        server->setMaxThreads(kMaxThreads);
         server->setRootObject(sp<MyBinderRpcBenchmark>::make());
         CHECK_EQ(OK, server->setupUnixDomainServer(addr));
         server->join();
@@ -356,6 +427,12 @@ int main(int argc, char** argv) {
     setupClient(gSessionTls, tlsAddr.c_str());
     gRpcTlsBinder = gSessionTls->getRootObject();
 
+    std::string ioUringAddr = tmp + "/binderRpcIoUringBenchmark";
+    (void)unlink(ioUringAddr.c_str());
+    forkRpcServer(ioUringAddr.c_str(), RpcServer::make(RpcTransportCtxFactoryIoUring::make()));
+    setupClient(gSessionIoUring, ioUringAddr.c_str());
+    gRpcIoUringBinder = gSessionIoUring->getRootObject();
+
     ::benchmark::RunSpecifiedBenchmarks();
     return 0;
 }
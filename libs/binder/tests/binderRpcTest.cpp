@@ -19,6 +19,7 @@
 #include <aidl/IBinderRpcTest.h>
 #endif
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
@@ -31,6 +32,8 @@
 #include <sys/prctl.h>
 #include <sys/socket.h>
 
+#include <binder/TransactionStats.h>
+
 #ifdef BINDER_RPC_TO_TRUSTY_TEST
 #include <binder/RpcTransportTipcAndroid.h>
 #include <trusty/tipc.h>
@@ -629,6 +632,116 @@ TEST_P(BinderRpc, OnewayCallQueueing) {
     saturateThreadPool(1 + kNumExtraServerThreads, proc.rootIface);
 }
 
+TEST_P(BinderRpc, OnewayBatchQueueing) {
+    if (clientOrServerSingleThreaded()) {
+        GTEST_SKIP() << "This test requires multiple threads";
+    }
+
+    constexpr size_t kNumQueued = 10;
+    constexpr size_t kNumExtraServerThreads = 4;
+
+    auto proc = createRpcTestSocketServerProcess({.numThreads = 1 + kNumExtraServerThreads});
+
+    // same as OnewayCallQueueing, but all oneway calls are written together
+    {
+        RpcSession::OnewayBatch batch(proc.proc->sessions.at(0).session,
+                                      RpcSession::OnewayBatch::kDefaultMaxBytes,
+                                      std::chrono::seconds(10));
+        for (size_t i = 0; i + 1 < kNumQueued; i++) {
+            EXPECT_OK(proc.rootIface->blockingSendIntOneway(i));
+        }
+    }
+    for (size_t i = 0; i + 1 < kNumQueued; i++) {
+        int n;
+        EXPECT_OK(proc.rootIface->blockingRecvInt(&n));
+        EXPECT_EQ(n, i);
+    }
+
+    saturateThreadPool(1 + kNumExtraServerThreads, proc.rootIface);
+}
+
+TEST_P(BinderRpc, OnewayBatchFlushesBeforeTwoway) {
+    // with one connection, the server handles calls in the order they are written
+    auto proc = createRpcTestSocketServerProcess({.numThreads = 1});
+
+    RpcSession::OnewayBatch batch(proc.proc->sessions.at(0).session,
+                                  RpcSession::OnewayBatch::kDefaultMaxBytes,
+                                  std::chrono::seconds(10));
+    EXPECT_OK(proc.rootIface->recordStringOneway("a"));
+    EXPECT_OK(proc.rootIface->recordStringOneway("b"));
+
+    // the synchronous call must not overtake the oneway calls
+    std::vector<std::string> recorded;
+    EXPECT_OK(proc.rootIface->recordString("c", &recorded));
+    EXPECT_EQ(recorded, (std::vector<std::string>{"a", "b", "c"}));
+    EXPECT_OK(batch.flush());
+}
+
+TEST_P(BinderRpc, OnewayBatchDoesNotHoldUpOtherThreads) {
+    if (clientOrServerSingleThreaded()) {
+        GTEST_SKIP() << "This test requires multiple threads";
+    }
+
+    auto proc = createRpcTestSocketServerProcess({.numThreads = 2});
+
+    RpcSession::OnewayBatch batch(proc.proc->sessions.at(0).session,
+                                  RpcSession::OnewayBatch::kDefaultMaxBytes,
+                                  std::chrono::seconds(10));
+    EXPECT_OK(proc.rootIface->recordStringOneway("a"));
+
+    auto contains = [](const std::vector<std::string>& v, const std::string& s) {
+        return std::find(v.begin(), v.end(), s) != v.end();
+    };
+    // oneway calls may still be in flight on another connection
+    auto waitForRecorded = [&](const std::string& s) {
+        std::vector<std::string> recorded;
+        auto deadline = std::chrono::steady_clock::now() + 5s;
+        do {
+            EXPECT_OK(proc.rootIface->recordString("", &recorded));
+        } while (!contains(recorded, s) && std::chrono::steady_clock::now() < deadline);
+        return recorded;
+    };
+
+    // a oneway call to the same binder from another thread is handled while
+    // "a" is still pending
+    std::thread([&] {
+        EXPECT_OK(proc.rootIface->recordStringOneway("b"));
+        std::vector<std::string> recorded = waitForRecorded("b");
+        EXPECT_TRUE(contains(recorded, "b"));
+        EXPECT_FALSE(contains(recorded, "a"));
+    }).join();
+
+    EXPECT_OK(batch.flush());
+    EXPECT_TRUE(contains(waitForRecorded("a"), "a"));
+}
+
+TEST_P(BinderRpc, TransactionStatsRecordsCalls) {
+    using android::binder::debug::TransactionStats;
+    constexpr size_t kNumCalls = 10;
+
+    auto proc = createRpcTestSocketServerProcess({});
+
+    TransactionStats::setEnabled(true);
+    TransactionStats::reset();
+    for (size_t i = 0; i < kNumCalls; i++) {
+        EXPECT_OK(proc.rootIface->sendString("a"));
+    }
+    TransactionStats::setEnabled(false);
+
+    std::string descriptor = String8(IBinderRpcTest::descriptor).c_str();
+    auto entries = TransactionStats::snapshot();
+    auto it = std::find_if(entries.begin(), entries.end(), [&](const auto& entry) {
+        return entry.descriptor == descriptor;
+    });
+    ASSERT_NE(it, entries.end()) << TransactionStats::dump();
+    EXPECT_EQ(kNumCalls, it->calls);
+    EXPECT_EQ(0u, it->errors);
+    EXPECT_GT(it->totalLatencyNs, 0);
+    EXPECT_LE(it->p50LatencyNs, it->maxLatencyNs);
+    EXPECT_LE(it->p99LatencyNs, it->maxLatencyNs);
+    EXPECT_GE(it->totalDataBytes, kNumCalls * descriptor.size() * sizeof(char16_t));
+}
+
 TEST_P(BinderRpc, OnewayCallExhaustion) {
     if (clientOrServerSingleThreaded()) {
         GTEST_SKIP() << "This test requires multiple threads";
@@ -1293,6 +1406,20 @@ static std::vector<BinderRpc::ParamType> getBinderRpcParams() {
                     }
                 }
             }
+            if (type == SocketType::UNIX) {
+                for (auto security : {RpcSecurity::SHMEM, RpcSecurity::IO_URING}) {
+                    for (bool singleThreaded : {false, true}) {
+                        ret.push_back(BinderRpc::ParamType{
+                                .type = type,
+                                .security = security,
+                                .clientVersion = RPC_WIRE_PROTOCOL_VERSION,
+                                .serverVersion = RPC_WIRE_PROTOCOL_VERSION,
+                                .singleThreaded = singleThreaded,
+                                .noKernel = false,
+                        });
+                    }
+                }
+            }
         } else {
             ret.push_back(BinderRpc::ParamType{
                     .type = type,
@@ -1468,6 +1595,63 @@ TEST_P(BinderRpcServerOnly, Shutdown) {
             << "After server->shutdown() returns true, join() did not stop after 2s";
 }
 
+TEST_P(BinderRpcServerOnly, EventDrivenManySessions) {
+    if constexpr (!kEnableRpcThreads) {
+        GTEST_SKIP() << "Test skipped because threads were disabled at build time";
+    }
+
+    constexpr size_t kNumSessions = 20;
+    constexpr size_t kNumConnections = 4;
+
+    auto addr = allocateSocketAddress();
+    auto server = RpcServer::make(newTlsFactory(std::get<0>(GetParam())));
+    ASSERT_TRUE(server->setProtocolVersion(std::get<1>(GetParam())));
+    server->setMaxThreads(kNumConnections);
+    server->setEventDrivenWorkerThreads(2);
+    server->setRootObject(sp<BBinder>::make());
+    ASSERT_EQ(OK, server->setupUnixDomainServer(addr.c_str()));
+    server->start();
+
+    std::vector<sp<RpcSession>> sessions;
+    std::vector<sp<IBinder>> roots;
+    for (size_t i = 0; i < kNumSessions; i++) {
+        auto session = RpcSession::make(newTlsFactory(std::get<0>(GetParam())));
+        ASSERT_TRUE(session->setProtocolVersion(std::get<1>(GetParam())));
+        ASSERT_EQ(OK, session->setupUnixDomainClient(addr.c_str()));
+        auto root = session->getRootObject();
+        ASSERT_NE(nullptr, root);
+        sessions.push_back(session);
+        roots.push_back(root);
+    }
+    EXPECT_EQ(kNumSessions, server->listSessions().size());
+
+    // more concurrent calls than there are workers
+    std::vector<std::thread> threads;
+    for (const auto& root : roots) {
+        for (size_t i = 0; i < kNumConnections; i++) {
+            threads.push_back(std::thread([root] {
+                for (size_t j = 0; j < 10; j++) {
+                    EXPECT_EQ(OK, root->pingBinder());
+                }
+            }));
+        }
+    }
+    for (auto& thread : threads) thread.join();
+
+    // sessions are dropped when their clients go away
+    roots.clear();
+    for (const auto& session : sessions) {
+        EXPECT_TRUE(session->shutdownAndWait(true));
+    }
+    sessions.clear();
+    for (size_t tries = 0; tries < 100 && !server->listSessions().empty(); tries++) {
+        usleep(10 * 1000);
+    }
+    EXPECT_EQ(0u, server->listSessions().size());
+
+    EXPECT_TRUE(server->shutdown());
+}
+
 INSTANTIATE_TEST_CASE_P(BinderRpc, BinderRpcServerOnly,
                         ::testing::Combine(::testing::ValuesIn(RpcSecurityValues()),
                                            ::testing::ValuesIn(testVersions())),
@@ -1769,6 +1953,10 @@ public:
                             ret.emplace_back(socketType, rpcSecurity, RpcCertificateFormat::DER,
                                              serverVersion);
                         } break;
+                        case RpcSecurity::SHMEM:
+                        case RpcSecurity::IO_URING:
+                            // not in RpcSecurityValues
+                            break;
                     }
                 }
             }
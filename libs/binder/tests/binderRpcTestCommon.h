@@ -46,6 +46,8 @@
 #include <binder/ProcessState.h>
 #include <binder/RpcTlsTestUtils.h>
 #include <binder/RpcTlsUtils.h>
+#include <binder/RpcTransportIoUring.h>
+#include <binder/RpcTransportShmem.h>
 #include <binder/RpcTransportTls.h>
 
 #include <signal.h>
@@ -67,7 +69,9 @@ namespace android {
 
 constexpr char kLocalInetAddress[] = "127.0.0.1";
 
-enum class RpcSecurity { RAW, TLS };
+// SHMEM and IO_URING are only tested with Unix domain sockets, so they aren't
+// in RpcSecurityValues
+enum class RpcSecurity { RAW, TLS, SHMEM, IO_URING };
 
 static inline std::vector<RpcSecurity> RpcSecurityValues() {
     return {RpcSecurity::RAW, RpcSecurity::TLS};
@@ -203,6 +207,10 @@ static inline std::unique_ptr<RpcTransportCtxFactory> newTlsFactory(
             }
             return RpcTransportCtxFactoryTls::make(std::move(verifier), std::move(auth));
         }
+        case RpcSecurity::SHMEM:
+            return RpcTransportCtxFactoryShmem::make();
+        case RpcSecurity::IO_URING:
+            return RpcTransportCtxFactoryIoUring::make();
         default:
             LOG_ALWAYS_FATAL("Unknown RpcSecurity %d", rpcSecurity);
     }
@@ -413,6 +421,19 @@ public:
         return doCallback(callback, oneway, delayed, value);
     }
 
+    RpcMutex recordedMutex;
+    std::vector<std::string> recordedStrings;
+    Status recordStringOneway(const std::string& str) override {
+        std::vector<std::string> unused;
+        return recordString(str, &unused);
+    }
+    Status recordString(const std::string& str, std::vector<std::string>* out) override {
+        RpcMutexLockGuard _l(recordedMutex);
+        recordedStrings.push_back(str);
+        *out = recordedStrings;
+        return Status::ok();
+    }
+
 protected:
     // Generic version of countBinders that works with both
     // RpcServer and RpcServerTrusty
@@ -2,12 +2,14 @@
 #include <binder/IBinder.h>
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
 #include <string>
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
 
 #include <iostream>
+#include <thread>
 #include <vector>
 #include <tuple>
 
@@ -29,6 +31,13 @@ do { \
     } \
 } while (0)
 
+// Bursty load, see --help
+static int client_threads = 1;
+static int burst_size = 0;
+static int burst_gap_ms = 0;
+static int server_work_us = 0;
+static int adaptive_idle_ms = 0;
+
 class BinderWorkerService : public BBinder
 {
 public:
@@ -42,6 +51,9 @@ public:
         (void)reply;
         switch (code) {
         case BINDER_NOP:
+            if (server_work_us > 0) {
+                usleep(server_work_us);
+            }
             return NO_ERROR;
         default:
             return UNKNOWN_TRANSACTION;
@@ -184,6 +196,9 @@ void worker_fx(int num,
                Pipe p)
 {
     // Create BinderWorkerService and for go.
+    if (adaptive_idle_ms > 0) {
+        ProcessState::self()->setThreadPoolAdaptive(1, adaptive_idle_ms);
+    }
     ProcessState::self()->startThreadPool();
     sp<IServiceManager> serviceMgr = defaultServiceManager();
     sp<BinderWorkerService> service = new BinderWorkerService;
@@ -211,34 +226,59 @@ void worker_fx(int num,
     }
 
     // Run the benchmark if client
-    ProcResults results;
-    chrono::time_point<chrono::high_resolution_clock> start, end;
-    for (int i = 0; (!cs_pair || num >= server_count) && i < iterations; i++) {
-        Parcel data, reply;
-        int target = cs_pair ? num % server_count : rand() % workers.size();
-        int sz = payload_size;
-
-        while (sz >= sizeof(uint32_t)) {
-            data.writeInt32(0);
-            sz -= sizeof(uint32_t);
-        }
-        start = chrono::high_resolution_clock::now();
-        status_t ret = workers[target]->transact(BINDER_NOP, data, &reply);
-        end = chrono::high_resolution_clock::now();
+    auto client_fx = [&](unsigned int seed) {
+        ProcResults results;
+        chrono::time_point<chrono::high_resolution_clock> start, end;
+        for (int i = 0; (!cs_pair || num >= server_count) && i < iterations; i++) {
+            if (burst_size > 0 && i > 0 && i % burst_size == 0) {
+                usleep(burst_gap_ms * 1000);
+            }
+            Parcel data, reply;
+            int target = cs_pair ? num % server_count : rand_r(&seed) % workers.size();
+            int sz = payload_size;
 
-        uint64_t cur_time = uint64_t(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
-        results.add_time(cur_time);
+            while (sz >= sizeof(uint32_t)) {
+                data.writeInt32(0);
+                sz -= sizeof(uint32_t);
+            }
+            start = chrono::high_resolution_clock::now();
+            status_t ret = workers[target]->transact(BINDER_NOP, data, &reply);
+            end = chrono::high_resolution_clock::now();
 
-        if (ret != NO_ERROR) {
-           cout << "thread " << num << " failed " << ret << "i : " << i << endl;
-           exit(EXIT_FAILURE);
+            uint64_t cur_time = uint64_t(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+            results.add_time(cur_time);
+
+            if (ret != NO_ERROR) {
+               cout << "thread " << num << " failed " << ret << "i : " << i << endl;
+               exit(EXIT_FAILURE);
+            }
         }
+        return results;
+    };
+
+    vector<ProcResults> thread_results(client_threads);
+    vector<thread> clients;
+    for (int t = 0; t < client_threads; t++) {
+        clients.push_back(thread([&, t] {
+            thread_results[t] = client_fx(num * client_threads + t);
+        }));
+    }
+    ProcResults results;
+    for (int t = 0; t < client_threads; t++) {
+        clients[t].join();
+        results = ProcResults::combine(results, thread_results[t]);
     }
 
     // Signal completion to master and wait.
     p.signal();
     p.wait();
 
+    ProcessState::ThreadPoolStats pool = ProcessState::self()->getThreadPoolStats();
+    cout << "BinderWorker" << num << " thread pool: current:" << pool.currentThreads
+         << " peak executing:" << pool.peakExecutingThreads
+         << " started:" << pool.kernelStartedThreads << " retired:" << pool.retiredThreads
+         << " starved:" << pool.starvationCount << " (" << pool.starvationTimeMs << "ms)" << endl;
+
     // Send results to master and wait for go to exit.
     p.send(results);
     p.wait();
@@ -299,7 +339,7 @@ void run_main(int iterations,
     end = chrono::high_resolution_clock::now();
 
     // Calculate overall throughput.
-    double iterations_per_sec = double(iterations * workers) / (chrono::duration_cast<chrono::nanoseconds>(end - start).count() / 1.0E9);
+    double iterations_per_sec = double(iterations * workers * client_threads) / (chrono::duration_cast<chrono::nanoseconds>(end - start).count() / 1.0E9);
     cout << "iterations per sec: " << iterations_per_sec << endl;
 
     // Collect all results from the workers.
@@ -347,6 +387,11 @@ int main(int argc, char *argv[])
     for (int i = 1; i < argc; i++) {
         if (string(argv[i]) == "--help") {
             cout << "Usage: binderThroughputTest [OPTIONS]" << endl;
+            cout << "\t-a N    : Retire idle binder threads after N ms (adaptive thread pool)." << endl;
+            cout << "\t-b N    : Send transactions in bursts of N per client thread." << endl;
+            cout << "\t-c N    : Specify number of client threads per worker." << endl;
+            cout << "\t-d N    : Specify server work per transaction in microseconds." << endl;
+            cout << "\t-g N    : Specify gap between bursts in milliseconds." << endl;
             cout << "\t-i N    : Specify number of iterations." << endl;
             cout << "\t-m N    : Specify expected max latency in microseconds." << endl;
             cout << "\t-p      : Split workers into client/server pairs." << endl;
@@ -360,6 +405,31 @@ int main(int argc, char *argv[])
             i++;
             continue;
         }
+        if (string(argv[i]) == "-a") {
+            adaptive_idle_ms = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-b") {
+            burst_size = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-c") {
+            client_threads = max(1, atoi(argv[i+1]));
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-d") {
+            server_work_us = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
+        if (string(argv[i]) == "-g") {
+            burst_gap_ms = atoi(argv[i+1]);
+            i++;
+            continue;
+        }
         if (string(argv[i]) == "-i") {
             iterations = atoi(argv[i+1]);
             i++;
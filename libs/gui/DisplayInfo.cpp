@@ -53,6 +53,11 @@ status_t DisplayInfo::readFromParcel(const android::Parcel* parcel) {
     return OK;
 }
 
+size_t DisplayInfo::getParcelSizeHint() const {
+    // displayId, logical size and transform
+    return 3 * sizeof(int32_t) + 6 * sizeof(float);
+}
+
 status_t DisplayInfo::writeToParcel(android::Parcel* parcel) const {
     if (parcel == nullptr) {
         ALOGE("%s: Null parcel", __func__);
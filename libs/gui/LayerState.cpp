@@ -99,107 +99,196 @@ layer_state_t::layer_state_t()
     hdrMetadata.validTypes = 0;
 }
 
+// Only the fields selected by 'what' are parceled, after a header of the surface, layer id and
+// 'what' itself. Everything else keeps its default value on the reading side. Fields must be
+// written and read in the same order.
 status_t layer_state_t::write(Parcel& output) const
 {
     SAFE_PARCEL(output.writeStrongBinder, surface);
     SAFE_PARCEL(output.writeInt32, layerId);
     SAFE_PARCEL(output.writeUint64, what);
-    SAFE_PARCEL(output.writeFloat, x);
-    SAFE_PARCEL(output.writeFloat, y);
-    SAFE_PARCEL(output.writeInt32, z);
-    SAFE_PARCEL(output.writeUint32, layerStack.id);
-    SAFE_PARCEL(output.writeUint32, flags);
-    SAFE_PARCEL(output.writeUint32, mask);
-    SAFE_PARCEL(matrix.write, output);
-    SAFE_PARCEL(output.write, crop);
-    SAFE_PARCEL(SurfaceControl::writeNullableToParcel, output, relativeLayerSurfaceControl);
-    SAFE_PARCEL(SurfaceControl::writeNullableToParcel, output, parentSurfaceControlForChild);
-    SAFE_PARCEL(output.writeFloat, color.r);
-    SAFE_PARCEL(output.writeFloat, color.g);
-    SAFE_PARCEL(output.writeFloat, color.b);
-    SAFE_PARCEL(output.writeFloat, color.a);
-    SAFE_PARCEL(windowInfoHandle->writeToParcel, &output);
-    SAFE_PARCEL(output.write, transparentRegion);
-    SAFE_PARCEL(output.writeUint32, bufferTransform);
-    SAFE_PARCEL(output.writeBool, transformToDisplayInverse);
-    SAFE_PARCEL(output.writeBool, borderEnabled);
-    SAFE_PARCEL(output.writeFloat, borderWidth);
-    SAFE_PARCEL(output.writeFloat, borderColor.r);
-    SAFE_PARCEL(output.writeFloat, borderColor.g);
-    SAFE_PARCEL(output.writeFloat, borderColor.b);
-    SAFE_PARCEL(output.writeFloat, borderColor.a);
-    SAFE_PARCEL(output.writeUint32, static_cast<uint32_t>(dataspace));
-    SAFE_PARCEL(output.write, hdrMetadata);
-    SAFE_PARCEL(output.write, surfaceDamageRegion);
-    SAFE_PARCEL(output.writeInt32, api);
-
-    if (sidebandStream) {
-        SAFE_PARCEL(output.writeBool, true);
-        SAFE_PARCEL(output.writeNativeHandle, sidebandStream->handle());
-    } else {
-        SAFE_PARCEL(output.writeBool, false);
-    }
-
-    SAFE_PARCEL(output.write, colorTransform.asArray(), 16 * sizeof(float));
-    SAFE_PARCEL(output.writeFloat, cornerRadius);
-    SAFE_PARCEL(output.writeUint32, backgroundBlurRadius);
-    SAFE_PARCEL(output.writeParcelable, metadata);
-    SAFE_PARCEL(output.writeFloat, bgColor.r);
-    SAFE_PARCEL(output.writeFloat, bgColor.g);
-    SAFE_PARCEL(output.writeFloat, bgColor.b);
-    SAFE_PARCEL(output.writeFloat, bgColor.a);
-    SAFE_PARCEL(output.writeUint32, static_cast<uint32_t>(bgColorDataspace));
-    SAFE_PARCEL(output.writeBool, colorSpaceAgnostic);
-    SAFE_PARCEL(output.writeVectorSize, listeners);
-
-    for (auto listener : listeners) {
-        SAFE_PARCEL(output.writeStrongBinder, listener.transactionCompletedListener);
-        SAFE_PARCEL(output.writeParcelableVector, listener.callbackIds);
-    }
-    SAFE_PARCEL(output.writeFloat, shadowRadius);
-    SAFE_PARCEL(output.writeInt32, frameRateSelectionPriority);
-    SAFE_PARCEL(output.writeFloat, frameRate);
-    SAFE_PARCEL(output.writeByte, frameRateCompatibility);
-    SAFE_PARCEL(output.writeByte, changeFrameRateStrategy);
-    SAFE_PARCEL(output.writeByte, defaultFrameRateCompatibility);
-    SAFE_PARCEL(output.writeByte, frameRateCategory);
-    SAFE_PARCEL(output.writeBool, frameRateCategorySmoothSwitchOnly);
-    SAFE_PARCEL(output.writeByte, frameRateSelectionStrategy);
-    SAFE_PARCEL(output.writeUint32, fixedTransformHint);
-    SAFE_PARCEL(output.writeBool, autoRefresh);
-    SAFE_PARCEL(output.writeBool, dimmingEnabled);
-
-    SAFE_PARCEL(output.writeUint32, blurRegions.size());
-    for (auto region : blurRegions) {
-        SAFE_PARCEL(output.writeUint32, region.blurRadius);
-        SAFE_PARCEL(output.writeFloat, region.cornerRadiusTL);
-        SAFE_PARCEL(output.writeFloat, region.cornerRadiusTR);
-        SAFE_PARCEL(output.writeFloat, region.cornerRadiusBL);
-        SAFE_PARCEL(output.writeFloat, region.cornerRadiusBR);
-        SAFE_PARCEL(output.writeFloat, region.alpha);
-        SAFE_PARCEL(output.writeInt32, region.left);
-        SAFE_PARCEL(output.writeInt32, region.top);
-        SAFE_PARCEL(output.writeInt32, region.right);
-        SAFE_PARCEL(output.writeInt32, region.bottom);
-    }
-
-    SAFE_PARCEL(output.write, stretchEffect);
-    SAFE_PARCEL(output.write, bufferCrop);
-    SAFE_PARCEL(output.write, destinationFrame);
-    SAFE_PARCEL(output.writeBool, isTrustedOverlay);
-
-    SAFE_PARCEL(output.writeUint32, static_cast<uint32_t>(dropInputMode));
-
-    const bool hasBufferData = (bufferData != nullptr);
-    SAFE_PARCEL(output.writeBool, hasBufferData);
-    if (hasBufferData) {
-        SAFE_PARCEL(output.writeParcelable, *bufferData);
-    }
-    SAFE_PARCEL(output.writeParcelable, trustedPresentationThresholds);
-    SAFE_PARCEL(output.writeParcelable, trustedPresentationListener);
-    SAFE_PARCEL(output.writeFloat, currentHdrSdrRatio);
-    SAFE_PARCEL(output.writeFloat, desiredHdrSdrRatio);
-    SAFE_PARCEL(output.writeInt32, static_cast<int32_t>(cachingHint))
+
+    if (what & ePositionChanged) {
+        SAFE_PARCEL(output.writeFloat, x);
+        SAFE_PARCEL(output.writeFloat, y);
+    }
+    if (what & (eLayerChanged | eRelativeLayerChanged)) {
+        SAFE_PARCEL(output.writeInt32, z);
+    }
+    if (what & eLayerStackChanged) {
+        SAFE_PARCEL(output.writeUint32, layerStack.id);
+    }
+    if (what & eFlagsChanged) {
+        SAFE_PARCEL(output.writeUint32, flags);
+        SAFE_PARCEL(output.writeUint32, mask);
+    }
+    if (what & eMatrixChanged) {
+        SAFE_PARCEL(matrix.write, output);
+    }
+    if (what & eCropChanged) {
+        SAFE_PARCEL(output.write, crop);
+    }
+    if (what & eRelativeLayerChanged) {
+        SAFE_PARCEL(SurfaceControl::writeNullableToParcel, output, relativeLayerSurfaceControl);
+    }
+    if (what & eReparent) {
+        SAFE_PARCEL(SurfaceControl::writeNullableToParcel, output, parentSurfaceControlForChild);
+    }
+    if (what & eColorChanged) {
+        SAFE_PARCEL(output.writeFloat, color.r);
+        SAFE_PARCEL(output.writeFloat, color.g);
+        SAFE_PARCEL(output.writeFloat, color.b);
+    }
+    if (what & eAlphaChanged) {
+        SAFE_PARCEL(output.writeFloat, color.a);
+    }
+    if (what & eInputInfoChanged) {
+        SAFE_PARCEL(windowInfoHandle->writeToParcel, &output);
+    }
+    if (what & eTransparentRegionChanged) {
+        SAFE_PARCEL(output.write, transparentRegion);
+    }
+    if (what & eBufferTransformChanged) {
+        SAFE_PARCEL(output.writeUint32, bufferTransform);
+    }
+    if (what & eTransformToDisplayInverseChanged) {
+        SAFE_PARCEL(output.writeBool, transformToDisplayInverse);
+    }
+    if (what & eRenderBorderChanged) {
+        SAFE_PARCEL(output.writeBool, borderEnabled);
+        SAFE_PARCEL(output.writeFloat, borderWidth);
+        SAFE_PARCEL(output.writeFloat, borderColor.r);
+        SAFE_PARCEL(output.writeFloat, borderColor.g);
+        SAFE_PARCEL(output.writeFloat, borderColor.b);
+        SAFE_PARCEL(output.writeFloat, borderColor.a);
+    }
+    if (what & eDataspaceChanged) {
+        SAFE_PARCEL(output.writeUint32, static_cast<uint32_t>(dataspace));
+    }
+    if (what & eHdrMetadataChanged) {
+        SAFE_PARCEL(output.write, hdrMetadata);
+    }
+    if (what & eSurfaceDamageRegionChanged) {
+        SAFE_PARCEL(output.write, surfaceDamageRegion);
+    }
+    if (what & eApiChanged) {
+        SAFE_PARCEL(output.writeInt32, api);
+    }
+    if (what & eSidebandStreamChanged) {
+        if (sidebandStream) {
+            SAFE_PARCEL(output.writeBool, true);
+            SAFE_PARCEL(output.writeNativeHandle, sidebandStream->handle());
+        } else {
+            SAFE_PARCEL(output.writeBool, false);
+        }
+    }
+    if (what & eColorTransformChanged) {
+        SAFE_PARCEL(output.write, colorTransform.asArray(), 16 * sizeof(float));
+    }
+    if (what & eCornerRadiusChanged) {
+        SAFE_PARCEL(output.writeFloat, cornerRadius);
+    }
+    if (what & eBackgroundBlurRadiusChanged) {
+        SAFE_PARCEL(output.writeUint32, backgroundBlurRadius);
+    }
+    if (what & eMetadataChanged) {
+        SAFE_PARCEL(output.writeParcelable, metadata);
+    }
+    if (what & eBackgroundColorChanged) {
+        SAFE_PARCEL(output.writeFloat, bgColor.r);
+        SAFE_PARCEL(output.writeFloat, bgColor.g);
+        SAFE_PARCEL(output.writeFloat, bgColor.b);
+        SAFE_PARCEL(output.writeFloat, bgColor.a);
+        SAFE_PARCEL(output.writeUint32, static_cast<uint32_t>(bgColorDataspace));
+    }
+    if (what & eColorSpaceAgnosticChanged) {
+        SAFE_PARCEL(output.writeBool, colorSpaceAgnostic);
+    }
+    if (what & eHasListenerCallbacksChanged) {
+        SAFE_PARCEL(output.writeVectorSize, listeners);
+        for (auto listener : listeners) {
+            SAFE_PARCEL(output.writeStrongBinder, listener.transactionCompletedListener);
+            SAFE_PARCEL(output.writeParcelableVector, listener.callbackIds);
+        }
+    }
+    if (what & eShadowRadiusChanged) {
+        SAFE_PARCEL(output.writeFloat, shadowRadius);
+    }
+    if (what & eFrameRateSelectionPriority) {
+        SAFE_PARCEL(output.writeInt32, frameRateSelectionPriority);
+    }
+    if (what & eFrameRateChanged) {
+        SAFE_PARCEL(output.writeFloat, frameRate);
+        SAFE_PARCEL(output.writeByte, frameRateCompatibility);
+        SAFE_PARCEL(output.writeByte, changeFrameRateStrategy);
+    }
+    if (what & eDefaultFrameRateCompatibilityChanged) {
+        SAFE_PARCEL(output.writeByte, defaultFrameRateCompatibility);
+    }
+    if (what & eFrameRateCategoryChanged) {
+        SAFE_PARCEL(output.writeByte, frameRateCategory);
+        SAFE_PARCEL(output.writeBool, frameRateCategorySmoothSwitchOnly);
+    }
+    if (what & eFrameRateSelectionStrategyChanged) {
+        SAFE_PARCEL(output.writeByte, frameRateSelectionStrategy);
+    }
+    if (what & eFixedTransformHintChanged) {
+        SAFE_PARCEL(output.writeUint32, fixedTransformHint);
+    }
+    if (what & eAutoRefreshChanged) {
+        SAFE_PARCEL(output.writeBool, autoRefresh);
+    }
+    if (what & eDimmingEnabledChanged) {
+        SAFE_PARCEL(output.writeBool, dimmingEnabled);
+    }
+    if (what & eBlurRegionsChanged) {
+        SAFE_PARCEL(output.writeUint32, blurRegions.size());
+        for (auto region : blurRegions) {
+            SAFE_PARCEL(output.writeUint32, region.blurRadius);
+            SAFE_PARCEL(output.writeFloat, region.cornerRadiusTL);
+            SAFE_PARCEL(output.writeFloat, region.cornerRadiusTR);
+            SAFE_PARCEL(output.writeFloat, region.cornerRadiusBL);
+            SAFE_PARCEL(output.writeFloat, region.cornerRadiusBR);
+            SAFE_PARCEL(output.writeFloat, region.alpha);
+            SAFE_PARCEL(output.writeInt32, region.left);
+            SAFE_PARCEL(output.writeInt32, region.top);
+            SAFE_PARCEL(output.writeInt32, region.right);
+            SAFE_PARCEL(output.writeInt32, region.bottom);
+        }
+    }
+    if (what & eStretchChanged) {
+        SAFE_PARCEL(output.write, stretchEffect);
+    }
+    if (what & eBufferCropChanged) {
+        SAFE_PARCEL(output.write, bufferCrop);
+    }
+    if (what & eDestinationFrameChanged) {
+        SAFE_PARCEL(output.write, destinationFrame);
+    }
+    if (what & eTrustedOverlayChanged) {
+        SAFE_PARCEL(output.writeBool, isTrustedOverlay);
+    }
+    if (what & eDropInputModeChanged) {
+        SAFE_PARCEL(output.writeUint32, static_cast<uint32_t>(dropInputMode));
+    }
+    if (what & eBufferChanged) {
+        const bool hasBufferData = (bufferData != nullptr);
+        SAFE_PARCEL(output.writeBool, hasBufferData);
+        if (hasBufferData) {
+            SAFE_PARCEL(output.writeParcelable, *bufferData);
+        }
+    }
+    if (what & eTrustedPresentationInfoChanged) {
+        SAFE_PARCEL(output.writeParcelable, trustedPresentationThresholds);
+        SAFE_PARCEL(output.writeParcelable, trustedPresentationListener);
+    }
+    if (what & eExtendedRangeBrightnessChanged) {
+        SAFE_PARCEL(output.writeFloat, currentHdrSdrRatio);
+        SAFE_PARCEL(output.writeFloat, desiredHdrSdrRatio);
+    }
+    if (what & eCachingHintChanged) {
+        SAFE_PARCEL(output.writeInt32, static_cast<int32_t>(cachingHint));
+    }
     return NO_ERROR;
 }
 
@@ -208,150 +297,223 @@ status_t layer_state_t::read(const Parcel& input)
     SAFE_PARCEL(input.readNullableStrongBinder, &surface);
     SAFE_PARCEL(input.readInt32, &layerId);
     SAFE_PARCEL(input.readUint64, &what);
-    SAFE_PARCEL(input.readFloat, &x);
-    SAFE_PARCEL(input.readFloat, &y);
-    SAFE_PARCEL(input.readInt32, &z);
-    SAFE_PARCEL(input.readUint32, &layerStack.id);
-
-    SAFE_PARCEL(input.readUint32, &flags);
-
-    SAFE_PARCEL(input.readUint32, &mask);
-
-    SAFE_PARCEL(matrix.read, input);
-    SAFE_PARCEL(input.read, crop);
-
-    SAFE_PARCEL(SurfaceControl::readNullableFromParcel, input, &relativeLayerSurfaceControl);
-    SAFE_PARCEL(SurfaceControl::readNullableFromParcel, input, &parentSurfaceControlForChild);
 
     float tmpFloat = 0;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    color.r = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    color.g = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    color.b = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    color.a = tmpFloat;
-
-    SAFE_PARCEL(windowInfoHandle->readFromParcel, &input);
-
-    SAFE_PARCEL(input.read, transparentRegion);
-    SAFE_PARCEL(input.readUint32, &bufferTransform);
-    SAFE_PARCEL(input.readBool, &transformToDisplayInverse);
-    SAFE_PARCEL(input.readBool, &borderEnabled);
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    borderWidth = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    borderColor.r = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    borderColor.g = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    borderColor.b = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    borderColor.a = tmpFloat;
-
     uint32_t tmpUint32 = 0;
-    SAFE_PARCEL(input.readUint32, &tmpUint32);
-    dataspace = static_cast<ui::Dataspace>(tmpUint32);
-
-    SAFE_PARCEL(input.read, hdrMetadata);
-    SAFE_PARCEL(input.read, surfaceDamageRegion);
-    SAFE_PARCEL(input.readInt32, &api);
-
     bool tmpBool = false;
-    SAFE_PARCEL(input.readBool, &tmpBool);
-    if (tmpBool) {
-        sidebandStream = NativeHandle::create(input.readNativeHandle(), true);
-    }
-
-    SAFE_PARCEL(input.read, &colorTransform, 16 * sizeof(float));
-    SAFE_PARCEL(input.readFloat, &cornerRadius);
-    SAFE_PARCEL(input.readUint32, &backgroundBlurRadius);
-    SAFE_PARCEL(input.readParcelable, &metadata);
-
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    bgColor.r = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    bgColor.g = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    bgColor.b = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    bgColor.a = tmpFloat;
-    SAFE_PARCEL(input.readUint32, &tmpUint32);
-    bgColorDataspace = static_cast<ui::Dataspace>(tmpUint32);
-    SAFE_PARCEL(input.readBool, &colorSpaceAgnostic);
-
-    int32_t numListeners = 0;
-    SAFE_PARCEL_READ_SIZE(input.readInt32, &numListeners, input.dataSize());
+
+    if (what & ePositionChanged) {
+        SAFE_PARCEL(input.readFloat, &x);
+        SAFE_PARCEL(input.readFloat, &y);
+    }
+    if (what & (eLayerChanged | eRelativeLayerChanged)) {
+        SAFE_PARCEL(input.readInt32, &z);
+    }
+    if (what & eLayerStackChanged) {
+        SAFE_PARCEL(input.readUint32, &layerStack.id);
+    }
+    if (what & eFlagsChanged) {
+        SAFE_PARCEL(input.readUint32, &flags);
+        SAFE_PARCEL(input.readUint32, &mask);
+    }
+    if (what & eMatrixChanged) {
+        SAFE_PARCEL(matrix.read, input);
+    }
+    if (what & eCropChanged) {
+        SAFE_PARCEL(input.read, crop);
+    }
+    if (what & eRelativeLayerChanged) {
+        SAFE_PARCEL(SurfaceControl::readNullableFromParcel, input, &relativeLayerSurfaceControl);
+    }
+    if (what & eReparent) {
+        SAFE_PARCEL(SurfaceControl::readNullableFromParcel, input, &parentSurfaceControlForChild);
+    }
+    if (what & eColorChanged) {
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        color.r = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        color.g = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        color.b = tmpFloat;
+    }
+    if (what & eAlphaChanged) {
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        color.a = tmpFloat;
+    }
+    if (what & eInputInfoChanged) {
+        SAFE_PARCEL(windowInfoHandle->readFromParcel, &input);
+    }
+    if (what & eTransparentRegionChanged) {
+        SAFE_PARCEL(input.read, transparentRegion);
+    }
+    if (what & eBufferTransformChanged) {
+        SAFE_PARCEL(input.readUint32, &bufferTransform);
+    }
+    if (what & eTransformToDisplayInverseChanged) {
+        SAFE_PARCEL(input.readBool, &transformToDisplayInverse);
+    }
+    if (what & eRenderBorderChanged) {
+        SAFE_PARCEL(input.readBool, &borderEnabled);
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        borderWidth = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        borderColor.r = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        borderColor.g = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        borderColor.b = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        borderColor.a = tmpFloat;
+    }
+    if (what & eDataspaceChanged) {
+        SAFE_PARCEL(input.readUint32, &tmpUint32);
+        dataspace = static_cast<ui::Dataspace>(tmpUint32);
+    }
+    if (what & eHdrMetadataChanged) {
+        SAFE_PARCEL(input.read, hdrMetadata);
+    }
+    if (what & eSurfaceDamageRegionChanged) {
+        SAFE_PARCEL(input.read, surfaceDamageRegion);
+    }
+    if (what & eApiChanged) {
+        SAFE_PARCEL(input.readInt32, &api);
+    }
+    if (what & eSidebandStreamChanged) {
+        SAFE_PARCEL(input.readBool, &tmpBool);
+        if (tmpBool) {
+            sidebandStream = NativeHandle::create(input.readNativeHandle(), true);
+        }
+    }
+    if (what & eColorTransformChanged) {
+        SAFE_PARCEL(input.read, &colorTransform, 16 * sizeof(float));
+    }
+    if (what & eCornerRadiusChanged) {
+        SAFE_PARCEL(input.readFloat, &cornerRadius);
+    }
+    if (what & eBackgroundBlurRadiusChanged) {
+        SAFE_PARCEL(input.readUint32, &backgroundBlurRadius);
+    }
+    if (what & eMetadataChanged) {
+        SAFE_PARCEL(input.readParcelable, &metadata);
+    }
+    if (what & eBackgroundColorChanged) {
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        bgColor.r = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        bgColor.g = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        bgColor.b = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        bgColor.a = tmpFloat;
+        SAFE_PARCEL(input.readUint32, &tmpUint32);
+        bgColorDataspace = static_cast<ui::Dataspace>(tmpUint32);
+    }
+    if (what & eColorSpaceAgnosticChanged) {
+        SAFE_PARCEL(input.readBool, &colorSpaceAgnostic);
+    }
     listeners.clear();
-    for (int i = 0; i < numListeners; i++) {
-        sp<IBinder> listener;
-        std::vector<CallbackId> callbackIds;
-        SAFE_PARCEL(input.readNullableStrongBinder, &listener);
-        SAFE_PARCEL(input.readParcelableVector, &callbackIds);
-        listeners.emplace_back(listener, callbackIds);
-    }
-    SAFE_PARCEL(input.readFloat, &shadowRadius);
-    SAFE_PARCEL(input.readInt32, &frameRateSelectionPriority);
-    SAFE_PARCEL(input.readFloat, &frameRate);
-    SAFE_PARCEL(input.readByte, &frameRateCompatibility);
-    SAFE_PARCEL(input.readByte, &changeFrameRateStrategy);
-    SAFE_PARCEL(input.readByte, &defaultFrameRateCompatibility);
-    SAFE_PARCEL(input.readByte, &frameRateCategory);
-    SAFE_PARCEL(input.readBool, &frameRateCategorySmoothSwitchOnly);
-    SAFE_PARCEL(input.readByte, &frameRateSelectionStrategy);
-    SAFE_PARCEL(input.readUint32, &tmpUint32);
-    fixedTransformHint = static_cast<ui::Transform::RotationFlags>(tmpUint32);
-    SAFE_PARCEL(input.readBool, &autoRefresh);
-    SAFE_PARCEL(input.readBool, &dimmingEnabled);
-
-    uint32_t numRegions = 0;
-    SAFE_PARCEL(input.readUint32, &numRegions);
+    if (what & eHasListenerCallbacksChanged) {
+        int32_t numListeners = 0;
+        SAFE_PARCEL_READ_SIZE(input.readInt32, &numListeners, input.dataSize());
+        for (int i = 0; i < numListeners; i++) {
+            sp<IBinder> listener;
+            std::vector<CallbackId> callbackIds;
+            SAFE_PARCEL(input.readNullableStrongBinder, &listener);
+            SAFE_PARCEL(input.readParcelableVector, &callbackIds);
+            listeners.emplace_back(listener, callbackIds);
+        }
+    }
+    if (what & eShadowRadiusChanged) {
+        SAFE_PARCEL(input.readFloat, &shadowRadius);
+    }
+    if (what & eFrameRateSelectionPriority) {
+        SAFE_PARCEL(input.readInt32, &frameRateSelectionPriority);
+    }
+    if (what & eFrameRateChanged) {
+        SAFE_PARCEL(input.readFloat, &frameRate);
+        SAFE_PARCEL(input.readByte, &frameRateCompatibility);
+        SAFE_PARCEL(input.readByte, &changeFrameRateStrategy);
+    }
+    if (what & eDefaultFrameRateCompatibilityChanged) {
+        SAFE_PARCEL(input.readByte, &defaultFrameRateCompatibility);
+    }
+    if (what & eFrameRateCategoryChanged) {
+        SAFE_PARCEL(input.readByte, &frameRateCategory);
+        SAFE_PARCEL(input.readBool, &frameRateCategorySmoothSwitchOnly);
+    }
+    if (what & eFrameRateSelectionStrategyChanged) {
+        SAFE_PARCEL(input.readByte, &frameRateSelectionStrategy);
+    }
+    if (what & eFixedTransformHintChanged) {
+        SAFE_PARCEL(input.readUint32, &tmpUint32);
+        fixedTransformHint = static_cast<ui::Transform::RotationFlags>(tmpUint32);
+    }
+    if (what & eAutoRefreshChanged) {
+        SAFE_PARCEL(input.readBool, &autoRefresh);
+    }
+    if (what & eDimmingEnabledChanged) {
+        SAFE_PARCEL(input.readBool, &dimmingEnabled);
+    }
     blurRegions.clear();
-    for (uint32_t i = 0; i < numRegions; i++) {
-        BlurRegion region;
-        SAFE_PARCEL(input.readUint32, &region.blurRadius);
-        SAFE_PARCEL(input.readFloat, &region.cornerRadiusTL);
-        SAFE_PARCEL(input.readFloat, &region.cornerRadiusTR);
-        SAFE_PARCEL(input.readFloat, &region.cornerRadiusBL);
-        SAFE_PARCEL(input.readFloat, &region.cornerRadiusBR);
-        SAFE_PARCEL(input.readFloat, &region.alpha);
-        SAFE_PARCEL(input.readInt32, &region.left);
-        SAFE_PARCEL(input.readInt32, &region.top);
-        SAFE_PARCEL(input.readInt32, &region.right);
-        SAFE_PARCEL(input.readInt32, &region.bottom);
-        blurRegions.push_back(region);
-    }
-
-    SAFE_PARCEL(input.read, stretchEffect);
-    SAFE_PARCEL(input.read, bufferCrop);
-    SAFE_PARCEL(input.read, destinationFrame);
-    SAFE_PARCEL(input.readBool, &isTrustedOverlay);
-
-    uint32_t mode;
-    SAFE_PARCEL(input.readUint32, &mode);
-    dropInputMode = static_cast<gui::DropInputMode>(mode);
-
-    bool hasBufferData;
-    SAFE_PARCEL(input.readBool, &hasBufferData);
-    if (hasBufferData) {
-        bufferData = std::make_shared<BufferData>();
-        SAFE_PARCEL(input.readParcelable, bufferData.get());
-    } else {
-        bufferData = nullptr;
+    if (what & eBlurRegionsChanged) {
+        uint32_t numRegions = 0;
+        SAFE_PARCEL(input.readUint32, &numRegions);
+        for (uint32_t i = 0; i < numRegions; i++) {
+            BlurRegion region;
+            SAFE_PARCEL(input.readUint32, &region.blurRadius);
+            SAFE_PARCEL(input.readFloat, &region.cornerRadiusTL);
+            SAFE_PARCEL(input.readFloat, &region.cornerRadiusTR);
+            SAFE_PARCEL(input.readFloat, &region.cornerRadiusBL);
+            SAFE_PARCEL(input.readFloat, &region.cornerRadiusBR);
+            SAFE_PARCEL(input.readFloat, &region.alpha);
+            SAFE_PARCEL(input.readInt32, &region.left);
+            SAFE_PARCEL(input.readInt32, &region.top);
+            SAFE_PARCEL(input.readInt32, &region.right);
+            SAFE_PARCEL(input.readInt32, &region.bottom);
+            blurRegions.push_back(region);
+        }
+    }
+    if (what & eStretchChanged) {
+        SAFE_PARCEL(input.read, stretchEffect);
+    }
+    if (what & eBufferCropChanged) {
+        SAFE_PARCEL(input.read, bufferCrop);
+    }
+    if (what & eDestinationFrameChanged) {
+        SAFE_PARCEL(input.read, destinationFrame);
+    }
+    if (what & eTrustedOverlayChanged) {
+        SAFE_PARCEL(input.readBool, &isTrustedOverlay);
+    }
+    if (what & eDropInputModeChanged) {
+        uint32_t mode;
+        SAFE_PARCEL(input.readUint32, &mode);
+        dropInputMode = static_cast<gui::DropInputMode>(mode);
+    }
+    bufferData = nullptr;
+    if (what & eBufferChanged) {
+        bool hasBufferData;
+        SAFE_PARCEL(input.readBool, &hasBufferData);
+        if (hasBufferData) {
+            bufferData = std::make_shared<BufferData>();
+            SAFE_PARCEL(input.readParcelable, bufferData.get());
+        }
+    }
+    if (what & eTrustedPresentationInfoChanged) {
+        SAFE_PARCEL(input.readParcelable, &trustedPresentationThresholds);
+        SAFE_PARCEL(input.readParcelable, &trustedPresentationListener);
+    }
+    if (what & eExtendedRangeBrightnessChanged) {
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        currentHdrSdrRatio = tmpFloat;
+        SAFE_PARCEL(input.readFloat, &tmpFloat);
+        desiredHdrSdrRatio = tmpFloat;
+    }
+    if (what & eCachingHintChanged) {
+        int32_t tmpInt32;
+        SAFE_PARCEL(input.readInt32, &tmpInt32);
+        cachingHint = static_cast<gui::CachingHint>(tmpInt32);
     }
-
-    SAFE_PARCEL(input.readParcelable, &trustedPresentationThresholds);
-    SAFE_PARCEL(input.readParcelable, &trustedPresentationListener);
-
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    currentHdrSdrRatio = tmpFloat;
-    SAFE_PARCEL(input.readFloat, &tmpFloat);
-    desiredHdrSdrRatio = tmpFloat;
-
-    int32_t tmpInt32;
-    SAFE_PARCEL(input.readInt32, &tmpInt32);
-    cachingHint = static_cast<gui::CachingHint>(tmpInt32);
 
     return NO_ERROR;
 }
@@ -28,6 +28,16 @@ namespace android::gui {
 
 namespace {
 
+// flat_binder_object and the stability written after it. Binders in RPC
+// parcels are smaller.
+constexpr size_t kBinderSizeHint = 24 + sizeof(int32_t);
+
+// Upper bound for writeUtf8AsUtf16, which writes at most one UTF-16 code unit
+// per UTF-8 byte.
+size_t utf16SizeHint(const std::string& str) {
+    return sizeof(int32_t) + (((str.size() + 1) * sizeof(char16_t) + 3) & ~size_t(3));
+}
+
 std::ostream& operator<<(std::ostream& out, const sp<IBinder>& binder) {
     if (binder == nullptr) {
         out << "<null>";
@@ -112,6 +122,22 @@ bool WindowInfo::operator==(const WindowInfo& info) const {
             info.layoutParamsFlags == layoutParamsFlags;
 }
 
+size_t WindowInfo::getParcelSizeHint() const {
+    if (name.empty()) {
+        return sizeof(int32_t);
+    }
+    // token, touchableRegionCropHandle, windowToken and focusTransferTarget
+    size_t binders = 4 * kBinderSizeHint;
+    // from id to replaceTouchableRegionWithCrop, except the frame
+    size_t fields = sizeof(int64_t) + 20 * sizeof(int32_t) + sizeof(Rect);
+    // size header, token, name and timeout
+    size_t applicationInfoSize = sizeof(int32_t) + kBinderSizeHint +
+            utf16SizeHint(applicationInfo.name) + sizeof(int64_t);
+    size_t regionSize = sizeof(int32_t) + ((touchableRegion.getFlattenedSize() + 3) & ~size_t(3));
+    return sizeof(int32_t) + binders + fields + utf16SizeHint(name) +
+            utf16SizeHint(packageName) + applicationInfoSize + regionSize;
+}
+
 status_t WindowInfo::writeToParcel(android::Parcel* parcel) const {
     if (parcel == nullptr) {
         ALOGE("%s: Null parcel", __func__);
@@ -47,12 +47,26 @@ status_t WindowInfosUpdate::readFromParcel(const android::Parcel* parcel) {
     return OK;
 }
 
+size_t WindowInfosUpdate::getParcelSizeHint() const {
+    size_t size = 2 * sizeof(uint32_t) + 2 * sizeof(int64_t);
+    for (auto& windowInfo : windowInfos) {
+        size += windowInfo.getParcelSizeHint();
+    }
+    for (auto& displayInfo : displayInfos) {
+        size += displayInfo.getParcelSizeHint();
+    }
+    return size;
+}
+
 status_t WindowInfosUpdate::writeToParcel(android::Parcel* parcel) const {
     if (parcel == nullptr) {
         ALOGE("%s: Null parcel", __func__);
         return BAD_VALUE;
     }
 
+    // only an optimization, errors are noticed by the writes
+    (void)parcel->reserve(getParcelSizeHint());
+
     SAFE_PARCEL(parcel->writeUint32, static_cast<uint32_t>(windowInfos.size()));
     for (auto& windowInfo : windowInfos) {
         SAFE_PARCEL(windowInfo.writeToParcel, parcel);
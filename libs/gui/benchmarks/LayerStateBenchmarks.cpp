@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+#include <vector>
+
+using namespace android;
+
+// Usage: atest libgui_benchmarks
+
+// Layers changed by a typical animation frame, e.g. a window moving and fading in.
+static std::vector<ComposerState> makeAnimationStates(size_t numLayers) {
+    std::vector<ComposerState> states(numLayers);
+    for (size_t i = 0; i < numLayers; i++) {
+        layer_state_t& s = states[i].state;
+        s.surface = sp<BBinder>::make();
+        s.layerId = static_cast<int32_t>(i);
+        s.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged;
+        s.x = 10.f * i;
+        s.y = 20.f * i;
+        s.color.a = 0.5f;
+    }
+    return states;
+}
+
+static void BM_writeAnimationTransaction(benchmark::State& state) {
+    const std::vector<ComposerState> states = makeAnimationStates(state.range(0));
+    Parcel p;
+    for (auto _ : state) {
+        p.setDataSize(0);
+        for (const auto& s : states) {
+            s.write(p);
+        }
+        benchmark::DoNotOptimize(p.data());
+    }
+    state.counters["bytes"] = p.dataSize();
+    state.counters["bytes/layer"] = double(p.dataSize()) / states.size();
+}
+BENCHMARK(BM_writeAnimationTransaction)->Arg(1)->Arg(8)->Arg(64);
+
+static void BM_readAnimationTransaction(benchmark::State& state) {
+    const std::vector<ComposerState> states = makeAnimationStates(state.range(0));
+    Parcel p;
+    for (const auto& s : states) {
+        s.write(p);
+    }
+    for (auto _ : state) {
+        p.setDataPosition(0);
+        for (size_t i = 0; i < states.size(); i++) {
+            ComposerState s;
+            s.read(p);
+            benchmark::DoNotOptimize(s);
+        }
+    }
+    state.counters["bytes"] = p.dataSize();
+}
+BENCHMARK(BM_readAnimationTransaction)->Arg(1)->Arg(8)->Arg(64);
+
+BENCHMARK_MAIN();
@@ -38,6 +38,8 @@ struct DisplayInfo : public Parcelable {
     // The display transform. This takes display coordinates to logical display coordinates.
     ui::Transform transform;
 
+    size_t getParcelSizeHint() const;
+
     status_t writeToParcel(android::Parcel*) const override;
 
     status_t readFromParcel(const android::Parcel*) override;
@@ -262,6 +262,9 @@ struct WindowInfo : public Parcelable {
 
     bool operator==(const WindowInfo& inputChannel) const;
 
+    // Upper bound of the bytes writeToParcel writes, see Parcel::reserve.
+    size_t getParcelSizeHint() const;
+
     status_t writeToParcel(android::Parcel* parcel) const override;
 
     status_t readFromParcel(const android::Parcel* parcel) override;
@@ -37,6 +37,7 @@ struct WindowInfosUpdate : public Parcelable {
     int64_t vsyncId;
     int64_t timestamp;
 
+    size_t getParcelSizeHint() const;
     status_t writeToParcel(android::Parcel*) const override;
     status_t readFromParcel(const android::Parcel*) override;
 };
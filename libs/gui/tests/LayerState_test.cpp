@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+
+#include <gui/LayerState.h>
+
+namespace android {
+
+namespace test {
+
+static layer_state_t parcelAndUnparcel(const layer_state_t& state, size_t* outSize = nullptr) {
+    Parcel p;
+    EXPECT_EQ(OK, state.write(p));
+    if (outSize) *outSize = p.dataSize();
+    p.setDataPosition(0);
+
+    layer_state_t result;
+    EXPECT_EQ(OK, result.read(p));
+    EXPECT_EQ(p.dataPosition(), p.dataSize());
+    return result;
+}
+
+TEST(LayerState, ParcellingOnlyWritesChangedFields) {
+    layer_state_t state;
+    state.surface = sp<BBinder>::make();
+    state.layerId = 42;
+    state.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged;
+    state.x = 10.5f;
+    state.y = -3.f;
+    state.color.a = 0.25f;
+    // not selected by 'what', so not parceled
+    state.cornerRadius = 8.f;
+    state.crop = Rect(1, 2, 3, 4);
+
+    size_t size = 0;
+    layer_state_t result = parcelAndUnparcel(state, &size);
+    EXPECT_EQ(state.surface, result.surface);
+    EXPECT_EQ(42, result.layerId);
+    EXPECT_EQ(state.what, result.what);
+    EXPECT_EQ(10.5f, result.x);
+    EXPECT_EQ(-3.f, result.y);
+    EXPECT_EQ(0.25f, result.color.a);
+    EXPECT_EQ(layer_state_t().cornerRadius, result.cornerRadius);
+    EXPECT_EQ(layer_state_t().crop, result.crop);
+
+    // header, position and alpha
+    layer_state_t empty;
+    empty.surface = state.surface;
+    size_t emptySize = 0;
+    parcelAndUnparcel(empty, &emptySize);
+    EXPECT_EQ(emptySize + 3 * sizeof(float), size);
+}
+
+TEST(LayerState, ParcellingChangedFields) {
+    layer_state_t state;
+    state.what = layer_state_t::eLayerChanged | layer_state_t::eFlagsChanged |
+            layer_state_t::eMatrixChanged | layer_state_t::eCropChanged |
+            layer_state_t::eColorChanged | layer_state_t::eCornerRadiusChanged |
+            layer_state_t::eBlurRegionsChanged | layer_state_t::eFrameRateChanged |
+            layer_state_t::eCachingHintChanged;
+    state.z = 7;
+    state.flags = layer_state_t::eLayerHidden;
+    state.mask = layer_state_t::eLayerHidden | layer_state_t::eLayerOpaque;
+    state.matrix.dsdx = 2.f;
+    state.crop = Rect(1, 2, 3, 4);
+    state.color.rgb = half3(0.1f, 0.2f, 0.3f);
+    state.cornerRadius = 8.f;
+    BlurRegion region;
+    region.blurRadius = 5;
+    region.alpha = 0.5f;
+    region.right = 100;
+    state.blurRegions.push_back(region);
+    state.frameRate = 60.f;
+    state.frameRateCompatibility = ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_FIXED_SOURCE;
+    state.cachingHint = gui::CachingHint::Disabled;
+
+    layer_state_t result = parcelAndUnparcel(state);
+    EXPECT_EQ(state.what, result.what);
+    EXPECT_EQ(7, result.z);
+    EXPECT_EQ(state.flags, result.flags);
+    EXPECT_EQ(state.mask, result.mask);
+    EXPECT_EQ(state.matrix, result.matrix);
+    EXPECT_EQ(state.crop, result.crop);
+    EXPECT_EQ(state.color.rgb, result.color.rgb);
+    EXPECT_EQ(state.cornerRadius, result.cornerRadius);
+    ASSERT_EQ(1u, result.blurRegions.size());
+    EXPECT_EQ(region.blurRadius, result.blurRegions[0].blurRadius);
+    EXPECT_EQ(region.alpha, result.blurRegions[0].alpha);
+    EXPECT_EQ(region.right, result.blurRegions[0].right);
+    EXPECT_EQ(state.frameRate, result.frameRate);
+    EXPECT_EQ(state.frameRateCompatibility, result.frameRateCompatibility);
+    EXPECT_EQ(state.cachingHint, result.cachingHint);
+}
+
+} // namespace test
+} // namespace android
@@ -102,6 +102,30 @@ TEST(WindowInfo, Parcelling) {
     ASSERT_EQ(i.focusTransferTarget, i2.focusTransferTarget);
 }
 
+TEST(WindowInfo, ParcelSizeHintIsUpperBound) {
+    WindowInfo i;
+    {
+        Parcel p;
+        ASSERT_EQ(OK, i.writeToParcel(&p));
+        EXPECT_LE(p.dataSize(), i.getParcelSizeHint());
+    }
+
+    i.token = new BBinder();
+    i.windowToken = new BBinder();
+    i.name = "Foobar\u00e9\u4e2d";
+    i.packageName = "com.example.package";
+    i.touchableRegion = Region(Rect(0, 0, 10, 10));
+    i.touchableRegion.orSelf(Rect(20, 20, 30, 40));
+    i.touchableRegionCropHandle = new BBinder();
+    i.applicationInfo.name = "ApplicationFooBar";
+    i.applicationInfo.token = new BBinder();
+    i.focusTransferTarget = new BBinder();
+
+    Parcel p;
+    ASSERT_EQ(OK, i.writeToParcel(&p));
+    EXPECT_LE(p.dataSize(), i.getParcelSizeHint());
+}
+
 TEST(InputApplicationInfo, Parcelling) {
     InputApplicationInfo i;
     i.token = new BBinder();
@@ -19,6 +19,8 @@
 #include <inttypes.h>
 #include <limits.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 
 #include <utils/Log.h>
@@ -764,6 +766,33 @@ void Region::boolean_operation(uint32_t op, Region& dst,
         return;
     }
 
+    // Intersecting or subtracting two plain rects is common (e.g. clipping a layer to the
+    // display) and doesn't need the rasterizer.
+    if ((op == op_and || op == op_nand) && lhs.isRect() && lhs.getBounds().isValid() &&
+        rhs.isValid()) {
+        const Rect lhsRect = lhs.getBounds();
+        Rect rhsRect = rhs;
+        rhsRect.offsetBy(dx, dy);
+        Rect overlap;
+        const bool overlaps = lhsRect.intersect(rhsRect, &overlap);
+        if (op == op_and) {
+            if (overlaps) {
+                dst.set(overlap);
+            } else {
+                dst.clear();
+            }
+            return;
+        }
+        if (overlaps && overlap == lhsRect) {
+            dst.clear();
+            return;
+        }
+        if (!overlaps && !lhsRect.isEmpty()) {
+            dst.set(lhsRect);
+            return;
+        }
+    }
+
 #if VALIDATE_WITH_CORECG || defined(VALIDATE_REGIONS)
     boolean_operation(op, dst, lhs, Region(rhs), dx, dy);
 #else
@@ -793,6 +822,103 @@ void Region::boolean_operation(uint32_t op, Region& dst,
     boolean_operation(op, dst, lhs, rhs, 0, 0);
 }
 
+template <typename GetRegion>
+Region Region::createUnion(size_t count, GetRegion getRegion) {
+    // The next band of each region that has not been fully swept yet.
+    struct Cursor {
+        const Rect* band;
+        const Rect* end;
+    };
+    // The horizontal extent of one rect.
+    struct Column {
+        int32_t left;
+        int32_t right;
+    };
+
+    FatVector<Cursor, 16> cursors;
+    const Region* nonEmpty = nullptr;
+    int32_t y = INT_MAX;
+    for (size_t i = 0; i < count; i++) {
+        const Region& region = getRegion(i);
+        if (!region.isEmpty()) {
+            cursors.push_back({region.begin(), region.end()});
+            nonEmpty = &region;
+            y = std::min(y, region.begin()->top);
+        }
+    }
+    if (cursors.empty()) {
+        return Region();
+    }
+    if (cursors.size() == 1) {
+        return *nonEmpty;
+    }
+
+    Region result;
+    { // scope for rasterizer (dtor has side effects)
+        rasterizer r(result);
+        FatVector<Column, 32> columns;
+        while (!cursors.empty()) {
+            // Collect the columns of every band that covers y. The next event is where the first
+            // of these bands ends, or where the first band below y starts.
+            int32_t nextY = INT_MAX;
+            columns.clear();
+            for (const Cursor& cursor : cursors) {
+                if (cursor.band->top > y) {
+                    nextY = std::min(nextY, cursor.band->top);
+                    continue;
+                }
+                nextY = std::min(nextY, cursor.band->bottom);
+                for (const Rect* rect = cursor.band;
+                     rect != cursor.end && rect->top == cursor.band->top; rect++) {
+                    columns.push_back({rect->left, rect->right});
+                }
+            }
+
+            std::sort(columns.begin(), columns.end(),
+                      [](const Column& lhs, const Column& rhs) { return lhs.left < rhs.left; });
+            for (size_t i = 0; i < columns.size();) {
+                const int32_t left = columns[i].left;
+                int32_t right = columns[i].right;
+                for (i++; i < columns.size() && columns[i].left <= right; i++) {
+                    right = std::max(right, columns[i].right);
+                }
+                r(Rect(left, y, right, nextY));
+            }
+
+            // Move every cursor whose band ends here on to its next band.
+            for (size_t i = 0; i < cursors.size();) {
+                Cursor& cursor = cursors[i];
+                if (cursor.band->top <= y && cursor.band->bottom == nextY) {
+                    const int32_t top = cursor.band->top;
+                    while (cursor.band != cursor.end && cursor.band->top == top) {
+                        cursor.band++;
+                    }
+                    if (cursor.band == cursor.end) {
+                        cursor = cursors.back();
+                        cursors.pop_back();
+                        continue;
+                    }
+                }
+                i++;
+            }
+            y = nextY;
+        }
+    }
+
+#if defined(VALIDATE_REGIONS)
+    validate(result, "createUnion");
+#endif
+    return result;
+}
+
+Region Region::createUnion(const Region* regions, size_t count) {
+    return createUnion(count, [regions](size_t i) -> const Region& { return regions[i]; });
+}
+
+Region Region::createUnion(const Region* const* regions, size_t count) {
+    return createUnion(count, [regions](size_t i) -> const Region& { return *regions[i]; });
+}
+
 void Region::translate(Region& reg, int dx, int dy)
 {
     if ((dx || dy) && !reg.isEmpty()) {
@@ -46,6 +46,12 @@ public:
 
     static  Region      createTJunctionFreeRegion(const Region& r);
 
+    // Returns the union of |count| regions. All of the regions are swept together in a single
+    // pass, which is much cheaper than folding them in with one orSelf() call each. No memory is
+    // allocated besides the result's storage unless the regions are very complex.
+    static  Region      createUnion(const Region* regions, size_t count);
+    static  Region      createUnion(const Region* const* regions, size_t count);
+
         Region& operator = (const Region& rhs);
 
     inline  bool        isEmpty() const     { return getBounds().isEmpty(); }
@@ -171,6 +177,9 @@ private:
     static void boolean_operation(uint32_t op, Region& dst,
             const Region& lhs, const Rect& rhs);
 
+    template <typename GetRegion>
+    static Region createUnion(size_t count, GetRegion getRegion);
+
     static void translate(Region& reg, int dx, int dy);
     static void translate(Region& dst, const Region& reg, int dx, int dy);
 
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+namespace android {
+namespace {
+
+const Rect kDisplay(0, 0, 1080, 2400);
+const Rect kStatusBar(0, 0, 1080, 100);
+const Rect kNavigationBar(0, 2270, 1080, 2400);
+
+// |count| icon sized rects laid out in a grid, like a launcher page or a list of notifications.
+std::vector<Region> makeGrid(int count) {
+    constexpr int32_t kSize = 180;
+    constexpr int32_t kColumns = 6;
+    std::vector<Region> regions;
+    regions.reserve(static_cast<size_t>(count));
+    for (int i = 0; i < count; i++) {
+        const int32_t left = (i % kColumns) * kSize;
+        const int32_t top = kStatusBar.bottom + ((i / kColumns) % 12) * kSize;
+        regions.emplace_back(Rect(left, top, left + kSize - 20, top + kSize - 20));
+    }
+    return regions;
+}
+
+// A fullscreen layer with the system bars and a rounded-corner-like notch taken out of it, which
+// is typical for a visible region.
+Region makeVisibleRegion() {
+    Region region(kDisplay);
+    region.subtractSelf(kStatusBar);
+    region.subtractSelf(kNavigationBar);
+    region.subtractSelf(Rect(440, 100, 640, 160));
+    return region;
+}
+
+void BM_UnionFolded(benchmark::State& state) {
+    const std::vector<Region> regions = makeGrid(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        Region result;
+        for (const Region& region : regions) {
+            result.orSelf(region);
+        }
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_UnionFolded)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_CreateUnion(benchmark::State& state) {
+    const std::vector<Region> regions = makeGrid(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        Region result = Region::createUnion(regions.data(), regions.size());
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_CreateUnion)->Arg(4)->Arg(16)->Arg(64);
+
+void BM_ClipRectToDisplay(benchmark::State& state) {
+    const Region layer(Rect(-100, 200, 900, 2600));
+    for (auto _ : state) {
+        Region result = layer.intersect(kDisplay);
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_ClipRectToDisplay);
+
+void BM_SubtractOpaque(benchmark::State& state) {
+    const Region visible = makeVisibleRegion();
+    Region opaque;
+    for (const Region& region : makeGrid(16)) {
+        opaque.orSelf(region);
+    }
+    for (auto _ : state) {
+        Region result = visible.subtract(opaque);
+        benchmark::DoNotOptimize(result);
+    }
+}
+BENCHMARK(BM_SubtractOpaque);
+
+void BM_AccumulateDamage(benchmark::State& state) {
+    const std::vector<Region> damage = makeGrid(8);
+    const Region visible = makeVisibleRegion();
+    for (auto _ : state) {
+        Region dirty;
+        for (const Region& region : damage) {
+            dirty.orSelf(region.intersect(visible));
+        }
+        benchmark::DoNotOptimize(dirty);
+    }
+}
+BENCHMARK(BM_AccumulateDamage);
+
+void BM_Translate(benchmark::State& state) {
+    Region region;
+    for (const Region& icon : makeGrid(64)) {
+        region.orSelf(icon);
+    }
+    for (auto _ : state) {
+        region.translateSelf(1, 1);
+        region.translateSelf(-1, -1);
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_Translate);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -17,6 +17,7 @@
 #define LOG_TAG "RegionTest"
 
 #include <stdlib.h>
+#include <iterator>
 #include <ui/Region.h>
 #include <ui/Rect.h>
 #include <gtest/gtest.h>
@@ -179,5 +180,103 @@ TEST_F(RegionTest, RegionHash) {
     EXPECT_NE(std::hash<Region>{}(region1), std::hash<Region>{}(region2));
 }
 
+TEST_F(RegionTest, CreateUnion_Empty) {
+    EXPECT_TRUE(Region::createUnion(static_cast<const Region*>(nullptr), 0).isEmpty());
+
+    const Region regions[] = {Region(), Region()};
+    EXPECT_TRUE(Region::createUnion(regions, 2).isEmpty());
+}
+
+TEST_F(RegionTest, CreateUnion_Single) {
+    Region r;
+    r.orSelf(Rect(0, 0, 10, 10));
+    r.orSelf(Rect(20, 20, 30, 30));
+
+    const Region regions[] = {Region(), r, Region()};
+    EXPECT_TRUE(Region::createUnion(regions, 3).hasSameRects(r));
+}
+
+TEST_F(RegionTest, CreateUnion_MergesAdjacentRects) {
+    // Four quadrants make up one rect.
+    const Region regions[] = {Region(Rect(0, 0, 50, 50)), Region(Rect(50, 0, 100, 50)),
+                              Region(Rect(0, 50, 50, 100)), Region(Rect(50, 50, 100, 100))};
+    const Region result = Region::createUnion(regions, 4);
+
+    EXPECT_TRUE(result.isRect());
+    EXPECT_EQ(Rect(0, 0, 100, 100), result.getBounds());
+}
+
+TEST_F(RegionTest, CreateUnion_AcceptsPointers) {
+    const Region a(Rect(0, 0, 10, 10));
+    const Region b(Rect(5, 5, 15, 15));
+    const Region* regions[] = {&a, &b};
+
+    EXPECT_TRUE(Region::createUnion(regions, 2).hasSameRects(a.merge(b)));
+}
+
+TEST_F(RegionTest, Random_CreateUnion) {
+    srandom(12345);
+
+    for (int iter = 0; iter < ITER_MAX; iter++) {
+        Region regions[8];
+        Region expected;
+        for (Region& region : regions) {
+            for (int i = 0; i < X_MAX; i++) {
+                const int32_t left = static_cast<int32_t>(random() % 100);
+                const int32_t top = static_cast<int32_t>(random() % 100);
+                const Rect rect(left, top, left + static_cast<int32_t>(random() % 50),
+                                top + static_cast<int32_t>(random() % 50));
+                if (random() % 4) {
+                    region.orSelf(rect);
+                } else {
+                    region.subtractSelf(rect);
+                }
+            }
+            expected.orSelf(region);
+        }
+
+        const Region result = Region::createUnion(regions, std::size(regions));
+        if (expected.isEmpty()) {
+            EXPECT_TRUE(result.isEmpty());
+        } else {
+            EXPECT_TRUE(result.hasSameRects(expected));
+            EXPECT_EQ(expected.getBounds(), result.getBounds());
+        }
+    }
+}
+
+TEST_F(RegionTest, IntersectRect) {
+    const Region r(Rect(0, 0, 100, 100));
+
+    EXPECT_EQ(Rect(50, 50, 100, 100), r.intersect(Rect(50, 50, 150, 150)).getBounds());
+    EXPECT_TRUE(r.intersect(Rect(100, 0, 200, 100)).isEmpty());
+}
+
+TEST_F(RegionTest, SubtractRect) {
+    const Region r(Rect(0, 0, 100, 100));
+
+    EXPECT_TRUE(r.subtract(Rect(-10, -10, 110, 110)).isEmpty());
+    EXPECT_TRUE(r.subtract(Rect(100, 0, 200, 100)).hasSameRects(r));
+
+    const Region remaining = r.subtract(Rect(0, 0, 100, 50));
+    EXPECT_TRUE(remaining.isRect());
+    EXPECT_EQ(Rect(0, 50, 100, 100), remaining.getBounds());
+}
+
+TEST_F(RegionTest, TranslateKeepsShape) {
+    Region r;
+    r.orSelf(Rect(0, 0, 10, 10));
+    r.orSelf(Rect(20, 0, 30, 10));
+    r.orSelf(Rect(0, 20, 30, 30));
+
+    const Region translated = r.translate(5, -5);
+    Region expected;
+    expected.orSelf(Rect(5, -5, 15, 5));
+    expected.orSelf(Rect(25, -5, 35, 5));
+    expected.orSelf(Rect(5, 15, 35, 25));
+    EXPECT_TRUE(translated.hasSameRects(expected));
+    EXPECT_EQ(Rect(5, -5, 35, 25), translated.getBounds());
+}
+
 }; // namespace android
 
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+
+#include <benchmark/benchmark.h>
+#include <gmock/gmock.h>
+
+#include <compositionengine/CompositionRefreshArgs.h>
+#include <compositionengine/impl/CompositionEngine.h>
+#include <compositionengine/impl/OutputCompositionState.h>
+#include <compositionengine/mock/Output.h>
+#include <ftl/future.h>
+
+namespace android::compositionengine {
+namespace {
+
+using namespace std::chrono_literals;
+using testing::_;
+using testing::Invoke;
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+
+void spinFor(std::chrono::microseconds duration) {
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+// An output whose composition stages take a fixed amount of CPU time. The costs roughly follow a
+// trace of a busy display: most of the time goes into preparing and updating the composition
+// state, and a smaller part into the stages that must stay serialized.
+class TimedOutput {
+public:
+    static constexpr auto kPrepareTime = 300us;
+    static constexpr auto kUpdateAndWriteTime = 500us;
+    static constexpr auto kPresentTime = 200us;
+
+    TimedOutput() {
+        mState.isEnabled = true;
+        ON_CALL(*mOutput, getDisplayId()).WillByDefault(Return(std::nullopt));
+        ON_CALL(*mOutput, getState()).WillByDefault(ReturnRef(mState));
+        ON_CALL(*mOutput, prepare(_, _)).WillByDefault(Invoke([](auto&, auto&) {
+            spinFor(kPrepareTime);
+        }));
+        ON_CALL(*mOutput, updateAndWriteCompositionState(_)).WillByDefault(Invoke([this](auto&) {
+            spinFor(kUpdateAndWriteTime);
+            mCompositionStateWritten = true;
+        }));
+        ON_CALL(*mOutput, present(_)).WillByDefault(Invoke([this](auto&) {
+            // Like impl::Output, present() runs the stages itself unless they already ran.
+            if (!mCompositionStateWritten) {
+                spinFor(kUpdateAndWriteTime);
+            }
+            mCompositionStateWritten = false;
+            spinFor(kPresentTime);
+            return ftl::yield<std::monostate>({});
+        }));
+    }
+
+    std::shared_ptr<mock::Output> output() const { return mOutput; }
+
+private:
+    std::shared_ptr<NiceMock<mock::Output>> mOutput = std::make_shared<NiceMock<mock::Output>>();
+    impl::OutputCompositionState mState;
+    bool mCompositionStateWritten = false;
+};
+
+void BM_PresentOutputs(benchmark::State& state) {
+    const auto outputCount = static_cast<size_t>(state.range(0));
+    const auto workerCount = static_cast<size_t>(state.range(1));
+
+    std::vector<TimedOutput> outputs(outputCount);
+    CompositionRefreshArgs refreshArgs;
+    for (const auto& output : outputs) {
+        refreshArgs.outputs.push_back(output.output());
+    }
+
+    impl::CompositionEngine engine;
+    engine.setParallelism(workerCount);
+    for (auto _ : state) {
+        engine.present(refreshArgs);
+    }
+}
+
+// Internal display only, and internal + two external + virtual displays, each composed serially
+// and on a pool with one worker fewer than there are outputs.
+BENCHMARK(BM_PresentOutputs)
+        ->Args({1, 0})
+        ->Args({4, 0})
+        ->Args({4, 3})
+        ->Unit(benchmark::kMicrosecond)
+        ->UseRealTime();
+
+} // namespace
+} // namespace android::compositionengine
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <gmock/gmock.h>
+
+#include <compositionengine/CompositionRefreshArgs.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/Output.h>
+#include <compositionengine/impl/OutputCompositionState.h>
+#include <compositionengine/mock/CompositionEngine.h>
+#include <compositionengine/mock/LayerFE.h>
+
+namespace android::compositionengine {
+namespace {
+
+using testing::NiceMock;
+using testing::Return;
+
+constexpr int32_t kDisplayWidth = 1080;
+constexpr int32_t kDisplayHeight = 2400;
+constexpr int32_t kIconSize = 180;
+
+// A launcher-like stack of layers, from bottom to top: an opaque wallpaper, a translucent
+// workspace, |iconCount| translucent icons laid out in a grid, and the status and navigation bars.
+// When |appOnTop| is set, an opaque fullscreen app is placed below the system bars, hiding the
+// whole launcher as it does right after an app is opened.
+class LauncherScene {
+public:
+    LauncherScene(int iconCount, bool appOnTop) {
+        addLayer(Rect(0, 0, kDisplayWidth, kDisplayHeight), true);
+        addLayer(Rect(0, 0, kDisplayWidth, kDisplayHeight), false);
+        constexpr int32_t kColumns = kDisplayWidth / kIconSize;
+        for (int i = 0; i < iconCount; i++) {
+            // Icons wrap back to the top once the screen is full, like pages stacked on top of
+            // each other.
+            const int32_t row = (i / kColumns) % (kDisplayHeight / kIconSize - 2);
+            const int32_t left = (i % kColumns) * kIconSize;
+            const int32_t top = kIconSize + row * kIconSize;
+            addLayer(Rect(left, top, left + kIconSize, top + kIconSize), false);
+        }
+        if (appOnTop) {
+            addLayer(Rect(0, 0, kDisplayWidth, kDisplayHeight), true);
+        }
+        addLayer(Rect(0, 0, kDisplayWidth, 100), false);
+        addLayer(Rect(0, kDisplayHeight - 130, kDisplayWidth, kDisplayHeight), false);
+
+        auto& state = mOutput->editState();
+        state.isEnabled = true;
+        state.displaySpace.setBounds(ui::Size(kDisplayWidth, kDisplayHeight));
+        state.displaySpace.setContent(Rect(0, 0, kDisplayWidth, kDisplayHeight));
+        state.layerStackSpace.setContent(Rect(0, 0, kDisplayWidth, kDisplayHeight));
+        state.transform = ui::Transform();
+    }
+
+    void rebuildLayerStacks(bool useTiles) {
+        CompositionRefreshArgs refreshArgs;
+        refreshArgs.layers = mLayers;
+        refreshArgs.updatingOutputGeometryThisFrame = true;
+        refreshArgs.cullOccludedLayersWithTiles = useTiles;
+
+        LayerFESet geomSnapshots;
+        mOutput->prepare(refreshArgs, geomSnapshots);
+    }
+
+private:
+    void addLayer(const Rect& bounds, bool opaque) {
+        auto& state = mStates.emplace_back(std::make_unique<LayerFECompositionState>());
+        state->isVisible = true;
+        state->isOpaque = opaque;
+        state->geomLayerBounds = bounds.toFloatRect();
+
+        sp<NiceMock<mock::LayerFE>> layerFE = sp<NiceMock<mock::LayerFE>>::make();
+        ON_CALL(*layerFE, getCompositionState()).WillByDefault(Return(state.get()));
+        ON_CALL(*layerFE, getDebugName()).WillByDefault(Return("layer"));
+        mLayers.push_back(layerFE);
+    }
+
+    NiceMock<mock::CompositionEngine> mCompositionEngine;
+    std::shared_ptr<impl::Output> mOutput = impl::createOutput(mCompositionEngine);
+    std::vector<std::unique_ptr<LayerFECompositionState>> mStates;
+    Layers mLayers;
+};
+
+void BM_RebuildLayerStacks(benchmark::State& state, bool appOnTop, bool useTiles) {
+    LauncherScene scene(static_cast<int>(state.range(0)), appOnTop);
+    for (auto _ : state) {
+        scene.rebuildLayerStacks(useTiles);
+    }
+}
+
+BENCHMARK_CAPTURE(BM_RebuildLayerStacks, Occluded_Region, true, false)->Arg(24)->Arg(96)->Arg(384);
+BENCHMARK_CAPTURE(BM_RebuildLayerStacks, Occluded_Tiles, true, true)->Arg(24)->Arg(96)->Arg(384);
+BENCHMARK_CAPTURE(BM_RebuildLayerStacks, Visible_Region, false, false)->Arg(24)->Arg(96)->Arg(384);
+BENCHMARK_CAPTURE(BM_RebuildLayerStacks, Visible_Tiles, false, true)->Arg(24)->Arg(96)->Arg(384);
+
+} // namespace
+} // namespace android::compositionengine
+
+BENCHMARK_MAIN();
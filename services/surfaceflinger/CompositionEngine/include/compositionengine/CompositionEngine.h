@@ -67,6 +67,10 @@ public:
     // Presents the indicated outputs
     virtual void present(CompositionRefreshArgs&) = 0;
 
+    // Sets the number of extra threads used to compose several outputs at once. Zero, the
+    // default, composes every output on the calling thread.
+    virtual void setParallelism(size_t workerCount) = 0;
+
     // Updates the cursor position for the indicated outputs.
     virtual void updateCursorAsync(CompositionRefreshArgs&) = 0;
 
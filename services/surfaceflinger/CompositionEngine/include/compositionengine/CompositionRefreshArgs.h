@@ -106,6 +106,10 @@ struct CompositionRefreshArgs {
 
     bool hasTrustedPresentationListener = false;
 
+    // If true, layers that are fully hidden behind opaque layers above them are rejected using a
+    // coarse tile mask before any Region math is done for them.
+    bool cullOccludedLayersWithTiles = true;
+
     ICEPowerCallback* powerCallback = nullptr;
 };
 
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <ui/Rect.h>
+
+namespace android {
+namespace compositionengine {
+
+// Coarse record of the parts of an area that are opaquely covered, used to reject layers that are
+// entirely occluded without any Region operations.
+//
+// The area is split into at most 64 columns of square tiles, so each row of tiles is a single
+// bitmask. A tile is only marked once one opaque rect covers all of it, which makes the mask
+// conservative: a rect that falls entirely in marked tiles is certainly covered, while anything
+// else must be checked exactly.
+class OpaqueTileMask {
+public:
+    explicit OpaqueTileMask(const Rect& bounds);
+
+    // Marks the tiles that |rect| covers completely.
+    void add(const Rect& rect);
+
+    // Returns true if every pixel of |rect| is known to be covered.
+    bool covers(const Rect& rect) const;
+
+private:
+    static constexpr int32_t kMinTileSize = 32;
+    static constexpr int32_t kMaxColumns = 64;
+
+    static uint64_t columnMask(int32_t first, int32_t end);
+
+    Rect mBounds;
+    int32_t mTileSize = kMinTileSize;
+    int32_t mColumnCount = 0;
+    // Bit c of mRows[r] is set when the tile at column c, row r is covered.
+    std::vector<uint64_t> mRows;
+};
+
+} // namespace compositionengine
+} // namespace android
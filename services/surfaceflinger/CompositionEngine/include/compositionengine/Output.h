@@ -26,6 +26,7 @@
 #include <vector>
 
 #include <compositionengine/LayerFE.h>
+#include <compositionengine/OpaqueTileMask.h>
 #include <ftl/future.h>
 #include <renderengine/LayerSettings.h>
 #include <ui/Fence.h>
@@ -157,6 +158,9 @@ public:
         // only has a value if there's something needing it, like when a TrustedPresentationListener
         // is set
         std::optional<Region> aboveCoveredLayersExcludingOverlays;
+        // Conservative tiled copy of aboveOpaqueLayers, used to reject fully occluded layers
+        // cheaply. Only has a value if tile culling is enabled for this refresh.
+        std::optional<OpaqueTileMask> aboveOpaqueTiles;
     };
 
     virtual ~Output();
@@ -264,6 +268,11 @@ public:
     // Prepare the output, updating the OutputLayers used in the output
     virtual void prepare(const CompositionRefreshArgs&, LayerFESet&) = 0;
 
+    // Runs the stages of present() up to and including writing the composition state to HWC. These
+    // only touch this output and its own HWC display, so they may run concurrently with the same
+    // stages of other outputs. The next call to present() then skips them.
+    virtual void updateAndWriteCompositionState(const CompositionRefreshArgs&) = 0;
+
     // Presents the output, finalizing all composition details. This may happen
     // asynchronously, in which case the returned future must be waited upon.
     virtual ftl::Future<std::monostate> present(const CompositionRefreshArgs&) = 0;
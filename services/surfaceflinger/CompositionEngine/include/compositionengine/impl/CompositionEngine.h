@@ -20,6 +20,8 @@
 
 namespace android::compositionengine::impl {
 
+class OutputWorkerPool;
+
 class CompositionEngine : public compositionengine::CompositionEngine {
 public:
     CompositionEngine();
@@ -43,6 +45,7 @@ public:
     nsecs_t getLastFrameRefreshTimestamp() const override;
 
     void present(CompositionRefreshArgs&) override;
+    void setParallelism(size_t workerCount) override;
 
     void updateCursorAsync(CompositionRefreshArgs&) override;
 
@@ -57,11 +60,14 @@ public:
     void setNeedsAnotherUpdateForTest(bool);
 
 private:
+    void prepareOutputsConcurrently(CompositionRefreshArgs&);
+
     std::unique_ptr<HWComposer> mHwComposer;
     renderengine::RenderEngine* mRenderEngine;
     std::shared_ptr<TimeStats> mTimeStats;
     bool mNeedsAnotherUpdate = false;
     nsecs_t mRefreshStartTime = 0;
+    std::unique_ptr<OutputWorkerPool> mWorkerPool;
 };
 
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine();
@@ -80,6 +80,7 @@ public:
     void setReleasedLayers(ReleasedLayers&&) override;
 
     void prepare(const CompositionRefreshArgs&, LayerFESet&) override;
+    void updateAndWriteCompositionState(const CompositionRefreshArgs&) override;
     ftl::Future<std::monostate> present(const CompositionRefreshArgs&) override;
     bool supportsOffloadPresent() const override { return false; }
     void offloadPresentNextFrame() override;
@@ -185,6 +186,8 @@ private:
 
     bool mPredictCompositionStrategy = false;
     bool mOffloadPresent = false;
+    // Whether updateAndWriteCompositionState() already ran for the next present().
+    bool mCompositionStateWritten = false;
 
     // Whether the content must be recomposed this frame.
     bool mMustRecompose = false;
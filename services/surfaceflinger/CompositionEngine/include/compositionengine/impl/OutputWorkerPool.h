@@ -0,0 +1,60 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android::compositionengine::impl {
+
+// A fixed set of real time threads used to compose several outputs at once. The threads are kept
+// around between frames so that a frame never waits on thread creation.
+class OutputWorkerPool final {
+public:
+    explicit OutputWorkerPool(size_t workerCount);
+    ~OutputWorkerPool();
+
+    // Calls |work| once for every index in [0, count), spread over the workers and the calling
+    // thread, and returns once all calls are done.
+    void forEach(size_t count, const std::function<void(size_t)>& work);
+
+private:
+    void run();
+    void drain();
+
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+    bool mDone GUARDED_BY(mMutex) = false;
+    uint64_t mGeneration GUARDED_BY(mMutex) = 0;
+    size_t mBusyWorkers GUARDED_BY(mMutex) = 0;
+
+    // Only written by forEach() while all workers are idle.
+    const std::function<void(size_t)>* mWork = nullptr;
+    size_t mCount = 0;
+    std::atomic<size_t> mNextIndex = 0;
+
+    std::vector<std::thread> mThreads;
+};
+
+} // namespace android::compositionengine::impl
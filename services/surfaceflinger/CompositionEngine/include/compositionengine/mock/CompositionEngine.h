@@ -49,6 +49,7 @@ public:
     MOCK_CONST_METHOD0(getLastFrameRefreshTimestamp, nsecs_t());
 
     MOCK_METHOD1(present, void(CompositionRefreshArgs&));
+    MOCK_METHOD1(setParallelism, void(size_t));
     MOCK_METHOD1(updateCursorAsync, void(CompositionRefreshArgs&));
 
     MOCK_METHOD1(preComposition, void(CompositionRefreshArgs&));
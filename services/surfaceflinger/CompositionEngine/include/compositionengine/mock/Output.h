@@ -80,6 +80,8 @@ public:
     MOCK_METHOD1(setReleasedLayers, void(ReleasedLayers&&));
 
     MOCK_METHOD2(prepare, void(const compositionengine::CompositionRefreshArgs&, LayerFESet&));
+    MOCK_METHOD1(updateAndWriteCompositionState,
+                 void(const compositionengine::CompositionRefreshArgs&));
     MOCK_METHOD1(present,
                  ftl::Future<std::monostate>(const compositionengine::CompositionRefreshArgs&));
     MOCK_CONST_METHOD0(supportsOffloadPresent, bool());
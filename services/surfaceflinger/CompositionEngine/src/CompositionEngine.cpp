@@ -20,6 +20,7 @@
 #include <compositionengine/OutputLayer.h>
 #include <compositionengine/impl/CompositionEngine.h>
 #include <compositionengine/impl/Display.h>
+#include <compositionengine/impl/OutputWorkerPool.h>
 #include <ui/DisplayMap.h>
 
 #include <renderengine/RenderEngine.h>
@@ -125,6 +126,28 @@ void offloadOutputs(Outputs& outputs) {
         output->offloadPresentNextFrame();
     }
 }
+
+// Whether the outputs can prepare and write their composition state on separate threads. Outputs
+// without a HWC display only touch their own state, but HWC displays must allow being driven from
+// several threads at once.
+bool canPrepareOutputsConcurrently(const Outputs& outputs) {
+    if (outputs.size() < 2) {
+        return false;
+    }
+
+    for (const auto& output : outputs) {
+        if (!ftl::Optional(output->getDisplayId()).and_then(HalDisplayId::tryCast)) {
+            continue;
+        }
+        if (!output->getState().isEnabled) {
+            continue;
+        }
+        if (!output->supportsOffloadPresent()) {
+            return false;
+        }
+    }
+    return true;
+}
 } // namespace
 
 void CompositionEngine::present(CompositionRefreshArgs& args) {
@@ -133,7 +156,9 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
 
     preComposition(args);
 
-    {
+    if (mWorkerPool && canPrepareOutputsConcurrently(args.outputs)) {
+        prepareOutputsConcurrently(args);
+    } else {
         // latchedLayers is used to track the set of front-end layer state that
         // has been latched across all outputs for the prepare step, and is not
         // needed for anything else.
@@ -164,6 +189,29 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
     }
 }
 
+void CompositionEngine::setParallelism(size_t workerCount) {
+    mWorkerPool = workerCount > 0 ? std::make_unique<OutputWorkerPool>(workerCount) : nullptr;
+}
+
+void CompositionEngine::prepareOutputsConcurrently(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    // Each output latches into its own set, as the set only avoids duplicate
+    // work within a single pass and sharing it would need locking.
+    std::vector<LayerFESet> latchedLayers(args.outputs.size());
+
+    // Everything up to writing the composition state only touches the output
+    // itself and its own HWC display. The remaining stages of present() touch
+    // state shared between outputs, such as RenderEngine and the release fences
+    // of layers shown on several outputs, so they still run one output at a
+    // time and in order.
+    mWorkerPool->forEach(args.outputs.size(), [&](size_t i) {
+        const auto& output = args.outputs[i];
+        output->prepare(args, latchedLayers[i]);
+        output->updateAndWriteCompositionState(args);
+    });
+}
+
 void CompositionEngine::updateCursorAsync(CompositionRefreshArgs& args) {
 
     for (const auto& output : args.outputs) {
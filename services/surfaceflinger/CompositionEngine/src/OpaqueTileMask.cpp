@@ -0,0 +1,90 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <compositionengine/OpaqueTileMask.h>
+
+namespace android::compositionengine {
+
+OpaqueTileMask::OpaqueTileMask(const Rect& bounds) : mBounds(bounds) {
+    if (!mBounds.isValid() || mBounds.isEmpty()) {
+        return;
+    }
+    const int64_t width = mBounds.getWidth();
+    const int64_t height = mBounds.getHeight();
+    mTileSize = static_cast<int32_t>(
+            std::max<int64_t>(kMinTileSize, (width + kMaxColumns - 1) / kMaxColumns));
+    mColumnCount = static_cast<int32_t>((width + mTileSize - 1) / mTileSize);
+    mRows.resize(static_cast<size_t>((height + mTileSize - 1) / mTileSize));
+}
+
+uint64_t OpaqueTileMask::columnMask(int32_t first, int32_t end) {
+    if (first >= end) {
+        return 0;
+    }
+    const int32_t count = end - first;
+    const uint64_t bits = count >= kMaxColumns ? ~uint64_t{0} : (uint64_t{1} << count) - 1;
+    return bits << first;
+}
+
+void OpaqueTileMask::add(const Rect& rect) {
+    Rect covered;
+    if (mRows.empty() || !mBounds.intersect(rect, &covered)) {
+        return;
+    }
+    // Only tiles that lie entirely inside the rect are marked. Tiles on the right and bottom
+    // edges of the mask are cut off by the bounds, so reaching the bounds covers them.
+    const int32_t left = covered.left - mBounds.left;
+    const int32_t top = covered.top - mBounds.top;
+    const int32_t firstColumn = (left + mTileSize - 1) / mTileSize;
+    const int32_t endColumn = covered.right == mBounds.right
+            ? mColumnCount
+            : (covered.right - mBounds.left) / mTileSize;
+    const int32_t firstRow = (top + mTileSize - 1) / mTileSize;
+    const int32_t endRow = covered.bottom == mBounds.bottom
+            ? static_cast<int32_t>(mRows.size())
+            : (covered.bottom - mBounds.top) / mTileSize;
+
+    const uint64_t mask = columnMask(firstColumn, endColumn);
+    if (mask == 0) {
+        return;
+    }
+    for (int32_t row = firstRow; row < endRow; row++) {
+        mRows[static_cast<size_t>(row)] |= mask;
+    }
+}
+
+bool OpaqueTileMask::covers(const Rect& rect) const {
+    if (mRows.empty() || rect.isEmpty() || rect.left < mBounds.left || rect.top < mBounds.top ||
+        rect.right > mBounds.right || rect.bottom > mBounds.bottom) {
+        return false;
+    }
+    const int32_t firstColumn = (rect.left - mBounds.left) / mTileSize;
+    const int32_t endColumn = (rect.right - mBounds.left + mTileSize - 1) / mTileSize;
+    const int32_t firstRow = (rect.top - mBounds.top) / mTileSize;
+    const int32_t endRow = (rect.bottom - mBounds.top + mTileSize - 1) / mTileSize;
+
+    const uint64_t mask = columnMask(firstColumn, endColumn);
+    for (int32_t row = firstRow; row < endRow; row++) {
+        if ((mRows[static_cast<size_t>(row)] & mask) != mask) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace android::compositionengine
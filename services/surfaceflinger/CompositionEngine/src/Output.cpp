@@ -433,10 +433,14 @@ ftl::Future<std::monostate> Output::present(
     ATRACE_FORMAT("%s for %s", __func__, mNamePlusId.c_str());
     ALOGV(__FUNCTION__);
 
-    updateColorProfile(refreshArgs);
-    updateCompositionState(refreshArgs);
-    planComposition();
-    writeCompositionState(refreshArgs);
+    if (mCompositionStateWritten) {
+        mCompositionStateWritten = false;
+    } else {
+        updateColorProfile(refreshArgs);
+        updateCompositionState(refreshArgs);
+        planComposition();
+        writeCompositionState(refreshArgs);
+    }
     setColorTransform(refreshArgs);
     beginFrame();
 
@@ -467,6 +471,18 @@ ftl::Future<std::monostate> Output::present(
     return future;
 }
 
+void Output::updateAndWriteCompositionState(
+        const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_FORMAT("%s for %s", __func__, mNamePlusId.c_str());
+    ALOGV(__FUNCTION__);
+
+    updateColorProfile(refreshArgs);
+    updateCompositionState(refreshArgs);
+    planComposition();
+    writeCompositionState(refreshArgs);
+    mCompositionStateWritten = true;
+}
+
 void Output::offloadPresentNextFrame() {
     mOffloadPresent = true;
     updateHwcAsyncWorker();
@@ -497,6 +513,9 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
     coverage.aboveCoveredLayersExcludingOverlays = refreshArgs.hasTrustedPresentationListener
             ? std::make_optional<Region>()
             : std::nullopt;
+    if (refreshArgs.cullOccludedLayersWithTiles) {
+        coverage.aboveOpaqueTiles.emplace(outputState.layerStackSpace.getContent());
+    }
     collectVisibleLayers(refreshArgs, coverage);
 
     // Compute the resulting coverage for this output, and store it for later
@@ -622,6 +641,16 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
         return;
     }
 
+    // Reject layers that are entirely behind opaque layers above them before doing any of the
+    // Region work below. Such a layer would end up with an empty visible region, and since the
+    // opaque area above is already part of aboveCoveredLayers, it would not change that either.
+    if (coverage.aboveOpaqueTiles && coverage.aboveOpaqueTiles->covers(visibleRegion.getBounds())) {
+        if (CC_UNLIKELY(computeAboveCoveredExcludingOverlays)) {
+            coverage.aboveCoveredLayersExcludingOverlays->orSelf(visibleRegion);
+        }
+        return;
+    }
+
     // Remove the transparent area from the visible region
     if (!layerFEState->isOpaque) {
         if (tr.preserveRects()) {
@@ -731,6 +760,9 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
 
     // Update accumAboveOpaqueLayers for next (lower) layer
     coverage.aboveOpaqueLayers.orSelf(opaqueRegion);
+    if (coverage.aboveOpaqueTiles && !opaqueRegion.isEmpty()) {
+        coverage.aboveOpaqueTiles->add(opaqueRegion.getBounds());
+    }
 
     // Compute the visible non-transparent region
     Region visibleNonTransparentRegion = visibleRegion.subtract(transparentRegion);
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/OutputWorkerPool.h>
+#include <pthread.h>
+#include <sched.h>
+#include <system/thread_defs.h>
+
+#include <cutils/sched_policy.h>
+
+namespace android::compositionengine::impl {
+
+OutputWorkerPool::OutputWorkerPool(size_t workerCount) {
+    for (size_t i = 0; i < workerCount; i++) {
+        mThreads.emplace_back(&OutputWorkerPool::run, this);
+        pthread_setname_np(mThreads.back().native_handle(), "OutputWorker");
+    }
+}
+
+OutputWorkerPool::~OutputWorkerPool() {
+    {
+        std::scoped_lock lock(mMutex);
+        mDone = true;
+    }
+    mWorkAvailable.notify_all();
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void OutputWorkerPool::forEach(size_t count, const std::function<void(size_t)>& work) {
+    if (count == 0) {
+        return;
+    }
+
+    mWork = &work;
+    mCount = count;
+    mNextIndex.store(0, std::memory_order_relaxed);
+    {
+        std::scoped_lock lock(mMutex);
+        mGeneration++;
+        mBusyWorkers = mThreads.size();
+    }
+    mWorkAvailable.notify_all();
+
+    drain();
+
+    std::unique_lock lock(mMutex);
+    android::base::ScopedLockAssertion assumeLock(mMutex);
+    mWorkDone.wait(lock, [this]() REQUIRES(mMutex) { return mBusyWorkers == 0; });
+    mWork = nullptr;
+}
+
+void OutputWorkerPool::drain() {
+    for (size_t index = mNextIndex.fetch_add(1, std::memory_order_relaxed); index < mCount;
+         index = mNextIndex.fetch_add(1, std::memory_order_relaxed)) {
+        (*mWork)(index);
+    }
+}
+
+void OutputWorkerPool::run() {
+    // Composition runs at real time priority on the main thread, so the workers need to match it.
+    set_sched_policy(0, SP_FOREGROUND);
+    struct sched_param param = {0};
+    param.sched_priority = 2;
+    sched_setscheduler(gettid(), SCHED_FIFO, &param);
+
+    uint64_t seenGeneration = 0;
+    std::unique_lock lock(mMutex);
+    android::base::ScopedLockAssertion assumeLock(mMutex);
+    while (true) {
+        mWorkAvailable.wait(lock, [&]() REQUIRES(mMutex) {
+            return mDone || mGeneration != seenGeneration;
+        });
+        if (mDone) {
+            return;
+        }
+        seenGeneration = mGeneration;
+        lock.unlock();
+        drain();
+        lock.lock();
+        if (--mBusyWorkers == 0) {
+            mWorkDone.notify_one();
+        }
+    }
+}
+
+} // namespace android::compositionengine::impl
@@ -43,6 +43,7 @@ using ::testing::Ref;
 using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::SaveArg;
+using ::testing::Sequence;
 using ::testing::StrictMock;
 
 struct CompositionEngineTest : public testing::Test {
@@ -483,5 +484,80 @@ TEST_F(CompositionEngineOffloadTest, disabledDisplaysDoNotPreventOthersFromOfflo
     mEngine.present(mRefreshArgs);
 }
 
+struct CompositionEngineParallelTest : public CompositionEngineOffloadTest {
+    void SetUp() override {
+        CompositionEngineOffloadTest::SetUp();
+        mEngine.setParallelism(2);
+    }
+};
+
+TEST_F(CompositionEngineParallelTest, preparesOutputsConcurrently) {
+    EXPECT_CALL(*mDisplay1, supportsOffloadPresent).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mDisplay2, supportsOffloadPresent).WillRepeatedly(Return(true));
+
+    // Each output prepares before writing its composition state, and the outputs
+    // are still presented in order.
+    Sequence display1, display2, virtualDisplay, present;
+    EXPECT_CALL(*mDisplay1, prepare(Ref(mRefreshArgs), _)).InSequence(display1);
+    EXPECT_CALL(*mDisplay1, updateAndWriteCompositionState(Ref(mRefreshArgs)))
+            .InSequence(display1);
+    EXPECT_CALL(*mDisplay2, prepare(Ref(mRefreshArgs), _)).InSequence(display2);
+    EXPECT_CALL(*mDisplay2, updateAndWriteCompositionState(Ref(mRefreshArgs)))
+            .InSequence(display2);
+    EXPECT_CALL(*mVirtualDisplay, prepare(Ref(mRefreshArgs), _)).InSequence(virtualDisplay);
+    EXPECT_CALL(*mVirtualDisplay, updateAndWriteCompositionState(Ref(mRefreshArgs)))
+            .InSequence(virtualDisplay);
+    EXPECT_CALL(*mDisplay1, present(Ref(mRefreshArgs)))
+            .InSequence(display1, present)
+            .WillOnce(Return(ftl::yield<std::monostate>({})));
+    EXPECT_CALL(*mDisplay2, present(Ref(mRefreshArgs)))
+            .InSequence(display2, present)
+            .WillOnce(Return(ftl::yield<std::monostate>({})));
+    EXPECT_CALL(*mVirtualDisplay, present(Ref(mRefreshArgs)))
+            .InSequence(virtualDisplay, present)
+            .WillOnce(Return(ftl::yield<std::monostate>({})));
+
+    SET_FLAG_FOR_TEST(flags::multithreaded_present, false);
+    mRefreshArgs.outputs = {mDisplay1, mDisplay2, mVirtualDisplay};
+
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEngineParallelTest, dependsOnSupport) {
+    EXPECT_CALL(*mDisplay1, supportsOffloadPresent).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mDisplay2, supportsOffloadPresent).WillRepeatedly(Return(false));
+
+    EXPECT_CALL(*mDisplay1, updateAndWriteCompositionState).Times(0);
+    EXPECT_CALL(*mDisplay2, updateAndWriteCompositionState).Times(0);
+
+    SET_FLAG_FOR_TEST(flags::multithreaded_present, false);
+    setOutputs({mDisplay1, mDisplay2});
+
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEngineParallelTest, disabledDisplaysDoNotPreventConcurrency) {
+    mOutputStates[1].isEnabled = false;
+    EXPECT_CALL(*mDisplay1, supportsOffloadPresent).WillRepeatedly(Return(true));
+    EXPECT_CALL(*mDisplay2, supportsOffloadPresent).WillRepeatedly(Return(false));
+
+    EXPECT_CALL(*mDisplay1, updateAndWriteCompositionState(Ref(mRefreshArgs))).Times(1);
+    EXPECT_CALL(*mDisplay2, updateAndWriteCompositionState(Ref(mRefreshArgs))).Times(1);
+
+    SET_FLAG_FOR_TEST(flags::multithreaded_present, false);
+    setOutputs({mDisplay1, mDisplay2});
+
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEngineParallelTest, oneDisplay) {
+    EXPECT_CALL(*mDisplay1, updateAndWriteCompositionState).Times(0);
+
+    SET_FLAG_FOR_TEST(flags::multithreaded_present, false);
+    setOutputs({mDisplay1});
+
+    mEngine.present(mRefreshArgs);
+}
+
 } // namespace
 } // namespace android::compositionengine
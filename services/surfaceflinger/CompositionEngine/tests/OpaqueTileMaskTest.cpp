@@ -0,0 +1,115 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/OpaqueTileMask.h>
+#include <gtest/gtest.h>
+
+namespace android::compositionengine {
+namespace {
+
+const Rect kBounds(0, 0, 1080, 2400);
+
+TEST(OpaqueTileMaskTest, emptyMaskCoversNothing) {
+    OpaqueTileMask mask(kBounds);
+
+    EXPECT_FALSE(mask.covers(Rect(0, 0, 10, 10)));
+    EXPECT_FALSE(mask.covers(kBounds));
+}
+
+TEST(OpaqueTileMaskTest, fullRectCoversEverything) {
+    OpaqueTileMask mask(kBounds);
+    mask.add(kBounds);
+
+    EXPECT_TRUE(mask.covers(kBounds));
+    EXPECT_TRUE(mask.covers(Rect(1, 1, 2, 2)));
+    EXPECT_TRUE(mask.covers(Rect(1070, 2390, 1080, 2400)));
+}
+
+TEST(OpaqueTileMaskTest, neverCoversOutsideBounds) {
+    OpaqueTileMask mask(kBounds);
+    mask.add(Rect(-100, -100, 2000, 3000));
+
+    EXPECT_TRUE(mask.covers(kBounds));
+    EXPECT_FALSE(mask.covers(Rect(-1, 0, 10, 10)));
+    EXPECT_FALSE(mask.covers(Rect(0, 0, 1080, 2401)));
+}
+
+TEST(OpaqueTileMaskTest, emptyRectIsNotCovered) {
+    OpaqueTileMask mask(kBounds);
+    mask.add(kBounds);
+
+    EXPECT_FALSE(mask.covers(Rect(10, 10, 10, 20)));
+}
+
+TEST(OpaqueTileMaskTest, partiallyCoveredTilesAreNotMarked) {
+    OpaqueTileMask mask(kBounds);
+    // Covers tiles [1, 3) in both directions completely, and parts of tiles 0 and 3.
+    mask.add(Rect(20, 20, 100, 100));
+
+    EXPECT_TRUE(mask.covers(Rect(32, 32, 96, 96)));
+    EXPECT_FALSE(mask.covers(Rect(20, 20, 100, 100)));
+    EXPECT_FALSE(mask.covers(Rect(31, 32, 96, 96)));
+    EXPECT_FALSE(mask.covers(Rect(32, 32, 97, 96)));
+}
+
+TEST(OpaqueTileMaskTest, accumulatesAdjacentRects) {
+    OpaqueTileMask mask(kBounds);
+    mask.add(Rect(0, 0, 1080, 128));
+    mask.add(Rect(0, 128, 1080, 256));
+
+    EXPECT_TRUE(mask.covers(Rect(0, 0, 1080, 256)));
+    EXPECT_FALSE(mask.covers(Rect(0, 0, 1080, 257)));
+}
+
+TEST(OpaqueTileMaskTest, edgeTilesAreCoveredByReachingTheBounds) {
+    // 1000 is not a multiple of the tile size, so the last column and row are cut off.
+    const Rect bounds(0, 0, 1000, 1000);
+    OpaqueTileMask mask(bounds);
+    mask.add(Rect(992, 992, 1000, 1000));
+
+    EXPECT_TRUE(mask.covers(Rect(995, 995, 1000, 1000)));
+    EXPECT_FALSE(mask.covers(Rect(991, 995, 1000, 1000)));
+}
+
+TEST(OpaqueTileMaskTest, handlesOffsetBounds) {
+    const Rect bounds(-500, -500, 500, 500);
+    OpaqueTileMask mask(bounds);
+    mask.add(Rect(-500, -500, 0, 0));
+
+    // Tiles are aligned to the bounds, so the last full tile before 0 ends at -20.
+    EXPECT_TRUE(mask.covers(Rect(-500, -500, -20, -20)));
+    EXPECT_FALSE(mask.covers(Rect(-500, -500, 0, 0)));
+}
+
+TEST(OpaqueTileMaskTest, wideBoundsUseLargerTiles) {
+    // With at most 64 columns, 8192 pixels means 128 pixel tiles.
+    const Rect bounds(0, 0, 8192, 512);
+    OpaqueTileMask mask(bounds);
+    mask.add(Rect(0, 0, 192, 512));
+
+    EXPECT_TRUE(mask.covers(Rect(0, 0, 128, 512)));
+    EXPECT_FALSE(mask.covers(Rect(0, 0, 129, 512)));
+}
+
+TEST(OpaqueTileMaskTest, invalidBoundsCoverNothing) {
+    OpaqueTileMask mask(Rect::INVALID_RECT);
+    mask.add(Rect(0, 0, 100, 100));
+
+    EXPECT_FALSE(mask.covers(Rect(0, 0, 10, 10)));
+}
+
+} // namespace
+} // namespace android::compositionengine
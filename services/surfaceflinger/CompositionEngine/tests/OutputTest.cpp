@@ -1914,6 +1914,47 @@ TEST_F(OutputEnsureOutputLayerIfVisibleTest, takesNotSoEarlyOutifLayerWithShadow
     ensureOutputLayerIfVisible();
 }
 
+TEST_F(OutputEnsureOutputLayerIfVisibleTest, takesEarlyOutIfLayerIsCoveredByOpaqueTiles) {
+    mCoverageState.aboveCoveredLayers = Region(Rect(0, 0, 200, 300));
+    mCoverageState.aboveOpaqueLayers = Region(Rect(0, 0, 200, 300));
+    mCoverageState.aboveOpaqueTiles.emplace(Rect(0, 0, 200, 300));
+    mCoverageState.aboveOpaqueTiles->add(Rect(0, 0, 200, 300));
+
+    ensureOutputLayerIfVisible();
+
+    EXPECT_THAT(mCoverageState.aboveCoveredLayers, RegionEq(Region(Rect(0, 0, 200, 300))));
+    EXPECT_THAT(mCoverageState.aboveOpaqueLayers, RegionEq(Region(Rect(0, 0, 200, 300))));
+}
+
+TEST_F(OutputEnsureOutputLayerIfVisibleTest, layerCoveredByOpaqueTilesStillCoversNonOverlays) {
+    mLayer.layerFEState.outputFilter.toInternalDisplay = false;
+
+    mCoverageState.aboveCoveredLayers = Region(Rect(0, 0, 200, 300));
+    mCoverageState.aboveOpaqueLayers = Region(Rect(0, 0, 200, 300));
+    mCoverageState.aboveCoveredLayersExcludingOverlays = Region();
+    mCoverageState.aboveOpaqueTiles.emplace(Rect(0, 0, 200, 300));
+    mCoverageState.aboveOpaqueTiles->add(Rect(0, 0, 200, 300));
+
+    ensureOutputLayerIfVisible();
+
+    EXPECT_THAT(*mCoverageState.aboveCoveredLayersExcludingOverlays,
+                RegionEq(kFullBoundsNoRotation));
+}
+
+TEST_F(OutputEnsureOutputLayerIfVisibleTest, opaqueLayerIsAddedToOpaqueTiles) {
+    mCoverageState.aboveOpaqueTiles.emplace(Rect(0, 0, 200, 300));
+
+    EXPECT_CALL(mOutput, ensureOutputLayer(Eq(0u), Eq(mLayer.layerFE)))
+            .WillOnce(Return(&mLayer.outputLayer));
+
+    ensureOutputLayerIfVisible();
+
+    EXPECT_THAT(mCoverageState.aboveOpaqueLayers, RegionEq(kFullBoundsNoRotation));
+    // Only the 32x32 tiles entirely inside the layer are recorded.
+    EXPECT_TRUE(mCoverageState.aboveOpaqueTiles->covers(Rect(0, 0, 96, 192)));
+    EXPECT_FALSE(mCoverageState.aboveOpaqueTiles->covers(Rect(0, 0, 100, 200)));
+}
+
 TEST_F(OutputEnsureOutputLayerIfVisibleTest, displayDecorSetsBlockingFromTransparentRegion) {
     mLayer.layerFEState.isOpaque = false;
     mLayer.layerFEState.contentDirty = true;
@@ -2062,6 +2103,27 @@ TEST_F(OutputPresentTest, predictingCompositionStrategyInvokesPrepareFrameAsync)
     mOutput.present(args);
 }
 
+TEST_F(OutputPresentTest, skipsStagesAlreadyRunByUpdateAndWriteCompositionState) {
+    CompositionRefreshArgs args;
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, updateColorProfile(Ref(args)));
+    EXPECT_CALL(mOutput, updateCompositionState(Ref(args)));
+    EXPECT_CALL(mOutput, planComposition());
+    EXPECT_CALL(mOutput, writeCompositionState(Ref(args)));
+    EXPECT_CALL(mOutput, setColorTransform(Ref(args)));
+    EXPECT_CALL(mOutput, beginFrame());
+    EXPECT_CALL(mOutput, canPredictCompositionStrategy(Ref(args))).WillOnce(Return(false));
+    EXPECT_CALL(mOutput, prepareFrame());
+    EXPECT_CALL(mOutput, devOptRepaintFlash(Ref(args)));
+    EXPECT_CALL(mOutput, finishFrame(_));
+    EXPECT_CALL(mOutput, presentFrameAndReleaseLayers());
+    EXPECT_CALL(mOutput, renderCachedSets(Ref(args)));
+
+    mOutput.updateAndWriteCompositionState(args);
+    mOutput.present(args);
+}
+
 /*
  * Output::updateColorProfile()
  */
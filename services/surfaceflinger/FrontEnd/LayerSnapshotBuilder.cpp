@@ -19,8 +19,14 @@
 #undef LOG_TAG
 #define LOG_TAG "SurfaceFlinger"
 
+#include <pthread.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <numeric>
 #include <optional>
+#include <thread>
 
 #include <ftl/small_map.h>
 #include <gui/TraceUtils.h>
@@ -365,13 +371,85 @@ LayerSnapshot LayerSnapshotBuilder::getRootSnapshot() {
     return snapshot;
 }
 
+// Threads that help the main thread walk independent parts of the hierarchy. Each call to run
+// hands the same job to every worker and to the caller, and returns once all of them are done.
+class LayerSnapshotBuilder::WorkerPool {
+public:
+    explicit WorkerPool(size_t workerCount) {
+        for (size_t i = 0; i < workerCount; i++) {
+            mThreads.emplace_back([this]() { loop(); });
+            pthread_setname_np(mThreads.back().native_handle(), "SnapshotWorker");
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard lock(mMutex);
+            mDone = true;
+        }
+        mWorkAvailable.notify_all();
+        for (auto& thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    void run(const std::function<void()>& job) {
+        {
+            std::lock_guard lock(mMutex);
+            mJob = &job;
+            mGeneration++;
+            mBusyWorkers = mThreads.size();
+        }
+        mWorkAvailable.notify_all();
+        job();
+        std::unique_lock lock(mMutex);
+        mWorkDone.wait(lock, [this]() { return mBusyWorkers == 0; });
+        mJob = nullptr;
+    }
+
+private:
+    void loop() {
+        uint64_t seenGeneration = 0;
+        std::unique_lock lock(mMutex);
+        while (true) {
+            mWorkAvailable.wait(lock, [&]() { return mDone || mGeneration != seenGeneration; });
+            if (mDone) {
+                return;
+            }
+            seenGeneration = mGeneration;
+            const std::function<void()>& job = *mJob;
+            lock.unlock();
+            job();
+            lock.lock();
+            if (--mBusyWorkers == 0) {
+                mWorkDone.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailable;
+    std::condition_variable mWorkDone;
+    const std::function<void()>* mJob = nullptr;
+    uint64_t mGeneration = 0;
+    size_t mBusyWorkers = 0;
+    bool mDone = false;
+};
+
 LayerSnapshotBuilder::LayerSnapshotBuilder() {}
 
+LayerSnapshotBuilder::~LayerSnapshotBuilder() = default;
+
 LayerSnapshotBuilder::LayerSnapshotBuilder(Args args) : LayerSnapshotBuilder() {
     args.forceUpdate = ForceUpdateFlags::ALL;
     updateSnapshots(args);
 }
 
+void LayerSnapshotBuilder::setParallelism(size_t workerCount) {
+    mWorkerPool = workerCount > 0 ? std::make_unique<WorkerPool>(workerCount) : nullptr;
+}
+
 bool LayerSnapshotBuilder::tryFastUpdate(const Args& args) {
     const bool forceUpdate = args.forceUpdate != ForceUpdateFlags::NONE;
 
@@ -398,10 +476,13 @@ bool LayerSnapshotBuilder::tryFastUpdate(const Args& args) {
 
     // Walk through all the updated requested layer states and update the corresponding snapshots.
     for (const RequestedLayerState* requested : args.layerLifecycleManager.getChangedLayers()) {
-        auto range = mIdToSnapshots.equal_range(requested->id);
-        for (auto it = range.first; it != range.second; it++) {
-            it->second->merge(*requested, forceUpdate, args.displayChanges, args.forceFullDamage,
-                              primaryDisplayRotationFlags);
+        auto it = mIdToSnapshots.find(requested->id);
+        if (it == mIdToSnapshots.end()) {
+            continue;
+        }
+        for (LayerSnapshot* snapshot : it->second) {
+            snapshot->merge(*requested, forceUpdate, args.displayChanges, args.forceFullDamage,
+                            primaryDisplayRotationFlags);
         }
     }
 
@@ -446,6 +527,8 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
         LayerHierarchy::ScopedAddToTraversalPath addChildToPath(root, args.root.getLayer()->id,
                                                                 LayerHierarchy::Variant::Attached);
         updateSnapshotsInHierarchy(args, args.root, root, rootSnapshot, /*depth=*/0);
+    } else if (mWorkerPool && args.root.mChildren.size() > 1) {
+        updateSnapshotsInParallel(args, rootSnapshot);
     } else {
         for (auto& [childHierarchy, variant] : args.root.mChildren) {
             LayerHierarchy::ScopedAddToTraversalPath addChildToPath(root,
@@ -488,14 +571,12 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
             continue;
         }
 
-        mPathToSnapshot.erase(traversalPath);
-
-        auto range = mIdToSnapshots.equal_range(traversalPath.id);
-        auto matchingSnapshot =
-                std::find_if(range.first, range.second, [&traversalPath](auto& snapshotWithId) {
-                    return snapshotWithId.second->path == traversalPath;
-                });
-        mIdToSnapshots.erase(matchingSnapshot);
+        auto snapshotsWithId = mIdToSnapshots.find(traversalPath.id);
+        auto& snapshots = snapshotsWithId->second;
+        snapshots.unstable_erase(std::find(snapshots.begin(), snapshots.end(), it->get()));
+        if (snapshots.empty()) {
+            mIdToSnapshots.erase(snapshotsWithId);
+        }
         mNeedsTouchableRegionCrop.erase(traversalPath);
         mSnapshots.back()->globalZ = it->get()->globalZ;
         std::iter_swap(it, mSnapshots.end() - 1);
@@ -503,6 +584,89 @@ void LayerSnapshotBuilder::updateSnapshots(const Args& args) {
     }
 }
 
+void LayerSnapshotBuilder::updateSnapshotsInParallel(const Args& args,
+                                                     const LayerSnapshot& rootSnapshot) {
+    ATRACE_NAME("UpdateSnapshotsInParallel");
+    const auto& children = args.root.mChildren;
+
+    // Children that share snapshots with other children through relative layers are grouped and
+    // walked in their original order by one task. Every other child gets a task of its own.
+    std::vector<std::vector<size_t>> tasks;
+    std::vector<size_t> taskForChild(children.size());
+    std::optional<size_t> sharedTask;
+    for (size_t i = 0; i < children.size(); i++) {
+        auto& [childHierarchy, variant] = children[i];
+        if (variant == LayerHierarchy::Variant::Attached && isIndependentSubtree(*childHierarchy)) {
+            taskForChild[i] = tasks.size();
+            tasks.push_back({i});
+            continue;
+        }
+        if (!sharedTask) {
+            sharedTask = tasks.size();
+            tasks.emplace_back();
+        }
+        taskForChild[i] = *sharedTask;
+        tasks[*sharedTask].push_back(i);
+    }
+
+    // Walk from the builder's own maps without writing to them. Anything a task creates or
+    // records goes into its SubtreeState until every task is done.
+    std::vector<SubtreeState> states(tasks.size());
+    std::atomic<size_t> nextTask = 0;
+    const std::function<void()> job = [&]() {
+        for (size_t task = nextTask++; task < tasks.size(); task = nextTask++) {
+            for (size_t child : tasks[task]) {
+                auto& [childHierarchy, variant] = children[child];
+                const uint32_t childId = childHierarchy->getLayer()->id;
+                LayerHierarchy::TraversalPath root = LayerHierarchy::TraversalPath::ROOT;
+                LayerHierarchy::ScopedAddToTraversalPath addChildToPath(root, childId, variant);
+                updateSnapshotsInHierarchy(args, *childHierarchy, root, rootSnapshot,
+                                           /*depth=*/0, &states[task]);
+            }
+        }
+    };
+    mWorkerPool->run(job);
+
+    // Merge in child order so new snapshots are added in the same order as a serial walk.
+    std::vector<bool> merged(tasks.size(), false);
+    for (size_t i = 0; i < children.size(); i++) {
+        const size_t task = taskForChild[i];
+        if (!merged[task]) {
+            mergeSubtreeState(states[task]);
+            merged[task] = true;
+        }
+    }
+}
+
+bool LayerSnapshotBuilder::isIndependentSubtree(const LayerHierarchy& hierarchy, int depth) {
+    // A relative layer is reachable from both its parent (Detached) and its relative parent
+    // (Relative), and both paths update the same snapshot. Leave deep hierarchies to the serial
+    // walk, which reports cycles.
+    if (depth > 50) {
+        return false;
+    }
+    for (auto& [childHierarchy, variant] : hierarchy.mChildren) {
+        if (variant == LayerHierarchy::Variant::Relative ||
+            variant == LayerHierarchy::Variant::Detached ||
+            !isIndependentSubtree(*childHierarchy, depth + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LayerSnapshotBuilder::mergeSubtreeState(SubtreeState& subtree) {
+    for (auto& snapshot : subtree.snapshots) {
+        snapshot->globalZ = mSnapshots.size();
+        mIdToSnapshots[snapshot->path.id].push_back(snapshot.get());
+        mSnapshots.emplace_back(std::move(snapshot));
+    }
+    mNeedsTouchableRegionCrop.insert(subtree.needsTouchableRegionCrop.begin(),
+                                     subtree.needsTouchableRegionCrop.end());
+    // New snapshots were given a z order at the end of the list. Sort them into place.
+    mResortSnapshots |= subtree.resortSnapshots || !subtree.snapshots.empty();
+}
+
 void LayerSnapshotBuilder::update(const Args& args) {
     for (auto& snapshot : mSnapshots) {
         clearChanges(*snapshot);
@@ -517,17 +681,17 @@ void LayerSnapshotBuilder::update(const Args& args) {
 const LayerSnapshot& LayerSnapshotBuilder::updateSnapshotsInHierarchy(
         const Args& args, const LayerHierarchy& hierarchy,
         LayerHierarchy::TraversalPath& traversalPath, const LayerSnapshot& parentSnapshot,
-        int depth) {
+        int depth, SubtreeState* subtree) {
     LLOG_ALWAYS_FATAL_WITH_TRACE_IF(depth > 50,
                                     "Cycle detected in LayerSnapshotBuilder. See "
                                     "builder_stack_overflow_transactions.winscope");
 
     const RequestedLayerState* layer = hierarchy.getLayer();
-    LayerSnapshot* snapshot = getSnapshot(traversalPath);
+    LayerSnapshot* snapshot = findSnapshot(traversalPath, subtree);
     const bool newSnapshot = snapshot == nullptr;
     uint32_t primaryDisplayRotationFlags = getPrimaryDisplayRotationFlags(args.displays);
     if (newSnapshot) {
-        snapshot = createSnapshot(traversalPath, *layer, parentSnapshot);
+        snapshot = createSnapshot(traversalPath, *layer, parentSnapshot, subtree);
         snapshot->merge(*layer, /*forceUpdate=*/true, /*displayChanges=*/true, args.forceFullDamage,
                         primaryDisplayRotationFlags);
         snapshot->changes |= RequestedLayerState::Changes::Created;
@@ -540,7 +704,7 @@ const LayerSnapshot& LayerSnapshotBuilder::updateSnapshotsInHierarchy(
         if (traversalPath.isAttached()) {
             resetRelativeState(*snapshot);
         }
-        updateSnapshot(*snapshot, args, *layer, parentSnapshot, traversalPath);
+        updateSnapshot(*snapshot, args, *layer, parentSnapshot, traversalPath, subtree);
     }
 
     for (auto& [childHierarchy, variant] : hierarchy.mChildren) {
@@ -549,7 +713,7 @@ const LayerSnapshot& LayerSnapshotBuilder::updateSnapshotsInHierarchy(
                                                                 variant);
         const LayerSnapshot& childSnapshot =
                 updateSnapshotsInHierarchy(args, *childHierarchy, traversalPath, *snapshot,
-                                           depth + 1);
+                                           depth + 1, subtree);
         updateFrameRateFromChildSnapshot(*snapshot, childSnapshot, args);
     }
 
@@ -565,22 +729,45 @@ LayerSnapshot* LayerSnapshotBuilder::getSnapshot(uint32_t layerId) const {
 }
 
 LayerSnapshot* LayerSnapshotBuilder::getSnapshot(const LayerHierarchy::TraversalPath& id) const {
-    auto it = mPathToSnapshot.find(id);
-    return it == mPathToSnapshot.end() ? nullptr : it->second;
+    auto it = mIdToSnapshots.find(id.id);
+    if (it == mIdToSnapshots.end()) {
+        return nullptr;
+    }
+    for (LayerSnapshot* snapshot : it->second) {
+        if (snapshot->path == id) {
+            return snapshot;
+        }
+    }
+    return nullptr;
+}
+
+LayerSnapshot* LayerSnapshotBuilder::findSnapshot(const LayerHierarchy::TraversalPath& id,
+                                                  const SubtreeState* subtree) const {
+    LayerSnapshot* snapshot = getSnapshot(id);
+    if (snapshot || !subtree) {
+        return snapshot;
+    }
+    auto it = subtree->pathToSnapshot.find(id);
+    return it == subtree->pathToSnapshot.end() ? nullptr : it->second;
 }
 
 LayerSnapshot* LayerSnapshotBuilder::createSnapshot(const LayerHierarchy::TraversalPath& path,
                                                     const RequestedLayerState& layer,
-                                                    const LayerSnapshot& parentSnapshot) {
-    mSnapshots.emplace_back(std::make_unique<LayerSnapshot>(layer, path));
-    LayerSnapshot* snapshot = mSnapshots.back().get();
-    snapshot->globalZ = static_cast<size_t>(mSnapshots.size()) - 1;
+                                                    const LayerSnapshot& parentSnapshot,
+                                                    SubtreeState* subtree) {
+    auto& snapshots = subtree ? subtree->snapshots : mSnapshots;
+    snapshots.emplace_back(std::make_unique<LayerSnapshot>(layer, path));
+    LayerSnapshot* snapshot = snapshots.back().get();
+    snapshot->globalZ = static_cast<size_t>(snapshots.size()) - 1;
     if (path.isClone() && path.variant != LayerHierarchy::Variant::Mirror) {
         snapshot->mirrorRootPath = parentSnapshot.mirrorRootPath;
     }
-    mPathToSnapshot[path] = snapshot;
-
-    mIdToSnapshots.emplace(path.id, snapshot);
+    if (subtree) {
+        // Added to the builder in mergeSubtreeState.
+        subtree->pathToSnapshot[path] = snapshot;
+        return snapshot;
+    }
+    mIdToSnapshots[path.id].push_back(snapshot);
     return snapshot;
 }
 
@@ -703,7 +890,8 @@ void LayerSnapshotBuilder::resetRelativeState(LayerSnapshot& snapshot) {
 void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& args,
                                           const RequestedLayerState& requested,
                                           const LayerSnapshot& parentSnapshot,
-                                          const LayerHierarchy::TraversalPath& path) {
+                                          const LayerHierarchy::TraversalPath& path,
+                                          SubtreeState* subtree) {
     // Always update flags and visibility
     ftl::Flags<RequestedLayerState::Changes> parentChanges = parentSnapshot.changes &
             (RequestedLayerState::Changes::Hierarchy | RequestedLayerState::Changes::Geometry |
@@ -741,7 +929,7 @@ void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& a
             snapshot.changes.any(RequestedLayerState::Changes::Geometry |
                                  RequestedLayerState::Changes::BufferSize |
                                  RequestedLayerState::Changes::Input)) {
-            updateInput(snapshot, requested, parentSnapshot, path, args);
+            updateInput(snapshot, requested, parentSnapshot, path, args, subtree);
         }
         return;
     }
@@ -864,7 +1052,8 @@ void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& a
 
     if (forceUpdate || snapshot.changes.any(RequestedLayerState::Changes::Geometry)) {
         uint32_t primaryDisplayRotationFlags = getPrimaryDisplayRotationFlags(args.displays);
-        updateLayerBounds(snapshot, requested, parentSnapshot, primaryDisplayRotationFlags);
+        updateLayerBounds(snapshot, requested, parentSnapshot, primaryDisplayRotationFlags,
+                          subtree);
     }
 
     if (forceUpdate || snapshot.clientChanges & layer_state_t::eCornerRadiusChanged ||
@@ -881,7 +1070,7 @@ void LayerSnapshotBuilder::updateSnapshot(LayerSnapshot& snapshot, const Args& a
     if (forceUpdate ||
         snapshot.changes.any(RequestedLayerState::Changes::Geometry |
                              RequestedLayerState::Changes::Input)) {
-        updateInput(snapshot, requested, parentSnapshot, path, args);
+        updateInput(snapshot, requested, parentSnapshot, path, args, subtree);
     }
 
     // computed snapshot properties
@@ -944,7 +1133,8 @@ void LayerSnapshotBuilder::updateRoundedCorner(LayerSnapshot& snapshot,
 void LayerSnapshotBuilder::updateLayerBounds(LayerSnapshot& snapshot,
                                              const RequestedLayerState& requested,
                                              const LayerSnapshot& parentSnapshot,
-                                             uint32_t primaryDisplayRotationFlags) {
+                                             uint32_t primaryDisplayRotationFlags,
+                                             SubtreeState* subtree) {
     snapshot.geomLayerTransform = parentSnapshot.geomLayerTransform * snapshot.localTransform;
     const bool transformWasInvalid = snapshot.invalidTransform;
     snapshot.invalidTransform = !LayerSnapshot::isTransformValid(snapshot.geomLayerTransform);
@@ -973,7 +1163,7 @@ void LayerSnapshotBuilder::updateLayerBounds(LayerSnapshot& snapshot,
     }
     if (transformWasInvalid != snapshot.invalidTransform) {
         // If transform is invalid, the layer will be hidden.
-        mResortSnapshots = true;
+        (subtree ? subtree->resortSnapshots : mResortSnapshots) = true;
     }
     snapshot.geomInverseLayerTransform = snapshot.geomLayerTransform.inverse();
 
@@ -1027,7 +1217,7 @@ void LayerSnapshotBuilder::updateInput(LayerSnapshot& snapshot,
                                        const RequestedLayerState& requested,
                                        const LayerSnapshot& parentSnapshot,
                                        const LayerHierarchy::TraversalPath& path,
-                                       const Args& args) {
+                                       const Args& args, SubtreeState* subtree) {
     if (requested.windowInfoHandle) {
         snapshot.inputInfo = *requested.windowInfoHandle->getInfo();
     } else {
@@ -1087,7 +1277,7 @@ void LayerSnapshotBuilder::updateInput(LayerSnapshot& snapshot,
     }
 
     if (requested.touchCropId != UNASSIGNED_LAYER_ID || path.isClone()) {
-        mNeedsTouchableRegionCrop.insert(path);
+        (subtree ? subtree->needsTouchableRegionCrop : mNeedsTouchableRegionCrop).insert(path);
     }
     auto cropLayerSnapshot = getSnapshot(requested.touchCropId);
     if (!cropLayerSnapshot && snapshot.inputInfo.replaceTouchableRegionWithCrop) {
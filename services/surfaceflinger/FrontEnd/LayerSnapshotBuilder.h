@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <ftl/small_vector.h>
+#include <memory>
+
 #include "FrontEnd/DisplayInfo.h"
 #include "FrontEnd/LayerLifecycleManager.h"
 #include "LayerHierarchy.h"
@@ -61,10 +64,16 @@ public:
         LayerSnapshot rootSnapshot = getRootSnapshot();
     };
     LayerSnapshotBuilder();
+    ~LayerSnapshotBuilder();
 
     // Rebuild the snapshots from scratch.
     LayerSnapshotBuilder(Args);
 
+    // Opt in to walking independent children of the hierarchy root on |workerCount| threads in
+    // addition to the calling thread. Children that contain relative layers are still walked in
+    // order on a single thread. Passing 0 (the default) walks the whole hierarchy serially.
+    void setParallelism(size_t workerCount);
+
     // Update an existing set of snapshot using change flags in RequestedLayerState
     // and LayerLifecycleManager. This needs to be called before
     // LayerLifecycleManager.commitChanges is called as that function will clear all
@@ -91,43 +100,66 @@ public:
 
 private:
     friend class LayerSnapshotTest;
+    class WorkerPool;
+
+    // Snapshots created and state recorded while walking part of the hierarchy in parallel with
+    // other parts. Merged into the builder once all parts have been walked.
+    struct SubtreeState {
+        std::vector<std::unique_ptr<LayerSnapshot>> snapshots;
+        std::unordered_map<LayerHierarchy::TraversalPath, LayerSnapshot*,
+                           LayerHierarchy::TraversalPathHash>
+                pathToSnapshot;
+        std::unordered_set<LayerHierarchy::TraversalPath, LayerHierarchy::TraversalPathHash>
+                needsTouchableRegionCrop;
+        bool resortSnapshots = false;
+    };
 
     // return true if we were able to successfully update the snapshots via
     // the fast path.
     bool tryFastUpdate(const Args& args);
 
     void updateSnapshots(const Args& args);
+    void updateSnapshotsInParallel(const Args& args, const LayerSnapshot& rootSnapshot);
+    // Returns true if no other child of the root can reach snapshots below this hierarchy.
+    static bool isIndependentSubtree(const LayerHierarchy& hierarchy, int depth = 0);
+    void mergeSubtreeState(SubtreeState& subtree);
 
+    // |subtree| is null when walking serially, in which case the builder is updated directly.
     const LayerSnapshot& updateSnapshotsInHierarchy(const Args&, const LayerHierarchy& hierarchy,
                                                     LayerHierarchy::TraversalPath& traversalPath,
-                                                    const LayerSnapshot& parentSnapshot, int depth);
+                                                    const LayerSnapshot& parentSnapshot, int depth,
+                                                    SubtreeState* subtree = nullptr);
     void updateSnapshot(LayerSnapshot&, const Args&, const RequestedLayerState&,
-                        const LayerSnapshot& parentSnapshot, const LayerHierarchy::TraversalPath&);
+                        const LayerSnapshot& parentSnapshot, const LayerHierarchy::TraversalPath&,
+                        SubtreeState* subtree = nullptr);
     static void updateRelativeState(LayerSnapshot& snapshot, const LayerSnapshot& parentSnapshot,
                                     bool parentIsRelative, const Args& args);
     static void resetRelativeState(LayerSnapshot& snapshot);
     static void updateRoundedCorner(LayerSnapshot& snapshot, const RequestedLayerState& layerState,
                                     const LayerSnapshot& parentSnapshot, const Args& args);
     void updateLayerBounds(LayerSnapshot& snapshot, const RequestedLayerState& layerState,
-                           const LayerSnapshot& parentSnapshot, uint32_t displayRotationFlags);
+                           const LayerSnapshot& parentSnapshot, uint32_t displayRotationFlags,
+                           SubtreeState* subtree = nullptr);
     static void updateShadows(LayerSnapshot& snapshot, const RequestedLayerState& requested,
                               const ShadowSettings& globalShadowSettings);
     void updateInput(LayerSnapshot& snapshot, const RequestedLayerState& requested,
                      const LayerSnapshot& parentSnapshot, const LayerHierarchy::TraversalPath& path,
-                     const Args& args);
+                     const Args& args, SubtreeState* subtree = nullptr);
     // Return true if there are unreachable snapshots
     bool sortSnapshotsByZ(const Args& args);
     LayerSnapshot* createSnapshot(const LayerHierarchy::TraversalPath& id,
                                   const RequestedLayerState& layer,
-                                  const LayerSnapshot& parentSnapshot);
+                                  const LayerSnapshot& parentSnapshot,
+                                  SubtreeState* subtree = nullptr);
+    LayerSnapshot* findSnapshot(const LayerHierarchy::TraversalPath& id,
+                                const SubtreeState* subtree) const;
     void updateFrameRateFromChildSnapshot(LayerSnapshot& snapshot,
                                           const LayerSnapshot& childSnapshot, const Args& args);
     void updateTouchableRegionCrop(const Args& args);
 
-    std::unordered_map<LayerHierarchy::TraversalPath, LayerSnapshot*,
-                       LayerHierarchy::TraversalPathHash>
-            mPathToSnapshot;
-    std::multimap<uint32_t, LayerSnapshot*> mIdToSnapshots;
+    // Snapshots by layer id. A layer has a single snapshot unless it is mirrored, so finding the
+    // snapshot for a path hashes one integer and compares the mirror root ids of a few entries.
+    std::unordered_map<uint32_t, ftl::SmallVector<LayerSnapshot*, 1>> mIdToSnapshots;
 
     // Track snapshots that needs touchable region crop from other snapshots
     std::unordered_set<LayerHierarchy::TraversalPath, LayerHierarchy::TraversalPathHash>
@@ -135,6 +167,7 @@ private:
     std::vector<std::unique_ptr<LayerSnapshot>> mSnapshots;
     bool mResortSnapshots = false;
     int mNumInterestingSnapshots = 0;
+    std::unique_ptr<WorkerPool> mWorkerPool;
 };
 
 } // namespace android::surfaceflinger::frontend
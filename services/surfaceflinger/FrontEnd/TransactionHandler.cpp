@@ -26,8 +26,63 @@
 
 #include "TransactionHandler.h"
 
+#include <algorithm>
+
 namespace android::surfaceflinger::frontend {
 
+namespace {
+
+bool isSameFrameTimelineInfo(const FrameTimelineInfo& lhs, const FrameTimelineInfo& rhs) {
+    return lhs.vsyncId == rhs.vsyncId && lhs.inputEventId == rhs.inputEventId &&
+            lhs.startTimeNanos == rhs.startTimeNanos &&
+            lhs.useForRefreshRateSelection == rhs.useForRefreshRateSelection &&
+            lhs.skippedFrameVsyncId == rhs.skippedFrameVsyncId &&
+            lhs.skippedFrameStartTimeNanos == rhs.skippedFrameStartTimeNanos;
+}
+
+// Changes which depend on the state of other layers, so their order relative to changes of other
+// layers matters.
+constexpr uint64_t kHierarchyChanges =
+        layer_state_t::eLayerChanged | layer_state_t::eRelativeLayerChanged |
+        layer_state_t::eReparent;
+
+bool hasChangesPreventingCoalescing(const TransactionState& transaction) {
+    return std::any_of(transaction.states.begin(), transaction.states.end(),
+                       [](const ResolvedComposerState& state) {
+                           return state.layerId == UNASSIGNED_LAYER_ID ||
+                                   state.state.hasBufferChanges() ||
+                                   (state.state.what &
+                                    (layer_state_t::eSidebandStreamChanged | kHierarchyChanges));
+                       });
+}
+
+// Whether both transactions change the same layers in the same order.
+bool changesSameLayers(const TransactionState& lhs, const TransactionState& rhs) {
+    return std::equal(lhs.states.begin(), lhs.states.end(), rhs.states.begin(), rhs.states.end(),
+                      [](const ResolvedComposerState& lhs, const ResolvedComposerState& rhs) {
+                          return lhs.layerId == rhs.layerId;
+                      });
+}
+
+// Folds the layer state of a later transaction into the state of the same layer in an
+// earlier transaction. The touch crop id is only taken from the later state if it changes it,
+// mirroring how RequestedLayerState::merge consumes it.
+void mergeResolvedState(ResolvedComposerState& into, ResolvedComposerState&& from) {
+    const uint64_t what = from.state.what;
+    into.state.merge(from.state);
+    // layer_state_t::merge only sets the flag, the listeners are carried separately.
+    if (what & layer_state_t::eHasListenerCallbacksChanged) {
+        into.state.listeners.insert(into.state.listeners.end(),
+                                    std::make_move_iterator(from.state.listeners.begin()),
+                                    std::make_move_iterator(from.state.listeners.end()));
+    }
+    if (what & layer_state_t::eInputInfoChanged) {
+        into.touchCropId = from.touchCropId;
+    }
+}
+
+} // namespace
+
 void TransactionHandler::queueTransaction(TransactionState&& state) {
     mLocklessTransactionQueue.push(std::move(state));
     mPendingTransactionCount.fetch_add(1);
@@ -40,7 +95,7 @@ void TransactionHandler::collectTransactions() {
         if (!maybeTransaction.has_value()) {
             break;
         }
-        auto transaction = maybeTransaction.value();
+        auto transaction = std::move(*maybeTransaction);
         mPendingTransactionQueues[transaction.applyToken].emplace(std::move(transaction));
     }
 }
@@ -71,6 +126,7 @@ std::vector<TransactionState> TransactionHandler::flushTransactions() {
     applyUnsignaledBufferTransaction(transactions, flushState);
 
     mPendingTransactionCount.fetch_sub(transactions.size());
+    coalesceTransactions(transactions);
     ATRACE_INT("TransactionQueue", static_cast<int>(mPendingTransactionCount.load()));
     return transactions;
 }
@@ -124,6 +180,63 @@ void TransactionHandler::popTransactionFromPending(std::vector<TransactionState>
     });
 }
 
+bool TransactionHandler::canCoalesce(const TransactionState& earlier,
+                                     const TransactionState& later) {
+    // Transactions with buffers are never folded so that each buffer is latched, released and
+    // reported exactly as if its transaction was applied on its own. Display changes are rare and
+    // order sensitive, so they are left alone as well.
+    //
+    // Only transactions changing the same layers without hierarchy changes are folded, so that
+    // every layer sees its changes in the same order relative to the other layers. With the same
+    // frame timeline info, the layers also create the same bufferless SurfaceFrames.
+    return earlier.applyToken == later.applyToken && earlier.originPid == later.originPid &&
+            earlier.originUid == later.originUid && earlier.flags == later.flags &&
+            earlier.isAutoTimestamp == later.isAutoTimestamp &&
+            earlier.desiredPresentTime == later.desiredPresentTime &&
+            earlier.displays.empty() && later.displays.empty() &&
+            isSameFrameTimelineInfo(earlier.frameTimelineInfo, later.frameTimelineInfo) &&
+            changesSameLayers(earlier, later) && !hasChangesPreventingCoalescing(earlier) &&
+            !hasChangesPreventingCoalescing(later);
+}
+
+void TransactionHandler::coalesceTransactions(std::vector<TransactionState>& transactions) {
+    if (transactions.size() < 2) {
+        return;
+    }
+
+    // Only adjacent transactions are folded, so the apply order of the others is unchanged.
+    auto merged = transactions.begin();
+    for (auto it = std::next(merged); it != transactions.end(); it++) {
+        if (!canCoalesce(*merged, *it)) {
+            merged++;
+            if (merged != it) {
+                *merged = std::move(*it);
+            }
+            continue;
+        }
+
+        ATRACE_NAME("coalesceTransaction");
+        for (size_t i = 0; i < it->states.size(); i++) {
+            mergeResolvedState(merged->states[i], std::move(it->states[i]));
+        }
+        merged->inputWindowCommands.merge(it->inputWindowCommands);
+        merged->uncacheBufferIds.insert(merged->uncacheBufferIds.end(),
+                                        it->uncacheBufferIds.begin(), it->uncacheBufferIds.end());
+        merged->hasListenerCallbacks |= it->hasListenerCallbacks;
+        merged->listenerCallbacks.insert(merged->listenerCallbacks.end(),
+                                         std::make_move_iterator(it->listenerCallbacks.begin()),
+                                         std::make_move_iterator(it->listenerCallbacks.end()));
+        // The post time of the earlier transaction is kept, since that is the one which would have
+        // created the bufferless SurfaceFrames of the layers.
+        merged->coalescedTransactionIds.push_back(it->id);
+        merged->mergedTransactionIds.push_back(it->id);
+        merged->mergedTransactionIds.insert(merged->mergedTransactionIds.end(),
+                                            it->mergedTransactionIds.begin(),
+                                            it->mergedTransactionIds.end());
+    }
+    transactions.erase(std::next(merged), transactions.end());
+}
+
 TransactionHandler::TransactionReadiness TransactionHandler::applyFilters(
         TransactionFlushState& flushState) {
     auto ready = TransactionReadiness::Ready;
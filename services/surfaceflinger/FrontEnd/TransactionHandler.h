@@ -85,6 +85,13 @@ private:
     void applyUnsignaledBufferTransaction(std::vector<TransactionState>&, TransactionFlushState&);
     void popTransactionFromPending(std::vector<TransactionState>&, TransactionFlushState&,
                                    std::queue<TransactionState>&);
+    // Folds consecutive ready transactions from the same apply token into a single transaction,
+    // so that a client sending many small transactions per frame costs one apply per changed
+    // layer instead of one per transaction. Only transactions which change the same layers,
+    // without buffer, hierarchy or display changes, are folded. The ids of folded transactions
+    // are added to coalescedTransactionIds and mergedTransactionIds.
+    void coalesceTransactions(std::vector<TransactionState>&);
+    static bool canCoalesce(const TransactionState& earlier, const TransactionState& later);
     TransactionReadiness applyFilters(TransactionFlushState&);
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IListenerHash>
             mPendingTransactionQueues;
@@ -15,7 +15,9 @@
  */
 
 #pragma once
+#include <array>
 #include <atomic>
+#include <cstdint>
 #include <optional>
 
 template <typename T>
@@ -36,33 +38,73 @@ template <typename T>
 // then store the list and pop one element.
 //
 // If we already had something in the pop list we just pop directly.
+//
+// Entries are not allocated per push. They are carved out of fixed size chunks which are never
+// freed before the queue itself, and popped entries go back on a free list. Producers take from
+// the free list concurrently, so unlike mPush it is subject to ABA: a producer may read a head
+// and its next link, lose the race to other producers and the consumer, and then see the same
+// head again with a different next link. To catch this, the free list head is a 32-bit entry id
+// packed with a 32-bit tag that is bumped on every update. Entries are referred to by id rather
+// than by pointer so the packed head fits a single 64-bit atomic regardless of pointer tagging.
+//
+// Once the pool covers the largest backlog the queue has seen, push and pop never allocate.
+// Should the pool reach kMaxChunks, further entries are heap allocated and freed on pop.
 class LocklessQueue {
 public:
     class Entry {
     public:
-        T mValue;
-        std::atomic<Entry*> mNext;
-        Entry(T value) : mValue(value) {}
+        std::optional<T> mValue;
+        std::atomic<Entry*> mNext = nullptr;
+        // Link in the free list, as an entry id. 0 terminates the list.
+        std::atomic<uint32_t> mFreeNext = 0;
+        // 1-based index into the pool, or 0 if this entry was heap allocated on overflow.
+        uint32_t mId = 0;
     };
+
+    static constexpr uint32_t kEntriesPerChunk = 64;
+    static constexpr uint32_t kMaxChunks = 256;
+
+    LocklessQueue() = default;
+    LocklessQueue(const LocklessQueue&) = delete;
+    LocklessQueue& operator=(const LocklessQueue&) = delete;
+
+    ~LocklessQueue() {
+        // Only entries allocated on overflow live outside of the chunks.
+        for (Entry* list : {mPush.load(), mPop.load()}) {
+            while (list) {
+                Entry* next = list->mNext;
+                if (list->mId == 0) delete list;
+                list = next;
+            }
+        }
+        for (uint32_t i = 0; i < pooledChunkCount(); i++) {
+            delete[] mChunks[i].load();
+        }
+    }
+
     std::atomic<Entry*> mPush = nullptr;
     std::atomic<Entry*> mPop = nullptr;
     bool isEmpty() { return (mPush.load() == nullptr) && (mPop.load() == nullptr); }
 
-    void push(T value) {
-        Entry* entry = new Entry(value);
-        Entry* previousHead = mPush.load(/*std::memory_order_relaxed*/);
-        do {
-            entry->mNext = previousHead;
-        } while (!mPush.compare_exchange_weak(previousHead, entry)); /*std::memory_order_release*/
+    // Number of entries owned by the pool, in use or free. Does not include overflow entries.
+    size_t capacity() const { return pooledChunkCount() * kEntriesPerChunk; }
+
+    void push(T&& value) {
+        Entry* entry = acquireEntry();
+        entry->mValue.emplace(std::move(value));
+        pushEntry(entry);
+    }
+    void push(const T& value) {
+        Entry* entry = acquireEntry();
+        entry->mValue.emplace(value);
+        pushEntry(entry);
     }
+
     std::optional<T> pop() {
         Entry* popped = mPop.load(/*std::memory_order_acquire*/);
         if (popped) {
             // Single consumer so this is fine
             mPop.store(popped->mNext /* , std::memory_order_release */);
-            auto value = popped->mValue;
-            delete popped;
-            return std::move(value);
         } else {
             Entry* grabbedList = mPush.exchange(nullptr /* , std::memory_order_acquire */);
             if (!grabbedList) return std::nullopt;
@@ -74,9 +116,89 @@ public:
                 grabbedList = next;
             }
             mPop.store(popped /* , std::memory_order_release */);
-            auto value = grabbedList->mValue;
-            delete grabbedList;
-            return std::move(value);
+            popped = grabbedList;
+        }
+        std::optional<T> value = std::move(popped->mValue);
+        popped->mValue.reset();
+        releaseEntry(popped);
+        return value;
+    }
+
+private:
+    static uint64_t pack(uint32_t tag, uint32_t id) { return (uint64_t{tag} << 32) | id; }
+    static uint32_t tagOf(uint64_t head) { return static_cast<uint32_t>(head >> 32); }
+    static uint32_t idOf(uint64_t head) { return static_cast<uint32_t>(head); }
+
+    uint32_t pooledChunkCount() const {
+        const uint32_t count = mChunkCount.load();
+        return count < kMaxChunks ? count : kMaxChunks;
+    }
+
+    Entry* entryForId(uint32_t id) const {
+        const uint32_t index = id - 1;
+        return mChunks[index / kEntriesPerChunk].load() + index % kEntriesPerChunk;
+    }
+
+    void pushEntry(Entry* entry) {
+        Entry* previousHead = mPush.load(/*std::memory_order_relaxed*/);
+        do {
+            entry->mNext = previousHead;
+        } while (!mPush.compare_exchange_weak(previousHead, entry)); /*std::memory_order_release*/
+    }
+
+    Entry* acquireEntry() {
+        uint64_t head = mFreeHead.load();
+        while (idOf(head) != 0) {
+            Entry* entry = entryForId(idOf(head));
+            // If another thread takes this entry first, mFreeNext may be stale, but then the tag
+            // has moved on and the compare_exchange fails.
+            const uint64_t next = pack(tagOf(head) + 1, entry->mFreeNext.load());
+            if (mFreeHead.compare_exchange_weak(head, next)) {
+                return entry;
+            }
+        }
+        return allocateChunk();
+    }
+
+    void releaseEntry(Entry* entry) {
+        if (entry->mId == 0) {
+            delete entry;
+            return;
         }
+        pushFree(entry, entry);
+    }
+
+    // Pushes the chain first..last, already linked through mFreeNext, onto the free list.
+    void pushFree(Entry* first, Entry* last) {
+        uint64_t head = mFreeHead.load();
+        do {
+            last->mFreeNext = idOf(head);
+        } while (!mFreeHead.compare_exchange_weak(head, pack(tagOf(head) + 1, first->mId)));
     }
+
+    // Called when the free list is empty. Returns one entry of a new chunk and donates the rest
+    // to the free list.
+    Entry* allocateChunk() {
+        // Check first so that overflow allocations don't keep bumping mChunkCount.
+        if (mChunkCount.load() >= kMaxChunks) {
+            return new Entry();
+        }
+        const uint32_t chunk = mChunkCount.fetch_add(1);
+        if (chunk >= kMaxChunks) {
+            return new Entry();
+        }
+        Entry* entries = new Entry[kEntriesPerChunk];
+        for (uint32_t i = 0; i < kEntriesPerChunk; i++) {
+            entries[i].mId = chunk * kEntriesPerChunk + i + 1;
+            if (i > 1) entries[i - 1].mFreeNext = entries[i].mId;
+        }
+        // Publish the chunk before any of its ids can be seen on the free list.
+        mChunks[chunk].store(entries);
+        pushFree(&entries[1], &entries[kEntriesPerChunk - 1]);
+        return &entries[0];
+    }
+
+    std::array<std::atomic<Entry*>, kMaxChunks> mChunks{};
+    std::atomic<uint32_t> mChunkCount = 0;
+    std::atomic<uint64_t> mFreeHead = 0;
 };
@@ -37,6 +37,8 @@
 #include <cutils/compiler.h>
 #include <cutils/sched_policy.h>
 
+#include <ftl/small_map.h>
+
 #include <gui/DisplayEventReceiver.h>
 #include <gui/SchedulingPolicy.h>
 
@@ -667,14 +669,24 @@ void EventThread::generateFrameTimeline(VsyncEventData& outVsyncEventData, nsecs
 
 void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
                                 const DisplayEventConsumers& consumers) {
+    // Consumers only differ in their frame interval, which is shared by most of them, so generate
+    // the frame timelines and their tokens once per frame interval rather than once per consumer.
+    ftl::SmallMap<nsecs_t, VsyncEventData, 4> vsyncDataByFrameInterval;
+
     for (const auto& consumer : consumers) {
         DisplayEventReceiver::Event copy = event;
         if (event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
-            const Period frameInterval = mCallback.getVsyncPeriod(consumer->mOwnerUid);
-            copy.vsync.vsyncData.frameInterval = frameInterval.ns();
-            generateFrameTimeline(copy.vsync.vsyncData, frameInterval.ns(), copy.header.timestamp,
-                                  event.vsync.vsyncData.preferredExpectedPresentationTime(),
-                                  event.vsync.vsyncData.preferredDeadlineTimestamp());
+            const nsecs_t frameInterval = mCallback.getVsyncPeriod(consumer->mOwnerUid).ns();
+            const auto [it, inserted] =
+                    vsyncDataByFrameInterval.try_emplace(frameInterval, event.vsync.vsyncData);
+            VsyncEventData& vsyncData = it->second;
+            if (inserted) {
+                vsyncData.frameInterval = frameInterval;
+                generateFrameTimeline(vsyncData, frameInterval, event.header.timestamp,
+                                      event.vsync.vsyncData.preferredExpectedPresentationTime(),
+                                      event.vsync.vsyncData.preferredDeadlineTimestamp());
+            }
+            copy.vsync.vsyncData = vsyncData;
         }
         switch (consumer->postEvent(copy)) {
             case NO_ERROR:
@@ -21,6 +21,7 @@
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wextra"
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <deque>
@@ -33,6 +34,7 @@
 #include <ftl/match.h>
 #include <ftl/unit.h>
 #include <gui/TraceUtils.h>
+#include <math/HashCombine.h>
 #include <scheduler/FrameRateMode.h>
 #include <utils/Trace.h>
 
@@ -469,18 +471,50 @@ float RefreshRateSelector::calculateLayerScoreLocked(const LayerRequirement& lay
 
 auto RefreshRateSelector::getRankedFrameRates(const std::vector<LayerRequirement>& layers,
                                               GlobalSignals signals) const -> RankedFrameRates {
+    const size_t fingerprint = getRankedFrameRatesFingerprint(layers, signals);
+
     std::lock_guard lock(mLock);
 
-    if (mGetRankedFrameRatesCache &&
-        mGetRankedFrameRatesCache->arguments == std::make_pair(layers, signals)) {
-        return mGetRankedFrameRatesCache->result;
+    auto& cache = mGetRankedFrameRatesCache;
+    const auto it = std::find_if(cache.begin(), cache.end(), [&](const auto& entry) {
+        return entry.fingerprint == fingerprint && entry.arguments.second == signals &&
+                entry.arguments.first == layers;
+    });
+
+    if (it != cache.end()) {
+        // Move the entry to the back, as the most recently used.
+        std::rotate(it, it + 1, cache.end());
+        return cache.back().result;
+    }
+
+    auto result = getRankedFrameRatesLocked(layers, signals);
+
+    if (cache.full()) {
+        // Evict the least recently used entry.
+        std::rotate(cache.begin(), cache.begin() + 1, cache.end());
+        cache.pop_back();
     }
 
-    const auto result = getRankedFrameRatesLocked(layers, signals);
-    mGetRankedFrameRatesCache = GetRankedFrameRatesCache{{layers, signals}, result};
+    cache.push_back({fingerprint, {layers, signals}, result});
     return result;
 }
 
+size_t RefreshRateSelector::getRankedFrameRatesFingerprint(
+        const std::vector<LayerRequirement>& layers, GlobalSignals signals) {
+    size_t fingerprint = hashCombine(signals.touch, signals.idle, signals.powerOnImminent);
+
+    for (const auto& layer : layers) {
+        hashCombineSingle(fingerprint, layer.name);
+        hashCombineSingle(fingerprint, layer.vote);
+        hashCombineSingle(fingerprint, layer.seamlessness);
+        hashCombineSingle(fingerprint, layer.frameRateCategory);
+        hashCombineSingle(fingerprint, layer.weight);
+        hashCombineSingle(fingerprint, layer.focused);
+    }
+
+    return fingerprint;
+}
+
 auto RefreshRateSelector::getRankedFrameRatesLocked(const std::vector<LayerRequirement>& layers,
                                                     GlobalSignals signals) const
         -> RankedFrameRates {
@@ -1159,9 +1193,9 @@ const FrameRateMode& RefreshRateSelector::getActiveModeLocked() const {
 void RefreshRateSelector::setActiveMode(DisplayModeId modeId, Fps renderFrameRate) {
     std::lock_guard lock(mLock);
 
-    // Invalidate the cached invocation to getRankedFrameRates. This forces
+    // Invalidate the cached invocations of getRankedFrameRates. This forces
     // the refresh rate to be recomputed on the next call to getRankedFrameRates.
-    mGetRankedFrameRatesCache.reset();
+    mGetRankedFrameRatesCache.clear();
 
     const auto activeModeOpt = mDisplayModes.get(modeId);
     LOG_ALWAYS_FATAL_IF(!activeModeOpt);
@@ -1198,9 +1232,9 @@ void RefreshRateSelector::initializeIdleTimer() {
 void RefreshRateSelector::updateDisplayModes(DisplayModes modes, DisplayModeId activeModeId) {
     std::lock_guard lock(mLock);
 
-    // Invalidate the cached invocation to getRankedFrameRates. This forces
+    // Invalidate the cached invocations of getRankedFrameRates. This forces
     // the refresh rate to be recomputed on the next call to getRankedFrameRates.
-    mGetRankedFrameRatesCache.reset();
+    mGetRankedFrameRatesCache.clear();
 
     mDisplayModes = std::move(modes);
     const auto activeModeOpt = mDisplayModes.get(activeModeId);
@@ -1300,7 +1334,7 @@ auto RefreshRateSelector::setPolicy(const PolicyVariant& policy) -> SetPolicyRes
             return SetPolicyResult::Invalid;
         }
 
-        mGetRankedFrameRatesCache.reset();
+        mGetRankedFrameRatesCache.clear();
 
         if (*getCurrentPolicyLocked() == oldPolicy) {
             return SetPolicyResult::Unchanged;
@@ -22,6 +22,7 @@
 
 #include <ftl/concat.h>
 #include <ftl/optional.h>
+#include <ftl/static_vector.h>
 #include <ftl/unit.h>
 #include <gui/DisplayEventReceiver.h>
 
@@ -534,11 +535,22 @@ private:
 
     Config::FrameRateOverride mFrameRateOverrideConfig;
 
+    // Hashes the arguments of getRankedFrameRates, except for the desired refresh rates of layers,
+    // which are compared approximately. Matching fingerprints are confirmed by comparing arguments.
+    static size_t getRankedFrameRatesFingerprint(const std::vector<LayerRequirement>&,
+                                                 GlobalSignals);
+
     struct GetRankedFrameRatesCache {
+        size_t fingerprint;
         std::pair<std::vector<LayerRequirement>, GlobalSignals> arguments;
         RankedFrameRates result;
     };
-    mutable std::optional<GetRankedFrameRatesCache> mGetRankedFrameRatesCache GUARDED_BY(mLock);
+
+    // Content tends to alternate between a few layer configurations, e.g. video with UI on top
+    // and the idle home screen, so remember the results for as many, least recently used first.
+    static constexpr size_t kGetRankedFrameRatesCacheSize = 4;
+    mutable ftl::StaticVector<GetRankedFrameRatesCache, kGetRankedFrameRatesCacheSize>
+            mGetRankedFrameRatesCache GUARDED_BY(mLock);
 
     // Declare mIdleTimer last to ensure its thread joins before the mutex/callbacks are destroyed.
     std::mutex mIdleTimerCallbacksMutex;
@@ -16,6 +16,7 @@
 
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <algorithm>
 #include <vector>
 
 #include <android-base/stringprintf.h>
@@ -50,6 +51,10 @@ nsecs_t getExpectedCallbackTime(VSyncTracker& tracker, nsecs_t now,
     return getExpectedCallbackTime(nextVsyncTime, timing);
 }
 
+bool isActive(const VSyncDispatchTimerQueueEntry& entry) {
+    return entry.wakeupTime() || entry.hasPendingWorkloadUpdate();
+}
+
 } // namespace
 
 VSyncDispatch::~VSyncDispatch() = default;
@@ -256,6 +261,15 @@ void VSyncDispatchTimerQueue::setTimer(nsecs_t targetTime, nsecs_t /*now*/) {
     mLastTimerSchedule = mTimeKeeper->now();
 }
 
+void VSyncDispatchTimerQueue::removeActiveCallback(CallbackToken token) {
+    const auto it = std::find_if(mActiveCallbacks.begin(), mActiveCallbacks.end(),
+                                 [token](const auto& active) { return active.first == token; });
+    if (it != mActiveCallbacks.end()) {
+        *it = std::move(mActiveCallbacks.back());
+        mActiveCallbacks.pop_back();
+    }
+}
+
 void VSyncDispatchTimerQueue::rearmTimer(nsecs_t now) {
     rearmTimerSkippingUpdateFor(now, mCallbacks.end());
 }
@@ -265,13 +279,8 @@ void VSyncDispatchTimerQueue::rearmTimerSkippingUpdateFor(
     std::optional<nsecs_t> min;
     std::optional<nsecs_t> targetVsync;
     std::optional<std::string_view> nextWakeupName;
-    for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
-        auto& callback = it->second;
-        if (!callback->wakeupTime() && !callback->hasPendingWorkloadUpdate()) {
-            continue;
-        }
-
-        if (it != skipUpdateIt) {
+    for (auto& [token, callback] : mActiveCallbacks) {
+        if (skipUpdateIt == mCallbacks.end() || token != skipUpdateIt->first) {
             callback->update(*mTracker, now);
         }
         auto const wakeupTime = *callback->wakeupTime();
@@ -307,10 +316,11 @@ void VSyncDispatchTimerQueue::timerCallback() {
         std::lock_guard lock(mMutex);
         auto const now = mTimeKeeper->now();
         mLastTimerCallback = now;
-        for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
-            auto& callback = it->second;
+        for (size_t i = 0; i < mActiveCallbacks.size();) {
+            auto const [token, callback] = mActiveCallbacks[i];
             auto const wakeupTime = callback->wakeupTime();
             if (!wakeupTime) {
+                i++;
                 continue;
             }
 
@@ -319,9 +329,16 @@ void VSyncDispatchTimerQueue::timerCallback() {
             auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
             if (*wakeupTime < mIntendedWakeupTime + mTimerSlack + lagAllowance) {
                 callback->executing();
-                invocations.emplace_back(Invocation{callback, *callback->lastExecutedVsyncTarget(),
+                invocations.emplace_back(Invocation{mCallbacks.at(token),
+                                                    *callback->lastExecutedVsyncTarget(),
                                                     *wakeupTime, *readyTime});
+                if (!callback->hasPendingWorkloadUpdate()) {
+                    mActiveCallbacks[i] = std::move(mActiveCallbacks.back());
+                    mActiveCallbacks.pop_back();
+                    continue;
+                }
             }
+            i++;
         }
 
         mIntendedWakeupTime = kInvalidTime;
@@ -353,6 +370,7 @@ void VSyncDispatchTimerQueue::unregisterCallback(CallbackToken token) {
         auto it = mCallbacks.find(token);
         if (it != mCallbacks.end()) {
             entry = it->second;
+            removeActiveCallback(token);
             mCallbacks.erase(it);
         }
     }
@@ -376,16 +394,23 @@ ScheduleResult VSyncDispatchTimerQueue::scheduleLocked(CallbackToken token,
     }
     auto& callback = it->second;
     auto const now = mTimeKeeper->now();
+    const bool wasActive = isActive(*callback);
 
     /* If the timer thread will run soon, we'll apply this work update via the callback
      * timer recalculation to avoid cancelling a callback that is about to fire. */
     auto const rearmImminent = now > mIntendedWakeupTime;
     if (CC_UNLIKELY(rearmImminent)) {
         callback->addPendingWorkloadUpdate(scheduleTiming);
+        if (!wasActive) {
+            mActiveCallbacks.emplace_back(token, callback.get());
+        }
         return getExpectedCallbackTime(*mTracker, now, scheduleTiming);
     }
 
     const ScheduleResult result = callback->schedule(scheduleTiming, *mTracker, now);
+    if (!wasActive && isActive(*callback)) {
+        mActiveCallbacks.emplace_back(token, callback.get());
+    }
     if (!result.has_value()) {
         return {};
     }
@@ -424,6 +449,9 @@ CancelResult VSyncDispatchTimerQueue::cancel(CallbackToken token) {
     auto const wakeupTime = callback->wakeupTime();
     if (wakeupTime) {
         callback->disarm();
+        if (!callback->hasPendingWorkloadUpdate()) {
+            removeActiveCallback(token);
+        }
 
         if (*wakeupTime == mIntendedWakeupTime) {
             mIntendedWakeupTime = kInvalidTime;
@@ -22,6 +22,7 @@
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include <android-base/thread_annotations.h>
 
@@ -137,6 +138,7 @@ private:
 
     using CallbackMap =
             std::unordered_map<CallbackToken, std::shared_ptr<VSyncDispatchTimerQueueEntry>>;
+    using ActiveCallbacks = std::vector<std::pair<CallbackToken, VSyncDispatchTimerQueueEntry*>>;
 
     void timerCallback();
     void setTimer(nsecs_t, nsecs_t) REQUIRES(mMutex);
@@ -144,6 +146,7 @@ private:
     void rearmTimerSkippingUpdateFor(nsecs_t now, CallbackMap::iterator const& skipUpdate)
             REQUIRES(mMutex);
     void cancelTimer() REQUIRES(mMutex);
+    void removeActiveCallback(CallbackToken) REQUIRES(mMutex);
     ScheduleResult scheduleLocked(CallbackToken, ScheduleTiming) REQUIRES(mMutex);
 
     std::mutex mutable mMutex;
@@ -157,6 +160,12 @@ private:
     size_t mCallbackToken GUARDED_BY(mMutex) = 0;
 
     CallbackMap mCallbacks GUARDED_BY(mMutex);
+
+    // The callbacks that are armed or have a pending workload update, which are the only ones the
+    // timer has to look at, so that registered callbacks that are not scheduled cost nothing on
+    // rearm. Entries are owned by mCallbacks, and removed from here before they are unregistered.
+    ActiveCallbacks mActiveCallbacks GUARDED_BY(mMutex);
+
     nsecs_t mIntendedWakeupTime GUARDED_BY(mMutex) = kInvalidTime;
 
     // For debugging purposes
@@ -56,7 +56,8 @@ VSyncPredictor::VSyncPredictor(ftl::NonNull<DisplayModePtr> modePtr, size_t hist
         kMinimumSamplesForPrediction(minimumSamplesForPrediction),
         kOutlierTolerancePercent(std::min(outlierTolerancePercent, kMaxPercent)),
         mVsyncTrackerCallback(callback),
-        mDisplayModePtr(modePtr) {
+        mDisplayModePtr(modePtr),
+        mCallbackDisplayModePtr(modePtr) {
     resetModel();
 }
 
@@ -74,6 +75,17 @@ inline size_t VSyncPredictor::next(size_t i) const {
     return (i + 1) % mTimestamps.size();
 }
 
+nsecs_t VSyncPredictor::oldestTimestamp() const {
+    if (mIrregularSamples > 0) {
+        return *std::min_element(mTimestamps.begin(), mTimestamps.end());
+    }
+    return mTimestamps[next(mLastTimestampIndex)];
+}
+
+int64_t VSyncPredictor::snapToOrdinal(nsecs_t timestamp, nsecs_t period) {
+    return period == 0 ? 0 : (timestamp + period / 2) / period;
+}
+
 nsecs_t VSyncPredictor::idealPeriod() const {
     return mDisplayModePtr->getVsyncRate().getPeriodNsecs();
 }
@@ -92,10 +104,13 @@ bool VSyncPredictor::validate(nsecs_t timestamp) const {
         return false;
     }
 
-    const auto iter = std::min_element(mTimestamps.begin(), mTimestamps.end(),
-                                       [timestamp](nsecs_t a, nsecs_t b) {
-                                           return std::abs(timestamp - a) < std::abs(timestamp - b);
-                                       });
+    // While the window is in order, the closest timestamp to a newer one is the newest.
+    const auto iter = mIrregularSamples == 0 && timestamp >= aValidTimestamp
+            ? mTimestamps.begin() + mLastTimestampIndex
+            : std::min_element(mTimestamps.begin(), mTimestamps.end(),
+                               [timestamp](nsecs_t a, nsecs_t b) {
+                                   return std::abs(timestamp - a) < std::abs(timestamp - b);
+                               });
     const auto distancePercent = std::abs(*iter - timestamp) * kMaxPercent / idealPeriod();
     if (distancePercent < kOutlierTolerancePercent) {
         // duplicate timestamp
@@ -106,8 +121,7 @@ bool VSyncPredictor::validate(nsecs_t timestamp) const {
 }
 
 nsecs_t VSyncPredictor::currentPeriod() const {
-    std::lock_guard lock(mMutex);
-    return mRateMap.find(idealPeriod())->second.slope;
+    return mSnapshot.load().model.slope;
 }
 
 Period VSyncPredictor::minFramePeriod() const {
@@ -115,8 +129,7 @@ Period VSyncPredictor::minFramePeriod() const {
         return Period::fromNs(currentPeriod());
     }
 
-    std::lock_guard lock(mMutex);
-    return minFramePeriodLocked();
+    return Period::fromNs(mSnapshot.load().minFramePeriod);
 }
 
 Period VSyncPredictor::minFramePeriodLocked() const {
@@ -131,7 +144,12 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     ATRACE_CALL();
 
     std::lock_guard lock(mMutex);
+    const bool accepted = addVsyncTimestampLocked(timestamp);
+    publishSnapshot();
+    return accepted;
+}
 
+bool VSyncPredictor::addVsyncTimestampLocked(nsecs_t timestamp) {
     if (!validate(timestamp)) {
         // VSR could elect to ignore the incongruent timestamp or resetModel(). If ts is ignored,
         // don't insert this ts into mTimestamps ringbuffer. If we are still
@@ -153,11 +171,22 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         return false;
     }
 
+    // The window is kept in insertion order, so the oldest timestamp is only the smallest one as
+    // long as no timestamp arrived out of order.
+    if (!mTimestamps.empty() && timestamp < mTimestamps[mLastTimestampIndex]) {
+        mIrregularSamples = kHistorySize;
+    } else if (mIrregularSamples > 0) {
+        mIrregularSamples--;
+    }
+
+    std::optional<Sample> evicted;
     if (mTimestamps.size() != kHistorySize) {
         mTimestamps.push_back(timestamp);
+        mOrdinals.push_back(0);
         mLastTimestampIndex = next(mLastTimestampIndex);
     } else {
         mLastTimestampIndex = next(mLastTimestampIndex);
+        evicted = Sample{mTimestamps[mLastTimestampIndex], mOrdinals[mLastTimestampIndex]};
         mTimestamps[mLastTimestampIndex] = timestamp;
     }
 
@@ -166,6 +195,7 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     const size_t numSamples = mTimestamps.size();
     if (numSamples < kMinimumSamplesForPrediction) {
         mRateMap[idealPeriod()] = {idealPeriod(), 0};
+        mSamplesUntilRebuild = 0;
         return true;
     }
 
@@ -184,48 +214,74 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     //
     // intercept = mean(Y) - slope * mean(X)
     //
-    std::vector<nsecs_t> vsyncTS(numSamples);
-    std::vector<nsecs_t> ordinals(numSamples);
-
-    // Normalizing to the oldest timestamp cuts down on error in calculating the intercept.
-    const auto oldestTS = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+    // Rather than refitting the whole window on every timestamp, the sums over X, Y, X^2 and X*Y
+    // are updated as timestamps enter and leave the window. The sums are kept relative to an
+    // anchor, and the ordinal of a timestamp is snapped with the period at the time it entered.
+    // This gives the same ordinals as snapping the whole window with the current period as long
+    // as every timestamp is close to its ordinal and the period barely moved, which is checked
+    // below. Otherwise, and once per window, the sums are rebuilt from scratch.
     auto it = mRateMap.find(idealPeriod());
     auto const currentPeriod = it->second.slope;
 
-    // The mean of the ordinals must be precise for the intercept calculation, so scale them up for
-    // fixed-point arithmetic.
-    constexpr int64_t kScalingFactor = 1000;
-
-    nsecs_t meanTS = 0;
-    nsecs_t meanOrdinal = 0;
-
-    for (size_t i = 0; i < numSamples; i++) {
-        const auto timestamp = mTimestamps[i] - oldestTS;
-        vsyncTS[i] = timestamp;
-        meanTS += timestamp;
-
-        const auto ordinal = currentPeriod == 0
-                ? 0
-                : (vsyncTS[i] + currentPeriod / 2) / currentPeriod * kScalingFactor;
-        ordinals[i] = ordinal;
-        meanOrdinal += ordinal;
+    const nsecs_t relativeTS = timestamp - mSumsAnchor;
+    const int64_t ordinal = snapToOrdinal(relativeTS, currentPeriod);
+    const nsecs_t maxResidual = mRebuildPeriod / 8;
+    if (std::abs(relativeTS - ordinal * currentPeriod) > maxResidual) {
+        mIrregularSamples = kHistorySize;
     }
+    mMaxPeriodDeviation = std::max(mMaxPeriodDeviation, std::abs(currentPeriod - mRebuildPeriod));
 
-    meanTS /= numSamples;
-    meanOrdinal /= numSamples;
+    // How far any timestamp in the window can be from its ordinal with the current period. The
+    // ordinals only match a fresh snap if no two timestamps are more than half a period apart.
+    const nsecs_t maxError = maxResidual + 2 * ordinal * mMaxPeriodDeviation;
+    const bool canUpdate =
+            mSamplesUntilRebuild > 0 && mIrregularSamples == 0 && 4 * maxError + 2 < currentPeriod;
 
-    for (size_t i = 0; i < numSamples; i++) {
-        vsyncTS[i] -= meanTS;
-        ordinals[i] -= meanOrdinal;
-    }
+    // Normalizing to the oldest timestamp cuts down on error in calculating the intercept.
+    nsecs_t oldestTS;
+    int64_t oldestOrdinal;
+    if (canUpdate) {
+        if (evicted) {
+            mSums.remove(evicted->ordinal, evicted->timestamp - mSumsAnchor);
+        }
+        mOrdinals[mLastTimestampIndex] = ordinal;
+        mSums.add(ordinal, relativeTS);
+        mSamplesUntilRebuild--;
 
-    nsecs_t top = 0;
-    nsecs_t bottom = 0;
-    for (size_t i = 0; i < numSamples; i++) {
-        top += vsyncTS[i] * ordinals[i];
-        bottom += ordinals[i] * ordinals[i];
+        const size_t oldest = next(mLastTimestampIndex);
+        oldestTS = mTimestamps[oldest];
+        oldestOrdinal = mOrdinals[oldest];
+    } else {
+        rebuildRegressionSums(currentPeriod);
+        oldestTS = mSumsAnchor;
+        oldestOrdinal = 0;
     }
 
+    // The mean of the ordinals must be precise for the intercept calculation, so scale them up for
+    // fixed-point arithmetic.
+    constexpr int64_t kScalingFactor = 1000;
+
+    // Move the sums from the anchor to the oldest timestamp, so that the result matches a fit of
+    // the window with the ordinals counted from there.
+    const auto n = static_cast<int64_t>(numSamples);
+    const int64_t offset = oldestTS - mSumsAnchor;
+    const int64_t sumOrdinals = mSums.ordinals - n * oldestOrdinal;
+    const int64_t sumTS = mSums.timestamps - n * offset;
+    const int64_t sumOrdinalsSquared = mSums.ordinalsSquared -
+            2 * oldestOrdinal * mSums.ordinals + n * oldestOrdinal * oldestOrdinal;
+    const int64_t sumProducts = mSums.products - offset * mSums.ordinals -
+            oldestOrdinal * mSums.timestamps + n * oldestOrdinal * offset;
+
+    const nsecs_t meanTS = sumTS / n;
+    const nsecs_t meanOrdinal = sumOrdinals * kScalingFactor / n;
+
+    // Sigma_i( (X_i - mean(X)) * (Y_i - mean(Y) ) and Sigma_i ( X_i - mean(X) ) ^ 2, expanded so
+    // that they only depend on the sums.
+    nsecs_t const top = sumProducts * kScalingFactor - meanOrdinal * sumTS -
+            meanTS * sumOrdinals * kScalingFactor + n * meanTS * meanOrdinal;
+    nsecs_t const bottom = sumOrdinalsSquared * kScalingFactor * kScalingFactor -
+            2 * meanOrdinal * sumOrdinals * kScalingFactor + n * meanOrdinal * meanOrdinal;
+
     if (CC_UNLIKELY(bottom == 0)) {
         it->second = {idealPeriod(), 0};
         clearTimestamps();
@@ -252,28 +308,45 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     return true;
 }
 
-auto VSyncPredictor::getVsyncSequenceLocked(nsecs_t timestamp) const -> VsyncSequence {
-    const auto vsync = nextAnticipatedVSyncTimeFromLocked(timestamp);
+void VSyncPredictor::publishSnapshot() {
+    Snapshot snapshot;
+    snapshot.idealPeriod = idealPeriod();
+    snapshot.model = mRateMap.find(idealPeriod())->second;
+    snapshot.numSamples = mTimestamps.size();
+    if (!mTimestamps.empty()) {
+        snapshot.oldestTimestamp = oldestTimestamp();
+    }
+    snapshot.knownTimestamp = mKnownTimestamp;
+    snapshot.renderRate = mRenderRateOpt;
+    snapshot.minFramePeriod = minFramePeriodLocked().ns();
+    mSnapshot.store(snapshot);
+}
+
+auto VSyncPredictor::getVsyncSequence(const Snapshot& snapshot, nsecs_t timestamp) const
+        -> VsyncSequence {
+    const auto vsync = nextAnticipatedVSyncTimeFrom(snapshot, timestamp);
     if (!mLastVsyncSequence) return {vsync, 0};
 
-    const auto [slope, _] = getVSyncPredictionModelLocked();
+    const auto slope = snapshot.model.slope;
     const auto [lastVsyncTime, lastVsyncSequence] = *mLastVsyncSequence;
     const auto vsyncSequence = lastVsyncSequence +
             static_cast<int64_t>(std::round((vsync - lastVsyncTime) / static_cast<float>(slope)));
     return {vsync, vsyncSequence};
 }
 
-nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFromLocked(nsecs_t timePoint) const {
-    auto const [slope, intercept] = getVSyncPredictionModelLocked();
+nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFrom(const Snapshot& snapshot,
+                                                     nsecs_t timePoint) const {
+    auto const [slope, intercept] = snapshot.model;
 
-    if (mTimestamps.empty()) {
+    if (snapshot.numSamples == 0) {
         traceInt64("VSP-mode", 1);
-        auto const knownTimestamp = mKnownTimestamp ? *mKnownTimestamp : timePoint;
-        auto const numPeriodsOut = ((timePoint - knownTimestamp) / idealPeriod()) + 1;
-        return knownTimestamp + numPeriodsOut * idealPeriod();
+        auto const idealPeriod = snapshot.idealPeriod;
+        auto const knownTimestamp = snapshot.knownTimestamp.value_or(timePoint);
+        auto const numPeriodsOut = ((timePoint - knownTimestamp) / idealPeriod) + 1;
+        return knownTimestamp + numPeriodsOut * idealPeriod;
     }
 
-    auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+    auto const oldest = snapshot.oldestTimestamp;
 
     // See b/145667109, the ordinal calculation must take into account the intercept.
     auto const zeroPoint = oldest + intercept;
@@ -300,16 +373,17 @@ nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFromLocked(nsecs_t timePoint) co
 }
 
 nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const {
-    std::lock_guard lock(mMutex);
+    const auto snapshot = mSnapshot.load();
+    std::lock_guard lock(mSequenceMutex);
 
     // update the mLastVsyncSequence for reference point
-    mLastVsyncSequence = getVsyncSequenceLocked(timePoint);
+    mLastVsyncSequence = getVsyncSequence(snapshot, timePoint);
 
-    const auto renderRatePhase = [&]() REQUIRES(mMutex) -> int {
-        if (!mRenderRateOpt) return 0;
+    const auto renderRatePhase = [&]() REQUIRES(mSequenceMutex) -> int {
+        if (!snapshot.renderRate) return 0;
+        const auto idealRate = Fps::fromPeriodNsecs(snapshot.idealPeriod);
         const auto divisor =
-                RefreshRateSelector::getFrameRateDivisor(Fps::fromPeriodNsecs(idealPeriod()),
-                                                         *mRenderRateOpt);
+                RefreshRateSelector::getFrameRateDivisor(idealRate, *snapshot.renderRate);
         if (divisor <= 1) return 0;
 
         int mod = mLastVsyncSequence->seq % divisor;
@@ -330,23 +404,26 @@ nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const {
             const auto vsyncTimePoint = TimePoint::fromNs(vsyncTime);
             ATRACE_FORMAT("%s InPhase vsyncIn %.2fms", __func__,
                           ticks<std::milli, float>(vsyncTimePoint - TimePoint::now()));
-            const Fps renderRate = mRenderRateOpt ? *mRenderRateOpt : mDisplayModePtr->getPeakFps();
-            mVsyncTrackerCallback.onVsyncGenerated(vsyncTimePoint, mDisplayModePtr, renderRate);
+            const Fps renderRate = snapshot.renderRate ? *snapshot.renderRate
+                                                       : mCallbackDisplayModePtr->getPeakFps();
+            mVsyncTrackerCallback.onVsyncGenerated(vsyncTimePoint, mCallbackDisplayModePtr,
+                                                   renderRate);
         }
         return vsyncTime;
     }
 
-    auto const [slope, intercept] = getVSyncPredictionModelLocked();
+    const auto slope = snapshot.model.slope;
     const auto approximateNextVsync = mLastVsyncSequence->vsyncTime + slope * renderRatePhase;
     const auto nextAnticipatedVsyncTime =
-            nextAnticipatedVSyncTimeFromLocked(approximateNextVsync - slope / 2);
+            nextAnticipatedVSyncTimeFrom(snapshot, approximateNextVsync - slope / 2);
     if (FlagManager::getInstance().vrr_config()) {
         const auto nextAnticipatedVsyncTimePoint = TimePoint::fromNs(nextAnticipatedVsyncTime);
         ATRACE_FORMAT("%s outOfPhase vsyncIn %.2fms", __func__,
                       ticks<std::milli, float>(nextAnticipatedVsyncTimePoint - TimePoint::now()));
-        const Fps renderRate = mRenderRateOpt ? *mRenderRateOpt : mDisplayModePtr->getPeakFps();
-        mVsyncTrackerCallback.onVsyncGenerated(nextAnticipatedVsyncTimePoint, mDisplayModePtr,
-                                               renderRate);
+        const Fps renderRate = snapshot.renderRate ? *snapshot.renderRate
+                                                     : mCallbackDisplayModePtr->getPeakFps();
+        mVsyncTrackerCallback.onVsyncGenerated(nextAnticipatedVsyncTimePoint,
+                                               mCallbackDisplayModePtr, renderRate);
     }
     return nextAnticipatedVsyncTime;
 }
@@ -360,14 +437,16 @@ nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const {
  * isVSyncInPhase(50.0, 30) = true
  */
 bool VSyncPredictor::isVSyncInPhase(nsecs_t timePoint, Fps frameRate) const {
-    std::lock_guard lock(mMutex);
+    const auto snapshot = mSnapshot.load();
     const auto divisor =
-            RefreshRateSelector::getFrameRateDivisor(Fps::fromPeriodNsecs(idealPeriod()),
+            RefreshRateSelector::getFrameRateDivisor(Fps::fromPeriodNsecs(snapshot.idealPeriod),
                                                      frameRate);
-    return isVSyncInPhaseLocked(timePoint, static_cast<unsigned>(divisor));
+    std::lock_guard lock(mSequenceMutex);
+    return isVSyncInPhase(snapshot, timePoint, static_cast<unsigned>(divisor));
 }
 
-bool VSyncPredictor::isVSyncInPhaseLocked(nsecs_t timePoint, unsigned divisor) const {
+bool VSyncPredictor::isVSyncInPhase(const Snapshot& snapshot, nsecs_t timePoint,
+                                    unsigned divisor) const {
     const TimePoint now = TimePoint::now();
     const auto getTimePointIn = [](TimePoint now, nsecs_t timePoint) -> float {
         return ticks<std::milli, float>(TimePoint::fromNs(timePoint) - now);
@@ -379,9 +458,9 @@ bool VSyncPredictor::isVSyncInPhaseLocked(nsecs_t timePoint, unsigned divisor) c
         return true;
     }
 
-    const nsecs_t period = mRateMap[idealPeriod()].slope;
+    const nsecs_t period = snapshot.model.slope;
     const nsecs_t justBeforeTimePoint = timePoint - period / 2;
-    const auto vsyncSequence = getVsyncSequenceLocked(justBeforeTimePoint);
+    const auto vsyncSequence = getVsyncSequence(snapshot, justBeforeTimePoint);
     ATRACE_FORMAT_INSTANT("vsync in: %.2f sequence: %" PRId64,
                           getTimePointIn(now, vsyncSequence.vsyncTime), vsyncSequence.seq);
     return vsyncSequence.seq % divisor == 0;
@@ -392,6 +471,7 @@ void VSyncPredictor::setRenderRate(Fps renderRate) {
     ALOGV("%s %s: RenderRate %s ", __func__, to_string(mId).c_str(), to_string(renderRate).c_str());
     std::lock_guard lock(mMutex);
     mRenderRateOpt = renderRate;
+    publishSnapshot();
 }
 
 void VSyncPredictor::setDisplayModePtr(ftl::NonNull<DisplayModePtr> modePtr) {
@@ -419,6 +499,12 @@ void VSyncPredictor::setDisplayModePtr(ftl::NonNull<DisplayModePtr> modePtr) {
     }
 
     clearTimestamps();
+
+    {
+        std::lock_guard sequenceLock(mSequenceMutex);
+        mCallbackDisplayModePtr = modePtr;
+    }
+    publishSnapshot();
 }
 
 void VSyncPredictor::ensureMinFrameDurationIsKept(TimePoint expectedPresentTime,
@@ -448,6 +534,7 @@ void VSyncPredictor::ensureMinFrameDurationIsKept(TimePoint expectedPresentTime,
     if (!mPastExpectedPresentTimes.empty()) {
         const auto phase = Duration(mPastExpectedPresentTimes.back() - expectedPresentTime);
         if (phase > 0ns) {
+            std::lock_guard lock(mSequenceMutex);
             if (mLastVsyncSequence) {
                 mLastVsyncSequence->vsyncTime += phase.ns();
             }
@@ -511,13 +598,7 @@ void VSyncPredictor::onFrameMissed(TimePoint expectedPresentTime) {
 }
 
 VSyncPredictor::Model VSyncPredictor::getVSyncPredictionModel() const {
-    std::lock_guard lock(mMutex);
-    const auto model = VSyncPredictor::getVSyncPredictionModelLocked();
-    return {model.slope, model.intercept};
-}
-
-VSyncPredictor::Model VSyncPredictor::getVSyncPredictionModelLocked() const {
-    return mRateMap.find(idealPeriod())->second;
+    return mSnapshot.load().model;
 }
 
 void VSyncPredictor::clearTimestamps() {
@@ -534,17 +615,47 @@ void VSyncPredictor::clearTimestamps() {
         mTimestamps.clear();
         mLastTimestampIndex = 0;
     }
+
+    mOrdinals.clear();
+    mSamplesUntilRebuild = 0;
+    mIrregularSamples = 0;
+}
+
+void VSyncPredictor::rebuildRegressionSums(nsecs_t period) {
+    ATRACE_CALL();
+
+    const size_t numSamples = mTimestamps.size();
+    const size_t oldest = next(mLastTimestampIndex);
+
+    mSumsAnchor = oldestTimestamp();
+    mRebuildPeriod = period;
+    mMaxPeriodDeviation = 0;
+    mSums = {};
+    for (size_t i = 0; i < numSamples; i++) {
+        const nsecs_t relativeTS = mTimestamps[i] - mSumsAnchor;
+        const int64_t ordinal = snapToOrdinal(relativeTS, period);
+        mOrdinals[i] = ordinal;
+        mSums.add(ordinal, relativeTS);
+
+        // Keep rebuilding until a timestamp far from its ordinal has left the window.
+        if (std::abs(relativeTS - ordinal * period) > period / 8) {
+            const size_t samplesUntilEvicted =
+                    kHistorySize - numSamples + (i + numSamples - oldest) % numSamples + 1;
+            mIrregularSamples = std::max(mIrregularSamples, samplesUntilEvicted);
+        }
+    }
+    mSamplesUntilRebuild = kHistorySize;
 }
 
 bool VSyncPredictor::needsMoreSamples() const {
-    std::lock_guard lock(mMutex);
-    return mTimestamps.size() < kMinimumSamplesForPrediction;
+    return mSnapshot.load().numSamples < kMinimumSamplesForPrediction;
 }
 
 void VSyncPredictor::resetModel() {
     std::lock_guard lock(mMutex);
     mRateMap[idealPeriod()] = {idealPeriod(), 0};
     clearTimestamps();
+    publishSnapshot();
 }
 
 void VSyncPredictor::dump(std::string& result) const {
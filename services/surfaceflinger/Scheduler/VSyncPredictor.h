@@ -22,6 +22,7 @@
 #include <vector>
 
 #include <android-base/thread_annotations.h>
+#include <scheduler/SeqLock.h>
 #include <ui/DisplayId.h>
 
 #include "VSyncTracker.h"
@@ -45,24 +46,24 @@ public:
     ~VSyncPredictor();
 
     bool addVsyncTimestamp(nsecs_t timestamp) final EXCLUDES(mMutex);
-    nsecs_t nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const final EXCLUDES(mMutex);
-    nsecs_t currentPeriod() const final EXCLUDES(mMutex);
-    Period minFramePeriod() const final EXCLUDES(mMutex);
+    nsecs_t nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const final EXCLUDES(mSequenceMutex);
+    nsecs_t currentPeriod() const final;
+    Period minFramePeriod() const final;
     void resetModel() final EXCLUDES(mMutex);
 
     /* Query if the model is in need of more samples to make a prediction.
      * \return  True, if model would benefit from more samples, False if not.
      */
-    bool needsMoreSamples() const final EXCLUDES(mMutex);
+    bool needsMoreSamples() const final;
 
     struct Model {
         nsecs_t slope;
         nsecs_t intercept;
     };
 
-    VSyncPredictor::Model getVSyncPredictionModel() const EXCLUDES(mMutex);
+    VSyncPredictor::Model getVSyncPredictionModel() const;
 
-    bool isVSyncInPhase(nsecs_t timePoint, Fps frameRate) const final EXCLUDES(mMutex);
+    bool isVSyncInPhase(nsecs_t timePoint, Fps frameRate) const final EXCLUDES(mSequenceMutex);
 
     void setDisplayModePtr(ftl::NonNull<DisplayModePtr>) final EXCLUDES(mMutex);
 
@@ -84,19 +85,39 @@ private:
     inline void traceInt64If(const char* name, int64_t value) const;
     inline void traceInt64(const char* name, int64_t value) const;
 
+    // What the readers need to predict vsyncs, published by the writer whenever it changes so
+    // that predictions never wait for the model to be updated.
+    struct Snapshot {
+        nsecs_t idealPeriod = 0;
+        Model model = {0, 0};
+        size_t numSamples = 0;
+        // Only valid when numSamples is non-zero.
+        nsecs_t oldestTimestamp = 0;
+        std::optional<nsecs_t> knownTimestamp;
+        std::optional<Fps> renderRate;
+        nsecs_t minFramePeriod = 0;
+    };
+
     size_t next(size_t i) const REQUIRES(mMutex);
+    nsecs_t oldestTimestamp() const REQUIRES(mMutex);
+    static int64_t snapToOrdinal(nsecs_t timestamp, nsecs_t period);
+    void rebuildRegressionSums(nsecs_t period) REQUIRES(mMutex);
     bool validate(nsecs_t timestamp) const REQUIRES(mMutex);
-    Model getVSyncPredictionModelLocked() const REQUIRES(mMutex);
-    nsecs_t nextAnticipatedVSyncTimeFromLocked(nsecs_t timePoint) const REQUIRES(mMutex);
-    bool isVSyncInPhaseLocked(nsecs_t timePoint, unsigned divisor) const REQUIRES(mMutex);
+    bool addVsyncTimestampLocked(nsecs_t timestamp) REQUIRES(mMutex);
+    void publishSnapshot() REQUIRES(mMutex);
+    nsecs_t nextAnticipatedVSyncTimeFrom(const Snapshot&, nsecs_t timePoint) const;
+    bool isVSyncInPhase(const Snapshot&, nsecs_t timePoint, unsigned divisor) const
+            REQUIRES(mSequenceMutex);
     Period minFramePeriodLocked() const REQUIRES(mMutex);
-    void ensureMinFrameDurationIsKept(TimePoint, TimePoint) REQUIRES(mMutex);
+    void ensureMinFrameDurationIsKept(TimePoint, TimePoint) REQUIRES(mMutex)
+            EXCLUDES(mSequenceMutex);
 
     struct VsyncSequence {
         nsecs_t vsyncTime;
         int64_t seq;
     };
-    VsyncSequence getVsyncSequenceLocked(nsecs_t timestamp) const REQUIRES(mMutex);
+    VsyncSequence getVsyncSequence(const Snapshot&, nsecs_t timestamp) const
+            REQUIRES(mSequenceMutex);
     nsecs_t idealPeriod() const REQUIRES(mMutex);
 
     bool const mTraceOn;
@@ -104,7 +125,14 @@ private:
     size_t const kMinimumSamplesForPrediction;
     size_t const kOutlierTolerancePercent;
     IVsyncTrackerCallback& mVsyncTrackerCallback;
+
+    // Held while the model is updated. Predictions only read mSnapshot and take mSequenceMutex,
+    // so they never wait for a model update. When both are taken, mMutex is taken first.
     std::mutex mutable mMutex;
+    std::mutex mutable mSequenceMutex;
+
+    // Only stored to with mMutex held.
+    SeqLock<Snapshot> mSnapshot;
 
     std::optional<nsecs_t> mKnownTimestamp GUARDED_BY(mMutex);
 
@@ -114,10 +142,58 @@ private:
     size_t mLastTimestampIndex GUARDED_BY(mMutex) = 0;
     std::vector<nsecs_t> mTimestamps GUARDED_BY(mMutex);
 
+    struct Sample {
+        nsecs_t timestamp;
+        int64_t ordinal;
+    };
+
+    // Running sums of the regression over the timestamps in the window. Timestamps are relative
+    // to mSumsAnchor, and ordinals count whole vsync periods from it.
+    struct RegressionSums {
+        int64_t ordinals = 0;
+        int64_t timestamps = 0;
+        int64_t ordinalsSquared = 0;
+        int64_t products = 0;
+
+        void add(int64_t ordinal, nsecs_t timestamp) {
+            ordinals += ordinal;
+            timestamps += timestamp;
+            ordinalsSquared += ordinal * ordinal;
+            products += ordinal * timestamp;
+        }
+
+        void remove(int64_t ordinal, nsecs_t timestamp) {
+            ordinals -= ordinal;
+            timestamps -= timestamp;
+            ordinalsSquared -= ordinal * ordinal;
+            products -= ordinal * timestamp;
+        }
+    };
+
+    // The ordinal of each entry of mTimestamps, at the same index.
+    std::vector<int64_t> mOrdinals GUARDED_BY(mMutex);
+    RegressionSums mSums GUARDED_BY(mMutex);
+    nsecs_t mSumsAnchor GUARDED_BY(mMutex) = 0;
+
+    // The period the ordinals were snapped with when the sums were last rebuilt, and how far the
+    // period has moved from it since.
+    nsecs_t mRebuildPeriod GUARDED_BY(mMutex) = 0;
+    nsecs_t mMaxPeriodDeviation GUARDED_BY(mMutex) = 0;
+
+    // Timestamps left until the sums are rebuilt, or zero if they need to be rebuilt right away.
+    size_t mSamplesUntilRebuild GUARDED_BY(mMutex) = 0;
+
+    // Timestamps left until every timestamp that arrived out of order, or far from its ordinal,
+    // has left the window. Until then, the sums are rebuilt on every timestamp.
+    size_t mIrregularSamples GUARDED_BY(mMutex) = 0;
+
     ftl::NonNull<DisplayModePtr> mDisplayModePtr GUARDED_BY(mMutex);
     std::optional<Fps> mRenderRateOpt GUARDED_BY(mMutex);
 
-    mutable std::optional<VsyncSequence> mLastVsyncSequence GUARDED_BY(mMutex);
+    // The mode passed to mVsyncTrackerCallback, updated together with mDisplayModePtr.
+    ftl::NonNull<DisplayModePtr> mCallbackDisplayModePtr GUARDED_BY(mSequenceMutex);
+
+    mutable std::optional<VsyncSequence> mLastVsyncSequence GUARDED_BY(mSequenceMutex);
 
     std::deque<TimePoint> mPastExpectedPresentTimes GUARDED_BY(mMutex);
 };
@@ -34,6 +34,7 @@
 #include "VSyncTracker.h"
 
 namespace android {
+class EventThreadBenchmark;
 class EventThreadTest;
 class VsyncScheduleTest;
 }
@@ -123,6 +124,7 @@ protected:
 
 private:
     friend class TestableScheduler;
+    friend class android::EventThreadBenchmark;
     friend class android::EventThreadTest;
     friend class android::VsyncScheduleTest;
     friend class android::fuzz::SchedulerFuzzer;
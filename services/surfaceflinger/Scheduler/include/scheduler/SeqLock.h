@@ -0,0 +1,79 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace android::scheduler {
+
+// Publishes a small value from one writer to any number of readers without ever blocking the
+// writer. Readers retry while a store is in progress, so stores should be short and infrequent
+// compared to loads. Stores must be serialized by the caller, e.g. by a mutex held by the writer.
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    explicit SeqLock(const T& value = {}) { store(value); }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    void store(const T& value) {
+        const uint32_t sequence = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::array<uint64_t, kWords> words{};
+        std::memcpy(words.data(), &value, sizeof(T));
+        for (size_t i = 0; i < kWords; i++) {
+            mWords[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        std::array<uint64_t, kWords> words;
+        while (true) {
+            const uint32_t before = mSequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < kWords; i++) {
+                words[i] = mWords[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint32_t after = mSequence.load(std::memory_order_relaxed);
+
+            if (before == after && before % 2 == 0) break;
+        }
+
+        T value;
+        std::memcpy(&value, words.data(), sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint32_t> mSequence = 0;
+    std::array<std::atomic<uint64_t>, kWords> mWords{};
+};
+
+} // namespace android::scheduler
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <scheduler/SeqLock.h>
+
+namespace android::scheduler {
+namespace {
+
+// Odd sized so that the value does not fill its last word.
+struct Value {
+    int64_t a = 0;
+    int64_t b = 0;
+    int32_t c = 0;
+};
+
+TEST(SeqLockTest, loadsInitialValue) {
+    const SeqLock<Value> lock(Value{1, 2, 3});
+
+    const Value value = lock.load();
+    EXPECT_EQ(1, value.a);
+    EXPECT_EQ(2, value.b);
+    EXPECT_EQ(3, value.c);
+}
+
+TEST(SeqLockTest, loadsLatestStore) {
+    SeqLock<Value> lock;
+    EXPECT_EQ(0, lock.load().a);
+
+    lock.store({4, 5, 6});
+    lock.store({7, 8, 9});
+
+    const Value value = lock.load();
+    EXPECT_EQ(7, value.a);
+    EXPECT_EQ(8, value.b);
+    EXPECT_EQ(9, value.c);
+}
+
+TEST(SeqLockTest, neverLoadsTornValue) {
+    constexpr int64_t kStores = 100'000;
+    SeqLock<Value> lock;
+    std::atomic<bool> done = false;
+
+    std::thread writer([&] {
+        for (int64_t i = 1; i <= kStores; i++) {
+            lock.store({i, -i, static_cast<int32_t>(i)});
+        }
+        done = true;
+    });
+
+    int64_t last = 0;
+    while (!done) {
+        const Value value = lock.load();
+        ASSERT_EQ(value.a, -value.b);
+        ASSERT_EQ(static_cast<int32_t>(value.a), value.c);
+        ASSERT_GE(value.a, last);
+        last = value.a;
+    }
+    writer.join();
+
+    EXPECT_EQ(kStores, lock.load().a);
+}
+
+} // namespace
+} // namespace android::scheduler
@@ -554,6 +554,12 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
             base::GetBoolProperty("persist.debug.sf.enable_layer_lifecycle_manager"s, true);
     mLegacyFrontEndEnabled = !mLayerLifecycleManagerEnabled ||
             base::GetBoolProperty("persist.debug.sf.enable_legacy_frontend"s, false);
+
+    const int32_t snapshotWorkerThreads =
+            property_get_int32("debug.sf.layer_snapshot_worker_threads", 0);
+    if (snapshotWorkerThreads > 0) {
+        mLayerSnapshotBuilder.setParallelism(static_cast<size_t>(snapshotWorkerThreads));
+    }
 }
 
 LatchUnsignaledConfig SurfaceFlinger::getLatchUnsignaledConfig() {
@@ -862,6 +868,12 @@ void SurfaceFlinger::init() FTL_FAKE_GUARD(kMainThreadContext) {
     mCompositionEngine->getHwComposer().setCallback(*this);
     ClientCache::getInstance().setRenderEngine(&getRenderEngine());
 
+    const int32_t compositionWorkerThreads =
+            property_get_int32("debug.sf.composition_worker_threads", 0);
+    if (compositionWorkerThreads > 0) {
+        mCompositionEngine->setParallelism(static_cast<size_t>(compositionWorkerThreads));
+    }
+
     enableLatchUnsignaledConfig = getLatchUnsignaledConfig();
 
     if (base::GetBoolProperty("debug.sf.enable_hwc_vds"s, false)) {
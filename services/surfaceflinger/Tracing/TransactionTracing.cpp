@@ -182,6 +182,9 @@ void TransactionTracing::addCommittedTransactions(int64_t vsyncId, nsecs_t commi
     update.transactionIds.reserve(newUpdate.transactions.size());
     for (const auto& transaction : newUpdate.transactions) {
         update.transactionIds.emplace_back(transaction.id);
+        update.transactionIds.insert(update.transactionIds.end(),
+                                     transaction.coalescedTransactionIds.begin(),
+                                     transaction.coalescedTransactionIds.end());
     }
     update.displayInfoChanged = displayInfoChanged;
     if (displayInfoChanged) {
@@ -134,6 +134,10 @@ struct TransactionState {
     uint64_t id;
     bool sentFenceTimeoutWarning = false;
     std::vector<uint64_t> mergedTransactionIds;
+    // Transactions folded into this one by TransactionHandler when they became ready in the
+    // same frame. These were queued separately, unlike the client side merges which are only in
+    // mergedTransactionIds. Folded transactions are added to mergedTransactionIds as well.
+    std::vector<uint64_t> coalescedTransactionIds;
 };
 
 } // namespace android
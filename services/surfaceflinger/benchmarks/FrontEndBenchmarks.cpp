@@ -0,0 +1,129 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <ui/ShadowSettings.h>
+
+#include "Client.h" // temporarily needed for LayerCreationArgs
+#include "FrontEnd/LayerCreationArgs.h"
+#include "FrontEnd/LayerHierarchy.h"
+#include "FrontEnd/LayerLifecycleManager.h"
+#include "FrontEnd/LayerSnapshotBuilder.h"
+#include "TransactionState.h"
+
+namespace android::surfaceflinger::frontend {
+namespace {
+
+// A hierarchy of |roots| root layers, each with |children| children that each have |children|
+// children of their own. Every layer has a color so that it is visible.
+class FrontEnd {
+public:
+    FrontEnd(uint32_t roots, uint32_t children) {
+        uint32_t nextId = 1;
+        for (uint32_t root = 0; root < roots; root++) {
+            const uint32_t rootId = nextId++;
+            addLayer(rootId, UNASSIGNED_LAYER_ID);
+            for (uint32_t child = 0; child < children; child++) {
+                const uint32_t childId = nextId++;
+                addLayer(childId, rootId);
+                for (uint32_t grandChild = 0; grandChild < children; grandChild++) {
+                    addLayer(nextId++, childId);
+                }
+            }
+        }
+        mLayerCount = nextId - 1;
+        mLifecycleManager.applyTransactions(mColorTransactions);
+        mHierarchyBuilder.update(mLifecycleManager.getLayers(),
+                                 mLifecycleManager.getDestroyedLayers());
+    }
+
+    LayerSnapshotBuilder::Args args(LayerSnapshotBuilder::ForceUpdateFlags forceUpdate) {
+        return {.root = mHierarchyBuilder.getHierarchy(),
+                .layerLifecycleManager = mLifecycleManager,
+                .forceUpdate = forceUpdate,
+                .displays = mDisplays,
+                .globalShadowSettings = mShadowSettings,
+                .supportedLayerGenericMetadata = {},
+                .genericLayerMetadataKeyMap = {}};
+    }
+
+    uint32_t layerCount() const { return mLayerCount; }
+
+private:
+    void addLayer(uint32_t id, uint32_t parentId) {
+        LayerCreationArgs args(std::make_optional(id));
+        args.name = "benchmark";
+        args.addToRoot = parentId == UNASSIGNED_LAYER_ID;
+        args.parentId = parentId;
+        std::vector<std::unique_ptr<RequestedLayerState>> layers;
+        layers.emplace_back(std::make_unique<RequestedLayerState>(args));
+        mLifecycleManager.addLayers(std::move(layers));
+
+        TransactionState& transaction = mColorTransactions.emplace_back();
+        transaction.states.push_back({});
+        transaction.states.front().state.what = layer_state_t::eColorChanged;
+        transaction.states.front().state.color.rgb = half3(1._hf, 1._hf, 1._hf);
+        transaction.states.front().layerId = id;
+    }
+
+    LayerLifecycleManager mLifecycleManager;
+    LayerHierarchyBuilder mHierarchyBuilder{{}};
+    std::vector<TransactionState> mColorTransactions;
+    DisplayInfos mDisplays;
+    ShadowSettings mShadowSettings;
+    uint32_t mLayerCount = 0;
+};
+
+void BM_SnapshotBuilderFullUpdate(benchmark::State& state) {
+    FrontEnd frontEnd(/*roots=*/8, static_cast<uint32_t>(state.range(0)));
+    LayerSnapshotBuilder builder;
+    const auto args = frontEnd.args(LayerSnapshotBuilder::ForceUpdateFlags::ALL);
+    for (auto _ : state) {
+        builder.update(args);
+    }
+    state.SetItemsProcessed(state.iterations() * frontEnd.layerCount());
+}
+BENCHMARK(BM_SnapshotBuilderFullUpdate)->Arg(8)->Arg(24);
+
+void BM_SnapshotBuilderGetSnapshot(benchmark::State& state) {
+    FrontEnd frontEnd(/*roots=*/8, static_cast<uint32_t>(state.range(0)));
+    LayerSnapshotBuilder builder(frontEnd.args(LayerSnapshotBuilder::ForceUpdateFlags::ALL));
+    for (auto _ : state) {
+        for (uint32_t id = 1; id <= frontEnd.layerCount(); id++) {
+            benchmark::DoNotOptimize(builder.getSnapshot(id));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * frontEnd.layerCount());
+}
+BENCHMARK(BM_SnapshotBuilderGetSnapshot)->Arg(8)->Arg(24);
+
+void BM_SnapshotBuilderForEachVisibleSnapshot(benchmark::State& state) {
+    FrontEnd frontEnd(/*roots=*/8, static_cast<uint32_t>(state.range(0)));
+    LayerSnapshotBuilder builder(frontEnd.args(LayerSnapshotBuilder::ForceUpdateFlags::ALL));
+    for (auto _ : state) {
+        size_t visible = 0;
+        builder.forEachVisibleSnapshot([&visible](const LayerSnapshot&) { visible++; });
+        benchmark::DoNotOptimize(visible);
+    }
+    state.SetItemsProcessed(state.iterations() * frontEnd.layerCount());
+}
+BENCHMARK(BM_SnapshotBuilderForEachVisibleSnapshot)->Arg(8)->Arg(24);
+
+} // namespace
+} // namespace android::surfaceflinger::frontend
+
+BENCHMARK_MAIN();
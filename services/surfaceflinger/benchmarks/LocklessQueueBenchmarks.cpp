@@ -0,0 +1,132 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <atomic>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LocklessQueue.h"
+
+namespace {
+
+// The queue as it was before entries were pooled: one allocation per push and a copy of the
+// value into the entry. Kept here as the baseline.
+template <typename T>
+class AllocatingLocklessQueue {
+public:
+    class Entry {
+    public:
+        T mValue;
+        std::atomic<Entry*> mNext;
+        Entry(T value) : mValue(value) {}
+    };
+    std::atomic<Entry*> mPush = nullptr;
+    std::atomic<Entry*> mPop = nullptr;
+
+    void push(T value) {
+        Entry* entry = new Entry(value);
+        Entry* previousHead = mPush.load();
+        do {
+            entry->mNext = previousHead;
+        } while (!mPush.compare_exchange_weak(previousHead, entry));
+    }
+    std::optional<T> pop() {
+        Entry* popped = mPop.load();
+        if (popped) {
+            mPop.store(popped->mNext);
+            auto value = popped->mValue;
+            delete popped;
+            return value;
+        } else {
+            Entry* grabbedList = mPush.exchange(nullptr);
+            if (!grabbedList) return std::nullopt;
+            while (grabbedList->mNext) {
+                Entry* next = grabbedList->mNext;
+                grabbedList->mNext = popped;
+                popped = grabbedList;
+                grabbedList = next;
+            }
+            mPop.store(popped);
+            auto value = grabbedList->mValue;
+            delete grabbedList;
+            return value;
+        }
+    }
+};
+
+// Stand-in for TransactionState: some inline state plus a few heap backed members.
+struct Payload {
+    std::array<uint8_t, 256> inlineState{};
+    std::vector<int> states = std::vector<int>(8);
+    std::string debugName = std::string(48, 'x');
+};
+
+constexpr int kProducers = 16;
+constexpr int kPushesPerProducer = 64;
+
+// Each iteration, kProducers threads each push kPushesPerProducer payloads while the benchmark
+// thread pops them all, as binder threads and the main thread do with incoming transactions.
+template <typename Queue>
+void BM_Contention(benchmark::State& state) {
+    Queue queue;
+    std::atomic<int> generation = 0;
+    std::atomic<bool> done = false;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&]() {
+            int seen = 0;
+            while (true) {
+                int current;
+                while ((current = generation.load()) == seen && !done) {
+                    std::this_thread::yield();
+                }
+                if (done) return;
+                seen = current;
+                for (int i = 0; i < kPushesPerProducer; i++) {
+                    queue.push(Payload{});
+                }
+            }
+        });
+    }
+
+    for (auto _ : state) {
+        generation++;
+        int popped = 0;
+        while (popped < kProducers * kPushesPerProducer) {
+            auto value = queue.pop();
+            if (value) {
+                benchmark::DoNotOptimize(value);
+                popped++;
+            }
+        }
+    }
+
+    done = true;
+    for (auto& producer : producers) producer.join();
+    state.SetItemsProcessed(state.iterations() * kProducers * kPushesPerProducer);
+}
+BENCHMARK(BM_Contention<AllocatingLocklessQueue<Payload>>)->UseRealTime();
+BENCHMARK(BM_Contention<LocklessQueue<Payload>>)->UseRealTime();
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,426 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <scheduler/TimeKeeper.h>
+
+#include "DisplayHardware/DisplayMode.h"
+#include "FrameTimeline.h"
+#include "Scheduler/EventThread.h"
+#include "Scheduler/RefreshRateSelector.h"
+#include "Scheduler/VSyncDispatchTimerQueue.h"
+#include "Scheduler/VSyncPredictor.h"
+#include "Scheduler/VsyncSchedule.h"
+
+namespace android {
+
+// Builds the VsyncSchedule of an EventThread around a dispatch that the benchmark drives.
+class EventThreadBenchmark {
+public:
+    static std::shared_ptr<scheduler::VsyncSchedule> createVsyncSchedule(
+            scheduler::VsyncSchedule::TrackerPtr tracker,
+            scheduler::VsyncSchedule::DispatchPtr dispatch) {
+        return std::shared_ptr<scheduler::VsyncSchedule>(
+                new scheduler::VsyncSchedule(PhysicalDisplayId::fromPort(0), std::move(tracker),
+                                             std::move(dispatch), nullptr));
+    }
+};
+
+} // namespace android
+
+namespace android::scheduler {
+namespace {
+
+using namespace std::chrono_literals;
+
+constexpr nsecs_t kPeriod = 16'666'667;
+constexpr size_t kHistorySize = 20;
+constexpr size_t kMinimumSamplesForPrediction = 6;
+constexpr uint32_t kOutlierTolerancePercent = 25;
+
+struct NoOpVsyncTrackerCallback final : IVsyncTrackerCallback {
+    void onVsyncGenerated(TimePoint, ftl::NonNull<DisplayModePtr>, Fps) override {}
+};
+
+ftl::NonNull<DisplayModePtr> displayMode() {
+    return ftl::as_non_null(DisplayMode::Builder(hal::HWConfigId(0))
+                                    .setId(DisplayModeId(0))
+                                    .setPhysicalDisplayId(PhysicalDisplayId::fromPort(0))
+                                    .setVsyncPeriod(kPeriod)
+                                    .setResolution(ui::Size(1080, 2400))
+                                    .build());
+}
+
+// A predictor with a trained model. When |updating| is set, a thread keeps feeding it vsync
+// timestamps as fast as it can, like HWC vsync callbacks during resync but without the pauses.
+class Predictor {
+public:
+    explicit Predictor(bool updating) {
+        for (size_t i = 0; i < kHistorySize; i++) {
+            addVsync();
+        }
+        if (updating) {
+            mWriter = std::thread([this] {
+                while (!mDone) {
+                    addVsync();
+                }
+            });
+        }
+    }
+
+    ~Predictor() {
+        mDone = true;
+        if (mWriter.joinable()) mWriter.join();
+    }
+
+    VSyncPredictor& tracker() { return *mTracker; }
+    const std::shared_ptr<VSyncPredictor>& trackerPtr() const { return mTracker; }
+    nsecs_t lastVsync() const { return mLastVsync; }
+
+private:
+    void addVsync() {
+        const nsecs_t vsync = mLastVsync + kPeriod;
+        mTracker->addVsyncTimestamp(vsync);
+        mLastVsync = vsync;
+    }
+
+    NoOpVsyncTrackerCallback mCallback;
+    const std::shared_ptr<VSyncPredictor> mTracker =
+            std::make_shared<VSyncPredictor>(displayMode(), kHistorySize,
+                                             kMinimumSamplesForPrediction,
+                                             kOutlierTolerancePercent, mCallback);
+    std::atomic<nsecs_t> mLastVsync = 0;
+    std::atomic<bool> mDone = false;
+    std::thread mWriter;
+};
+
+void BM_CurrentPeriod(benchmark::State& state) {
+    Predictor predictor(state.range(0) != 0);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(predictor.tracker().currentPeriod());
+    }
+}
+BENCHMARK(BM_CurrentPeriod)->Arg(false)->Arg(true);
+
+void BM_NextAnticipatedVSyncTimeFrom(benchmark::State& state) {
+    Predictor predictor(state.range(0) != 0);
+    for (auto _ : state) {
+        const nsecs_t timePoint = predictor.lastVsync() + kPeriod / 3;
+        benchmark::DoNotOptimize(predictor.tracker().nextAnticipatedVSyncTimeFrom(timePoint));
+    }
+}
+BENCHMARK(BM_NextAnticipatedVSyncTimeFrom)->Arg(false)->Arg(true);
+
+void BM_IsVSyncInPhase(benchmark::State& state) {
+    Predictor predictor(state.range(0) != 0);
+    const Fps halfRate = Fps::fromPeriodNsecs(kPeriod * 2);
+    for (auto _ : state) {
+        const nsecs_t timePoint = predictor.lastVsync() + kPeriod;
+        benchmark::DoNotOptimize(predictor.tracker().isVSyncInPhase(timePoint, halfRate));
+    }
+}
+BENCHMARK(BM_IsVSyncInPhase)->Arg(false)->Arg(true);
+
+// Feeds vsync timestamps of a steady display to a predictor with a history of state.range(0)
+// timestamps. Updating the model should cost about the same regardless of the history size.
+void BM_AddVsyncTimestamp(benchmark::State& state) {
+    const auto historySize = static_cast<size_t>(state.range(0));
+
+    NoOpVsyncTrackerCallback callback;
+    VSyncPredictor tracker(displayMode(), historySize, kMinimumSamplesForPrediction,
+                           kOutlierTolerancePercent, callback);
+
+    nsecs_t vsync = 0;
+    for (size_t i = 0; i < historySize; i++) {
+        vsync += kPeriod;
+        tracker.addVsyncTimestamp(vsync);
+    }
+
+    for (auto _ : state) {
+        vsync += kPeriod;
+        benchmark::DoNotOptimize(tracker.addVsyncTimestamp(vsync));
+    }
+}
+BENCHMARK(BM_AddVsyncTimestamp)->Arg(kHistorySize)->Arg(256)->Arg(4096);
+
+// A timer that only fires when told to, at the time it was armed for.
+class ManualTimeKeeper final : public TimeKeeper {
+public:
+    explicit ManualTimeKeeper(nsecs_t now) : mNow(now) {}
+
+    nsecs_t now() const override { return mNow; }
+
+    void alarmAt(std::function<void()> callback, nsecs_t time) override {
+        mCallback = std::move(callback);
+        mAlarmTime = time;
+    }
+
+    void alarmCancel() override { mCallback = nullptr; }
+    void dump(std::string&) const override {}
+
+    void fire() {
+        if (auto callback = std::exchange(mCallback, nullptr)) {
+            mNow = mAlarmTime;
+            callback();
+        }
+    }
+
+private:
+    nsecs_t mNow;
+    nsecs_t mAlarmTime = 0;
+    std::function<void()> mCallback;
+};
+
+// Registers state.range(0) callbacks, of which state.range(1) schedule themselves for every vsync
+// with staggered work durations, and measures a frame worth of timer fires.
+void BM_DispatchCallbacks(benchmark::State& state) {
+    const auto registeredCount = static_cast<size_t>(state.range(0));
+    const auto scheduledCount = static_cast<size_t>(state.range(1));
+
+    Predictor predictor(false);
+    auto timeKeeperPtr = std::make_unique<ManualTimeKeeper>(predictor.lastVsync());
+    ManualTimeKeeper& timeKeeper = *timeKeeperPtr;
+    VSyncDispatchTimerQueue dispatch(std::move(timeKeeperPtr), predictor.trackerPtr(),
+                                     /*timerSlack*/ 500'000, /*minVsyncDistance*/ 3'000'000);
+
+    std::vector<VSyncDispatch::CallbackToken> tokens;
+    tokens.reserve(registeredCount);
+    const auto timing = [](size_t i, nsecs_t earliestVsync) {
+        return VSyncDispatch::ScheduleTiming{.workDuration = static_cast<nsecs_t>(i % 8 + 1) *
+                                                     1'000'000,
+                                             .readyDuration = 0,
+                                             .earliestVsync = earliestVsync};
+    };
+    for (size_t i = 0; i < registeredCount; i++) {
+        tokens.push_back(dispatch.registerCallback(
+                [&, i](nsecs_t vsyncTime, nsecs_t, nsecs_t) {
+                    dispatch.schedule(tokens[i], timing(i, vsyncTime + kPeriod));
+                },
+                "callback"));
+    }
+    for (size_t i = 0; i < scheduledCount; i++) {
+        dispatch.schedule(tokens[i], timing(i, 0));
+    }
+
+    for (auto _ : state) {
+        // The work durations spread the wakeups over eight timer fires per vsync.
+        for (int i = 0; i < 8; i++) {
+            timeKeeper.fire();
+        }
+    }
+
+    for (const auto token : tokens) {
+        dispatch.unregisterCallback(token);
+    }
+}
+BENCHMARK(BM_DispatchCallbacks)
+        ->Args({8, 8})
+        ->Args({64, 8})
+        ->Args({512, 8})
+        ->Args({64, 64})
+        ->Args({512, 512});
+
+// Stands in for VSyncDispatchTimerQueue, invoking the callback of an EventThread on demand.
+class ManualVSyncDispatch final : public VSyncDispatch {
+public:
+    CallbackToken registerCallback(Callback callback, std::string) override {
+        mCallback = std::move(callback);
+        return CallbackToken(0);
+    }
+
+    void unregisterCallback(CallbackToken) override {}
+
+    ScheduleResult schedule(CallbackToken, ScheduleTiming timing) override {
+        mScheduled = true;
+        return timing.earliestVsync - timing.workDuration - timing.readyDuration;
+    }
+
+    ScheduleResult update(CallbackToken token, ScheduleTiming timing) override {
+        return schedule(token, timing);
+    }
+
+    CancelResult cancel(CallbackToken) override { return CancelResult::Cancelled; }
+    void dump(std::string&) const override {}
+
+    bool scheduled() const { return mScheduled; }
+
+    void onVsync(nsecs_t vsyncTime) {
+        mCallback(vsyncTime, vsyncTime - kPeriod, vsyncTime - kPeriod / 4);
+    }
+
+private:
+    Callback mCallback;
+    std::atomic<bool> mScheduled = false;
+};
+
+// A Choreographer client that only counts the vsync events it receives.
+class CountingConnection final : public EventThreadConnection {
+public:
+    CountingConnection(android::impl::EventThread* eventThread, uid_t uid,
+                       std::atomic<size_t>& vsyncCount)
+          : EventThreadConnection(eventThread, uid), mVsyncCount(vsyncCount) {}
+
+    status_t postEvent(const DisplayEventReceiver::Event& event) override {
+        if (event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+            mVsyncCount++;
+        }
+        return NO_ERROR;
+    }
+
+private:
+    std::atomic<size_t>& mVsyncCount;
+};
+
+// Half of the clients have their frame rate overridden to half the display rate.
+struct NoThrottleCallback final : IEventThreadCallback {
+    bool throttleVsync(TimePoint, uid_t) override { return false; }
+    Period getVsyncPeriod(uid_t uid) override { return Period::fromNs(kPeriod * (uid % 2 + 1)); }
+    void resync() override {}
+};
+
+// Registers state.range(0) connections that all want every vsync, and measures how long the
+// EventThread takes to post a vsync event to each of them.
+void BM_EventThreadVsyncFanOut(benchmark::State& state) {
+    const auto connectionCount = static_cast<size_t>(state.range(0));
+
+    Predictor predictor(false);
+    const auto dispatch = std::make_shared<ManualVSyncDispatch>();
+    frametimeline::impl::TokenManager tokenManager;
+    NoThrottleCallback callback;
+    auto vsyncSchedule =
+            EventThreadBenchmark::createVsyncSchedule(predictor.trackerPtr(), dispatch);
+    android::impl::EventThread eventThread("benchmark", std::move(vsyncSchedule), &tokenManager,
+                                           callback, /*workDuration*/ 8ms, /*readyDuration*/ 4ms);
+    eventThread.onHotplugReceived(PhysicalDisplayId::fromPort(0), true);
+
+    std::atomic<size_t> vsyncCount = 0;
+    std::vector<sp<CountingConnection>> connections;
+    for (size_t i = 0; i < connectionCount; i++) {
+        connections.push_back(sp<CountingConnection>::make(&eventThread,
+                                                           static_cast<uid_t>(10000 + i),
+                                                           vsyncCount));
+        eventThread.setVsyncRate(1, connections.back());
+    }
+
+    // The EventThread schedules its callback once the display is connected and clients want vsync.
+    while (!dispatch->scheduled()) {
+        std::this_thread::yield();
+    }
+
+    nsecs_t vsyncTime = predictor.lastVsync();
+    size_t expectedCount = 0;
+    for (auto _ : state) {
+        vsyncTime += kPeriod;
+        dispatch->onVsync(vsyncTime);
+        expectedCount += connectionCount;
+        while (vsyncCount < expectedCount) {
+            std::this_thread::yield();
+        }
+    }
+}
+BENCHMARK(BM_EventThreadVsyncFanOut)->Arg(16)->Arg(64)->Arg(256)->UseRealTime();
+
+using LayerRequirement = RefreshRateSelector::LayerRequirement;
+using LayerVoteType = RefreshRateSelector::LayerVoteType;
+
+// The modes of a panel that supports the common content rates.
+DisplayModes displayModes() {
+    constexpr Fps kRates[] = {24_Hz, 25_Hz, 30_Hz, 48_Hz,  50_Hz,  60_Hz,
+                              72_Hz, 90_Hz, 96_Hz, 100_Hz, 120_Hz, 144_Hz};
+
+    DisplayModes modes;
+    for (size_t i = 0; i < std::size(kRates); i++) {
+        const DisplayModeId modeId(static_cast<int32_t>(i));
+        modes.try_emplace(modeId,
+                          DisplayMode::Builder(hal::HWConfigId(modeId.value()))
+                                  .setId(modeId)
+                                  .setPhysicalDisplayId(PhysicalDisplayId::fromPort(0))
+                                  .setVsyncPeriod(kRates[i].getPeriodNsecs())
+                                  .setResolution(ui::Size(1080, 2400))
+                                  .build());
+    }
+    return modes;
+}
+
+// Summarizes 40 layers as LayerHistory would for video with UI on top, a game, or the idle home
+// screen. Configurations past the first three differ in the frame rate of the foreground content.
+std::vector<LayerRequirement> layerRequirements(size_t configuration) {
+    constexpr size_t kLayerCount = 40;
+    constexpr Fps kContentRates[] = {24_Hz, 30_Hz, 60_Hz};
+    const Fps contentRate = kContentRates[configuration / 3 % std::size(kContentRates)];
+
+    std::vector<LayerRequirement> layers;
+    layers.reserve(kLayerCount);
+    for (size_t i = 0; i < kLayerCount; i++) {
+        LayerRequirement layer{.name = "layer#" + std::to_string(i),
+                               .ownerUid = static_cast<uid_t>(10000 + i % 4),
+                               .weight = 1.f / static_cast<float>(i + 1)};
+
+        switch (configuration % 3) {
+            case 0: // Video with UI on top.
+                layer.vote = i == 0 ? LayerVoteType::ExplicitExactOrMultiple
+                                    : LayerVoteType::Heuristic;
+                layer.desiredRefreshRate = i == 0 ? contentRate : 60_Hz;
+                break;
+            case 1: // Game.
+                layer.vote = i == 0 ? LayerVoteType::ExplicitDefault : LayerVoteType::NoVote;
+                layer.desiredRefreshRate = Fps::fromValue(contentRate.getValue() * 2);
+                break;
+            case 2: // Idle.
+                layer.vote = i % 2 ? LayerVoteType::Min : LayerVoteType::NoVote;
+                break;
+        }
+
+        layer.focused = i == 0;
+        layers.push_back(std::move(layer));
+    }
+    return layers;
+}
+
+// Ranks the frame rates of 12 modes for state.range(0) configurations of 40 layers in turn, as if
+// the content switched between them every frame.
+void BM_GetRankedFrameRates(benchmark::State& state) {
+    const auto configurationCount = static_cast<size_t>(state.range(0));
+
+    const RefreshRateSelector selector(displayModes(), DisplayModeId(5));
+
+    std::vector<std::vector<LayerRequirement>> configurations;
+    for (size_t i = 0; i < configurationCount; i++) {
+        configurations.push_back(layerRequirements(i));
+    }
+
+    size_t configuration = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+                selector.getRankedFrameRates(configurations[configuration], {}));
+        configuration = (configuration + 1) % configurationCount;
+    }
+}
+BENCHMARK(BM_GetRankedFrameRates)->Arg(1)->Arg(3)->Arg(6);
+
+} // namespace
+} // namespace android::scheduler
+
+BENCHMARK_MAIN();
@@ -141,6 +141,7 @@ protected:
 
     static constexpr uid_t mConnectionUid = 443;
     static constexpr uid_t mThrottledConnectionUid = 177;
+    static constexpr uid_t mHalfRateConnectionUid = 316;
 };
 
 EventThreadTest::EventThreadTest() {
@@ -179,8 +180,8 @@ bool EventThreadTest::throttleVsync(android::TimePoint expectedVsyncTimestamp, u
     return (uid == mThrottledConnectionUid);
 }
 
-Period EventThreadTest::getVsyncPeriod(uid_t) {
-    return mVsyncPeriod;
+Period EventThreadTest::getVsyncPeriod(uid_t uid) {
+    return uid == mHalfRateConnectionUid ? mVsyncPeriod * 2 : mVsyncPeriod;
 }
 
 void EventThreadTest::resync() {
@@ -599,6 +600,61 @@ TEST_F(EventThreadTest, setVsyncRateTwoPostsEveryOtherEventToThatConnection) {
     expectVsyncEventReceivedByConnection(101112, 4u);
 }
 
+TEST_F(EventThreadTest, connectionsShareFrameTimelinesForTheSameFrameInterval) {
+    setupEventThread();
+
+    ConnectionEventRecorder firstConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> firstConnection = createConnection(firstConnectionEventRecorder);
+    mThread->setVsyncRate(1, firstConnection);
+    ConnectionEventRecorder secondConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> secondConnection =
+            createConnection(secondConnectionEventRecorder);
+    mThread->setVsyncRate(1, secondConnection);
+    ConnectionEventRecorder halfRateConnectionEventRecorder{0};
+    sp<MockEventThreadConnection> halfRateConnection =
+            createConnection(halfRateConnectionEventRecorder, {}, mHalfRateConnectionUid);
+    mThread->setVsyncRate(1, halfRateConnection);
+
+    expectVSyncCallbackScheduleReceived(true);
+    onVSyncEvent(123, 456, 789);
+
+    auto args = firstConnectionEventRecorder.waitForCall();
+    ASSERT_TRUE(args.has_value());
+    const VsyncEventData first = std::get<0>(args.value()).vsync.vsyncData;
+    args = secondConnectionEventRecorder.waitForCall();
+    ASSERT_TRUE(args.has_value());
+    const VsyncEventData second = std::get<0>(args.value()).vsync.vsyncData;
+    args = halfRateConnectionEventRecorder.waitForCall();
+    ASSERT_TRUE(args.has_value());
+    const VsyncEventData halfRate = std::get<0>(args.value()).vsync.vsyncData;
+
+    EXPECT_EQ(mVsyncPeriod.count(), first.frameInterval);
+    EXPECT_EQ(mVsyncPeriod.count() * 2, halfRate.frameInterval);
+
+    ASSERT_EQ(first.frameTimelinesLength, second.frameTimelinesLength);
+    EXPECT_EQ(first.preferredFrameTimelineIndex, second.preferredFrameTimelineIndex);
+    for (size_t i = 0; i < first.frameTimelinesLength; i++) {
+        EXPECT_EQ(first.frameTimelines[i].vsyncId, second.frameTimelines[i].vsyncId);
+        EXPECT_EQ(first.frameTimelines[i].deadlineTimestamp,
+                  second.frameTimelines[i].deadlineTimestamp);
+        EXPECT_EQ(first.frameTimelines[i].expectedPresentationTime,
+                  second.frameTimelines[i].expectedPresentationTime);
+    }
+
+    // The half rate timelines are spaced differently, so they get predictions of their own.
+    for (size_t i = 0; i < halfRate.frameTimelinesLength; i++) {
+        const auto prediction =
+                mTokenManager->getPredictionsForToken(halfRate.frameTimelines[i].vsyncId);
+        ASSERT_TRUE(prediction.has_value());
+        EXPECT_EQ(halfRate.frameTimelines[i].deadlineTimestamp, prediction->endTime);
+        if (i > 0) {
+            EXPECT_EQ(mVsyncPeriod.count() * 2,
+                      halfRate.frameTimelines[i].deadlineTimestamp -
+                              halfRate.frameTimelines[i - 1].deadlineTimestamp);
+        }
+    }
+}
+
 TEST_F(EventThreadTest, connectionsRemovedIfInstanceDestroyed) {
     setupEventThread();
 
@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 
 #include <renderengine/mock/FakeExternalTexture.h>
+#include <utils/Timers.h>
 
 #include "FrontEnd/LayerHierarchy.h"
 #include "FrontEnd/LayerLifecycleManager.h"
@@ -1200,4 +1201,98 @@ TEST_F(LayerSnapshotTest, propagateDropInputMode) {
     EXPECT_EQ(getSnapshot(11)->dropInputMode, gui::DropInputMode::ALL);
 }
 
+TEST_F(LayerSnapshotTest, parallelUpdate) {
+    mSnapshotBuilder.setParallelism(2);
+    size_t startingNumSnapshots = mSnapshotBuilder.getSnapshots().size();
+    setAlpha(1, 0.5);
+    setAlpha(122, 0.5);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(getSnapshot(12)->alpha, 0.5f);
+    EXPECT_EQ(getSnapshot(1221)->alpha, 0.25f);
+
+    // Snapshots created on worker threads are merged back into the builder.
+    createDisplayMirrorLayer(3, ui::LayerStack::fromValue(0));
+    setLayerStack(3, 1);
+    std::vector<uint32_t> expected = {1, 11, 111, 12, 121, 122, 1221, 13, 2, 3,
+                                      1, 11, 111, 12, 121, 122, 1221, 13, 2};
+    UPDATE_AND_VERIFY(mSnapshotBuilder, expected);
+    EXPECT_EQ(getSnapshot({.id = 1221, .mirrorRootIds = 3u})->outputFilter.layerStack.id, 1u);
+
+    destroyLayerHandle(3);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, STARTING_ZORDER);
+    EXPECT_EQ(startingNumSnapshots, mSnapshotBuilder.getSnapshots().size());
+}
+
+TEST_F(LayerSnapshotTest, parallelUpdateWithRelativeLayers) {
+    mSnapshotBuilder.setParallelism(2);
+    reparentRelativeLayer(13, 11);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 13, 111, 12, 121, 122, 1221, 2});
+    hideLayer(11);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 12, 121, 122, 1221, 2});
+
+    // Relative parent under a different child of the root.
+    showLayer(11);
+    reparentRelativeLayer(13, 2);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 111, 12, 121, 122, 1221, 2, 13});
+    hideLayer(2);
+    UPDATE_AND_VERIFY(mSnapshotBuilder, {1, 11, 111, 12, 121, 122, 1221});
+}
+
+// Compares a serial and a parallel walk of a hierarchy with several thousand layers. Timings are
+// recorded as test properties; the test only fails if the walks disagree.
+TEST_F(LayerSnapshotTest, parallelUpdatePerf) {
+    constexpr uint32_t kRoots = 16;
+    constexpr uint32_t kChildrenPerRoot = 16;
+    constexpr uint32_t kGrandChildrenPerChild = 16;
+    for (uint32_t root = 0; root < kRoots; root++) {
+        const uint32_t rootId = 10000 + root * 1000;
+        createRootLayer(rootId);
+        for (uint32_t child = 0; child < kChildrenPerRoot; child++) {
+            const uint32_t childId = rootId + (child + 1) * 20;
+            createLayer(childId, rootId);
+            for (uint32_t grandChild = 0; grandChild < kGrandChildrenPerChild; grandChild++) {
+                createLayer(childId + grandChild + 1, childId);
+            }
+        }
+    }
+    mHierarchyBuilder.update(mLifecycleManager.getLayers(),
+                             mLifecycleManager.getDestroyedLayers());
+    LayerSnapshotBuilder::Args args{.root = mHierarchyBuilder.getHierarchy(),
+                                    .layerLifecycleManager = mLifecycleManager,
+                                    .forceUpdate = LayerSnapshotBuilder::ForceUpdateFlags::ALL,
+                                    .includeMetadata = false,
+                                    .displays = mFrontEndDisplayInfos,
+                                    .globalShadowSettings = globalShadowSettings,
+                                    .supportsBlur = true,
+                                    .supportedLayerGenericMetadata = {},
+                                    .genericLayerMetadataKeyMap = {}};
+
+    constexpr int kIterations = 20;
+    auto timeUpdates = [&](LayerSnapshotBuilder& builder) {
+        const nsecs_t start = systemTime();
+        for (int i = 0; i < kIterations; i++) {
+            builder.update(args);
+        }
+        return (systemTime() - start) / kIterations;
+    };
+    auto visibleLayerIds = [](const LayerSnapshotBuilder& builder) {
+        std::vector<uint32_t> ids;
+        builder.forEachVisibleSnapshot(
+                [&ids](const LayerSnapshot& snapshot) { ids.push_back(snapshot.path.id); });
+        return ids;
+    };
+
+    LayerSnapshotBuilder serialBuilder;
+    LayerSnapshotBuilder parallelBuilder;
+    parallelBuilder.setParallelism(3);
+    const nsecs_t serialTime = timeUpdates(serialBuilder);
+    const nsecs_t parallelTime = timeUpdates(parallelBuilder);
+    RecordProperty("serialUpdateNs", std::to_string(serialTime));
+    RecordProperty("parallelUpdateNs", std::to_string(parallelTime));
+
+    EXPECT_EQ(serialBuilder.getSnapshots().size(), parallelBuilder.getSnapshots().size());
+    EXPECT_EQ(visibleLayerIds(serialBuilder), visibleLayerIds(parallelBuilder));
+    mLifecycleManager.commitChanges();
+}
+
 } // namespace android::surfaceflinger::frontend
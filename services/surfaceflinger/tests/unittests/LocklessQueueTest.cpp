@@ -0,0 +1,112 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "LocklessQueue.h"
+
+namespace android {
+namespace {
+
+TEST(LocklessQueueTest, popsInPushOrder) {
+    LocklessQueue<int> queue;
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_FALSE(queue.pop().has_value());
+
+    queue.push(1);
+    queue.push(2);
+    EXPECT_EQ(1, queue.pop());
+    queue.push(3);
+    EXPECT_EQ(2, queue.pop());
+    EXPECT_EQ(3, queue.pop());
+    EXPECT_TRUE(queue.isEmpty());
+    EXPECT_FALSE(queue.pop().has_value());
+}
+
+TEST(LocklessQueueTest, movesValues) {
+    LocklessQueue<std::unique_ptr<int>> queue;
+    queue.push(std::make_unique<int>(42));
+    auto value = queue.pop();
+    ASSERT_TRUE(value.has_value());
+    ASSERT_NE(nullptr, *value);
+    EXPECT_EQ(42, **value);
+}
+
+TEST(LocklessQueueTest, reusesEntries) {
+    LocklessQueue<int> queue;
+    for (int i = 0; i < 10'000; i++) {
+        queue.push(i);
+        queue.push(i);
+        EXPECT_EQ(i, queue.pop());
+        EXPECT_EQ(i, queue.pop());
+    }
+    EXPECT_EQ(LocklessQueue<int>::kEntriesPerChunk, queue.capacity());
+
+    // A backlog larger than one chunk grows the pool, which is then kept.
+    const int backlog = 3 * LocklessQueue<int>::kEntriesPerChunk;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < backlog; i++) queue.push(i);
+        for (int i = 0; i < backlog; i++) EXPECT_EQ(i, queue.pop());
+    }
+    EXPECT_EQ(static_cast<size_t>(backlog), queue.capacity());
+}
+
+TEST(LocklessQueueTest, overflowsPastMaxChunks) {
+    using Queue = LocklessQueue<int>;
+    const int count = Queue::kMaxChunks * Queue::kEntriesPerChunk + 10;
+    auto queue = std::make_unique<Queue>();
+    for (int i = 0; i < count; i++) queue->push(i);
+    EXPECT_EQ(Queue::kMaxChunks * Queue::kEntriesPerChunk, queue->capacity());
+    for (int i = 0; i < count / 2; i++) EXPECT_EQ(i, queue->pop());
+    // Destroying a non-empty queue frees both pooled and overflow entries.
+    queue.reset();
+}
+
+TEST(LocklessQueueTest, multipleProducers) {
+    constexpr int kProducers = 8;
+    constexpr int kPerProducer = 10'000;
+    LocklessQueue<std::pair<int, int>> queue;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < kPerProducer; i++) queue.push({p, i});
+        });
+    }
+
+    // Values from the same producer must come out in the order they were pushed.
+    std::vector<int> next(kProducers, 0);
+    int received = 0;
+    while (received < kProducers * kPerProducer) {
+        auto value = queue.pop();
+        if (!value) {
+            std::this_thread::yield();
+            continue;
+        }
+        auto [producer, sequence] = *value;
+        ASSERT_EQ(next[producer], sequence);
+        next[producer]++;
+        received++;
+    }
+    for (auto& producer : producers) producer.join();
+    EXPECT_TRUE(queue.isEmpty());
+}
+
+} // namespace
+} // namespace android
@@ -100,6 +100,8 @@ struct TestableRefreshRateSelector : RefreshRateSelector {
     const std::vector<Fps>& knownFrameRates() const { return mKnownFrameRates; }
 
     using RefreshRateSelector::GetRankedFrameRatesCache;
+    using RefreshRateSelector::getRankedFrameRatesFingerprint;
+    using RefreshRateSelector::kGetRankedFrameRatesCacheSize;
     auto& mutableGetRankedRefreshRatesCache() { return mGetRankedFrameRatesCache; }
 
     auto getRankedFrameRates(const std::vector<LayerRequirement>& layers,
@@ -2643,15 +2645,43 @@ TEST_P(RefreshRateSelectorTest, getBestFrameRateMode_ReadsCache) {
                                                                   {90_Hz, kMode90}}},
                                                           GlobalSignals{.touch = true}};
 
-    selector.mutableGetRankedRefreshRatesCache() = {args, result};
+    selector.mutableGetRankedRefreshRatesCache().push_back(
+            {TestableRefreshRateSelector::getRankedFrameRatesFingerprint(args.first, args.second),
+             args, result});
 
     EXPECT_EQ(result, selector.getRankedFrameRates(args.first, args.second));
 }
 
+TEST_P(RefreshRateSelectorTest, getBestFrameRateMode_ComparesCachedArguments) {
+    auto selector = createSelector(kModes_30_60_72_90_120, kModeId60);
+
+    using GlobalSignals = RefreshRateSelector::GlobalSignals;
+    const auto args = std::make_pair(std::vector<LayerRequirement>{{.weight = 1.f}},
+                                     GlobalSignals{.touch = true, .idle = true});
+
+    const RefreshRateSelector::RankedFrameRates result = {{RefreshRateSelector::ScoredFrameRate{
+                                                                  {90_Hz, kMode90}}},
+                                                          GlobalSignals{.touch = true}};
+
+    // The desired refresh rate does not contribute to the fingerprint.
+    auto cachedArgs = args;
+    cachedArgs.first[0].desiredRefreshRate = 30_Hz;
+    ASSERT_EQ(TestableRefreshRateSelector::getRankedFrameRatesFingerprint(cachedArgs.first,
+                                                                          cachedArgs.second),
+              TestableRefreshRateSelector::getRankedFrameRatesFingerprint(args.first,
+                                                                          args.second));
+
+    selector.mutableGetRankedRefreshRatesCache().push_back(
+            {TestableRefreshRateSelector::getRankedFrameRatesFingerprint(args.first, args.second),
+             cachedArgs, result});
+
+    EXPECT_NE(result, selector.getRankedFrameRates(args.first, args.second));
+}
+
 TEST_P(RefreshRateSelectorTest, getBestFrameRateMode_WritesCache) {
     auto selector = createSelector(kModes_30_60_72_90_120, kModeId60);
 
-    EXPECT_FALSE(selector.mutableGetRankedRefreshRatesCache());
+    EXPECT_TRUE(selector.mutableGetRankedRefreshRatesCache().empty());
 
     std::vector<LayerRequirement> layers = {{.weight = 1.f}, {.weight = 0.5f}};
     RefreshRateSelector::GlobalSignals globalSignals{.touch = true, .idle = true};
@@ -2659,10 +2689,43 @@ TEST_P(RefreshRateSelectorTest, getBestFrameRateMode_WritesCache) {
     const auto result = selector.getRankedFrameRates(layers, globalSignals);
 
     const auto& cache = selector.mutableGetRankedRefreshRatesCache();
-    ASSERT_TRUE(cache);
+    ASSERT_EQ(1u, cache.size());
+
+    EXPECT_EQ(cache.back().arguments, std::make_pair(layers, globalSignals));
+    EXPECT_EQ(cache.back().result, result);
+}
+
+TEST_P(RefreshRateSelectorTest, getBestFrameRateMode_EvictsLeastRecentlyUsedCache) {
+    auto selector = createSelector(kModes_30_60_72_90_120, kModeId60);
 
-    EXPECT_EQ(cache->arguments, std::make_pair(layers, globalSignals));
-    EXPECT_EQ(cache->result, result);
+    constexpr size_t kCacheSize = TestableRefreshRateSelector::kGetRankedFrameRatesCacheSize;
+    const auto layersFor = [](size_t i) {
+        return std::vector<LayerRequirement>{{.vote = LayerVoteType::ExplicitDefault,
+                                              .desiredRefreshRate = Fps::fromValue(30.f + i),
+                                              .weight = 1.f}};
+    };
+
+    for (size_t i = 0; i < kCacheSize; i++) {
+        selector.getRankedFrameRates(layersFor(i), {});
+    }
+
+    const auto& cache = selector.mutableGetRankedRefreshRatesCache();
+    ASSERT_EQ(kCacheSize, cache.size());
+
+    // Reading the oldest entry makes it the most recently used.
+    selector.getRankedFrameRates(layersFor(0), {});
+    ASSERT_EQ(kCacheSize, cache.size());
+    EXPECT_EQ(layersFor(0), cache.back().arguments.first);
+    EXPECT_EQ(layersFor(1), cache.front().arguments.first);
+
+    // So a new entry evicts the next oldest one.
+    selector.getRankedFrameRates(layersFor(kCacheSize), {});
+    ASSERT_EQ(kCacheSize, cache.size());
+    EXPECT_EQ(layersFor(kCacheSize), cache.back().arguments.first);
+    EXPECT_EQ(layersFor(2), cache.front().arguments.first);
+    EXPECT_TRUE(std::none_of(cache.begin(), cache.end(), [&](const auto& entry) {
+        return entry.arguments.first == layersFor(1);
+    }));
 }
 
 TEST_P(RefreshRateSelectorTest, getBestFrameRateMode_ExplicitExactTouchBoost) {
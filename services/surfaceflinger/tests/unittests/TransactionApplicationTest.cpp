@@ -909,6 +909,193 @@ TEST(TransactionHandlerTest, QueueTransaction) {
     EXPECT_EQ(transactionsReadyToBeApplied.front().id, 42u);
 }
 
+TransactionState createTransactionForCoalescing(const sp<IBinder>& applyToken, uint64_t id) {
+    TransactionState transaction;
+    transaction.applyToken = applyToken;
+    transaction.id = id;
+    transaction.flags = 0;
+    transaction.desiredPresentTime = 0;
+    transaction.isAutoTimestamp = true;
+    transaction.postTime = 0;
+    transaction.hasListenerCallbacks = false;
+    transaction.originPid = 1;
+    transaction.originUid = 1;
+    return transaction;
+}
+
+ResolvedComposerState createStateForCoalescing(uint32_t layerId, uint64_t what) {
+    ResolvedComposerState state;
+    state.layerId = layerId;
+    state.state.what = what;
+    return state;
+}
+
+TEST(TransactionHandlerTest, CoalescesTransactionsFromSameApplyToken) {
+    TransactionHandler handler;
+    auto applyToken = sp<BBinder>::make();
+
+    TransactionState transaction1 = createTransactionForCoalescing(applyToken, 1);
+    transaction1.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+    transaction1.states.back().state.x = 10.f;
+    transaction1.states.push_back(createStateForCoalescing(2, layer_state_t::eAlphaChanged));
+    TransactionState transaction2 = createTransactionForCoalescing(applyToken, 2);
+    transaction2.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+    transaction2.states.back().state.x = 20.f;
+    transaction2.states.push_back(createStateForCoalescing(2, layer_state_t::eAlphaChanged));
+    transaction2.mergedTransactionIds = {5};
+    TransactionState transaction3 = createTransactionForCoalescing(applyToken, 3);
+    transaction3.states.push_back(createStateForCoalescing(1, layer_state_t::eAlphaChanged));
+    transaction3.states.back().state.color.a = 0.5f;
+    transaction3.states.push_back(createStateForCoalescing(2, layer_state_t::ePositionChanged));
+
+    handler.queueTransaction(std::move(transaction1));
+    handler.queueTransaction(std::move(transaction2));
+    handler.queueTransaction(std::move(transaction3));
+    handler.collectTransactions();
+    std::vector<TransactionState> transactions = handler.flushTransactions();
+
+    ASSERT_EQ(transactions.size(), 1u);
+    EXPECT_EQ(transactions[0].id, 1u);
+    EXPECT_EQ(transactions[0].coalescedTransactionIds, (std::vector<uint64_t>{2, 3}));
+    EXPECT_EQ(transactions[0].mergedTransactionIds, (std::vector<uint64_t>{2, 5, 3}));
+    ASSERT_EQ(transactions[0].states.size(), 2u);
+    const layer_state_t& layer1 = transactions[0].states[0].state;
+    EXPECT_EQ(transactions[0].states[0].layerId, 1u);
+    EXPECT_EQ(layer1.what, layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged);
+    EXPECT_EQ(layer1.x, 20.f);
+    EXPECT_EQ(layer1.color.a, 0.5f);
+    EXPECT_EQ(transactions[0].states[1].layerId, 2u);
+    EXPECT_EQ(transactions[0].states[1].state.what,
+              layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged);
+}
+
+TEST(TransactionHandlerTest, DoesNotCoalesceTransactionsChangingDifferentLayers) {
+    TransactionHandler handler;
+    auto applyToken = sp<BBinder>::make();
+    TransactionState transaction1 = createTransactionForCoalescing(applyToken, 1);
+    transaction1.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+    TransactionState transaction2 = createTransactionForCoalescing(applyToken, 2);
+    transaction2.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+    transaction2.states.push_back(createStateForCoalescing(2, layer_state_t::ePositionChanged));
+    TransactionState transaction3 = createTransactionForCoalescing(applyToken, 3);
+    transaction3.states.push_back(createStateForCoalescing(2, layer_state_t::ePositionChanged));
+    transaction3.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+
+    handler.queueTransaction(std::move(transaction1));
+    handler.queueTransaction(std::move(transaction2));
+    handler.queueTransaction(std::move(transaction3));
+    handler.collectTransactions();
+    std::vector<TransactionState> transactions = handler.flushTransactions();
+
+    // Folding would reorder the changes to layer 2 relative to the changes to layer 1.
+    ASSERT_EQ(transactions.size(), 3u);
+    for (size_t i = 0; i < transactions.size(); i++) {
+        EXPECT_EQ(transactions[i].id, i + 1);
+        EXPECT_TRUE(transactions[i].coalescedTransactionIds.empty());
+    }
+}
+
+TEST(TransactionHandlerTest, DoesNotCoalesceHierarchyChanges) {
+    TransactionHandler handler;
+    auto applyToken = sp<BBinder>::make();
+    TransactionState transaction1 = createTransactionForCoalescing(applyToken, 1);
+    transaction1.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+    TransactionState transaction2 = createTransactionForCoalescing(applyToken, 2);
+    transaction2.states.push_back(createStateForCoalescing(1, layer_state_t::eReparent));
+    TransactionState transaction3 = createTransactionForCoalescing(applyToken, 3);
+    transaction3.states.push_back(createStateForCoalescing(1, layer_state_t::eLayerChanged));
+    TransactionState transaction4 = createTransactionForCoalescing(applyToken, 4);
+    transaction4.states.push_back(
+            createStateForCoalescing(1, layer_state_t::eRelativeLayerChanged));
+
+    handler.queueTransaction(std::move(transaction1));
+    handler.queueTransaction(std::move(transaction2));
+    handler.queueTransaction(std::move(transaction3));
+    handler.queueTransaction(std::move(transaction4));
+    handler.collectTransactions();
+    std::vector<TransactionState> transactions = handler.flushTransactions();
+
+    ASSERT_EQ(transactions.size(), 4u);
+    for (size_t i = 0; i < transactions.size(); i++) {
+        EXPECT_EQ(transactions[i].id, i + 1);
+    }
+}
+
+TEST(TransactionHandlerTest, DoesNotCoalesceAcrossApplyTokens) {
+    TransactionHandler handler;
+    TransactionState transaction1 = createTransactionForCoalescing(sp<BBinder>::make(), 1);
+    transaction1.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+    TransactionState transaction2 = createTransactionForCoalescing(sp<BBinder>::make(), 2);
+    transaction2.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+
+    handler.queueTransaction(std::move(transaction1));
+    handler.queueTransaction(std::move(transaction2));
+    handler.collectTransactions();
+    std::vector<TransactionState> transactions = handler.flushTransactions();
+
+    ASSERT_EQ(transactions.size(), 2u);
+    EXPECT_TRUE(transactions[0].coalescedTransactionIds.empty());
+    EXPECT_TRUE(transactions[1].coalescedTransactionIds.empty());
+}
+
+TEST(TransactionHandlerTest, DoesNotCoalesceBufferTransactions) {
+    TransactionHandler handler;
+    auto applyToken = sp<BBinder>::make();
+    TransactionState transaction1 = createTransactionForCoalescing(applyToken, 1);
+    transaction1.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+    TransactionState transaction2 = createTransactionForCoalescing(applyToken, 2);
+    transaction2.states.push_back(createStateForCoalescing(1, layer_state_t::eBufferChanged));
+    TransactionState transaction3 = createTransactionForCoalescing(applyToken, 3);
+    transaction3.states.push_back(createStateForCoalescing(1, layer_state_t::ePositionChanged));
+    TransactionState transaction4 = createTransactionForCoalescing(applyToken, 4);
+    transaction4.states.push_back(createStateForCoalescing(1, layer_state_t::eAlphaChanged));
+    transaction4.flags = ISurfaceComposer::eAnimation;
+
+    handler.queueTransaction(std::move(transaction1));
+    handler.queueTransaction(std::move(transaction2));
+    handler.queueTransaction(std::move(transaction3));
+    handler.queueTransaction(std::move(transaction4));
+    handler.collectTransactions();
+    std::vector<TransactionState> transactions = handler.flushTransactions();
+
+    // Transactions stay in order and nothing is folded around the buffer or across flags.
+    ASSERT_EQ(transactions.size(), 4u);
+    for (size_t i = 0; i < transactions.size(); i++) {
+        EXPECT_EQ(transactions[i].id, i + 1);
+    }
+}
+
+TEST(TransactionHandlerTest, CoalescingKeepsCallbacks) {
+    TransactionHandler handler;
+    auto applyToken = sp<BBinder>::make();
+    auto listener1 = sp<BBinder>::make();
+    auto listener2 = sp<BBinder>::make();
+
+    TransactionState transaction1 = createTransactionForCoalescing(applyToken, 1);
+    transaction1.states.push_back(
+            createStateForCoalescing(1, layer_state_t::eHasListenerCallbacksChanged));
+    transaction1.states.back().state.listeners.emplace_back(listener1, std::vector<CallbackId>{});
+    transaction1.hasListenerCallbacks = true;
+    transaction1.listenerCallbacks.emplace_back(listener1, std::vector<CallbackId>{});
+    TransactionState transaction2 = createTransactionForCoalescing(applyToken, 2);
+    transaction2.states.push_back(
+            createStateForCoalescing(1, layer_state_t::eHasListenerCallbacksChanged));
+    transaction2.states.back().state.listeners.emplace_back(listener2, std::vector<CallbackId>{});
+    transaction2.hasListenerCallbacks = true;
+    transaction2.listenerCallbacks.emplace_back(listener2, std::vector<CallbackId>{});
+
+    handler.queueTransaction(std::move(transaction1));
+    handler.queueTransaction(std::move(transaction2));
+    handler.collectTransactions();
+    std::vector<TransactionState> transactions = handler.flushTransactions();
+
+    ASSERT_EQ(transactions.size(), 1u);
+    EXPECT_TRUE(transactions[0].hasListenerCallbacks);
+    EXPECT_EQ(transactions[0].listenerCallbacks.size(), 2u);
+    ASSERT_EQ(transactions[0].states.size(), 1u);
+    EXPECT_EQ(transactions[0].states[0].state.listeners.size(), 2u);
+}
+
 TEST(TransactionHandlerTest, TransactionsKeepTrackOfDirectMerges) {
     SurfaceComposerClient::Transaction transaction1, transaction2, transaction3, transaction4;
 
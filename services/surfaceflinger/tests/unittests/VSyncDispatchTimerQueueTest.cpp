@@ -1182,6 +1182,50 @@ TEST_F(VSyncDispatchTimerQueueTest, dontskipAVsyc) {
     EXPECT_THAT(cb.mReadyTime[0], Eq(1000));
 }
 
+TEST_F(VSyncDispatchTimerQueueTest, dispatchesScheduledAmongManyCallbacks) {
+    std::vector<std::unique_ptr<CountingCallback>> callbacks;
+    for (int i = 0; i < 64; i++) {
+        callbacks.push_back(std::make_unique<CountingCallback>(mDispatch));
+    }
+    CountingCallback& cb0 = *callbacks[10];
+    CountingCallback& cb1 = *callbacks[20];
+    CountingCallback& cb2 = *callbacks[30];
+
+    Sequence seq;
+    EXPECT_CALL(mMockClock, alarmAt(_, 900)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmAt(_, 800)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmAt(_, 700)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmAt(_, 800)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmAt(_, 900)).InSequence(seq);
+    EXPECT_CALL(mMockClock, alarmAt(_, 1800)).InSequence(seq);
+
+    mDispatch->schedule(cb0, {.workDuration = 100, .readyDuration = 0, .earliestVsync = mPeriod});
+    mDispatch->schedule(cb1, {.workDuration = 200, .readyDuration = 0, .earliestVsync = mPeriod});
+    mDispatch->schedule(cb2, {.workDuration = 300, .readyDuration = 0, .earliestVsync = mPeriod});
+    EXPECT_EQ(CancelResult::Cancelled, mDispatch->cancel(cb2));
+
+    advanceToNextCallback();
+    ASSERT_THAT(cb1.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb1.mCalls[0], Eq(1000));
+    EXPECT_THAT(cb0.mCalls.size(), Eq(0));
+
+    advanceToNextCallback();
+    ASSERT_THAT(cb0.mCalls.size(), Eq(1));
+    EXPECT_THAT(cb0.mCalls[0], Eq(1000));
+
+    mDispatch->schedule(cb1,
+                        {.workDuration = 200, .readyDuration = 0, .earliestVsync = 2 * mPeriod});
+    advanceToNextCallback();
+    ASSERT_THAT(cb1.mCalls.size(), Eq(2));
+    EXPECT_THAT(cb1.mCalls[1], Eq(2000));
+
+    for (const auto& callback : callbacks) {
+        if (callback.get() != &cb0 && callback.get() != &cb1) {
+            EXPECT_THAT(callback->mCalls.size(), Eq(0));
+        }
+    }
+}
+
 class VSyncDispatchTimerQueueEntryTest : public testing::Test {
 protected:
     nsecs_t const mPeriod = 1000;
@@ -31,7 +31,10 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <thread>
 #include <utility>
 
 #include <com_android_graphics_surfaceflinger_flags.h>
@@ -75,6 +78,31 @@ ftl::NonNull<DisplayModePtr> displayMode(nsecs_t period) {
     return ftl::as_non_null(createDisplayMode(DisplayModeId(0), refreshRate, kGroup, kResolution,
                                               DEFAULT_DISPLAY_ID));
 }
+
+// A full least squares fit of |window|, with the ordinals snapped with |period|.
+VSyncPredictor::Model fullFit(const std::deque<nsecs_t>& window, nsecs_t period) {
+    constexpr int64_t kScalingFactor = 1000;
+    const auto n = static_cast<int64_t>(window.size());
+    const auto oldest = *std::min_element(window.begin(), window.end());
+    nsecs_t meanTS = 0;
+    nsecs_t meanOrdinal = 0;
+    for (const auto timestamp : window) {
+        meanTS += timestamp - oldest;
+        meanOrdinal += (timestamp - oldest + period / 2) / period * kScalingFactor;
+    }
+    meanTS /= n;
+    meanOrdinal /= n;
+
+    nsecs_t top = 0;
+    nsecs_t bottom = 0;
+    for (const auto timestamp : window) {
+        const auto ordinal = (timestamp - oldest + period / 2) / period * kScalingFactor;
+        top += (timestamp - oldest - meanTS) * (ordinal - meanOrdinal);
+        bottom += (ordinal - meanOrdinal) * (ordinal - meanOrdinal);
+    }
+    const nsecs_t slope = top * kScalingFactor / bottom;
+    return VSyncPredictor::Model{slope, meanTS - slope * meanOrdinal / kScalingFactor};
+}
 } // namespace
 
 struct VSyncPredictorTest : testing::Test {
@@ -731,6 +759,82 @@ TEST_F(VSyncPredictorTest, adjustsVrrTimeline) {
     EXPECT_EQ(4000, vrrTracker.nextAnticipatedVSyncTimeFrom(3300));
 }
 
+TEST_F(VSyncPredictorTest, incrementalModelMatchesFullFit) {
+    // A slightly slow display with jitter, a few missed vsyncs and one timestamp that is far off.
+    std::deque<nsecs_t> window;
+    nsecs_t timestamp = 0;
+    for (int i = 0; i < 500; i++) {
+        timestamp += i % 97 == 0 ? 3 * mPeriod : mPeriod + 3;
+        const nsecs_t jitter = i == 250 ? 200 : (i * 37) % 61 - 30;
+
+        const auto period = tracker.getVSyncPredictionModel().slope;
+        ASSERT_TRUE(tracker.addVsyncTimestamp(timestamp + jitter));
+
+        window.push_back(timestamp + jitter);
+        if (window.size() > kHistorySize) window.pop_front();
+        if (window.size() < kMinimumSamplesForPrediction) continue;
+
+        const auto expected = fullFit(window, period);
+        const auto model = tracker.getVSyncPredictionModel();
+        EXPECT_EQ(expected.slope, model.slope) << "after timestamp " << i;
+        EXPECT_EQ(expected.intercept, model.intercept) << "after timestamp " << i;
+    }
+}
+
+TEST_F(VSyncPredictorTest, incrementalModelMatchesFullFitWithLongHistory) {
+    // A steady display, so that the running sums are mostly updated incrementally, and rebuilt
+    // once per window. The rare late timestamps move the period, which forces rebuilds for a while.
+    constexpr size_t kLongHistorySize = 512;
+    constexpr size_t kTimestamps = 4 * kLongHistorySize;
+    VSyncPredictor tracker{mMode, kLongHistorySize, kMinimumSamplesForPrediction,
+                           kOutlierTolerancePercent, mVsyncTrackerCallback};
+
+    std::deque<nsecs_t> window;
+    for (size_t i = 1; i <= kTimestamps; i++) {
+        const nsecs_t timestamp = static_cast<nsecs_t>(i) * mPeriod + (i % 1000 == 0 ? 20 : 0);
+
+        const auto period = tracker.getVSyncPredictionModel().slope;
+        ASSERT_TRUE(tracker.addVsyncTimestamp(timestamp));
+
+        window.push_back(timestamp);
+        if (window.size() > kLongHistorySize) window.pop_front();
+        if (window.size() < kMinimumSamplesForPrediction) continue;
+
+        const auto expected = fullFit(window, period);
+        const auto model = tracker.getVSyncPredictionModel();
+        ASSERT_EQ(expected.slope, model.slope) << "after timestamp " << i;
+        ASSERT_EQ(expected.intercept, model.intercept) << "after timestamp " << i;
+    }
+}
+
+TEST_F(VSyncPredictorTest, predictsWhileModelIsUpdated) {
+    constexpr size_t kTimestamps = 10'000;
+    std::atomic<nsecs_t> lastTimestamp = 0;
+    std::atomic<bool> done = false;
+
+    std::thread writer([&] {
+        for (size_t i = 1; i <= kTimestamps; i++) {
+            const auto timestamp = static_cast<nsecs_t>(i) * mPeriod;
+            tracker.addVsyncTimestamp(timestamp);
+            lastTimestamp = timestamp;
+        }
+        done = true;
+    });
+
+    while (!done) {
+        const nsecs_t timePoint = lastTimestamp + mPeriod / 3;
+        const auto prediction = tracker.nextAnticipatedVSyncTimeFrom(timePoint);
+        EXPECT_THAT(prediction, Ge(timePoint));
+        EXPECT_THAT(tracker.currentPeriod(), IsCloseTo(mPeriod, mMaxRoundingError));
+        tracker.isVSyncInPhase(timePoint, Fps::fromPeriodNsecs(mPeriod * 2));
+    }
+    writer.join();
+
+    EXPECT_FALSE(tracker.needsMoreSamples());
+    EXPECT_THAT(tracker.nextAnticipatedVSyncTimeFrom(kTimestamps * mPeriod + 1),
+                IsCloseTo((kTimestamps + 1) * mPeriod, mMaxRoundingError));
+}
+
 } // namespace android::scheduler
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues